@@ -2,6 +2,7 @@
 #include <string.h>
 #include "pico/stdlib.h"
 #include "mpu9250.h"
+#include "config_store.h"
 
 int main() {
     stdio_init_all();
@@ -12,15 +13,48 @@ int main() {
 
     start_spi();  //Starts the mpu
 
-    int16_t acceleration[3], gyro[3], mag[3];
     int16_t accCal[3], gyroCal[3], magCal[3];
-
-    calibrate_acc(accCal, 2000); // Calibrates the acc
-    printf("Offset accl. X=%d, Y=%d, Z=%d\n", accCal[0], accCal[1], accCal[2]);
-
-    calibrate_mag(magCal, 2000); // Calibrates the mag
-    printf("Offset  mag. X=%d, Y=%d, Z=%d\n", magCal[0], magCal[1], magCal[2]);
-
-    calibrate_gyro(gyroCal, 2000);  //Calibrates the gyro
-    printf("Offset gyro. X=%d, Y=%d, Z=%d\n", gyroCal[0], gyroCal[1], gyroCal[2]);
-}
+    calib_stats_t accStats, gyroStats, magStats;
+    float var[3];
+
+    absolute_time_t start = get_absolute_time();
+    int used = calibrate_still_dev(&mpu9250_default_dev, &accStats, &gyroStats, &magStats, 2000); // Calibrates the three sensors, keep the board still and flat
+    printf("Still calibration: %d samples in %d ms\n", used, (int)(absolute_time_diff_us(start, get_absolute_time()) / 1000));
+
+    calib_stats_offset(&accStats, accCal);
+    calib_stats_variance(&accStats, var);
+    printf("Offset accl. X=%d, Y=%d, Z=%d (var %.1f %.1f %.1f)\n", accCal[0], accCal[1], accCal[2], var[0], var[1], var[2]);
+
+    calib_stats_offset(&magStats, magCal);
+    calib_stats_variance(&magStats, var);
+    printf("Offset  mag. X=%d, Y=%d, Z=%d (var %.1f %.1f %.1f)\n", magCal[0], magCal[1], magCal[2], var[0], var[1], var[2]);
+
+    calib_stats_offset(&gyroStats, gyroCal);
+    calib_stats_variance(&gyroStats, var);
+    printf("Offset gyro. X=%d, Y=%d, Z=%d (var %.1f %.1f %.1f)\n", gyroCal[0], gyroCal[1], gyroCal[2], var[0], var[1], var[2]);
+
+    printf("Rotate the board in every direction for 15 s...\n");
+    calib_mag_t magFit;
+    if (calibrate_mag_ellipsoid_dev(&mpu9250_default_dev, &magFit, 15000)) // Hard/soft iron fit of the magnetometer
+    {
+        printf("Mag hard iron X=%.1f, Y=%.1f, Z=%.1f\n", magFit.offset[0], magFit.offset[1], magFit.offset[2]);
+        printf("Mag soft iron X=%.3f, Y=%.3f, Z=%.3f\n", magFit.scale[0], magFit.scale[1], magFit.scale[2]);
+        printf("Mag radius %.1f, residual %.2f%%, quality %.2f\n", magFit.radius, magFit.rms * 100, magFit.quality);
+    }
+    else
+    {
+        printf("Mag fit failed, rotate the board through more orientations\n");
+    }
+
+    config_t *config = config_edit();  //Stores the result so telemetria boots without recalibrating
+    for (int i = 0; i < 3; i++)
+    {
+        config->acc_offset[i] = accCal[i];
+        config->gyro_offset[i] = gyroCal[i];
+        config->mag_offset[i] = magFit.quality > 0.5f ? (int16_t)magFit.offset[i] : magCal[i];
+        config->mag_scale[i] = magFit.quality > 0.5f ? magFit.scale[i] : 1.0f;
+    }
+    config->acc_offset[2] -= accCal[2] > 0 ? 16384 : -16384;  //Keeps 1 g on Z, whichever side is up
+    config->calibrated = true;
+    printf(config_save(config) ? "Calibration saved to flash\n" : "Could not save the calibration\n");
+}
\ No newline at end of file
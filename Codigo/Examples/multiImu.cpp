@@ -0,0 +1,86 @@
+#include "mpuObject.h"
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "spsc_ring.h"
+
+// Two IMUs sharing spi0: MISO 4, SCK 6, MOSI 7, one chip select each
+const mpu9250_dev_t imuDevs[] = {{spi0, 5}, {spi0, 13}};
+const int IMU_COUNT = sizeof(imuDevs) / sizeof(imuDevs[0]);
+
+struct ImuFrame  // One pass over the bus
+{
+    uint64_t t_us;
+    mpu9250_sample_t samples[MPU9250_MAX_DEVICES];
+};
+
+static mpu9250_bus_t bus;
+static SpscRing<ImuFrame, 64> frames;  // Core 1 reads the bus, core 0 runs the fusion
+static volatile uint32_t framesDropped = 0;
+
+void core1_main()  //Reads every IMU back to back and queues the samples
+{
+    while (1)
+    {
+        uint32_t count;
+        ImuFrame *frame = frames.write_span(count);  //Reads straight into the queue, no copy
+        if (count == 0)
+        {
+            ImuFrame lost;
+            mpu9250_bus_read_all(&bus, lost.samples);  //Core 0 is behind, keep the bus rate and count the loss
+            framesDropped++;
+            continue;
+        }
+        frame->t_us = time_us_64();
+        mpu9250_bus_read_all(&bus, frame->samples);
+        frames.write_commit(1);
+    }
+}
+
+int main()
+{
+    stdio_init_all();
+
+    sleep_ms(10000);
+
+    printf("Hello, MPU9250! Reading %d IMUs on one SPI bus...\n", IMU_COUNT);
+
+    mpu9250_bus_init(&bus, spi0, 4, 6, 7, 1000 * 1000);
+    for (int i = 0; i < IMU_COUNT; i++)
+    {
+        if (!mpu9250_bus_add(&bus, &imuDevs[i])) printf("IMU %d on CS %d not responding\n", i, imuDevs[i].pin_cs);
+    }
+    printf("SPI at %lu Hz, DMA %s\n", (unsigned long)bus.baudrate, bus.dma_tx >= 0 ? "on" : "off");
+
+    mpu9250 imu0(&imuDevs[0], 100);  //Creates one object per IMU, calibrates before core 1 owns the bus
+    mpu9250 imu1(&imuDevs[1], 100);
+
+    multicore_launch_core1(core1_main);
+
+    uint32_t passes = 0;
+    absolute_time_t start = get_absolute_time();
+
+    while (1)
+    {
+        uint32_t count;
+        const ImuFrame *frame = frames.read_span(count);  //Every frame queued so far, in place
+        for (uint32_t i = 0; i < count; i++)
+        {
+            imu0.updateAngles(frame[i].samples[0], frame[i].t_us);
+            imu1.updateAngles(frame[i].samples[1], frame[i].t_us);
+        }
+        frames.read_commit(count);
+        passes += count;
+
+        int64_t elapsed = absolute_time_diff_us(start, get_absolute_time());
+        if (elapsed >= 1000000)
+        {
+            printf("%lu samples/s over %d IMUs, %lu frames dropped\n", (unsigned long)(passes * bus.count * 1000000ull / elapsed), bus.count,
+                   (unsigned long)framesDropped);
+            imu0.printData();
+            imu1.printData();
+            passes = 0;
+            start = get_absolute_time();
+        }
+    }
+}
\ No newline at end of file
@@ -1,8 +1,9 @@
 #include "mpuObject.h"
 #include <stdio.h>
 #include "pico/stdlib.h"
-
-mpu9250 mpu(100);  //Creates an mpu object
+extern "C" {
+    #include "config_store.h"
+}
 
 int main()
 {
@@ -12,6 +13,16 @@ int main()
 
     printf("Hello, MPU9250! Reading raw data from registers via SPI...\n");
 
+    config_t *config = config_edit();
+    if (!config->calibrated)  //Calibrates only once, later boots use the offsets stored in flash
+    {
+        mpu9250 first(&mpu9250_default_dev, 100);
+        for (int i = 0; i < 3; i++) config->gyro_offset[i] = first.gyroCal[i];
+        config->calibrated = true;
+        config_save(config);
+    }
+    mpu9250 mpu(&mpu9250_default_dev, config->gyro_offset);  //Creates an mpu object
+
     while (1)
     {
         mpu.updateAngles();  //Uses the object to calculate the angles
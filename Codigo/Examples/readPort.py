@@ -37,21 +37,102 @@ def accept_connection(sock):
     print("Conexión establecida con {}:{}".format(address[0], address[1]))
     return conn
 
-def receive_data(conn, buffer_size=256):
-    # Recibe los datos de la conexión
-    data = conn.recv(buffer_size)
-    data = data.decode()
+def receive_data(conn, buffer_size=4096, idle_s=1.0):
+    # Recibe los datos de la conexión hasta que el equipo la cierra o deja de enviar por idle_s
+    # segundos (despues de "+++" el ESP puede dejarla abierta). Una conexion puede traer varias
+    # lineas: las que quedaron en la cola del equipo salen juntas con la siguiente.
+    conn.settimeout(idle_s)
+    chunks = []
+    while True:
+        try:
+            chunk = conn.recv(buffer_size)
+        except socket.timeout:
+            break
+        if not chunk:
+            break
+        chunks.append(chunk)
+    data = b''.join(chunks).decode(errors='replace')
     print("Datos recibidos: {}".format(data))
-    return data
+    return [line for line in data.split('\n') if line.strip()]
 
-def save_to_csv(data):
+def save_to_csv(data, path='datos.csv'):
     # Guarda los datos recibidos en un archivo CSV
     
-    with open('datos.csv', 'a', newline='') as file:
+    with open(path, 'a', newline='') as file:
         writer = csv.writer(file)
         data_str = data.strip()  # Convertir los datos a una cadena y eliminar espacios en blanco
         writer.writerow(data_str.split(','))  # Escribir los datos en el archivo CSV
-    print("Datos guardados en datos.csv")
+    print("Datos guardados en {}".format(path))
+
+def is_sample(line):
+    # Las muestras empiezan con la latitud; otras lineas (resumenes "VIB,...") empiezan con una palabra
+    try:
+        float(line.split(',', 1)[0])
+        return True
+    except ValueError:
+        return False
+
+def new_stats():
+    # Estadisticas de latencia y perdida calculadas con la secuencia y la hora UTC de cada muestra
+    return {'received': 0, 'lost': 0, 'duplicated': 0, 'reordered': 0, 'last_seq': None,
+            'latencies': [], 'device_reboots': 0, 'missing': set(), 'recent': {}, 'suppressed': 0}
+
+SEQ_WINDOW = 1000  # Gaps and received samples remembered to classify late arrivals
+
+def update_stats(stats, data):
+    # Actualiza las estadisticas con una linea "...,magz,seq,t_us,utc_us"
+    fields = data.strip().split(',')
+    if len(fields) < 14:
+        return  # Firmware sin secuencia ni hora
+    seq = int(fields[11])
+    t_us = int(fields[12])
+    utc_us = int(fields[13])
+    stats['received'] += 1
+
+    last = stats['last_seq']
+    missing, recent = stats['missing'], stats['recent']
+    if last is not None and seq <= last:
+        if recent.get(seq) == t_us:
+            stats['duplicated'] += 1
+            return
+        if seq in missing:
+            # A sample counted as lost arrived late
+            missing.discard(seq)
+            stats['lost'] -= 1
+            stats['reordered'] += 1
+            recent[seq] = t_us
+            return
+        # Neither a gap nor a repeat: the counter started again at 0 after a reset
+        stats['device_reboots'] += 1
+        missing.clear()
+        recent.clear()
+    elif last is not None and seq > last + 1:
+        stats['lost'] += seq - last - 1
+        missing.update(range(max(last + 1, seq - SEQ_WINDOW), seq))
+    stats['last_seq'] = seq
+    recent[seq] = t_us
+    if len(recent) > SEQ_WINDOW:
+        for old in [k for k in recent if k < seq - SEQ_WINDOW]:
+            del recent[old]
+        missing.difference_update([k for k in missing if k < seq - SEQ_WINDOW])
+
+    if utc_us > 0:
+        # End-to-end latency: from the IMU read on the device to now, both in UTC
+        stats['latencies'].append((time.time() * 1e6 - utc_us) / 1000.0)
+        del stats['latencies'][:-1000]
+
+def print_stats(stats):
+    # Muestra las estadisticas acumuladas
+    latencies = sorted(stats['latencies'])
+    total = stats['received'] + stats['lost']
+    loss = 100.0 * stats['lost'] / total if total else 0.0
+    if latencies:
+        p50 = latencies[len(latencies) // 2]
+        p95 = latencies[min(len(latencies) - 1, int(len(latencies) * 0.95))]
+        print("Latencia ms: p50 {:.1f} p95 {:.1f} max {:.1f}".format(p50, p95, latencies[-1]))
+    print("Recibidas {} perdidas {} ({:.2f}%) duplicadas {} desordenadas {} reinicios {} filtradas {}".format(
+        stats['received'], stats['lost'], loss, stats['duplicated'], stats['reordered'], stats['device_reboots'],
+        stats['suppressed']))
 
 def check_connection(host, port):
     # Comprueba la conexión al host y puerto
@@ -68,7 +149,9 @@ def check_connection(host, port):
 def main():
     with open('datos.csv', 'a', newline='') as file:
         writer = csv.writer(file)
-        writer.writerow(("Latitud,Longitud,accx,accy,accz,gyrox,gyroy,gyroz,magx,magy,magz").split(','))
+        # vel_n..sigma_e only come with nav_rate_hz on; rows without them just end after utc_us
+        writer.writerow(("Latitud,Longitud,accx,accy,accz,gyrox,gyroy,gyroz,magx,magy,magz,seq,t_us,utc_us,"
+                         "vel_n,vel_e,sigma_n,sigma_e").split(','))
     host = '192.168.70.109'  # Escucha en todas las interfaces de red disponibles
     port = 8080  # Puerto de escucha
     backlog = 5  # Número máximo de conexiones pendientes en la colas
@@ -76,11 +159,22 @@ def main():
     sock = create_socket()
     bind_socket(sock, host, port)
     listen_for_connections(sock, backlog)
+    stats = new_stats()
 
     while True:
         conn = accept_connection(sock)
-        data = receive_data(conn)
-        save_to_csv(data)
+        for line in receive_data(conn):
+            if line.startswith('FILTER,'):
+                # "FILTER,enviadas,filtradas": the report filter skips samples without using a seq
+                stats['suppressed'] = int(line.split(',')[2])
+                continue
+            if not is_sample(line):
+                save_to_csv(line, 'vibraciones.csv')  # Vibration summaries share the uplink
+                continue
+            save_to_csv(line)
+            update_stats(stats, line)
+            if stats['received'] and stats['received'] % 10 == 0:
+                print_stats(stats)
         conn.close()
 
 if __name__ == '__main__':
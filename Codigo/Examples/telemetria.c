@@ -12,13 +12,29 @@
 #include <string.h>
 #include <stdlib.h>
 #include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "pico/mutex.h"
 #include "hardware/uart.h" 
 #include "mpu9250.h"
 #include "gps.h"
+#include "gps_time.h"
+#include "config_store.h"
+#include "telemetry.h"
+#include "report_filter.h"
+#include "nav_ekf.h"
+#include "vibration.h"
+#include "power.h"
+#include "spsc_ring.h"
 #include <time.h>
 
 
 #define GPS_BAUDRATE 9600 // Baudrate for the GPS
+#define GPS_FIX_MAX_AGE_US 250000 // Older fixes, read after core 0 was blocked, are not given to the navigation
+#define IMU_INT_PIN 20 // MPU9250 INT, wakes the board on data ready in low power mode
+#define POWER_REPORT_MS 10000 // Time between duty cycle reports in low power mode
+#define FILTER_REPORT_MS 10000 // Time between report filter counters on the console
+#define NAV_REPORT_MS 10000 // Time between navigation step timings on the console
+#define VIBRATION_REPORT_MS 10000 // Time between vibration analysis timings on the console
 
 //WIFI///////////////////////////////////////////////////////////////////////////
 #define UART_ID uart1 
@@ -28,14 +44,35 @@
 #define UART_TX_PIN 8
 #define UART_RX_PIN 9
 
-char SSID[] = "Sebas";  // Wifi name
-char password[] = "12345678"; // Wifi password
-char ServerIP[] = "192.168.70.109"; // IP of the server
-char Port[] = "8080"; // Port of the server
-char uart_command[50] = ""; // Buffer for the uart commands
+char uart_command[128] = ""; // Buffer for the uart commands, network settings come from the flash config
 char buf[256] = {0}; // Buffer for the uart response
 
-bool send_sensor_values( char pos[]); // Function to send the sensor values to the server
+SPSC_RING_DEFINE(gpsRx, char, 1024);  // GPS bytes, filled by the uart interrupt (about 1 s at 9600 baud)
+SPSC_RING_DEFINE(gpsStarts, uint64_t, 64); // Arrival time of every '$' in gpsRx, NMEA lines are longer than 16 bytes
+SPSC_RING_DEFINE(uplink, char, 2048); // Lines waiting to be sent to the server, vibration summaries included
+SPSC_RING_DEFINE(vibrationOut, vibration_summary_t, 4); // Core 1 -> core 0, finished vibration windows
+
+/**
+ * @brief Fix del GPS que el nucleo 0 le pasa a la navegacion del nucleo 1.
+ */
+typedef struct {
+    float lat, lon;
+} nav_fix_t;
+
+SPSC_RING_DEFINE(navFixes, nav_fix_t, 8); // Core 0 -> core 1, every GPS fix for the navigation filter
+
+auto_init_mutex(imuLock);           // The IMU is read from both cores when core 1 runs
+static vibration_t vibration;       // Windows and FFT tables, used only by core 1
+static volatile uint32_t vibrationMaxUs, vibrationLate, vibrationDropped; // Written by core 1, printed by core 0
+static bool vibrationOn;            // Set by core 0 before core 1 starts
+static uint32_t navPeriodUs;        // Navigation step period on core 1, 0 when the navigation is off
+static bool core1Running;           // Core 1 must be locked out while the config is written to flash
+auto_init_mutex(navLock);           // Guards the navigation output published by core 1
+static nav_output_t navShared;      // Last navigation output, copied by core 0 for each sample
+static bool navSharedReady;         // navShared carries a position
+static volatile uint32_t navSteps, navBusyUs, navMaxUs, navLate, navFixCount, navRejected; // Written by core 1, printed by core 0
+
+bool send_sensor_values(spsc_ring_t *queue); // Function to send the sensor values to the server
 bool sendCMD(const char *cmd, const char *act); // Function to send commands to the ESP
 void connectToWifi(); //    Function to connect to the wifi
 
@@ -45,25 +82,34 @@ void connectToWifi(); //    Function to connect to the wifi
  * @brief Envia los datos del GPS y del acelerometro/gyroscopio al servidor.
  *
  * Esta función envía los valores de los sensores al servidor usando una conexión TCP.
- * Se conecta al servidor, envía los datos y cierra la conexión.
+ * Se conecta al servidor, envía todas las lineas que esperan en la cola y cierra la conexión.
+ * Las lineas salen de la cola sin copiarlas; si el ESP no acepta el envio se quedan para el siguiente intento.
  *
- * @param char pos[] este es el arreglo que contiene los datos del GPS y del acelerometro/gyroscopio.
+ * @param spsc_ring_t *queue cola con las lineas de datos del GPS y del acelerometro/gyroscopio.
  * @return bool retorna un valor booleano que indica si se pudo enviar los datos o no.
  */
-bool send_sensor_values( char pos[])
+bool send_sensor_values(spsc_ring_t *queue)
 {
     // Open connection
-    sprintf(uart_command, "AT+CIPSTART=\"TCP\",\"%s\",%s", ServerIP, Port); // Look for ESP docs
+    const config_t *config = config_get();
+    sprintf(uart_command, "AT+CIPSTART=\"TCP\",\"%s\",%u", config->server_ip, config->server_port); // Look for ESP docs
     sendCMD(uart_command, "OK"); // Connect to the server
 
     // Send data
     sendCMD("AT+CIPMODE=1", "OK");  // Look for ESP docs
     sleep_ms(10);
-    sendCMD("AT+CIPSEND", ">"); // Look for ESP docs
+    if (!sendCMD("AT+CIPSEND", ">")) // Look for ESP docs
+        return false; // Keep the lines for the next try
     sleep_ms(20);
 
     //printf("%s", (char*)buf);
-    uart_puts(UART_ID, pos);
+    const void *span;
+    uint32_t n;
+    while ((n = spsc_ring_read_span(queue, &span)) > 0) // At most two pieces when the queue wraps
+    {
+        uart_write_blocking(UART_ID, span, n);
+        spsc_ring_read_commit(queue, n);
+    }
 
     sleep_ms(50);            // Seems like this is critical
     uart_puts(UART_ID, "+++"); // Look for ESP docs
@@ -98,6 +144,8 @@ bool sendCMD(const char *cmd, const char *act) // Function to send commands to t
     t = time_us_64();
     while (time_us_64() - t < 2500 * 1000) // Wait for the response
     {
+        if (config_get()->low_power && !uart_is_readable(UART_ID))
+            power_wait(POWER_EVENT_WIFI_RX, from_us_since_boot(t + 2500 * 1000)); // Sleep until the ESP answers
         while (uart_is_readable_within_us(UART_ID, 2000)) // Read the response
         {
             buf[i++] = uart_getc(UART_ID); // Save the response in the buffer
@@ -132,12 +180,163 @@ void connectToWifi() //    Function to connect to the wifi
 {
     sendCMD("AT", "OK"); // Check if the ESP is working
     sendCMD("AT+CWMODE=3", "OK"); // Set the ESP as a client
-    sprintf(uart_command, "AT+CWJAP=\"%s\",\"%s\"", SSID, password); // Set the SSID and password
+    const config_t *config = config_get();
+    sprintf(uart_command, "AT+CWJAP=\"%s\",\"%s\"", config->ssid, config->password); // Set the SSID and password
     sendCMD(uart_command, "OK"); // Connect to the wifi
 }
 
 //WIFI///////////////////////////////////////////////////////////////////////////
 
+/**
+ * @brief Atiende la consola USB.
+ *
+ * Lee sin bloquear los caracteres que llegan por USB. Cada linea "clave=valor" cambia la configuracion
+ * y la guarda en flash, asi la red o la calibracion se cambian sin volver a programar la placa.
+ */
+void poll_console()
+{
+    static char line[96];
+    static size_t length = 0;
+    int c;
+
+    while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT)
+    {
+        if (c != '\r' && c != '\n')
+        {
+            if (length < sizeof(line) - 1) line[length++] = c;
+            continue;
+        }
+        if (length == 0) continue;
+
+        line[length] = '\0';
+        length = 0;
+        bool saved = config_set(config_edit(), line);
+        if (saved) {
+            if (core1Running) multicore_lockout_start_blocking(); // Core 1 runs from flash
+            saved = config_save(config_get());
+            if (core1Running) multicore_lockout_end_blocking();
+        }
+        if (saved)
+            printf("Saved %s\n", line);
+        else
+            printf("Invalid setting %s\n", line);
+    }
+}
+
+/**
+ * @brief Paso de la navegacion GPS/IMU.
+ *
+ * Lee el IMU en una sola rafaga, aplica la calibracion y avanza el filtro con el tiempo desde el paso
+ * anterior.
+ *
+ * @param nav_ekf_t *nav estado de la navegacion.
+ * @param uint64_t *last hora del paso anterior, 0 antes del primero.
+ * @return uint32_t retorna los microsegundos que tomo el paso.
+ */
+uint32_t navigation_step(nav_ekf_t *nav, uint64_t *last)
+{
+    const config_t *config = config_get();
+    mpu9250_sample_t raw;
+    float acc[3], gyro[3], mag[3];
+    const uint64_t now = time_us_64();
+
+    mutex_enter_blocking(&imuLock);
+    mpu9250_read_sample_dev(&mpu9250_default_dev, &raw);
+    mutex_exit(&imuLock);
+    for (int i = 0; i < 3; i++) // Same scales as the samples sent to the server
+    {
+        acc[i] = (raw.accel[i] - config->acc_offset[i]) * (2.0f / 32768);
+        gyro[i] = (raw.gyro[i] - config->gyro_offset[i]) * (250.0f / 32768);
+        mag[i] = (raw.mag[i] - config->mag_offset[i]) * config->mag_scale[i] * (4800.0f / 32768);
+    }
+    nav_ekf_predict(nav, acc, gyro, mag, *last ? (now - *last) * 1e-6f : 0);
+    *last = now;
+    return time_us_64() - now;
+}
+
+/**
+ * @brief Lectura del IMU para el analisis de vibraciones.
+ *
+ * Cada lectura hace como mucho la FFT de un eje y le pasa al nucleo 0 solo el resumen de cada ventana.
+ */
+void vibration_step()
+{
+    mpu9250_sample_t imu;
+    vibration_summary_t summary;
+
+    mutex_enter_blocking(&imuLock);
+    mpu9250_read_sample_dev(&mpu9250_default_dev, &imu);
+    mutex_exit(&imuLock);
+
+    const uint64_t start = time_us_64();
+    if (vibration_add(&vibration, imu.accel, start, &summary) && !spsc_ring_push(&vibrationOut, &summary))
+        vibrationDropped++; // Core 0 is stuck sending, the server sees the gap in seq
+    const uint32_t busy = time_us_64() - start;
+    if (busy > vibrationMaxUs)
+        vibrationMaxUs = busy;
+}
+
+/**
+ * @brief Lecturas del IMU a periodo fijo, corre en el nucleo 1.
+ *
+ * El analisis de vibraciones lee a imu_rate_hz y la navegacion avanza a nav_rate_hz, cada uno contra
+ * su propio reloj absoluto, asi ninguno se detiene mientras el nucleo 0 espera al ESP. Antes de cada
+ * paso de la navegacion se aplican los fixes que llegaron y despues se publica la salida. Si un paso
+ * sale tarde se cuenta y el reloj de la navegacion se vuelve a anclar en el presente, en lugar de
+ * recuperar con pasos seguidos de dt casi cero.
+ */
+void sensors_core1()
+{
+    multicore_lockout_victim_init();
+    const uint32_t vibrationPeriodUs = 1000000 / config_get()->imu_rate_hz;
+    nav_config_t navConfig;
+    nav_ekf_t nav;
+    nav_output_t navOut;
+    nav_config_defaults(&navConfig);
+    nav_ekf_init(&nav, &navConfig);
+    uint64_t lastNav = 0;
+    absolute_time_t nextVibration = get_absolute_time(), nextNav = nextVibration;
+
+    while (1) {
+        absolute_time_t next = vibrationOn ? nextVibration : nextNav;
+        if (navPeriodUs && absolute_time_diff_us(nextNav, next) > 0)
+            next = nextNav;
+        sleep_until(next);
+
+        if (vibrationOn && absolute_time_diff_us(get_absolute_time(), nextVibration) <= 0) {
+            vibration_step();
+            nextVibration = delayed_by_us(nextVibration, vibrationPeriodUs);
+            if (absolute_time_diff_us(get_absolute_time(), nextVibration) < 0)
+                vibrationLate++;
+        }
+
+        if (navPeriodUs && absolute_time_diff_us(get_absolute_time(), nextNav) <= 0) {
+            nav_fix_t fix;
+            while (spsc_ring_pop(&navFixes, &fix)) // Every fix corrects the navigation, not only the sampled ones
+                nav_ekf_update_gps(&nav, fix.lat, fix.lon);
+            const uint32_t us = navigation_step(&nav, &lastNav);
+            navSteps++;
+            navBusyUs += us;
+            if (us > navMaxUs)
+                navMaxUs = us;
+            navFixCount = nav.fixes;
+            navRejected = nav.rejected;
+
+            nav_ekf_output(&nav, &navOut);
+            mutex_enter_blocking(&navLock);
+            navShared = navOut;
+            navSharedReady = nav.position_ready;
+            mutex_exit(&navLock);
+
+            nextNav = delayed_by_us(nextNav, navPeriodUs);
+            if (absolute_time_diff_us(get_absolute_time(), nextNav) < 0) {
+                navLate++;
+                nextNav = get_absolute_time();
+            }
+        }
+    }
+}
+
 // Define uart properties for the GPS
 const uint8_t GPS_TX = 16, GPS_RX = 17;
 
@@ -155,6 +354,7 @@ int main() {
 
     // Initialize the standard IO and the uart for the gps
     stdio_init_all(); 
+    const config_t *config = config_get(); // Calibration, network and rates, read from flash in microseconds
     uart_init(gps_uart, GPS_BAUDRATE);
 
     // Don't convert \n to \r\n
@@ -175,7 +375,10 @@ int main() {
     start_spi();  //Starts the mpu
 
     int16_t acceleration[3], gyro[3], eulerAngles[2], fullAngles[2], mag[3]; //Declares the variables required for calculations
-    float acc_f[3], gyro_f[3], mag_f[3];
+    telemetry_sample_t sample; // Sample sent to the server, in physical units
+    uint32_t seq = 0;
+    gps_time_sync_t timeSync;  // Device clock to UTC, disciplined by the GNRMC time
+    gps_time_sync_reset(&timeSync);
     absolute_time_t timeOfLastCheck;
 
     mpu9250_read_raw_accel(acceleration);  //Sets the absolute angle using the direction of gravity
@@ -191,6 +394,50 @@ int main() {
     gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART);
     gpio_set_function(UART_RX_PIN, GPIO_FUNC_UART);
 
+    // Low power mode: sleep until an event and let the IMU rate follow the motion
+    activity_config_t activityConfig;
+    activity_t activity;
+    mpu9250_sample_t imuSample;
+    uint16_t imuRate = config->imu_rate_hz;
+    activity_config_defaults(&activityConfig, config->imu_rate_hz, config->idle_rate_hz);
+    activity_reset(&activity);
+    power_init(gps_uart, &gpsRx, &gpsStarts, UART_ID, config->low_power ? IMU_INT_PIN : -1);
+    if (config->low_power) {
+        mpu9250_set_sample_rate_dev(&mpu9250_default_dev, imuRate);
+        mpu9250_enable_data_ready_dev(&mpu9250_default_dev);
+    }
+    absolute_time_t nextReport = make_timeout_time_ms(POWER_REPORT_MS);
+    absolute_time_t nextSample = get_absolute_time();
+    size_t fill = 0; // Bytes of the GPS line received so far
+    uint64_t lineStart = 0; // When the '$' of that line arrived, stamped by the uart interrupt
+    uint32_t uplinkDropped = 0;
+
+    // Dead-band reporting: only samples that changed enough (or the heartbeat) reach the uplink
+    report_filter_t reportFilter;
+    report_filter_reset(&reportFilter);
+    absolute_time_t nextFilterReport = make_timeout_time_ms(FILTER_REPORT_MS);
+
+    // GPS/IMU navigation on core 1: the IMU is integrated between fixes and the samples carry the filtered position
+    navPeriodUs = config->nav_rate_hz ? 1000000 / config->nav_rate_hz : 0;
+    nav_output_t navOut;
+    bool navReady = false;
+    absolute_time_t nextNavReport = make_timeout_time_ms(NAV_REPORT_MS);
+
+    // Vibration spectrum on core 1: only band energies, peaks and RMS go to the server
+    vibrationOn = config->vibration_points && !config->low_power && // Low power owns the IMU rate
+                  vibration_init(&vibration, config->vibration_points, config->imu_rate_hz, 2.0f / 32768);
+    absolute_time_t nextVibrationReport = make_timeout_time_ms(VIBRATION_REPORT_MS);
+    uint32_t vibrationWindows = 0;
+    if (vibrationOn) {
+        mpu9250_set_sample_rate_dev(&mpu9250_default_dev, config->imu_rate_hz);
+    } else if (config->vibration_points) {
+        printf("Vibration analysis off: vibration_points must be a power of two from 64 to 512 and low_power off\n");
+    }
+    if (vibrationOn || navPeriodUs) { // Fixed-rate IMU work stays on time while this core waits for the ESP
+        core1Running = true;
+        multicore_launch_core1(sensors_core1);
+    }
+
     uart_puts(UART_ID, "+++"); // Look for ESP docs
     sleep_ms(10);
     while (uart_is_readable(UART_ID))       // Read the response
@@ -217,60 +464,176 @@ int main() {
  * 
  */
     while (1) {
+        poll_console();
+
+        if (navPeriodUs && absolute_time_diff_us(get_absolute_time(), nextNavReport) <= 0) {
+            printf("Nav: %lu steps, %lu us average, %lu us max (budget %d us), %lu late, %lu fixes, %lu rejected\n", (unsigned long)navSteps,
+                   (unsigned long)(navSteps ? navBusyUs / navSteps : 0), (unsigned long)navMaxUs, NAV_STEP_BUDGET_US,
+                   (unsigned long)navLate, (unsigned long)navFixCount, (unsigned long)navRejected);
+            navSteps = navBusyUs = navMaxUs = navLate = 0;
+            nextNavReport = make_timeout_time_ms(NAV_REPORT_MS);
+        }
+
+        vibration_summary_t vibrationSummary;
+        while (spsc_ring_pop(&vibrationOut, &vibrationSummary)) { // Goes out with the next sample
+            char line[VIBRATION_CSV_MAX + 1];
+            int lineLength = vibration_format_csv(&vibrationSummary, line, VIBRATION_CSV_MAX);
+            line[lineLength++] = '\n';
+            if (spsc_ring_capacity(&uplink) - spsc_ring_count(&uplink) < (uint32_t)lineLength)
+                uplinkDropped++;
+            else
+                spsc_ring_push_n(&uplink, line, lineLength);
+            vibrationWindows++;
+        }
+        if (vibrationOn && absolute_time_diff_us(get_absolute_time(), nextVibrationReport) <= 0) {
+            printf("Vibration: %lu windows, %lu us max per sample (period %lu us), %lu late samples, %lu summaries dropped\n",
+                   (unsigned long)vibrationWindows, (unsigned long)vibrationMaxUs, (unsigned long)(1000000 / config->imu_rate_hz),
+                   (unsigned long)vibrationLate, (unsigned long)vibrationDropped);
+            vibrationWindows = vibrationMaxUs = vibrationLate = vibrationDropped = 0;
+            nextVibrationReport = make_timeout_time_ms(VIBRATION_REPORT_MS);
+        }
+
+        if (config->low_power && !navPeriodUs && spsc_ring_empty(&gpsRx)) { // Navigation needs the IMU at a fixed rate
+            uint32_t events = power_wait(POWER_EVENT_GPS_RX | POWER_EVENT_IMU_READY, nextReport);
+            if (events & POWER_EVENT_IMU_READY) {
+                mpu9250_read_sample_dev(&mpu9250_default_dev, &imuSample);
+                for (int i = 0; i < 3; i++) imuSample.gyro[i] -= config->gyro_offset[i];
+                uint16_t rate = activity_update(&activity, &activityConfig, imuSample.accel, imuSample.gyro, time_us_64());
+                if (rate != imuRate) {
+                    imuRate = rate;
+                    mpu9250_set_sample_rate_dev(&mpu9250_default_dev, imuRate);
+                }
+            }
+            if (events & POWER_EVENT_TIMER) {
+                power_stats_t stats;
+                power_get_stats(&stats);
+                float duty = power_duty_cycle();
+                printf("Power: duty %.1f%%, %lu wakeups, IMU %u Hz (%s), about %.1f mA, %lu GPS bytes and %lu lines dropped\n",
+                       duty * 100, (unsigned long)stats.wakeups, imuRate, activity.idle ? "still" : "moving", power_estimate_ma(duty),
+                       (unsigned long)stats.rx_dropped, (unsigned long)uplinkDropped);
+                power_reset_stats();
+                nextReport = make_timeout_time_ms(POWER_REPORT_MS);
+            }
+        }
 
         /*GPS//////////////////////////////////////////////////////////////////////////////////*/
-        // Read a line from the GPS data
-        const size_t length = uart_read_line(gps_uart, message, sizeof(message));
+        // Take the GPS bytes the interrupt already queued, the line is used once it is complete
+        const size_t length = ring_read_line(&gpsRx, &gpsStarts, message, sizeof(message), &fill, &lineStart);
+        if (length == 0) {
+            continue;
+        }
 
         // Skip to the next iteration, if the data is not correct or not of the correct type
         if(!is_correct(message, length)){
             continue;
         }
+
+        int64_t fixUtc;
+        if (gps_parse_rmc_time(message, &fixUtc)) { // Must run before decode(), which splits the string
+            gps_time_sync_update(&timeSync, lineStart, fixUtc);
+        }
           
         // Print the received line of data
         //Compara trama para solo usar GNRMC y extraer datos
         //printf("%s", message);
-        if (strncmp(message, "$GNRMC", strlen("$GNRMC")) == 0 || strncmp(message, "$GNGGA", strlen("$GNGGA")) == 0){
-            float latitud = 0, longitud = 0;
-            char pos[256];
+        const bool isFix = strncmp(message, "$GNRMC", strlen("$GNRMC")) == 0 || strncmp(message, "$GNGGA", strlen("$GNGGA")) == 0;
+        float latitud = 0, longitud = 0;
+        if (isFix) {
             decode(message, &latitud, &longitud);
+            const nav_fix_t fix = {latitud, longitud};
+            if (navPeriodUs && (latitud != 0 || longitud != 0) && time_us_64() - lineStart <= GPS_FIX_MAX_AGE_US) // Core 1 applies it before its next step
+                spsc_ring_push(&navFixes, &fix);
+        }
+        if (isFix && absolute_time_diff_us(get_absolute_time(), nextSample) <= 0){
+            nextSample = make_timeout_time_ms(config->sample_period_ms); // Keeps reading the GPS instead of sleeping
+            char pos[TELEMETRY_CSV_MAX + 4 * 48]; // Room for the navigation columns
+            sample.t_us = time_us_64();
+            sample.utc_us = gps_time_sync_to_utc(&timeSync, sample.t_us);
+            sample.lat = latitud;
+            sample.lon = longitud;
+            if (navPeriodUs) {
+                mutex_enter_blocking(&navLock);
+                navOut = navShared;
+                navReady = navSharedReady;
+                mutex_exit(&navLock);
+                if (navReady) {
+                    sample.lat = navOut.lat;
+                    sample.lon = navOut.lon;
+                }
+            }
 
         /*///////////////////////////////////////////////////////////////////////////////////GPS*/
         
+            mutex_enter_blocking(&imuLock);
             mpu9250_read_raw_mag(mag);  //Reads the accel and gyro
-            mag[0] -= 1;  //Applies the calibration
-            mag[1] -= 4;
-            mag[2] -= 0;
+            mag[0] -= config->mag_offset[0];  //Applies the calibration
+            mag[1] -= config->mag_offset[1];
+            mag[2] -= config->mag_offset[2];
 
-            mag_f[0] = ((float)mag[0]/32768.0) * 4800.0;
-            mag_f[1] = ((float)mag[1]/32768.0) * 4800.0;
-            mag_f[2] = ((float)mag[2]/32768.0) * 4800.0;
+            sample.mag[0] = ((float)mag[0] * config->mag_scale[0]/32768.0) * 4800.0;
+            sample.mag[1] = ((float)mag[1] * config->mag_scale[1]/32768.0) * 4800.0;
+            sample.mag[2] = ((float)mag[2] * config->mag_scale[2]/32768.0) * 4800.0;
 
             mpu9250_read_raw_accel(acceleration);  //Reads the accel and gyro
-            acceleration[0] -= 1;  //Applies the calibration
-            acceleration[1] -= 8;
-            acceleration[2] -= 9;
+            acceleration[0] -= config->acc_offset[0];  //Applies the calibration
+            acceleration[1] -= config->acc_offset[1];
+            acceleration[2] -= config->acc_offset[2];
 
-            acc_f[0] = ((float)acceleration[0]/32768.0) * 2.0;
-            acc_f[1] = ((float)acceleration[1]/32768.0) * 2.0;
-            acc_f[2] = ((float)acceleration[2]/32768.0) * 2.0;
+            sample.acc[0] = ((float)acceleration[0]/32768.0) * 2.0;
+            sample.acc[1] = ((float)acceleration[1]/32768.0) * 2.0;
+            sample.acc[2] = ((float)acceleration[2]/32768.0) * 2.0;
 
             mpu9250_read_raw_gyro(gyro);
-            gyro[0] -= -11;  //Applies the calibration
-            gyro[1] -= -6;
-            gyro[2] -= -15;
-
-            gyro_f[0] = ((float)gyro[0]/32768.0) * 250.0;
-            gyro_f[1] = ((float)gyro[1]/32768.0) * 250.0;
-            gyro_f[2] = ((float)gyro[2]/32768.0) * 250.0;
-
-  
-
-            sprintf(pos, "%.6f,%.6f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f", latitud, longitud, acc_f[0], acc_f[1], acc_f[2], gyro_f[0], gyro_f[1], gyro_f[2], mag_f[0], mag_f[1], mag_f[2]); 
+            mutex_exit(&imuLock);
+            gyro[0] -= config->gyro_offset[0];  //Applies the calibration
+            gyro[1] -= config->gyro_offset[1];
+            gyro[2] -= config->gyro_offset[2];
+
+            sample.gyro[0] = ((float)gyro[0]/32768.0) * 250.0;
+            sample.gyro[1] = ((float)gyro[1]/32768.0) * 250.0;
+            sample.gyro[2] = ((float)gyro[2]/32768.0) * 250.0;
+
+            // Thresholds are read for every sample, like the calibration, so console changes apply at once
+            const report_filter_config_t reportConfig = {config->report_position_m, config->report_attitude_deg, config->report_accel_g,
+                                                         config->report_gyro_dps, config->report_heartbeat_ms};
+            if (report_filter_enabled(&reportConfig) && absolute_time_diff_us(get_absolute_time(), nextFilterReport) <= 0) {
+                printf("Report filter: %lu sent, %lu suppressed\n", (unsigned long)reportFilter.sent, (unsigned long)reportFilter.suppressed);
+                // The server gets the counters too, it goes out with the next sample like a vibration summary
+                char line[32] = "FILTER,";
+                char *p = telemetry_put_u64(line + strlen(line), reportFilter.sent);
+                *p++ = ',';
+                p = telemetry_put_u64(p, reportFilter.suppressed);
+                *p++ = '\n';
+                if (spsc_ring_capacity(&uplink) - spsc_ring_count(&uplink) < (uint32_t)(p - line))
+                    uplinkDropped++;
+                else
+                    spsc_ring_push_n(&uplink, line, p - line);
+                nextFilterReport = make_timeout_time_ms(FILTER_REPORT_MS);
+            }
+            if (report_filter_check(&reportFilter, &reportConfig, &sample) == 0) {
+                continue; // Nothing changed enough, counted in the FILTER line instead of a gap in seq
+            }
+            sample.seq = seq++; // Only sent samples take a number, so a gap is always a lost sample
+
+            int posLength = telemetry_format_csv(&sample, pos, TELEMETRY_CSV_MAX);
+            if (navPeriodUs) { // Velocity North and East (m/s) and position uncertainty (m) after the usual columns
+                const float extra[4] = {navOut.vel_n, navOut.vel_e, navOut.sigma_n, navOut.sigma_e};
+                char *p = pos + posLength;
+                for (int i = 0; i < 4; i++) {
+                    *p++ = ',';
+                    p = telemetry_put_fixed(p, extra[i], 2);
+                }
+                *p = '\0';
+                posLength = p - pos;
+            }
             printf("%s\n", pos);
+            pos[posLength++] = '\n'; // Lines are separated when several go in one connection
+            if (spsc_ring_capacity(&uplink) - spsc_ring_count(&uplink) < (uint32_t)posLength) // Whole lines only
+                uplinkDropped++;
+            else
+                spsc_ring_push_n(&uplink, pos, posLength);
     
-            send_sensor_values(pos);
-            sleep_ms(1000);
+            send_sensor_values(&uplink);
         }
     }
 }
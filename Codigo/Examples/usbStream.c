@@ -0,0 +1,171 @@
+/**
+  @file usbStream.c
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Modo de captura por cable: lee el MPU9250 a 1 kHz y el GPS, y envia cada lectura como una trama binaria
+  por el USB (CDC) sin pasar por printf. El nucleo 1 adquiere y llena un bloque mientras el nucleo 0 envia
+  el otro (doble buffer), asi la adquisicion nunca espera al USB. En el PC se recibe con host/capture.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "pico/stdio_usb.h"
+#include "hardware/uart.h"
+#include "mpu9250.h"
+#include "gps.h"
+#include "gps_time.h"
+#include "telemetry_frame.h"
+#include "spsc_ring.h"
+
+#define STREAM_RATE_HZ 1000   // IMU frames per second
+#define GPS_BAUDRATE 9600     // Baudrate for the GPS
+#define BLOCK_SIZE 2048       // Bytes per buffer, about 50 IMU frames
+#define BLOCK_FLUSH_US 10000  // A block is handed over after this long even if not full, keeps the latency low
+
+typedef struct {
+    uint32_t used;
+    uint8_t data[BLOCK_SIZE];
+} stream_block_t;
+
+static stream_block_t blocks[2];            // Core 1 fills one while core 0 sends the other
+SPSC_RING_DEFINE(fullBlocks, uint8_t, 2);   // Core 1 -> core 0, blocks ready to send
+SPSC_RING_DEFINE(freeBlocks, uint8_t, 2);   // Core 0 -> core 1, blocks already sent
+SPSC_RING_DEFINE(gpsRx, char, 256);         // GPS bytes taken from the uart FIFO
+SPSC_RING_DEFINE(gpsStarts, uint64_t, 16);  // Time each '$' in gpsRx was taken from the FIFO
+
+// Define uart properties for the GPS
+const uint8_t GPS_TX = 16, GPS_RX = 17;
+uart_inst_t *const gps_uart = uart0;
+
+/**
+ * @brief Agrega una trama al bloque que se esta llenando.
+ *
+ * Si no hay bloque libre (el USB va atrasado) la trama se pierde; el numero de secuencia ya avanzo,
+ * asi que el PC ve el salto y cuenta la perdida.
+ *
+ * @param frame trama que se quiere enviar.
+ * @param block bloque que se esta llenando, NULL si no hay ninguno libre.
+ */
+static void stream_frame(const telemetry_frame_t *frame, stream_block_t *block)
+{
+    if (block == NULL || block->used + TELEMETRY_FRAME_MAX > BLOCK_SIZE) {
+        return;
+    }
+    block->used += telemetry_frame_encode(frame, block->data + block->used);
+}
+
+/**
+ * @brief Adquisicion, corre en el nucleo 1.
+ *
+ * Lee el IMU cada 1 ms contra un reloj absoluto (sin deriva), pasa al anillo los bytes que trae el GPS
+ * y arma una trama por cada lectura. Nunca se bloquea esperando al nucleo 0.
+ */
+void core1_main()
+{
+    telemetry_frame_t frame;
+    mpu9250_sample_t imu;
+    stream_block_t *block = NULL;
+    uint64_t blockStart = 0;
+    uint32_t seq = 0;
+    char message[256];
+    size_t fill = 0;
+    uint64_t lineStart = 0;
+    gps_time_sync_t timeSync;
+    gps_time_sync_reset(&timeSync);
+
+    absolute_time_t next = get_absolute_time();
+    while (1) {
+        next = delayed_by_us(next, 1000000 / STREAM_RATE_HZ);
+        sleep_until(next);
+
+        uint8_t index;
+        if (block == NULL && spsc_ring_pop(&freeBlocks, &index)) {
+            block = &blocks[index];
+            block->used = 0;
+            blockStart = time_us_64();
+        }
+
+        frame.type = TELEMETRY_FRAME_IMU;
+        frame.t_us = time_us_64();
+        frame.seq = seq++;
+        mpu9250_read_sample_dev(&mpu9250_default_dev, &imu);
+        memcpy(frame.imu.acc, imu.accel, sizeof(imu.accel));
+        memcpy(frame.imu.gyro, imu.gyro, sizeof(imu.gyro));
+        memcpy(frame.imu.mag, imu.mag, sizeof(imu.mag));
+        frame.imu.temp = imu.temp;
+        stream_frame(&frame, block);
+
+        // About one GPS character per millisecond, the 32 byte uart FIFO never overflows between reads
+        while (uart_is_readable(gps_uart) && spsc_ring_count(&gpsRx) < spsc_ring_capacity(&gpsRx)) {
+            const uint64_t now = time_us_64();
+            char c = uart_getc(gps_uart);
+            if (c == '$' && !spsc_ring_push(&gpsStarts, &now)) continue; // Never a '$' without its time
+            spsc_ring_push(&gpsRx, &c);
+        }
+        const size_t length = ring_read_line(&gpsRx, &gpsStarts, message, sizeof(message), &fill, &lineStart);
+        if (length > 0 && is_correct(message, length) && strncmp(message, "$GNRMC", strlen("$GNRMC")) == 0) {
+            int64_t fixUtc;
+            if (gps_parse_rmc_time(message, &fixUtc)) { // Must run before decode(), which splits the string
+                gps_time_sync_update(&timeSync, lineStart, fixUtc);
+            }
+            float latitud = 0, longitud = 0;
+            decode(message, &latitud, &longitud);
+            frame.type = TELEMETRY_FRAME_GPS;
+            frame.t_us = lineStart;
+            frame.seq = seq++;
+            frame.gps.lat_e7 = (int32_t)lround(latitud * 1e7);
+            frame.gps.lon_e7 = (int32_t)lround(longitud * 1e7);
+            frame.gps.utc_us = gps_time_sync_to_utc(&timeSync, lineStart);
+            stream_frame(&frame, block);
+        }
+
+        if (block != NULL && (block->used + 2 * TELEMETRY_FRAME_MAX > BLOCK_SIZE || time_us_64() - blockStart >= BLOCK_FLUSH_US)) {
+            index = block - blocks;
+            spsc_ring_push(&fullBlocks, &index); // Never full, there are only two blocks
+            block = NULL;
+        }
+    }
+}
+
+/**
+ * @brief Punto de entrada del programa.
+ *
+ * Configura el IMU y el GPS, arranca la adquisicion en el nucleo 1 y se queda enviando los bloques
+ * llenos por el USB. Los bytes van directo al driver USB de stdio, sin el formato ni la conversion de
+ * saltos de linea de printf.
+ */
+int main()
+{
+    stdio_init_all();
+    sleep_ms(2000);
+    printf("Streaming binary frames at %d Hz, capture them with host/capture\n", STREAM_RATE_HZ);
+
+    start_spi();
+    mpu9250_set_sample_rate_dev(&mpu9250_default_dev, STREAM_RATE_HZ);
+
+    uart_init(gps_uart, GPS_BAUDRATE);
+    uart_set_translate_crlf(gps_uart, false);
+    gpio_set_function(GPS_TX, GPIO_FUNC_UART);
+    gpio_set_function(GPS_RX, GPIO_FUNC_UART);
+
+    for (uint8_t i = 0; i < 2; i++) {
+        spsc_ring_push(&freeBlocks, &i);
+    }
+    multicore_launch_core1(core1_main);
+
+    while (1) {
+        uint8_t index;
+        if (!spsc_ring_pop(&fullBlocks, &index)) {
+            tight_loop_contents();
+            continue;
+        }
+        // Returns at once when no terminal is connected, the frames are dropped on the device side
+        stdio_usb.out_chars((const char *)blocks[index].data, blocks[index].used);
+        spsc_ring_push(&freeBlocks, &index);
+    }
+}
\ No newline at end of file
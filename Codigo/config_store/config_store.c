@@ -0,0 +1,446 @@
+/**
+  @file config_store.c
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Este archivo guarda la configuracion del equipo (calibracion, red y frecuencias de muestreo) en los
+  dos ultimos sectores de la flash. Cada sector es una copia (A/B) con numero de secuencia y CRC32:
+  al guardar se escribe la copia vieja y, si se corta la energia a mitad de la escritura, su CRC
+  falla y al arrancar se sigue usando la otra. La carga lee la flash directamente por XIP.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "config_store.h"
+
+#define CONFIG_MAGIC 0x47464354u // "TCFG"
+#define CONFIG_MAX_PAYLOAD 496    // Header + payload fit in two flash pages
+#define CONFIG_SLOT_A (PICO_FLASH_SIZE_BYTES - 2 * FLASH_SECTOR_SIZE)
+#define CONFIG_SLOT_B (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define CONFIG_MAX_RATE_HZ 1000   // MPU9250 output rate with the DLPF on
+#define CONFIG_MIN_NAV_RATE_HZ 2  // nav_ekf only integrates steps up to 0.5 s
+#define CONFIG_MIN_VIBRATION_POINTS 64  // Window sizes accepted by vibration_init
+#define CONFIG_MAX_VIBRATION_POINTS 512
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;    // Payload bytes after the header
+    uint32_t sequence;  // The valid copy with the highest sequence wins
+    uint32_t crc;       // CRC32 of the first 12 header bytes and the payload
+} config_header_t;
+
+static config_t current;
+static bool loaded = false;
+static int active_slot = -1;       // 0 = A, 1 = B, -1 = nothing valid in flash
+static uint32_t active_sequence = 0;
+
+/**
+ * @brief Calcula el CRC32 (polinomio 0xEDB88320) de un bloque
+ *
+ * Usa una tabla de 16 entradas: es rapido y no gasta 1 KB de tabla.
+ *
+ * @param crc valor inicial (0 para empezar).
+ * @param data bloque de datos.
+ * @param len longitud del bloque.
+ * @return uint32_t retorna el CRC acumulado.
+ */
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+/**
+ * @brief Llena la configuracion con los valores por defecto
+ *
+ * Son los valores que antes estaban fijos en el codigo de telemetria.c.
+ *
+ * @param config configuracion que se quiere llenar.
+ */
+void config_defaults(config_t *config)
+{
+    memset(config, 0, sizeof(*config));
+
+    const int16_t acc[3] = {1, 8, 9}, gyro[3] = {-11, -6, -15}, mag[3] = {1, 4, 0};
+    for (int i = 0; i < 3; i++) {
+        config->acc_offset[i] = acc[i];
+        config->gyro_offset[i] = gyro[i];
+        config->mag_offset[i] = mag[i];
+        config->mag_scale[i] = 1.0f;
+    }
+    config->calibrated = false;
+
+    strcpy(config->ssid, "Sebas");              // Wifi name
+    strcpy(config->password, "12345678");       // Wifi password
+    strcpy(config->server_ip, "192.168.70.109"); // IP of the server
+    config->server_port = 8080;                 // Port of the server
+
+    config->sample_period_ms = 1000;
+    config->imu_rate_hz = 1000;
+    config->low_power = false;
+    config->idle_rate_hz = 10;
+    config->report_position_m = 0;    // Report filter off: every sample is sent
+    config->report_attitude_deg = 0;
+    config->report_accel_g = 0;
+    config->report_gyro_dps = 0;
+    config->report_heartbeat_ms = 0;  // REPORT_DEFAULT_HEARTBEAT_MS once a threshold is set
+    config->nav_rate_hz = 0;          // Navigation filter off
+    config->vibration_points = 0;     // No vibration summaries
+}
+
+/**
+ * @brief Comprueba una copia de la configuracion en flash
+ *
+ * @param slot copia que se quiere comprobar (0 = A, 1 = B).
+ * @return const config_header_t* retorna el encabezado de la copia, o NULL si no es valida.
+ */
+static const config_header_t *slot_header(int slot)
+{
+    const config_header_t *header = (const config_header_t *)(XIP_BASE + (slot ? CONFIG_SLOT_B : CONFIG_SLOT_A));
+
+    if (header->magic != CONFIG_MAGIC || header->version != CONFIG_VERSION || header->length > CONFIG_MAX_PAYLOAD) {
+        return NULL;
+    }
+    uint32_t crc = crc32_update(0, (const uint8_t *)header, offsetof(config_header_t, crc));
+    crc = crc32_update(crc, (const uint8_t *)(header + 1), header->length);
+    return crc == header->crc ? header : NULL;
+}
+
+/**
+ * @brief Copia un registro a su campo si la longitud coincide
+ */
+static void read_field(void *field, size_t size, const uint8_t *value, uint8_t len)
+{
+    if (len == size) {
+        memcpy(field, value, size);
+    }
+}
+
+/**
+ * @brief Copia un registro de texto a su campo, siempre terminado en cero
+ */
+static void read_string(char *field, size_t size, const uint8_t *value, uint8_t len)
+{
+    if (len < size) {
+        memcpy(field, value, len);
+        field[len] = '\0';
+    }
+}
+
+/**
+ * @brief Carga la configuracion desde la flash
+ *
+ * Elige la copia valida con la secuencia mas alta y aplica sus registros sobre los valores por defecto.
+ * Solo lee unos cientos de bytes por XIP, asi que tarda microsegundos.
+ *
+ * @param config configuracion donde se guardaran los valores.
+ * @return bool retorna false si no habia ninguna copia valida (config queda con los valores por defecto).
+ */
+bool config_load(config_t *config)
+{
+    const config_header_t *a = slot_header(0), *b = slot_header(1);
+    const config_header_t *header = a;
+
+    active_slot = a ? 0 : -1;
+    if (b && (!a || (int32_t)(b->sequence - a->sequence) > 0)) {
+        header = b;
+        active_slot = 1;
+    }
+
+    config_defaults(config);
+    if (!header) {
+        active_sequence = 0;
+        return false;
+    }
+    active_sequence = header->sequence;
+
+    const uint8_t *p = (const uint8_t *)(header + 1), *end = p + header->length;
+    while (p + 2 <= end && p + 2 + p[1] <= end) {
+        uint8_t key = p[0], len = p[1];
+        const uint8_t *value = p + 2;
+
+        switch (key) {
+            case CONFIG_KEY_ACC_OFFSET: read_field(config->acc_offset, sizeof(config->acc_offset), value, len); break;
+            case CONFIG_KEY_GYRO_OFFSET: read_field(config->gyro_offset, sizeof(config->gyro_offset), value, len); break;
+            case CONFIG_KEY_MAG_OFFSET: read_field(config->mag_offset, sizeof(config->mag_offset), value, len); break;
+            case CONFIG_KEY_MAG_SCALE: read_field(config->mag_scale, sizeof(config->mag_scale), value, len); break;
+            case CONFIG_KEY_CALIBRATED: read_field(&config->calibrated, sizeof(config->calibrated), value, len); break;
+            case CONFIG_KEY_SSID: read_string(config->ssid, sizeof(config->ssid), value, len); break;
+            case CONFIG_KEY_PASSWORD: read_string(config->password, sizeof(config->password), value, len); break;
+            case CONFIG_KEY_SERVER_IP: read_string(config->server_ip, sizeof(config->server_ip), value, len); break;
+            case CONFIG_KEY_SERVER_PORT: read_field(&config->server_port, sizeof(config->server_port), value, len); break;
+            case CONFIG_KEY_SAMPLE_PERIOD_MS: read_field(&config->sample_period_ms, sizeof(config->sample_period_ms), value, len); break;
+            case CONFIG_KEY_IMU_RATE_HZ: read_field(&config->imu_rate_hz, sizeof(config->imu_rate_hz), value, len); break;
+            case CONFIG_KEY_LOW_POWER: read_field(&config->low_power, sizeof(config->low_power), value, len); break;
+            case CONFIG_KEY_IDLE_RATE_HZ: read_field(&config->idle_rate_hz, sizeof(config->idle_rate_hz), value, len); break;
+            case CONFIG_KEY_REPORT_POSITION_M: read_field(&config->report_position_m, sizeof(config->report_position_m), value, len); break;
+            case CONFIG_KEY_REPORT_ATTITUDE_DEG: read_field(&config->report_attitude_deg, sizeof(config->report_attitude_deg), value, len); break;
+            case CONFIG_KEY_REPORT_ACCEL_G: read_field(&config->report_accel_g, sizeof(config->report_accel_g), value, len); break;
+            case CONFIG_KEY_REPORT_GYRO_DPS: read_field(&config->report_gyro_dps, sizeof(config->report_gyro_dps), value, len); break;
+            case CONFIG_KEY_REPORT_HEARTBEAT_MS: read_field(&config->report_heartbeat_ms, sizeof(config->report_heartbeat_ms), value, len); break;
+            case CONFIG_KEY_NAV_RATE_HZ: read_field(&config->nav_rate_hz, sizeof(config->nav_rate_hz), value, len); break;
+            case CONFIG_KEY_VIBRATION_POINTS: read_field(&config->vibration_points, sizeof(config->vibration_points), value, len); break;
+            default: break; // Written by a newer firmware, keep going
+        }
+        p += 2 + len;
+    }
+
+    // A copy saved before config_set checked its values can hold a zero rate, which is a division on every boot
+    config_t defaults;
+    config_defaults(&defaults);
+    if (config->server_port == 0) config->server_port = defaults.server_port;
+    if (config->sample_period_ms == 0) config->sample_period_ms = defaults.sample_period_ms;
+    if (config->imu_rate_hz == 0 || config->imu_rate_hz > CONFIG_MAX_RATE_HZ) config->imu_rate_hz = defaults.imu_rate_hz;
+    if (config->idle_rate_hz == 0 || config->idle_rate_hz > CONFIG_MAX_RATE_HZ) config->idle_rate_hz = defaults.idle_rate_hz;
+    return true;
+}
+
+/**
+ * @brief Agrega un registro al bloque que se va a guardar
+ */
+static uint8_t *write_field(uint8_t *p, config_key_t key, const void *value, size_t len)
+{
+    *p++ = key;
+    *p++ = len;
+    memcpy(p, value, len);
+    return p + len;
+}
+
+/**
+ * @brief Guarda la configuracion en la flash
+ *
+ * Escribe la copia que no esta activa con la secuencia siguiente, de modo que la copia anterior
+ * sigue siendo valida hasta que la nueva queda completa. Las interrupciones se desactivan durante
+ * el borrado y la escritura; si el nucleo 1 esta corriendo debe estar bloqueado (multicore_lockout).
+ *
+ * @param config configuracion que se quiere guardar.
+ * @return bool retorna true si la copia escrita se verifico correctamente.
+ */
+bool config_save(const config_t *config)
+{
+    // The header is written through 32-bit fields and the M0+ faults on unaligned word stores
+    static uint8_t block[sizeof(config_header_t) + CONFIG_MAX_PAYLOAD] __attribute__((aligned(4)));
+    config_header_t *header = (config_header_t *)block;
+    uint8_t *p = block + sizeof(config_header_t);
+
+    memset(block, 0xFF, sizeof(block));
+    p = write_field(p, CONFIG_KEY_ACC_OFFSET, config->acc_offset, sizeof(config->acc_offset));
+    p = write_field(p, CONFIG_KEY_GYRO_OFFSET, config->gyro_offset, sizeof(config->gyro_offset));
+    p = write_field(p, CONFIG_KEY_MAG_OFFSET, config->mag_offset, sizeof(config->mag_offset));
+    p = write_field(p, CONFIG_KEY_MAG_SCALE, config->mag_scale, sizeof(config->mag_scale));
+    p = write_field(p, CONFIG_KEY_CALIBRATED, &config->calibrated, sizeof(config->calibrated));
+    p = write_field(p, CONFIG_KEY_SSID, config->ssid, strlen(config->ssid));
+    p = write_field(p, CONFIG_KEY_PASSWORD, config->password, strlen(config->password));
+    p = write_field(p, CONFIG_KEY_SERVER_IP, config->server_ip, strlen(config->server_ip));
+    p = write_field(p, CONFIG_KEY_SERVER_PORT, &config->server_port, sizeof(config->server_port));
+    p = write_field(p, CONFIG_KEY_SAMPLE_PERIOD_MS, &config->sample_period_ms, sizeof(config->sample_period_ms));
+    p = write_field(p, CONFIG_KEY_IMU_RATE_HZ, &config->imu_rate_hz, sizeof(config->imu_rate_hz));
+    p = write_field(p, CONFIG_KEY_LOW_POWER, &config->low_power, sizeof(config->low_power));
+    p = write_field(p, CONFIG_KEY_IDLE_RATE_HZ, &config->idle_rate_hz, sizeof(config->idle_rate_hz));
+    p = write_field(p, CONFIG_KEY_REPORT_POSITION_M, &config->report_position_m, sizeof(config->report_position_m));
+    p = write_field(p, CONFIG_KEY_REPORT_ATTITUDE_DEG, &config->report_attitude_deg, sizeof(config->report_attitude_deg));
+    p = write_field(p, CONFIG_KEY_REPORT_ACCEL_G, &config->report_accel_g, sizeof(config->report_accel_g));
+    p = write_field(p, CONFIG_KEY_REPORT_GYRO_DPS, &config->report_gyro_dps, sizeof(config->report_gyro_dps));
+    p = write_field(p, CONFIG_KEY_REPORT_HEARTBEAT_MS, &config->report_heartbeat_ms, sizeof(config->report_heartbeat_ms));
+    p = write_field(p, CONFIG_KEY_NAV_RATE_HZ, &config->nav_rate_hz, sizeof(config->nav_rate_hz));
+    p = write_field(p, CONFIG_KEY_VIBRATION_POINTS, &config->vibration_points, sizeof(config->vibration_points));
+
+    header->magic = CONFIG_MAGIC;
+    header->version = CONFIG_VERSION;
+    header->length = p - (block + sizeof(config_header_t));
+    header->sequence = active_sequence + 1;
+    header->crc = crc32_update(0, block, offsetof(config_header_t, crc));
+    header->crc = crc32_update(header->crc, block + sizeof(config_header_t), header->length);
+
+    int slot = active_slot == 0 ? 1 : 0;
+    uint32_t offset = slot ? CONFIG_SLOT_B : CONFIG_SLOT_A;
+    size_t size = (sizeof(config_header_t) + header->length + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_erase(offset, FLASH_SECTOR_SIZE);
+    flash_range_program(offset, block, size);
+    restore_interrupts(ints);
+
+    if (!slot_header(slot)) {
+        return false;
+    }
+    active_slot = slot;
+    active_sequence = header->sequence;
+    return true;
+}
+
+/**
+ * @brief Lee tres valores separados por comas
+ */
+static bool parse_triplet(const char *value, float out[3])
+{
+    return sscanf(value, "%f,%f,%f", &out[0], &out[1], &out[2]) == 3;
+}
+
+/**
+ * @brief Lee un entero sin signo dentro de un rango
+ *
+ * @return bool retorna false si el texto no es un numero entero o esta fuera de [min, max].
+ */
+static bool parse_uint(const char *value, uint32_t min, uint32_t max, uint32_t *out)
+{
+    char *end;
+    if (*value < '0' || *value > '9') {
+        return false;  // strtoul would accept spaces and a sign
+    }
+    unsigned long v = strtoul(value, &end, 10);
+    if (*end != '\0' || v < min || v > max) {
+        return false;
+    }
+    *out = v;
+    return true;
+}
+
+/**
+ * @brief Lee un umbral del filtro de reporte, 0 o positivo
+ */
+static bool parse_threshold(const char *value, float *out)
+{
+    char *end;
+    float v = strtof(value, &end);
+    if (end == value || *end != '\0' || !(v >= 0 && v < 1e6f)) {
+        return false;  // Also rejects nan
+    }
+    *out = v;
+    return true;
+}
+
+/**
+ * @brief Compara la clave de una linea "clave=valor" con un nombre
+ */
+static bool key_is(const char *line, size_t keylen, const char *name)
+{
+    return strlen(name) == keylen && strncmp(line, name, keylen) == 0;
+}
+
+/**
+ * @brief Cambia un valor de la configuracion a partir de una linea "clave=valor"
+ *
+ * Permite cambiar la red o la calibracion por la consola USB sin volver a programar la placa.
+ * Ejemplos: "ssid=MiRed", "server_port=8080", "gyro_offset=-11,-6,-15".
+ *
+ * @param config configuracion que se quiere cambiar.
+ * @param line linea con la clave y el valor.
+ * @return bool retorna false si la clave no existe o el valor no es valido.
+ */
+bool config_set(config_t *config, const char *line)
+{
+    const char *value = strchr(line, '=');
+    if (!value) {
+        return false;
+    }
+    size_t keylen = value - line;
+    value++;
+
+    float v[3];
+    int16_t *offset = NULL;
+    if (key_is(line, keylen, "ssid") && strlen(value) < sizeof(config->ssid)) {
+        strcpy(config->ssid, value);
+    } else if (key_is(line, keylen, "password") && strlen(value) < sizeof(config->password)) {
+        strcpy(config->password, value);
+    } else if (key_is(line, keylen, "server_ip") && strlen(value) < sizeof(config->server_ip)) {
+        strcpy(config->server_ip, value);
+    } else if (key_is(line, keylen, "server_port")) {
+        uint32_t port;
+        if (!parse_uint(value, 1, 65535, &port)) {
+            return false;
+        }
+        config->server_port = port;
+    } else if (key_is(line, keylen, "sample_period_ms")) {
+        return parse_uint(value, 1, UINT32_MAX, &config->sample_period_ms);
+    } else if (key_is(line, keylen, "imu_rate_hz")) {
+        return parse_uint(value, 1, CONFIG_MAX_RATE_HZ, &config->imu_rate_hz);
+    } else if (key_is(line, keylen, "low_power")) {
+        uint32_t on;
+        if (!parse_uint(value, 0, 1, &on)) {
+            return false;
+        }
+        config->low_power = on;
+    } else if (key_is(line, keylen, "idle_rate_hz")) {
+        return parse_uint(value, 1, CONFIG_MAX_RATE_HZ, &config->idle_rate_hz);
+    } else if (key_is(line, keylen, "report_position_m")) {
+        return parse_threshold(value, &config->report_position_m);
+    } else if (key_is(line, keylen, "report_attitude_deg")) {
+        return parse_threshold(value, &config->report_attitude_deg);
+    } else if (key_is(line, keylen, "report_accel_g")) {
+        return parse_threshold(value, &config->report_accel_g);
+    } else if (key_is(line, keylen, "report_gyro_dps")) {
+        return parse_threshold(value, &config->report_gyro_dps);
+    } else if (key_is(line, keylen, "report_heartbeat_ms")) {
+        return parse_uint(value, 0, UINT32_MAX, &config->report_heartbeat_ms);
+    } else if (key_is(line, keylen, "nav_rate_hz")) {
+        uint32_t rate;
+        if (!parse_uint(value, 0, CONFIG_MAX_RATE_HZ, &rate) || (rate && rate < CONFIG_MIN_NAV_RATE_HZ)) {
+            return false;
+        }
+        config->nav_rate_hz = rate;
+    } else if (key_is(line, keylen, "vibration_points")) {
+        uint32_t points;
+        if (!parse_uint(value, 0, CONFIG_MAX_VIBRATION_POINTS, &points) || (points & (points - 1)) != 0 ||
+            (points && points < CONFIG_MIN_VIBRATION_POINTS)) {
+            return false;
+        }
+        config->vibration_points = points;
+    } else if (key_is(line, keylen, "mag_scale") && parse_triplet(value, v)) {
+        for (int i = 0; i < 3; i++) config->mag_scale[i] = v[i];
+    } else {
+        if (key_is(line, keylen, "acc_offset")) offset = config->acc_offset;
+        else if (key_is(line, keylen, "gyro_offset")) offset = config->gyro_offset;
+        else if (key_is(line, keylen, "mag_offset")) offset = config->mag_offset;
+
+        if (!offset || !parse_triplet(value, v)) {
+            return false;
+        }
+        for (int i = 0; i < 3; i++) offset[i] = v[i];
+        config->calibrated = true;
+    }
+    return true;
+}
+
+/**
+ * @brief Configuracion activa del equipo
+ *
+ * La primera llamada la carga desde la flash.
+ *
+ * @return const config_t* retorna la configuracion activa.
+ */
+const config_t *config_get()
+{
+    return config_edit();
+}
+
+/**
+ * @brief Configuracion activa del equipo, para modificarla
+ *
+ * Los cambios solo sobreviven un reinicio si despues se llama config_save(config_get()).
+ *
+ * @return config_t* retorna la configuracion activa.
+ */
+config_t *config_edit()
+{
+    if (!loaded) {
+        config_load(&current);
+        loaded = true;
+    }
+    return &current;
+}
\ No newline at end of file
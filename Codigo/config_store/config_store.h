@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#ifndef config_store_h
+#define config_store_h
+
+#define CONFIG_VERSION 1
+
+/**
+ * @brief Claves de los registros guardados en flash.
+ *
+ * Cada registro se guarda como clave, longitud y valor. Las claves nunca se reutilizan: una
+ * clave desconocida se ignora al cargar y una clave ausente conserva su valor por defecto.
+ */
+typedef enum {
+    CONFIG_KEY_ACC_OFFSET = 1,
+    CONFIG_KEY_GYRO_OFFSET = 2,
+    CONFIG_KEY_MAG_OFFSET = 3,
+    CONFIG_KEY_MAG_SCALE = 4,
+    CONFIG_KEY_SSID = 5,
+    CONFIG_KEY_PASSWORD = 6,
+    CONFIG_KEY_SERVER_IP = 7,
+    CONFIG_KEY_SERVER_PORT = 8,
+    CONFIG_KEY_SAMPLE_PERIOD_MS = 9,
+    CONFIG_KEY_IMU_RATE_HZ = 10,
+    CONFIG_KEY_CALIBRATED = 11,
+    CONFIG_KEY_LOW_POWER = 12,
+    CONFIG_KEY_IDLE_RATE_HZ = 13,
+    CONFIG_KEY_REPORT_POSITION_M = 14,
+    CONFIG_KEY_REPORT_ATTITUDE_DEG = 15,
+    CONFIG_KEY_REPORT_ACCEL_G = 16,
+    CONFIG_KEY_REPORT_GYRO_DPS = 17,
+    CONFIG_KEY_REPORT_HEARTBEAT_MS = 18,
+    CONFIG_KEY_NAV_RATE_HZ = 19,
+    CONFIG_KEY_VIBRATION_POINTS = 20,
+} config_key_t;
+
+/**
+ * @brief Configuracion del equipo: calibracion, red y frecuencias de muestreo.
+ */
+typedef struct {
+    int16_t acc_offset[3], gyro_offset[3], mag_offset[3];
+    float mag_scale[3];
+    bool calibrated;            // Offsets come from a calibration, not from the defaults
+    char ssid[33];
+    char password[65];
+    char server_ip[16];
+    uint16_t server_port;
+    uint32_t sample_period_ms;  // Time between samples sent to the server
+    uint32_t imu_rate_hz;       // IMU read rate
+    bool low_power;             // Sleep between events and lower the IMU rate while the board is still
+    uint32_t idle_rate_hz;      // IMU read rate while still, in low power mode
+    float report_position_m;    // Dead-band thresholds of the report filter, 0 turns a field off
+    float report_attitude_deg;
+    float report_accel_g;
+    float report_gyro_dps;
+    uint32_t report_heartbeat_ms; // Longest time without sending a sample, 0 for the filter default (10 s)
+    uint32_t nav_rate_hz;       // GPS/IMU navigation step rate (2 Hz or more), 0 sends the raw GPS position
+    uint32_t vibration_points;  // FFT window of the vibration summaries (256 or 512), 0 for none
+} config_t;
+
+void config_defaults(config_t *config);
+bool config_load(config_t *config);
+bool config_save(const config_t *config);
+bool config_set(config_t *config, const char *line);
+const config_t *config_get();
+config_t *config_edit();
+
+#endif
\ No newline at end of file
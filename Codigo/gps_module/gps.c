@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include "pico/stdlib.h"
 #include "hardware/uart.h"
+#include "spsc_ring.h"
 
 // Define uart properties for the GPS
 const uint8_t DATABITS = 8;
@@ -91,6 +92,45 @@ size_t uart_read_line(uart_inst_t *uart, char *buffer, const size_t max_length){
     return i;
 }
 
+/**
+ * @brief Arma una linea con los bytes que ya llegaron a una cola.
+ *
+ * A diferencia de uart_read_line no espera: la interrupcion del uart llena la cola y esta función
+ * copia a la linea los bytes que haya, sin sacarlos uno por uno. Cuando la linea se completa la
+ * termina en 0 y retorna su tamaño; los bytes de la linea siguiente se quedan en la cola.
+ *
+ * @param spsc_ring_t *ring cola de bytes recibidos.
+ * @param spsc_ring_t *starts cola con la hora (uint64_t) de cada '$' de ring, en el mismo orden, o NULL.
+ * @param char *buffer este es el arreglo donde se va a guardar la linea.
+ * @param const size_t max_length este es el tamaño maximo del arreglo.
+ * @param size_t *fill bytes de la linea recibidos hasta ahora; debe empezar en 0 y se reinicia al completar la linea.
+ * @param uint64_t *start_us hora en que llego el '$' de la linea; se mantiene entre llamadas como fill.
+ * @return size_t retorna el tamaño de la linea completa, o 0 si todavia no termina.
+ */
+size_t ring_read_line(spsc_ring_t *ring, spsc_ring_t *starts, char *buffer, const size_t max_length, size_t *fill, uint64_t *start_us){
+    const void *span;
+    uint32_t n;
+
+    while((n = spsc_ring_read_span(ring, &span)) > 0){
+        const char *bytes = span;
+        for(uint32_t i = 0; i < n; i++){
+            buffer[(*fill)++] = bytes[i];
+            if(bytes[i] == '$' && starts){
+                spsc_ring_pop(starts, start_us); // Pushed with its '$', so it is already there
+            }
+            if(bytes[i] == '\n' || *fill == max_length - 1){
+                spsc_ring_read_commit(ring, i + 1);
+                size_t length = *fill;
+                buffer[length] = '\0';
+                *fill = 0;
+                return length;
+            }
+        }
+        spsc_ring_read_commit(ring, n);
+    }
+    return 0;
+}
+
 /**
  * @brief Si la trama es correcta.
  *
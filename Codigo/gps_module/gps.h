@@ -3,12 +3,14 @@
 #include <stdlib.h>
 #include "pico/stdlib.h"
 #include "hardware/uart.h" 
+#include "spsc_ring.h"
 
 #ifndef gps_h
 #define gps_h
 
 void decode(char gpsString[256], float * latitud, float * longitud);
 size_t uart_read_line(uart_inst_t *uart, char *buffer, const size_t max_length);
+size_t ring_read_line(spsc_ring_t *ring, spsc_ring_t *starts, char *buffer, const size_t max_length, size_t *fill, uint64_t *start_us);
 bool is_correct(const char *message, const size_t length);
 void send_with_checksum(uart_inst_t *uart, const char *message, const size_t length);
 
@@ -0,0 +1,164 @@
+/**
+  @file gps_time.c
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Este archivo relaciona el reloj del equipo (time_us_64) con la hora UTC que entrega el GPS en la trama
+  GNRMC, corrigiendo la deriva del cristal, para que cada muestra pueda llevar su hora UTC.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "gps_time.h"
+
+#define RESYNC_US 50000          // Larger errors move the mapping at once instead of slewing it
+#define DRIFT_MIN_SPAN_US 10000000 // Fixes closer than this make the drift too noisy
+#define SLEW_GAIN 0.25f          // Fraction of the error corrected on each fix
+
+/**
+ * @brief Dias desde el 1 de enero de 1970 para una fecha del calendario gregoriano
+ *
+ * @param y año.
+ * @param m mes (1 a 12).
+ * @param d dia (1 a 31).
+ * @return int64_t retorna el numero de dias.
+ */
+static int64_t days_from_civil(int y, int m, int d)
+{
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (int64_t)era * 146097 + doe - 719468;
+}
+
+/**
+ * @brief Lee un numero de dos digitos
+ */
+static int two_digits(const char *p)
+{
+    return (p[0] - '0') * 10 + (p[1] - '0');
+}
+
+/**
+ * @brief Obtiene la hora UTC de una trama RMC.
+ *
+ * Usa los campos de hora (hhmmss.sss) y fecha (ddmmyy). No modifica la trama, asi que se puede
+ * llamar antes de decode().
+ *
+ * @param sentence trama RMC completa ($GNRMC o $GPRMC).
+ * @param utc_us puntero donde se guardara la hora en microsegundos desde 1970.
+ * @return bool retorna false si la trama no es RMC, no tiene fix valido o le faltan campos.
+ */
+bool gps_parse_rmc_time(const char *sentence, int64_t *utc_us)
+{
+    const char *fields[10];
+    const char *p = sentence;
+
+    if (strncmp(sentence + 3, "RMC,", 4) != 0) {
+        return false;
+    }
+    for (int i = 0; i < 10; i++) {
+        fields[i] = p;
+        p = strchr(p, ',');
+        if (p == NULL) {
+            return false;
+        }
+        p++;
+    }
+
+    const char *time = fields[1], *status = fields[2], *date = fields[9];
+    if (*status != 'A' || fields[2] - time < 7 || p - date < 7) { // Time needs hhmmss, date needs ddmmyy
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        if (time[i] < '0' || time[i] > '9' || date[i] < '0' || date[i] > '9') {
+            return false;
+        }
+    }
+
+    int64_t us = 0;
+    if (time[6] == '.') { // Fraction of a second, any number of digits
+        int64_t scale = 100000;
+        for (const char *f = time + 7; *f >= '0' && *f <= '9' && scale > 0; f++) {
+            us += (*f - '0') * scale;
+            scale /= 10;
+        }
+    }
+
+    int64_t days = days_from_civil(2000 + two_digits(date + 4), two_digits(date + 2), two_digits(date));
+    int64_t seconds = days * 86400 + two_digits(time) * 3600 + two_digits(time + 2) * 60 + two_digits(time + 4);
+    *utc_us = seconds * 1000000 + us;
+    return true;
+}
+
+/**
+ * @brief Reinicia la relacion entre el reloj del equipo y UTC.
+ *
+ * @param sync relacion que se quiere reiniciar.
+ */
+void gps_time_sync_reset(gps_time_sync_t *sync)
+{
+    memset(sync, 0, sizeof(*sync));
+}
+
+/**
+ * @brief Agrega un fix del GPS a la relacion entre relojes.
+ *
+ * La primera vez fija la referencia. Despues corrige una parte del error en cada fix (para que la
+ * hora no salte) y mide la deriva del reloj entre fixes separados al menos 10 s. Si el error es
+ * grande (fixes perdidos, salto de hora del GPS) la referencia se mueve de una vez.
+ *
+ * @param sync relacion entre relojes.
+ * @param device_us hora del equipo cuando llego la trama.
+ * @param utc_us hora UTC de la trama.
+ */
+void gps_time_sync_update(gps_time_sync_t *sync, uint64_t device_us, int64_t utc_us)
+{
+    sync->fixes++;
+    if (!sync->valid) {
+        sync->valid = true;
+        sync->ref_device_us = sync->last_device_us = device_us;
+        sync->ref_utc_us = sync->last_utc_us = utc_us;
+        sync->drift_ppm = 0;
+        return;
+    }
+
+    int64_t predicted = gps_time_sync_to_utc(sync, device_us);
+    int64_t error = utc_us - predicted;
+    if (llabs(error) > RESYNC_US) {
+        sync->ref_device_us = sync->last_device_us = device_us;
+        sync->ref_utc_us = sync->last_utc_us = utc_us;
+        sync->resyncs++;
+        return;
+    }
+
+    int64_t span = device_us - sync->last_device_us;
+    if (span >= DRIFT_MIN_SPAN_US) {
+        float measured = (float)((utc_us - sync->last_utc_us) - span) * 1e6f / (float)span;
+        sync->drift_ppm = sync->drift_updates++ == 0 ? measured : sync->drift_ppm + 0.2f * (measured - sync->drift_ppm);
+        sync->last_device_us = device_us;
+        sync->last_utc_us = utc_us;
+    }
+
+    sync->ref_device_us = device_us;
+    sync->ref_utc_us = predicted + (int64_t)(error * SLEW_GAIN);
+}
+
+/**
+ * @brief Convierte una hora del equipo a UTC.
+ *
+ * @param sync relacion entre relojes.
+ * @param device_us hora del equipo (time_us_64).
+ * @return int64_t retorna microsegundos UTC desde 1970, o 0 si todavia no hay fix.
+ */
+int64_t gps_time_sync_to_utc(const gps_time_sync_t *sync, uint64_t device_us)
+{
+    if (!sync->valid) {
+        return 0;
+    }
+    int64_t delta = (int64_t)(device_us - sync->ref_device_us);
+    return sync->ref_utc_us + delta + (int64_t)(delta * (sync->drift_ppm * 1e-6f));
+}
\ No newline at end of file
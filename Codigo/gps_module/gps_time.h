@@ -0,0 +1,27 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef gps_time_h
+#define gps_time_h
+
+/**
+ * @brief Relacion entre el reloj del equipo (time_us_64) y la hora UTC del GPS.
+ */
+typedef struct {
+    bool valid;
+    uint64_t ref_device_us;  // Device time of the reference fix
+    int64_t ref_utc_us;      // UTC of the reference fix, microseconds since 1970
+    uint64_t last_device_us; // Device time of the last fix used for the drift
+    int64_t last_utc_us;
+    float drift_ppm;         // How fast the device clock runs against UTC
+    uint32_t drift_updates;
+    uint32_t fixes;
+    uint32_t resyncs;        // Times the mapping jumped instead of slewing
+} gps_time_sync_t;
+
+bool gps_parse_rmc_time(const char *sentence, int64_t *utc_us);
+void gps_time_sync_reset(gps_time_sync_t *sync);
+void gps_time_sync_update(gps_time_sync_t *sync, uint64_t device_us, int64_t utc_us);
+int64_t gps_time_sync_to_utc(const gps_time_sync_t *sync, uint64_t device_us);
+
+#endif
\ No newline at end of file
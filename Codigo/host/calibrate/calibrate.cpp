@@ -0,0 +1,174 @@
+/**
+  @file calibrate.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Corre en el PC los mismos algoritmos de calibracion del firmware (calibration.c) sobre datos grabados.
+  Acepta registros de telemetria (datos.csv) o lecturas crudas (9 enteros por linea: acc, gyro, mag).
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "telemetry_log.h"
+extern "C" {
+    #include "calibration.h"
+}
+
+struct RawSample
+{
+    int16_t acc[3], gyro[3], mag[3];
+};
+
+/**
+ * @brief Lee un archivo de lecturas crudas.
+ *
+ * @param path ruta del archivo.
+ * @param samples vector donde se agregan las lecturas.
+ * @return bool retorna false si no se pudo abrir el archivo.
+ */
+static bool read_raw(const std::string &path, std::vector<RawSample> &samples)
+{
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        int v[9];
+        if (sscanf(line.c_str(), "%d,%d,%d,%d,%d,%d,%d,%d,%d", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]) != 9) continue;
+        RawSample s;
+        for (int i = 0; i < 3; i++)
+        {
+            s.acc[i] = v[i];
+            s.gyro[i] = v[3 + i];
+            s.mag[i] = v[6 + i];
+        }
+        samples.push_back(s);
+    }
+    return true;
+}
+
+static void print_stats(const char *name, const calib_stats_t &stats)
+{
+    int16_t offset[3];
+    float var[3];
+    calib_stats_offset(&stats, offset);
+    calib_stats_variance(&stats, var);
+    printf("Offset %s. X=%d, Y=%d, Z=%d (var %.2f %.2f %.2f)\n", name, offset[0], offset[1], offset[2], var[0], var[1], var[2]);
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: calibrate [--raw] [--tolerance factor] [--max samples] file\n");
+}
+
+int main(int argc, char **argv)
+{
+    bool raw = false;
+    float tolerance = 1.0f;  // Scales the per sensor tolerances of calibration.h
+    size_t maxSamples = 2000;
+    const char *path = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--raw") == 0) raw = true;
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) tolerance = atof(argv[++i]);
+        else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) maxSamples = strtoul(argv[++i], nullptr, 10);
+        else if (argv[i][0] != '-') path = argv[i];
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (!path)
+    {
+        usage();
+        return 2;
+    }
+
+    std::vector<RawSample> samples;
+    if (raw)
+    {
+        if (!read_raw(path, samples))
+        {
+            fprintf(stderr, "cannot open %s\n", path);
+            return 1;
+        }
+    }
+    else
+    {
+        std::vector<TelemetryRow> rows;
+        std::string error;
+        if (!read_telemetry_csv(path, rows, error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        for (const TelemetryRow &row : rows)
+        {
+            RawSample s;
+            for (int i = 0; i < 3; i++)
+            {
+                s.acc[i] = to_raw(row.acc[i], ACC_FULL_SCALE);
+                s.gyro[i] = to_raw(row.gyro[i], GYRO_FULL_SCALE);
+                s.mag[i] = to_raw(row.mag[i], MAG_FULL_SCALE);
+            }
+            samples.push_back(s);
+        }
+    }
+    printf("%zu samples read from %s\n", samples.size(), path);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Same loop as calibrate_still_dev: stop once the three means are stable
+    calib_stats_t acc, gyro, mag;
+    calib_stats_reset(&acc);
+    calib_stats_reset(&gyro);
+    calib_stats_reset(&mag);
+    size_t used = 0;
+    bool converged = false;
+    while (used < samples.size() && used < maxSamples && !converged)
+    {
+        calib_stats_add(&acc, samples[used].acc);
+        calib_stats_add(&gyro, samples[used].gyro);
+        if (used == 0 || memcmp(samples[used].mag, samples[used - 1].mag, sizeof(samples[used].mag)) != 0)
+        {
+            calib_stats_add(&mag, samples[used].mag);
+        }
+        used++;
+        converged = calib_stats_converged(&acc, CALIB_ACC_TOLERANCE * tolerance) && calib_stats_converged(&gyro, CALIB_GYRO_TOLERANCE * tolerance) &&
+                    calib_stats_converged(&mag, CALIB_MAG_TOLERANCE * tolerance);
+    }
+
+    calib_ellipsoid_t fit;
+    calib_ellipsoid_reset(&fit);
+    for (const RawSample &s : samples) calib_ellipsoid_add(&fit, s.mag);
+    calib_mag_t magCal;
+    bool fitted = calib_ellipsoid_solve(&fit, &magCal);
+
+    double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    printf("Still calibration used %zu samples (%s), %.1f ms at 1 kHz on the device\n", used, converged ? "converged" : "not converged", used * 1.0);
+    print_stats("accl", acc);
+    print_stats("gyro", gyro);
+    print_stats(" mag", mag);
+
+    if (fitted)
+    {
+        printf("Mag hard iron X=%.1f, Y=%.1f, Z=%.1f\n", magCal.offset[0], magCal.offset[1], magCal.offset[2]);
+        printf("Mag soft iron X=%.3f, Y=%.3f, Z=%.3f\n", magCal.scale[0], magCal.scale[1], magCal.scale[2]);
+        printf("Mag radius %.1f, residual %.2f%%, quality %.2f\n", magCal.radius, magCal.rms * 100, magCal.quality);
+    }
+    else
+    {
+        printf("Mag fit not possible: the data does not cover enough orientations\n");
+    }
+    printf("Host processing time %.1f us\n", elapsed);
+    return 0;
+}
\ No newline at end of file
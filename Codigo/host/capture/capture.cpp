@@ -0,0 +1,301 @@
+/**
+  @file capture.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Recibe en el PC las tramas binarias que envia usbStream por el USB: guarda los bytes en disco tal como
+  llegan, opcionalmente las escribe en CSV, y reporta cada segundo tramas por segundo, bytes por segundo,
+  tramas perdidas (saltos en el numero de secuencia) y bytes descartados por errores de CRC.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+extern "C" {
+    #include "telemetry_frame.h"
+}
+
+/**
+ * @brief Contadores de la captura.
+ */
+struct CaptureStats
+{
+    uint64_t bytes = 0, imuFrames = 0, gpsFrames = 0, dropped = 0, badBytes = 0, restarts = 0;
+};
+
+/**
+ * @brief Separa las tramas del flujo de bytes y lleva la cuenta de las perdidas.
+ */
+class FrameReader
+{
+public:
+    explicit FrameReader(FILE *csv) : csv(csv)
+    {
+        if (csv) fprintf(csv, "type,seq,t_us,accx,accy,accz,gyrox,gyroy,gyroz,magx,magy,magz,temp,lat_e7,lon_e7,utc_us\n");
+    }
+
+    /**
+     * @brief Agrega bytes recibidos y procesa todas las tramas completas.
+     */
+    void feed(const uint8_t *data, size_t length)
+    {
+        stats.bytes += length;
+        pending.insert(pending.end(), data, data + length);
+
+        size_t offset = 0, used;
+        telemetry_frame_t frame;
+        while (offset < pending.size())
+        {
+            int result = telemetry_frame_decode(pending.data() + offset, pending.size() - offset, &frame, &used);
+            if (result == 0) break;
+            offset += used;
+            if (result < 0)
+            {
+                stats.badBytes += used;
+                continue;
+            }
+            on_frame(frame);
+        }
+        pending.erase(pending.begin(), pending.begin() + offset);
+    }
+
+    CaptureStats stats;
+
+private:
+    void on_frame(const telemetry_frame_t &frame)
+    {
+        if (started && frame.seq > nextSeq) stats.dropped += frame.seq - nextSeq;
+        else if (started && frame.seq < nextSeq) stats.restarts++;  // The board was reset
+        started = true;
+        nextSeq = frame.seq + 1;
+
+        if (frame.type == TELEMETRY_FRAME_IMU) stats.imuFrames++;
+        else stats.gpsFrames++;
+        if (!csv) return;
+
+        if (frame.type == TELEMETRY_FRAME_IMU)
+        {
+            fprintf(csv, "imu,%" PRIu32 ",%" PRIu64 ",%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,,,\n", frame.seq, frame.t_us, frame.imu.acc[0],
+                    frame.imu.acc[1], frame.imu.acc[2], frame.imu.gyro[0], frame.imu.gyro[1], frame.imu.gyro[2], frame.imu.mag[0],
+                    frame.imu.mag[1], frame.imu.mag[2], frame.imu.temp);
+        }
+        else
+        {
+            fprintf(csv, "gps,%" PRIu32 ",%" PRIu64 ",,,,,,,,,,,%" PRId32 ",%" PRId32 ",%" PRId64 "\n", frame.seq, frame.t_us,
+                    frame.gps.lat_e7, frame.gps.lon_e7, frame.gps.utc_us);
+        }
+    }
+
+    FILE *csv;
+    std::vector<uint8_t> pending;
+    bool started = false;
+    uint32_t nextSeq = 0;
+};
+
+/**
+ * @brief Abre el puerto serie del USB CDC en modo crudo (sin eco ni conversion de saltos de linea).
+ *
+ * @return int retorna el descriptor, -1 si no se pudo abrir.
+ */
+static int open_port(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    if (fd < 0) return -1;
+
+    termios tty;
+    if (tcgetattr(fd, &tty) == 0)
+    {
+        cfmakeraw(&tty);
+        tty.c_cc[VMIN] = 0;
+        tty.c_cc[VTIME] = 1;  // read() returns after 100 ms without data, so the report keeps running
+        tcsetattr(fd, TCSANOW, &tty);
+    }
+    tcflush(fd, TCIFLUSH);
+    return fd;
+}
+
+static void print_stats(const CaptureStats &now, const CaptureStats &before, double seconds)
+{
+    printf("%7.0f IMU frames/s %4.0f GPS frames/s %8.1f kB/s | total %" PRIu64 " frames, %" PRIu64 " dropped, %" PRIu64 " bad bytes\n",
+           (now.imuFrames - before.imuFrames) / seconds, (now.gpsFrames - before.gpsFrames) / seconds, (now.bytes - before.bytes) / seconds / 1000,
+           now.imuFrames + now.gpsFrames, now.dropped, now.badBytes);
+    fflush(stdout);
+}
+
+/**
+ * @brief Genera un flujo como el de usbStream con perdidas y bytes dañados conocidos y verifica que
+ * el lector los cuente igual.
+ *
+ * @return bool retorna true si los contadores coinciden.
+ */
+static bool simulate(double seconds, FILE *out, FILE *csv)
+{
+    std::mt19937 rng(2023);
+    std::vector<uint8_t> stream;
+    uint8_t buf[TELEMETRY_FRAME_MAX];
+    uint64_t frames = 0, dropped = 0, corrupted = 0;
+    const uint32_t total = seconds * 1000;
+
+    for (uint32_t seq = 0, ms = 0; ms < total; ms++)
+    {
+        telemetry_frame_t frame = {};
+        frame.type = TELEMETRY_FRAME_IMU;
+        frame.seq = seq++;
+        frame.t_us = ms * 1000ull;
+        for (int i = 0; i < 3; i++)
+        {
+            frame.imu.acc[i] = rng();
+            frame.imu.gyro[i] = rng();
+            frame.imu.mag[i] = rng();
+        }
+        frame.imu.temp = rng();
+
+        size_t length = telemetry_frame_encode(&frame, buf);
+        if (rng() % 500 == 0)
+        {
+            dropped++;  // Lost on the device, only the sequence number shows it
+            continue;
+        }
+        if (rng() % 700 == 0)
+        {
+            buf[1 + rng() % (length - 1)] ^= 1 << (rng() % 8);  // Damaged on the way, the CRC rejects it
+            corrupted++;
+        }
+        else
+        {
+            frames++;
+        }
+        stream.insert(stream.end(), buf, buf + length);
+
+        if (ms % 1000 == 999)
+        {
+            frame = {};
+            frame.type = TELEMETRY_FRAME_GPS;
+            frame.seq = seq++;
+            frame.t_us = ms * 1000ull;
+            frame.gps.lat_e7 = 62334567 + ms;
+            frame.gps.lon_e7 = -755678901 - ms;
+            frame.gps.utc_us = 1683547200000000ll + ms * 1000ll;
+            length = telemetry_frame_encode(&frame, buf);
+            stream.insert(stream.end(), buf, buf + length);
+            frames++;
+        }
+    }
+    if (out) fwrite(stream.data(), 1, stream.size(), out);
+
+    FrameReader reader(csv);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < stream.size();)
+    {
+        size_t n = std::min<size_t>(1 + rng() % 4096, stream.size() - i);  // USB packets split the frames anywhere
+        reader.feed(stream.data() + i, n);
+        i += n;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const CaptureStats &s = reader.stats;
+    // A damaged frame is either skipped whole (counted as a gap) or shows up as bad bytes
+    bool ok = s.imuFrames + s.gpsFrames == frames && s.dropped == dropped + corrupted && s.restarts == 0;
+    printf("Simulated %.0f s: %" PRIu64 " frames, %" PRIu64 " dropped and %" PRIu64 " corrupted on purpose\n", seconds, frames, dropped, corrupted);
+    printf("Read %" PRIu64 " frames, %" PRIu64 " dropped, %" PRIu64 " bad bytes, %.0f MB/s: %s\n", s.imuFrames + s.gpsFrames, s.dropped,
+           s.badBytes, stream.size() / elapsed / 1e6, ok ? "OK" : "MISMATCH");
+    return ok;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: capture (--port /dev/ttyACM0 | --in capture.bin | --simulate seconds) [--out capture.bin] [--csv frames.csv] [--seconds n]\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *port = nullptr, *in = nullptr, *outPath = nullptr, *csvPath = nullptr;
+    double seconds = 0, simulated = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) port = argv[++i];
+        else if (strcmp(argv[i], "--in") == 0 && i + 1 < argc) in = argv[++i];
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) outPath = argv[++i];
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) csvPath = argv[++i];
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--simulate") == 0 && i + 1 < argc) simulated = atof(argv[++i]);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if ((port != nullptr) + (in != nullptr) + (simulated > 0) != 1)
+    {
+        usage();
+        return 1;
+    }
+
+    FILE *out = outPath ? fopen(outPath, "wb") : nullptr;
+    FILE *csv = csvPath ? fopen(csvPath, "w") : nullptr;
+    if ((outPath && !out) || (csvPath && !csv))
+    {
+        fprintf(stderr, "Cannot open %s\n", outPath && !out ? outPath : csvPath);
+        return 1;
+    }
+
+    if (simulated > 0)
+    {
+        bool ok = simulate(simulated, out, csv);
+        if (out) fclose(out);
+        if (csv) fclose(csv);
+        return ok ? 0 : 1;
+    }
+
+    int fd = port ? open_port(port) : open(in, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Cannot open %s\n", port ? port : in);
+        return 1;
+    }
+
+    FrameReader reader(csv);
+    CaptureStats last;
+    std::vector<uint8_t> buf(1 << 16);
+    auto start = std::chrono::steady_clock::now(), lastReport = start;
+
+    while (1)
+    {
+        ssize_t n = read(fd, buf.data(), buf.size());
+        if (n < 0 || (n == 0 && !port)) break;
+        if (n > 0)
+        {
+            if (out) fwrite(buf.data(), 1, n, out);  // Raw bytes, --in replays them later
+            reader.feed(buf.data(), n);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (port && now - lastReport >= std::chrono::seconds(1))
+        {
+            print_stats(reader.stats, last, std::chrono::duration<double>(now - lastReport).count());
+            last = reader.stats;
+            lastReport = now;
+        }
+        if (seconds > 0 && std::chrono::duration<double>(now - start).count() >= seconds) break;
+    }
+    close(fd);
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const CaptureStats &s = reader.stats;
+    printf("%" PRIu64 " bytes, %" PRIu64 " IMU and %" PRIu64 " GPS frames in %.1f s (%.1f kB/s), %" PRIu64 " dropped (%.3f%%), %" PRIu64
+           " bad bytes, %" PRIu64 " restarts\n",
+           s.bytes, s.imuFrames, s.gpsFrames, elapsed, s.bytes / elapsed / 1000, s.dropped,
+           100.0 * s.dropped / std::max<uint64_t>(1, s.dropped + s.imuFrames + s.gpsFrames), s.badBytes, s.restarts);
+    if (out) fclose(out);
+    if (csv) fclose(csv);
+    return 0;
+}
\ No newline at end of file
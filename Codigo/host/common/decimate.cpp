@@ -0,0 +1,303 @@
+/**
+  @file decimate.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Simplificacion de trayectorias (Douglas-Peucker) y reduccion de series (LTTB) para graficar registros
+  largos con un numero fijo de puntos.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include "decimate.h"
+#include <algorithm>
+#include <cmath>
+
+static const double EARTH_RADIUS = 6371000.0; // m
+static const double DEG_TO_RAD = M_PI / 180.0;
+
+/**
+ * @brief Distancia aproximada (equirectangular) entre dos puntos cercanos.
+ *
+ * @param a primer punto.
+ * @param b segundo punto.
+ * @return double retorna la distancia en metros.
+ */
+double distance_meters(const GeoPoint &a, const GeoPoint &b)
+{
+    double x = (b.lon - a.lon) * DEG_TO_RAD * cos((a.lat + b.lat) * 0.5 * DEG_TO_RAD);
+    double y = (b.lat - a.lat) * DEG_TO_RAD;
+    return sqrt(x * x + y * y) * EARTH_RADIUS;
+}
+
+/**
+ * @brief Distancia de un punto a un segmento, en el plano.
+ */
+static double segment_distance(double px, double py, double ax, double ay, double bx, double by)
+{
+    double dx = bx - ax, dy = by - ay;
+    double len2 = dx * dx + dy * dy;
+    double t = len2 > 0 ? ((px - ax) * dx + (py - ay) * dy) / len2 : 0;
+    t = std::max(0.0, std::min(1.0, t));
+    double ex = ax + t * dx - px, ey = ay + t * dy - py;
+    return sqrt(ex * ex + ey * ey);
+}
+
+/**
+ * @brief Simplifica una trayectoria con Douglas-Peucker.
+ *
+ * Proyecta los puntos a metros alrededor del primero y usa una pila en lugar de recursion, asi
+ * que no se desborda con trayectorias largas.
+ *
+ * @param track puntos de la trayectoria.
+ * @param toleranceMeters distancia maxima entre la trayectoria original y la simplificada.
+ * @return std::vector<size_t> retorna los indices de los puntos que se conservan, en orden.
+ */
+std::vector<size_t> douglas_peucker(const std::vector<GeoPoint> &track, double toleranceMeters)
+{
+    std::vector<size_t> result;
+    if (track.size() < 3)
+    {
+        for (size_t i = 0; i < track.size(); i++) result.push_back(i);
+        return result;
+    }
+
+    double lat0 = track[0].lat, lon0 = track[0].lon;
+    double kx = DEG_TO_RAD * EARTH_RADIUS * cos(lat0 * DEG_TO_RAD), ky = DEG_TO_RAD * EARTH_RADIUS;
+    std::vector<double> x(track.size()), y(track.size());
+    for (size_t i = 0; i < track.size(); i++)
+    {
+        x[i] = (track[i].lon - lon0) * kx;
+        y[i] = (track[i].lat - lat0) * ky;
+    }
+
+    std::vector<bool> keep(track.size(), false);
+    keep.front() = keep.back() = true;
+    std::vector<std::pair<size_t, size_t>> stack = {{0, track.size() - 1}};
+    while (!stack.empty())
+    {
+        auto [first, last] = stack.back();
+        stack.pop_back();
+
+        double worst = 0;
+        size_t index = first;
+        for (size_t i = first + 1; i < last; i++)
+        {
+            double d = segment_distance(x[i], y[i], x[first], y[first], x[last], y[last]);
+            if (d > worst)
+            {
+                worst = d;
+                index = i;
+            }
+        }
+        if (worst > toleranceMeters)
+        {
+            keep[index] = true;
+            if (index - first > 1) stack.push_back({first, index});
+            if (last - index > 1) stack.push_back({index, last});
+        }
+    }
+
+    for (size_t i = 0; i < track.size(); i++)
+    {
+        if (keep[i]) result.push_back(i);
+    }
+    return result;
+}
+
+/**
+ * @brief Reduce una serie con Largest-Triangle-Three-Buckets.
+ *
+ * Conserva el primer y el ultimo punto y, en cada grupo intermedio, el punto que forma el triangulo
+ * mas grande con el punto elegido antes y el promedio del grupo siguiente.
+ *
+ * @param series serie ordenada por x.
+ * @param budget numero de puntos de la salida (normalmente el ancho en pixeles).
+ * @return std::vector<SeriesPoint> retorna la serie reducida.
+ */
+std::vector<SeriesPoint> lttb(const std::vector<SeriesPoint> &series, size_t budget)
+{
+    if (budget >= series.size() || budget < 3) return series;
+
+    std::vector<SeriesPoint> out;
+    out.reserve(budget);
+    out.push_back(series.front());
+
+    double every = (double)(series.size() - 2) / (budget - 2);
+    size_t a = 0;
+    for (size_t i = 0; i < budget - 2; i++)
+    {
+        size_t nextStart = (size_t)((i + 1) * every) + 1;
+        size_t nextEnd = std::min((size_t)((i + 2) * every) + 1, series.size());
+        double avgX = 0, avgY = 0;
+        for (size_t j = nextStart; j < nextEnd; j++)
+        {
+            avgX += series[j].x;
+            avgY += series[j].y;
+        }
+        size_t count = nextEnd - nextStart;
+        if (count == 0)
+        {
+            avgX = series.back().x;
+            avgY = series.back().y;
+        }
+        else
+        {
+            avgX /= count;
+            avgY /= count;
+        }
+
+        size_t start = (size_t)(i * every) + 1;
+        size_t end = (size_t)((i + 1) * every) + 1;
+        double best = -1;
+        size_t chosen = start;
+        for (size_t j = start; j < end; j++)
+        {
+            double area = fabs((series[a].x - avgX) * (series[j].y - series[a].y) - (series[a].x - series[j].x) * (avgY - series[a].y));
+            if (area > best)
+            {
+                best = area;
+                chosen = j;
+            }
+        }
+        out.push_back(series[chosen]);
+        a = chosen;
+    }
+
+    out.push_back(series.back());
+    return out;
+}
+
+TrackFilter::TrackFilter(double toleranceMeters, size_t capacity)
+    : tolerance(toleranceMeters), compactTolerance(toleranceMeters), capacity(std::max<size_t>(capacity, 16))
+{
+}
+
+/**
+ * @brief Simplifica los puntos guardados hasta dejar a lo sumo la mitad de capacity.
+ */
+void TrackFilter::compact()
+{
+    while (kept.size() > capacity / 2)
+    {
+        std::vector<GeoPoint> simplified;
+        for (size_t i : douglas_peucker(kept, compactTolerance)) simplified.push_back(kept[i]);
+        if (simplified.size() > capacity / 2) compactTolerance *= 2;  // Not enough at this tolerance
+        kept.swap(simplified);
+    }
+}
+
+/**
+ * @brief Agrega un punto de la trayectoria.
+ *
+ * Los puntos en (0, 0), que el firmware envia sin fix, se descartan.
+ */
+void TrackFilter::add(const GeoPoint &point)
+{
+    if (point.lat == 0 && point.lon == 0) return;
+
+    if (kept.empty() || distance_meters(kept.back(), point) > tolerance)
+    {
+        kept.push_back(point);
+        hasPending = false;
+        if (kept.size() >= capacity) compact();
+    }
+    else
+    {
+        pending = point; // Keeps the end of a parked segment
+        hasPending = true;
+    }
+}
+
+/**
+ * @brief Termina la trayectoria.
+ *
+ * @return std::vector<GeoPoint> retorna los puntos que pasaron el filtro, incluido el ultimo.
+ */
+std::vector<GeoPoint> TrackFilter::finish()
+{
+    if (hasPending) kept.push_back(pending);
+    hasPending = false;
+    return kept;
+}
+
+SeriesReducer::SeriesReducer(size_t capacity) : capacity(std::max<size_t>(capacity, 8))
+{
+    kept.reserve(this->capacity);
+}
+
+/**
+ * @brief Agrega un punto de la serie.
+ *
+ * @param x posicion en el eje x, creciente.
+ * @param y valor.
+ */
+void SeriesReducer::add(double x, float y)
+{
+    SeriesPoint p = {x, y};
+
+    if (stride == 1)
+    {
+        kept.push_back(p);
+    }
+    else
+    {
+        if (counter == 0)
+        {
+            low = high = p;
+        }
+        else
+        {
+            if (y < low.y) low = p;
+            if (y > high.y) high = p;
+        }
+        if (++counter < stride) return;
+
+        counter = 0;
+        const SeriesPoint &first = low.x <= high.x ? low : high;
+        const SeriesPoint &second = low.x <= high.x ? high : low;
+        kept.push_back(first);
+        if (second.x != first.x) kept.push_back(second);
+    }
+
+    if (kept.size() >= capacity) compact();
+}
+
+/**
+ * @brief Reduce a la mitad los puntos guardados, conservando minimo y maximo de cada grupo de cuatro.
+ */
+void SeriesReducer::compact()
+{
+    std::vector<SeriesPoint> out;
+    out.reserve(capacity);
+    for (size_t i = 0; i < kept.size(); i += 4)
+    {
+        size_t end = std::min(i + 4, kept.size());
+        size_t lo = i, hi = i;
+        for (size_t j = i + 1; j < end; j++)
+        {
+            if (kept[j].y < kept[lo].y) lo = j;
+            if (kept[j].y > kept[hi].y) hi = j;
+        }
+        out.push_back(kept[std::min(lo, hi)]);
+        if (lo != hi) out.push_back(kept[std::max(lo, hi)]);
+    }
+    kept.swap(out);
+    stride = stride == 1 ? 4 : stride * 2;
+}
+
+/**
+ * @brief Puntos reducidos, incluido el grupo que todavia no se completo.
+ *
+ * @return std::vector<SeriesPoint> retorna la serie reducida, ordenada por x.
+ */
+std::vector<SeriesPoint> SeriesReducer::points() const
+{
+    std::vector<SeriesPoint> out = kept;
+    if (counter > 0)
+    {
+        const SeriesPoint &first = low.x <= high.x ? low : high;
+        const SeriesPoint &second = low.x <= high.x ? high : low;
+        out.push_back(first);
+        if (second.x != first.x) out.push_back(second);
+    }
+    return out;
+}
\ No newline at end of file
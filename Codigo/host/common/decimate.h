@@ -0,0 +1,77 @@
+#include <cstddef>
+#include <vector>
+
+#ifndef decimate_h
+#define decimate_h
+
+/**
+ * @brief Punto de una serie: posicion en el eje x (indice o tiempo) y valor.
+ */
+struct SeriesPoint
+{
+    double x;
+    float y;
+};
+
+/**
+ * @brief Punto de una trayectoria en grados.
+ */
+struct GeoPoint
+{
+    double lat, lon;
+};
+
+std::vector<size_t> douglas_peucker(const std::vector<GeoPoint> &track, double toleranceMeters);
+std::vector<SeriesPoint> lttb(const std::vector<SeriesPoint> &series, size_t budget);
+
+/**
+ * @brief Filtro de distancia minima para una trayectoria que llega punto a punto.
+ *
+ * Descarta los puntos a menos de la tolerancia del ultimo guardado (el dron quieto genera miles de
+ * filas iguales), asi Douglas-Peucker solo trabaja con los puntos en movimiento. Si los puntos
+ * guardados llegan a capacity se simplifican con Douglas-Peucker, y si eso no basta se duplica la
+ * tolerancia de la simplificacion, asi la memoria queda acotada en vuelos de cualquier duracion.
+ */
+class TrackFilter
+{
+    public:
+    explicit TrackFilter(double toleranceMeters, size_t capacity = 1 << 20);
+    void add(const GeoPoint &point);
+    std::vector<GeoPoint> finish();
+
+    private:
+    void compact();
+
+    double tolerance, compactTolerance;
+    size_t capacity;
+    std::vector<GeoPoint> kept;
+    GeoPoint pending;
+    bool hasPending = false;
+};
+
+/**
+ * @brief Reduce una serie que llega punto a punto a memoria acotada.
+ *
+ * Cuando se llena, cada grupo de cuatro puntos se reemplaza por su minimo y su maximo, de modo que
+ * los picos se conservan. El resultado se pasa luego por LTTB para llegar al numero de pixeles.
+ */
+class SeriesReducer
+{
+    public:
+    explicit SeriesReducer(size_t capacity);
+    void add(double x, float y);
+    std::vector<SeriesPoint> points() const;
+
+    private:
+    void compact();
+
+    size_t capacity;
+    size_t stride = 1;   // Input points merged into each kept point before a compaction
+    size_t counter = 0;
+    SeriesPoint low, high;
+    std::vector<SeriesPoint> kept;
+};
+
+double distance_meters(const GeoPoint &a, const GeoPoint &b);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,153 @@
+/**
+  @file telemetry_log.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Lectura de los registros CSV guardados por readPort.py, compartida por las herramientas del PC.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include "telemetry_log.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * @brief Convierte una linea CSV en una fila.
+ *
+ * Las lineas que no empiezan con un numero (por ejemplo el encabezado que readPort.py escribe en cada arranque) se descartan.
+ *
+ * @param line linea terminada en cero.
+ * @param row fila donde se guardaran los valores.
+ * @return bool retorna true si la linea tenia al menos los 11 campos numericos.
+ */
+bool parse_telemetry_line(const char *line, TelemetryRow &row)
+{
+    double values[11];
+    const char *p = line;
+
+    for (int i = 0; i < 11; i++)
+    {
+        char *end;
+        values[i] = strtod(p, &end);
+        if (end == p) return false;
+        p = end;
+        if (i < 10)
+        {
+            if (*p != ',') return false;
+            p++;
+        }
+    }
+
+    row.lat = values[0];
+    row.lon = values[1];
+    for (int i = 0; i < 3; i++)
+    {
+        row.acc[i] = values[2 + i];
+        row.gyro[i] = values[5 + i];
+        row.mag[i] = values[8 + i];
+    }
+
+    // Optional sequence number, device time and UTC
+    row.timed = false;
+    row.seq = 0;
+    row.t_us = 0;
+    row.utc_us = 0;
+    if (*p == ',')
+    {
+        char *end;
+        unsigned long long seq = strtoull(p + 1, &end, 10);
+        if (*end != ',') return true;
+        unsigned long long t = strtoull(end + 1, &end, 10);
+        if (*end != ',') return true;
+        const char *utcStart = end + 1;
+        long long utc = strtoll(utcStart, &end, 10);
+        if (end == utcStart) return true;
+        row.timed = true;
+        row.seq = (uint32_t)seq;
+        row.t_us = t;
+        row.utc_us = utc;
+    }
+    return true;
+}
+
+/**
+ * @brief Lee un registro CSV completo.
+ *
+ * @param path ruta del archivo.
+ * @param rows vector donde se agregan las filas validas.
+ * @param error mensaje de error si no se pudo abrir el archivo.
+ * @return bool retorna false si el archivo no se pudo leer.
+ */
+bool read_telemetry_csv(const std::string &path, std::vector<TelemetryRow> &rows, std::string &error)
+{
+    return scan_telemetry_csv(path, [&rows](const TelemetryRow &row) { rows.push_back(row); }, error);
+}
+
+/**
+ * @brief Recorre un registro CSV fila por fila sin cargarlo completo en memoria.
+ *
+ * Lee el archivo en bloques grandes, asi que sirve para registros de millones de filas.
+ *
+ * @param path ruta del archivo.
+ * @param onRow funcion que se llama con cada fila valida.
+ * @param error mensaje de error si no se pudo abrir el archivo.
+ * @return bool retorna false si el archivo no se pudo leer.
+ */
+bool scan_telemetry_csv(const std::string &path, const std::function<void(const TelemetryRow &)> &onRow, std::string &error)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    std::vector<char> buffer(1 << 20);
+    size_t used = 0;
+    TelemetryRow row;
+    while (true)
+    {
+        size_t got = fread(buffer.data() + used, 1, buffer.size() - used - 1, file);
+        size_t end = used + got;
+        bool last = got == 0;
+        if (last && used == 0) break;
+        buffer[end] = '\0';
+
+        char *start = buffer.data();
+        char *newline;
+        while ((newline = (char *)memchr(start, '\n', buffer.data() + end - start)) != nullptr)
+        {
+            *newline = '\0';
+            if (parse_telemetry_line(start, row)) onRow(row);
+            start = newline + 1;
+        }
+
+        used = buffer.data() + end - start;
+        if (last)
+        {
+            // Last line without a newline
+            if (parse_telemetry_line(start, row)) onRow(row);
+            break;
+        }
+        if (used == buffer.size() - 1) used = 0; // A line longer than the buffer is garbage, drop it
+        memmove(buffer.data(), start, used);
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * @brief Convierte un valor fisico en cuentas crudas del MPU9250.
+ *
+ * @param value valor en unidades fisicas.
+ * @param fullScale fondo de escala usado por telemetria.c.
+ * @return int16_t retorna las cuentas crudas.
+ */
+int16_t to_raw(float value, float fullScale)
+{
+    long raw = lround(value / fullScale * 32768.0);
+    if (raw > INT16_MAX) raw = INT16_MAX;
+    if (raw < INT16_MIN) raw = INT16_MIN;
+    return (int16_t)raw;
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifndef telemetry_log_h
+#define telemetry_log_h
+
+// Full scale used by telemetria.c to turn raw counts into physical units
+const float ACC_FULL_SCALE = 2.0f;     // g
+const float GYRO_FULL_SCALE = 250.0f;  // deg/s
+const float MAG_FULL_SCALE = 4800.0f;  // uT
+
+/**
+ * @brief Una fila del registro de telemetria (Latitud,Longitud,accx,...,magz[,seq,t_us,utc_us]).
+ */
+struct TelemetryRow
+{
+    double lat, lon;
+    float acc[3], gyro[3], mag[3];
+    bool timed;       // The row has seq, t_us and utc_us (firmware with timestamps)
+    uint32_t seq;
+    uint64_t t_us;
+    int64_t utc_us;
+};
+
+bool read_telemetry_csv(const std::string &path, std::vector<TelemetryRow> &rows, std::string &error);
+bool scan_telemetry_csv(const std::string &path, const std::function<void(const TelemetryRow &)> &onRow, std::string &error);
+bool parse_telemetry_line(const char *line, TelemetryRow &row);
+int16_t to_raw(float value, float fullScale);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,362 @@
+/**
+  @file csvimport.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Importa registros CSV grandes (los de readPort.py) al almacen por columnas .tlm. El archivo se mapea
+  en memoria, se parte en trozos que empiezan en un inicio de linea y cada hilo convierte el suyo con
+  fast_csv; mientras se escribe una ronda al almacen ya se convierte la siguiente. Reporta los GB/s y
+  con --verify compara bit a bit cada fila con parse_telemetry_line. Con --synthetic genera un registro
+  de prueba del tamaño pedido.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "fast_csv.h"
+#include "telemetry_log.h"
+#include "telemetry_store.h"
+extern "C" {
+    #include "telemetry.h"
+}
+
+static const size_t ROUND_BYTES = 64 << 20;  // Parsed per round by all the threads, bounds the memory
+
+/**
+ * @brief Opciones de la linea de comandos.
+ */
+struct Options
+{
+    const char *path = nullptr;
+    std::string out;
+    int threads = 0;
+    CsvIsa isa = csv_best_isa();
+    bool verify = false;
+    int64_t periodUs = 1000000, start = 0;
+};
+
+/**
+ * @brief Registro mapeado en memoria, solo lectura.
+ */
+class MappedFile
+{
+public:
+    ~MappedFile()
+    {
+        if (data && size) munmap((void *)data, size);
+        if (fd >= 0) close(fd);
+    }
+
+    bool open(const char *path, std::string &error)
+    {
+        fd = ::open(path, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) < 0)
+        {
+            error = std::string("cannot open ") + path;
+            return false;
+        }
+        size = st.st_size;
+        if (size == 0) return true;
+        void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            error = std::string("cannot map ") + path + ": " + strerror(errno);
+            return false;
+        }
+        madvise(map, size, MADV_SEQUENTIAL | MADV_WILLNEED);
+        data = (const char *)map;
+        return true;
+    }
+
+    const char *data = nullptr;
+    size_t size = 0;
+
+private:
+    int fd = -1;
+};
+
+/**
+ * @brief Primer inicio de linea en o despues de pos.
+ */
+static size_t line_start(const MappedFile &file, size_t pos)
+{
+    if (pos == 0 || pos >= file.size) return std::min(pos, file.size);
+    const void *newline = memchr(file.data + pos - 1, '\n', file.size - pos + 1);
+    return newline ? (const char *)newline - file.data + 1 : file.size;
+}
+
+/**
+ * @brief Convierte [begin, end) repartido entre los hilos, cada uno en sus propias columnas.
+ */
+static void parse_round(const MappedFile &file, size_t begin, size_t end, const Options &options, std::vector<CsvColumns> &parts)
+{
+    const size_t n = parts.size();
+    std::vector<size_t> cuts(n + 1);
+    cuts[0] = begin;
+    cuts[n] = end;
+    for (size_t i = 1; i < n; i++) cuts[i] = std::max(cuts[i - 1], line_start(file, begin + (end - begin) * i / n));
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < n; i++)
+    {
+        parts[i].clear();
+        parts[i].reserve((cuts[i + 1] - cuts[i]) / 90);  // About 90 bytes per timestamped row
+        auto work = [&, i] { csv_parse_chunk(file.data + cuts[i], cuts[i + 1] - cuts[i], options.isa, parts[i]); };
+        if (i + 1 < n) threads.emplace_back(work);
+        else work();
+    }
+    for (auto &t : threads) t.join();
+}
+
+/**
+ * @brief Agrega las filas al almacen con las mismas reglas de hora que "query ingest".
+ */
+static void write_parts(StoreWriter &writer, const std::vector<CsvColumns> &parts, const Options &options, uint64_t &index)
+{
+    for (const CsvColumns &c : parts)
+    {
+        for (size_t i = 0; i < c.size(); i++, index++)
+        {
+            StoreRow r;
+            r.t_us = c.timed[i] ? (c.utc_us[i] ? c.utc_us[i] : (int64_t)c.t_us[i]) : options.start + (int64_t)index * options.periodUs;
+            r.lat = c.lat[i];
+            r.lon = c.lon[i];
+            for (int k = 0; k < 3; k++)
+            {
+                r.acc[k] = c.imu[k][i];
+                r.gyro[k] = c.imu[3 + k][i];
+                r.mag[k] = c.imu[6 + k][i];
+            }
+            r.seq = c.timed[i] ? c.seq[i] : index;
+            writer.add(r);
+        }
+    }
+}
+
+/**
+ * @brief Compara una ronda con parse_telemetry_line linea por linea.
+ *
+ * @return uint64_t retorna el numero de filas distintas (o que sobran o faltan).
+ */
+static uint64_t verify_round(const MappedFile &file, size_t begin, size_t end, const std::vector<CsvColumns> &parts, double &seconds)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<TelemetryRow> reference;
+    std::string line;
+    TelemetryRow row;
+    for (size_t pos = begin; pos < end;)
+    {
+        const char *newline = (const char *)memchr(file.data + pos, '\n', end - pos);
+        const size_t stop = newline ? newline - file.data : end;
+        line.assign(file.data + pos, stop - pos);
+        if (parse_telemetry_line(line.c_str(), row)) reference.push_back(row);
+        pos = stop + 1;
+    }
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    uint64_t mismatches = 0;
+    size_t k = 0;
+    for (const CsvColumns &c : parts)
+    {
+        for (size_t i = 0; i < c.size(); i++, k++)
+        {
+            if (k >= reference.size())
+            {
+                mismatches++;
+                continue;
+            }
+            const TelemetryRow &r = reference[k];
+            bool same = memcmp(&r.lat, &c.lat[i], sizeof(double)) == 0 && memcmp(&r.lon, &c.lon[i], sizeof(double)) == 0 &&
+                        (bool)c.timed[i] == r.timed && c.seq[i] == r.seq && c.t_us[i] == r.t_us && c.utc_us[i] == r.utc_us;
+            for (int a = 0; a < 3; a++)
+            {
+                same = same && memcmp(&r.acc[a], &c.imu[a][i], sizeof(float)) == 0 && memcmp(&r.gyro[a], &c.imu[3 + a][i], sizeof(float)) == 0 &&
+                       memcmp(&r.mag[a], &c.imu[6 + a][i], sizeof(float)) == 0;
+            }
+            if (!same && mismatches++ < 5) fprintf(stderr, "row %zu of the round differs from parse_telemetry_line\n", k);
+        }
+    }
+    if (reference.size() > k) mismatches += reference.size() - k;
+    return mismatches;
+}
+
+/**
+ * @brief Escribe un registro de prueba como los de readPort.py: encabezado en cada arranque, "\r\n",
+ * filas viejas de 11 columnas y filas nuevas con seq, t_us y utc_us.
+ */
+static int synthetic(const char *path, uint64_t rows)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+    const char *header = "Latitud,Longitud,accx,accy,accz,gyrox,gyroy,gyroz,magx,magy,magz,seq,t_us,utc_us\r\n";
+    std::mt19937 rng(2023);
+    std::normal_distribution<float> noise(0, 1);
+    std::vector<char> buffer;
+    buffer.reserve(1 << 22);
+    telemetry_sample_t s = {};
+    s.lat = 6.267552f;
+    s.lon = -75.567749f;
+    s.utc_us = 1683504000000000;
+    char line[TELEMETRY_CSV_MAX + 2];
+    for (uint64_t i = 0; i < rows; i++)
+    {
+        if (i % 100000 == 0) buffer.insert(buffer.end(), header, header + strlen(header));
+        const double t = i * 0.1;
+        s.seq = i;
+        s.t_us = i * 100000;
+        s.utc_us += 100000;
+        s.lat += 2e-6f * (float)cos(t * 0.01);
+        s.lon += 2e-6f * (float)sin(t * 0.01);
+        for (int k = 0; k < 3; k++)
+        {
+            s.acc[k] = (k == 2 ? -1.0f : 0.0f) + 0.05f * noise(rng);
+            s.gyro[k] = 2.0f * noise(rng);
+            s.mag[k] = 25.0f + 10.0f * noise(rng);
+        }
+        int length = telemetry_format_csv(&s, line, TELEMETRY_CSV_MAX);
+        if (i < rows / 4)
+        {
+            // Logs from before the timestamps: only the first 11 columns
+            int commas = 0;
+            for (int k = 0; k < length; k++)
+                if (line[k] == ',' && ++commas == 11) length = k;
+        }
+        line[length++] = '\r';
+        line[length++] = '\n';
+        buffer.insert(buffer.end(), line, line + length);
+        if (buffer.size() > (1 << 22) - 256)
+        {
+            fwrite(buffer.data(), 1, buffer.size(), file);
+            buffer.clear();
+        }
+    }
+    fwrite(buffer.data(), 1, buffer.size(), file);
+    bool ok = fclose(file) == 0;
+    struct stat st;
+    stat(path, &st);
+    printf("Wrote %" PRIu64 " rows, %.1f MB to %s\n", rows, st.st_size / 1e6, path);
+    return ok ? 0 : 1;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: csvimport [--out log.tlm] [--threads n] [--isa avx2|sse2|scalar] [--period-ms n] [--start utc_us] [--verify] datos.csv\n"
+                    "       csvimport --synthetic out.csv --rows n\n");
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    const char *syntheticPath = nullptr;
+    uint64_t syntheticRows = 1000000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) options.out = argv[++i];
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) options.threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--period-ms") == 0 && i + 1 < argc) options.periodUs = atoll(argv[++i]) * 1000;
+        else if (strcmp(argv[i], "--start") == 0 && i + 1 < argc) options.start = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--verify") == 0) options.verify = true;
+        else if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc) syntheticPath = argv[++i];
+        else if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) syntheticRows = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc)
+        {
+            const char *name = argv[++i];
+            if (strcmp(name, "scalar") == 0) options.isa = CsvIsa::Scalar;
+            else if (strcmp(name, "sse2") == 0 && csv_best_isa() != CsvIsa::Scalar) options.isa = CsvIsa::Sse2;
+            else if (strcmp(name, "avx2") == 0 && csv_best_isa() == CsvIsa::Avx2) options.isa = CsvIsa::Avx2;
+            else
+            {
+                fprintf(stderr, "%s is not available on this CPU\n", name);
+                return 1;
+            }
+        }
+        else if (argv[i][0] != '-') options.path = argv[i];
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (syntheticPath) return synthetic(syntheticPath, syntheticRows);
+    if (!options.path)
+    {
+        usage();
+        return 1;
+    }
+    if (options.threads <= 0) options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::string error;
+    MappedFile file;
+    if (!file.open(options.path, error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    StoreWriter writer;
+    if (!options.out.empty() && !writer.open(options.out, error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    // Round k is written on its own thread while round k + 1 is parsed
+    std::vector<CsvColumns> parts[2] = {std::vector<CsvColumns>(options.threads), std::vector<CsvColumns>(options.threads)};
+    std::thread storeThread;
+    uint64_t rows = 0, lines = 0, slowLines = 0, index = 0, mismatches = 0;
+    double parseSeconds = 0, referenceSeconds = 0;
+    auto begin = std::chrono::steady_clock::now();
+    int round = 0;
+    for (size_t pos = 0; pos < file.size; round ^= 1)
+    {
+        const size_t end = line_start(file, std::min(file.size, pos + ROUND_BYTES));
+        auto t0 = std::chrono::steady_clock::now();
+        parse_round(file, pos, end, options, parts[round]);
+        parseSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        for (const CsvColumns &c : parts[round])
+        {
+            rows += c.size();
+            lines += c.lines;
+            slowLines += c.slowLines;
+        }
+        if (options.verify) mismatches += verify_round(file, pos, end, parts[round], referenceSeconds);
+        if (storeThread.joinable()) storeThread.join();
+        if (!options.out.empty()) storeThread = std::thread([&, round] { write_parts(writer, parts[round], options, index); });
+        pos = end;
+    }
+    if (storeThread.joinable()) storeThread.join();
+    if (!options.out.empty() && !writer.close(error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    printf("%" PRIu64 " rows from %" PRIu64 " lines (%" PRIu64 " through parse_telemetry_line), %.1f MB\n", rows, lines, slowLines, file.size / 1e6);
+    printf("Parse: %.3f s, %.2f GB/s, %.1f M rows/s (%s, %d threads)\n", parseSeconds, file.size / parseSeconds / 1e9, rows / parseSeconds / 1e6,
+           csv_isa_name(options.isa), options.threads);
+    if (!options.out.empty()) printf("Import to %s: %.3f s, %.2f GB/s\n", options.out.c_str(), total, file.size / total / 1e9);
+    if (options.verify)
+    {
+        printf("parse_telemetry_line: %.3f s, %.2f GB/s, %.1fx slower\n", referenceSeconds, file.size / referenceSeconds / 1e9, referenceSeconds / parseSeconds);
+        printf("Verify: %" PRIu64 " mismatches, %s\n", mismatches, mismatches ? "FAILED" : "OK");
+        return mismatches ? 1 : 0;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,452 @@
+/**
+  @file fast_csv.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Lectura rapida de los registros CSV en dos pasos: primero se marcan las comas y los saltos de linea
+  de 4 KB a la vez con SSE2 o AVX2 (o byte a byte si no hay), despues se recorren las marcas y se
+  convierten los numeros. Los numeros de hasta 19 cifras se convierten con una sola operacion exacta
+  (metodo de Clinger); el resto va a strtod. Las lineas con otro formato pasan por
+  parse_telemetry_line, asi el resultado es siempre el mismo de las otras herramientas.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include "fast_csv.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "telemetry_log.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FAST_CSV_X86 1
+#endif
+
+static const size_t PIECE = 4096;            // Bytes classified per call, the masks stay in L1
+static const size_t PIECE_WORDS = PIECE / 64;
+
+typedef void (*ClassifyFn)(const char *data, size_t size, uint64_t *masks);
+
+/**
+ * @brief Marca con un bit cada ',' y '\n' de un pedazo; los bits despues de size quedan en cero.
+ */
+static void classify_scalar(const char *data, size_t size, uint64_t *masks)
+{
+    for (size_t w = 0; w * 64 < size; w++)
+    {
+        const size_t n = std::min<size_t>(64, size - w * 64);
+        uint64_t bits = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            const char c = data[w * 64 + i];
+            bits |= (uint64_t)(c == ',' || c == '\n') << i;
+        }
+        masks[w] = bits;
+    }
+}
+
+#ifdef FAST_CSV_X86
+static void classify_sse2(const char *data, size_t size, uint64_t *masks)
+{
+    const __m128i comma = _mm_set1_epi8(','), newline = _mm_set1_epi8('\n');
+    size_t w = 0;
+    for (; (w + 1) * 64 <= size; w++)
+    {
+        uint64_t bits = 0;
+        for (int k = 0; k < 4; k++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(data + w * 64 + k * 16));
+            __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, comma), _mm_cmpeq_epi8(v, newline));
+            bits |= (uint64_t)(uint16_t)_mm_movemask_epi8(hit) << (k * 16);
+        }
+        masks[w] = bits;
+    }
+    if (w * 64 < size) classify_scalar(data + w * 64, size - w * 64, masks + w);
+}
+
+__attribute__((target("avx2"))) static void classify_avx2(const char *data, size_t size, uint64_t *masks)
+{
+    const __m256i comma = _mm256_set1_epi8(','), newline = _mm256_set1_epi8('\n');
+    size_t w = 0;
+    for (; (w + 1) * 64 <= size; w++)
+    {
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(data + w * 64));
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(data + w * 64 + 32));
+        uint32_t a = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(lo, comma), _mm256_cmpeq_epi8(lo, newline)));
+        uint32_t b = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(hi, comma), _mm256_cmpeq_epi8(hi, newline)));
+        masks[w] = (uint64_t)b << 32 | a;
+    }
+    if (w * 64 < size) classify_scalar(data + w * 64, size - w * 64, masks + w);
+}
+#endif
+
+/**
+ * @brief Elige el mejor juego de instrucciones de la CPU en la que corre.
+ */
+CsvIsa csv_best_isa()
+{
+#ifdef FAST_CSV_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return CsvIsa::Avx2;
+    return CsvIsa::Sse2;
+#else
+    return CsvIsa::Scalar;
+#endif
+}
+
+const char *csv_isa_name(CsvIsa isa)
+{
+    switch (isa)
+    {
+    case CsvIsa::Avx2: return "AVX2";
+    case CsvIsa::Sse2: return "SSE2";
+    default: return "scalar";
+    }
+}
+
+static ClassifyFn classifier(CsvIsa isa)
+{
+#ifdef FAST_CSV_X86
+    if (isa == CsvIsa::Avx2) return classify_avx2;
+    if (isa == CsvIsa::Sse2) return classify_sse2;
+#endif
+    (void)isa;
+    return classify_scalar;
+}
+
+/**
+ * @brief Entrega en orden las posiciones de los separadores, clasificando un pedazo cuando hace falta.
+ */
+class SeparatorScanner
+{
+public:
+    SeparatorScanner(const char *data, size_t size, ClassifyFn classify) : data(data), size(size), classify(classify) { load(0); }
+
+    /**
+     * @brief Posicion del siguiente ',' o '\n'; size cuando no quedan.
+     */
+    size_t next()
+    {
+        while (current == 0)
+        {
+            if (word + 1 < words) current = masks[++word];
+            else if (pieceStart + PIECE < size) load(pieceStart + PIECE);
+            else return size;
+        }
+        const size_t pos = pieceStart + word * 64 + __builtin_ctzll(current);
+        current &= current - 1;
+        return pos;
+    }
+
+private:
+    void load(size_t start)
+    {
+        const size_t n = std::min(PIECE, size - start);
+        pieceStart = start;
+        classify(data + start, n, masks);
+        words = (n + 63) / 64;
+        word = 0;
+        current = words ? masks[0] : 0;
+    }
+
+    const char *data;
+    size_t size;
+    ClassifyFn classify;
+    size_t pieceStart = 0, words = 0, word = 0;
+    uint64_t current = 0;
+    uint64_t masks[PIECE_WORDS];
+};
+
+static const double POW10[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static const uint64_t POW10_INT[9] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+/**
+ * @brief Marca en el bit alto cada byte de chunk que no es una cifra ASCII.
+ *
+ * El prestamo o acarreo de la resta y la suma solo afecta a los bytes siguientes, asi la primera
+ * marca es exacta.
+ */
+static inline uint64_t non_digits(uint64_t chunk)
+{
+    return ((chunk + 0x4646464646464646) | (chunk - 0x3030303030303030)) & 0x8080808080808080;
+}
+
+/**
+ * @brief Valor de ocho cifras (0 a 9 por byte, la primera en el byte bajo) con tres multiplicaciones.
+ */
+static inline uint64_t eight_digits(uint64_t v)
+{
+    v = (v * 2561) >> 8;
+    v = ((v & 0x00FF00FF00FF00FF) * 6553601) >> 16;
+    return ((v & 0x0000FFFF0000FFFF) * 42949672960001) >> 32;
+}
+
+/**
+ * @brief Lee las cifras seguidas desde p y las agrega a la mantisa, ocho bytes a la vez.
+ *
+ * Nunca lee en o despues de limit.
+ *
+ * @return int retorna el numero de cifras leidas.
+ */
+static inline int take_digits(const char *&p, const char *limit, uint64_t &mantissa)
+{
+    int count = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (limit - p >= 8)
+    {
+        uint64_t chunk;
+        memcpy(&chunk, p, 8);
+        const uint64_t other = non_digits(chunk);
+        const int n = other ? __builtin_ctzll(other) >> 3 : 8;
+        if (n)
+        {
+            mantissa = mantissa * POW10_INT[n] + eight_digits((chunk << (8 * (8 - n))) & 0x0F0F0F0F0F0F0F0F);
+            count += n;
+            p += n;
+        }
+        if (n < 8) return count;
+    }
+#endif
+    for (; p < limit && (unsigned)(*p - '0') < 10; p++, count++) mantissa = mantissa * 10 + (*p - '0');
+    return count;
+}
+
+/**
+ * @brief Convierte un campo decimal con el mismo resultado de strtod.
+ *
+ * Con a lo sumo 19 cifras, mantisa menor que 2^53 y exponente decimal de -22 a 22, la mantisa y la
+ * potencia de diez son exactas en double y una sola multiplicacion o division da el redondeo
+ * correcto (Clinger). Los demas casos validos se resuelven con strtod.
+ *
+ * @param p inicio del campo.
+ * @param end fin del campo (el separador).
+ * @param limit hasta donde se puede leer, para tomar ocho bytes a la vez.
+ * @param value valor convertido.
+ * @return bool retorna false si el campo no es un numero decimal completo (signo, cifras, punto, exponente).
+ */
+static inline bool parse_double(const char *p, const char *end, const char *limit, double &value)
+{
+    const char *start = p;
+    // Signs come in any order in the IMU columns, so skip it without a branch
+    const bool negative = p < end && *p == '-';
+    p += negative || (p < end && *p == '+');
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // Common shape "ddd.dddd" with fewer than eight digits on each side: two loads and no loops
+    if (limit - p >= 16)
+    {
+        uint64_t whole, fraction;
+        memcpy(&whole, p, 8);
+        const uint64_t wholeOther = non_digits(whole);
+        const int n = __builtin_ctzll(wholeOther | (1ull << 63)) >> 3;
+        if (wholeOther && p[n] == '.')
+        {
+            memcpy(&fraction, p + n + 1, 8);
+            const uint64_t fractionOther = non_digits(fraction);
+            const int m = __builtin_ctzll(fractionOther | (1ull << 63)) >> 3;
+            if (fractionOther && p + n + 1 + m == end && n + m > 0)
+            {
+                // Shifting in two steps keeps n = 0 defined; mantissa < 10^14, exact in double
+                const uint64_t high = eight_digits(((whole << (63 - 8 * n)) << 1) & 0x0F0F0F0F0F0F0F0F);
+                const uint64_t low = eight_digits(((fraction << (63 - 8 * m)) << 1) & 0x0F0F0F0F0F0F0F0F);
+                value = (double)(high * POW10_INT[m] + low) / POW10[m];
+                value = negative ? -value : value;
+                return true;
+            }
+        }
+    }
+#endif
+    uint64_t mantissa = 0;
+    int digits = take_digits(p, end < limit ? limit : end, mantissa), exponent = 0;
+    if (p < end && *p == '.')
+    {
+        p++;
+        exponent = -take_digits(p, end < limit ? limit : end, mantissa);
+        digits -= exponent;
+    }
+    if (digits == 0 || p > end) return false;
+
+    if (p == end && digits <= 19 && mantissa <= (1ull << 53) && exponent >= -22)
+    {
+        value = (double)mantissa;
+        if (exponent < 0) value /= POW10[-exponent];
+        if (negative) value = -value;
+        return true;
+    }
+    if (p < end && *p != 'e' && *p != 'E') return false;
+
+    // Exponent or too many digits: strtod, which must take the whole field
+    char buf[64];
+    const size_t length = end - start;
+    if (length >= sizeof(buf)) return false;
+    memcpy(buf, start, length);
+    buf[length] = '\0';
+    char *stop;
+    value = strtod(buf, &stop);
+    return stop == buf + length;
+}
+
+/**
+ * @brief Entero sin signo de 1 a 19 cifras, como strtoull.
+ */
+static bool parse_unsigned(const char *p, const char *end, uint64_t &value)
+{
+    if (p == end || end - p > 19) return false;
+    uint64_t v = 0;
+    for (; p < end; p++)
+    {
+        if ((unsigned)(*p - '0') >= 10) return false;
+        v = v * 10 + (*p - '0');
+    }
+    value = v;
+    return true;
+}
+
+/**
+ * @brief Entero con signo de 1 a 18 cifras, como strtoll.
+ */
+static bool parse_signed(const char *p, const char *end, int64_t &value)
+{
+    const bool negative = p < end && *p == '-';
+    uint64_t v;
+    if (negative) p++;
+    if (end - p > 18 || !parse_unsigned(p, end, v)) return false;
+    value = negative ? -(int64_t)v : (int64_t)v;
+    return true;
+}
+
+void CsvColumns::clear()
+{
+    lat.clear();
+    lon.clear();
+    for (auto &column : imu) column.clear();
+    timed.clear();
+    seq.clear();
+    t_us.clear();
+    utc_us.clear();
+    lines = slowLines = 0;
+}
+
+void CsvColumns::reserve(size_t rows)
+{
+    lat.reserve(rows);
+    lon.reserve(rows);
+    for (auto &column : imu) column.reserve(rows);
+    timed.reserve(rows);
+    seq.reserve(rows);
+    t_us.reserve(rows);
+    utc_us.reserve(rows);
+}
+
+static void push_row(CsvColumns &out, const TelemetryRow &row)
+{
+    out.lat.push_back(row.lat);
+    out.lon.push_back(row.lon);
+    for (int i = 0; i < 3; i++)
+    {
+        out.imu[i].push_back(row.acc[i]);
+        out.imu[3 + i].push_back(row.gyro[i]);
+        out.imu[6 + i].push_back(row.mag[i]);
+    }
+    out.timed.push_back(row.timed);
+    out.seq.push_back(row.seq);
+    out.t_us.push_back(row.t_us);
+    out.utc_us.push_back(row.utc_us);
+}
+
+/**
+ * @brief Convierte una linea cuyos separadores ya se conocen.
+ *
+ * @param line inicio de la linea.
+ * @param stop fin de la linea sin '\r' ni '\n'.
+ * @param seps posiciones de los primeros separadores, relativas a line.
+ * @param limit fin del trozo, hasta donde se puede leer.
+ * @param fields numero de campos de la linea.
+ * @return bool retorna false si la linea no tiene la forma comun y hay que pasarla por parse_telemetry_line.
+ */
+static bool parse_fields(const char *line, const char *stop, const char *limit, const size_t *seps, int fields, TelemetryRow &row)
+{
+    if (fields != 11 && fields < 14) return false;
+    double values[11];
+    const char *p = line;
+    for (int i = 0; i < 11; i++)
+    {
+        const char *end = i == 10 && fields == 11 ? stop : line + seps[i];
+        if (!parse_double(p, end, limit, values[i])) return false;
+        p = end + 1;
+    }
+    row.lat = values[0];
+    row.lon = values[1];
+    for (int i = 0; i < 3; i++)
+    {
+        row.acc[i] = values[2 + i];
+        row.gyro[i] = values[5 + i];
+        row.mag[i] = values[8 + i];
+    }
+    row.timed = false;
+    row.seq = 0;
+    row.t_us = 0;
+    row.utc_us = 0;
+    if (fields == 11) return true;
+
+    uint64_t seq, t;
+    int64_t utc;
+    if (!parse_unsigned(line + seps[10] + 1, line + seps[11], seq) || !parse_unsigned(line + seps[11] + 1, line + seps[12], t) ||
+        !parse_signed(line + seps[12] + 1, fields == 14 ? stop : line + seps[13], utc))
+        return false;
+    row.timed = true;
+    row.seq = (uint32_t)seq;
+    row.t_us = t;
+    row.utc_us = utc;
+    return true;
+}
+
+/**
+ * @brief Convierte todas las lineas de un trozo del registro.
+ *
+ * El trozo debe empezar al inicio de una linea; la ultima puede no tener '\n'.
+ *
+ * @param data inicio del trozo.
+ * @param size bytes del trozo.
+ * @param isa instrucciones para buscar los separadores.
+ * @param out columnas donde se agregan las filas validas.
+ */
+void csv_parse_chunk(const char *data, size_t size, CsvIsa isa, CsvColumns &out)
+{
+    SeparatorScanner scanner(data, size, classifier(isa));
+    std::string copy;
+    TelemetryRow row;
+    size_t start = 0;
+    while (start < size)
+    {
+        size_t seps[14];
+        int fields = 0;
+        size_t sep;
+        do
+        {
+            sep = scanner.next();
+            if (fields < 14) seps[fields] = sep - start;
+            fields++;
+        } while (sep < size && data[sep] != '\n');
+
+        out.lines++;
+        const char *line = data + start;
+        const char *stop = data + sep;
+        if (stop > line && stop[-1] == '\r') stop--;
+        if (stop > line)
+        {
+            if (parse_fields(line, stop, data + size, seps, fields, row))
+            {
+                push_row(out, row);
+            }
+            else
+            {
+                // Header, vibration summary or an unusual number format: the reference parser decides
+                out.slowLines++;
+                copy.assign(line, data + sep);
+                if (parse_telemetry_line(copy.c_str(), row)) push_row(out, row);
+            }
+        }
+        start = sep + 1;
+    }
+}
\ No newline at end of file
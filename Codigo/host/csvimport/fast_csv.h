@@ -0,0 +1,45 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifndef fast_csv_h
+#define fast_csv_h
+
+/**
+ * @brief Instrucciones usadas para buscar comas y saltos de linea.
+ */
+enum class CsvIsa
+{
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+CsvIsa csv_best_isa();
+const char *csv_isa_name(CsvIsa isa);
+
+/**
+ * @brief Filas leidas de un trozo del registro, guardadas por columnas.
+ *
+ * Los valores son exactamente los de parse_telemetry_line: lat y lon en double, el IMU en float
+ * redondeado desde el double que da strtod.
+ */
+struct CsvColumns
+{
+    std::vector<double> lat, lon;
+    std::vector<float> imu[9];          // accx..accz, gyrox..gyroz, magx..magz
+    std::vector<uint8_t> timed;
+    std::vector<uint32_t> seq;
+    std::vector<uint64_t> t_us;
+    std::vector<int64_t> utc_us;
+    uint64_t lines = 0;                 // Every line, also the ones that are not rows
+    uint64_t slowLines = 0;             // Lines handed to parse_telemetry_line (headers, odd formats)
+
+    size_t size() const { return lat.size(); }
+    void clear();
+    void reserve(size_t rows);
+};
+
+void csv_parse_chunk(const char *data, size_t size, CsvIsa isa, CsvColumns &out);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,939 @@
+/**
+  @file dashboard.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Tablero en vivo: recibe las lineas CSV de los equipos por TCP (el mismo puerto de readPort.py), guarda
+  una ventana acotada por equipo y sirve una pagina por HTTP que recibe por WebSocket solo las muestras
+  nuevas. Las muestras se agrupan por cuadro y cada navegador tiene su propio limite de envios; el trabajo
+  por actualizacion depende de las muestras nuevas, no del historial. La pagina no usa recursos externos,
+  funciona sin internet en localhost.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "telemetry_log.h"
+
+static const size_t MAX_LINE = 512;              // Longer ingest lines are garbage
+static const size_t MAX_REQUEST = 8192;          // HTTP request headers
+static const uint32_t REPORT_PERIOD_S = 5;
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Opciones de la linea de comandos.
+ */
+struct Options
+{
+    int httpPort = 8000, ingestPort = 8080;
+    size_t window = 3000;            // Samples kept per device
+    size_t maxDevices = 256;
+    double fps = 20, clientHz = 10;  // Push ticks per second, and the most pushes a browser gets per second
+    size_t clientBuffer = 1 << 20;   // A browser with more unsent bytes skips pushes until it drains
+    bool perConnection = false;      // Device = address and port (load tests) instead of address
+    std::string follow, replay;
+    double replayRate = 10;
+};
+
+/**
+ * @brief Filas de un cuadro ya codificadas en JSON, se reutilizan para todos los navegadores.
+ */
+struct EncodedChunk
+{
+    uint64_t from, to;
+    std::string rows;  // "[lat,lon,...],[...]"
+};
+
+/**
+ * @brief Ventana circular de un equipo.
+ *
+ * head cuenta todas las muestras recibidas, asi una posicion (cursor) sigue valiendo aunque la ventana
+ * haya dado la vuelta: las muestras [head - window, head) estan en ring[i % window].
+ */
+struct DeviceWindow
+{
+    std::string id;
+    uint32_t generation = 0;        // Changes when the slot is reused by another device
+    std::vector<float> ring;        // 11 values per sample: lat, lon, acc, gyro, mag
+    std::vector<double> position;   // lat, lon in double, the float above loses ~1 m
+    uint64_t head = 0, tickStart = 0;
+    uint64_t lastUpdate = 0;
+    std::deque<EncodedChunk> chunks;  // One per tick with new samples, only inside the window
+};
+
+/**
+ * @brief Un navegador conectado.
+ */
+struct Client
+{
+    int fd = -1;
+    bool websocket = false, closing = false, dead = false;
+    std::string in, out;
+    size_t outOffset = 0;
+    std::vector<uint64_t> cursors;      // Next sample each device must send to this browser
+    std::vector<uint32_t> generations;
+    std::vector<std::string> drops;     // Evicted devices to remove from the page
+    uint64_t nextPush = 0;
+};
+
+/**
+ * @brief Una conexion de un equipo.
+ */
+struct IngestConnection
+{
+    int fd = -1;
+    std::string key;
+    std::string line;
+};
+
+static const char *PAGE = R"(<!DOCTYPE html>
+<html><head><meta charset="utf-8"><title>Telemetría Dron en vivo</title>
+<style>body{margin:0;font-family:sans-serif}#track{display:block;width:100%;height:50vh;background:#f4f4f4}.plots{display:flex}canvas.p{flex:1;width:33%;height:300px}p{margin:6px}</style>
+</head><body>
+<h1 style="text-align: center;">Telemetría Dron</h1>
+<canvas id="track"></canvas>
+<div class="plots"><canvas class="p" id="acc"></canvas><canvas class="p" id="gyro"></canvas><canvas class="p" id="mag"></canvas></div>
+<p>Equipo: <select id="device"></select> <span id="info"></span></p>
+<script>
+var devices = {}, order = [], windowSize = 1000, dirty = false, received = 0, state = 'conectando';
+var colors = ['#d62728', '#1f77b4', '#2ca02c', '#9467bd', '#ff7f0e', '#8c564b', '#e377c2', '#17becf'];
+var select = document.getElementById('device');
+function options() {
+  var current = select.value;
+  select.innerHTML = '';
+  order.forEach(function(id) { var o = document.createElement('option'); o.value = o.textContent = id; select.appendChild(o); });
+  if (devices[current]) select.value = current;
+}
+function connect() {
+  var ws = new WebSocket('ws://' + location.host + '/ws');
+  ws.onopen = function() { state = 'en vivo'; dirty = true; };
+  ws.onmessage = function(e) {
+    var m = JSON.parse(e.data), changed = false;
+    if (m.window) windowSize = m.window;
+    (m.drop || []).forEach(function(id) { if (devices[id]) { delete devices[id]; order.splice(order.indexOf(id), 1); changed = true; } });
+    (m.devices || []).forEach(function(p) {
+      var d = devices[p.id];
+      if (!d) { d = devices[p.id] = {rows: [], next: 0}; order.push(p.id); changed = true; }
+      if (p.from != d.next) d.rows = [];  // Gap or reconnection: the message has the whole window
+      for (var i = 0; i < p.rows.length; i++) d.rows.push(p.rows[i]);
+      if (d.rows.length > windowSize) d.rows.splice(0, d.rows.length - windowSize);
+      d.next = p.from + p.rows.length;
+      received += p.rows.length;
+    });
+    if (changed) options();
+    dirty = true;
+  };
+  ws.onclose = function() { state = 'sin conexión, reintentando'; dirty = true; setTimeout(connect, 1000); };
+}
+function plot(id, title, names, d, first) {
+  var c = document.getElementById(id), w = c.width = c.clientWidth, h = c.height = c.clientHeight, g = c.getContext('2d');
+  var rows = d ? d.rows : [], x0 = d ? d.next - rows.length : 0, x1 = x0 + Math.max(rows.length - 1, 1), y0 = Infinity, y1 = -Infinity;
+  rows.forEach(function(r) { for (var k = first; k < first + 3; k++) { y0 = Math.min(y0, r[k]); y1 = Math.max(y1, r[k]); } });
+  if (!(y1 > y0)) { y0 = (isFinite(y0) ? y0 : 0) - 1; y1 = y0 + 2; }
+  var m = 40, sx = (w - 2 * m) / (x1 - x0), sy = (h - 2 * m) / (y1 - y0);
+  g.font = '12px sans-serif'; g.fillText(title, w / 2 - 40, 16);
+  g.fillText(y1.toPrecision(3), 2, m); g.fillText(y0.toPrecision(3), 2, h - m); g.fillText('Índice', w / 2, h - 8);
+  g.strokeStyle = '#ccc'; g.strokeRect(m, m, w - 2 * m, h - 2 * m);
+  for (var k = 0; k < 3; k++) {
+    g.strokeStyle = g.fillStyle = colors[k + 1]; g.beginPath();
+    rows.forEach(function(r, i) { var X = m + i * sx, Y = h - m - (r[first + k] - y0) * sy; i ? g.lineTo(X, Y) : g.moveTo(X, Y); });
+    g.stroke(); g.fillText(names[k], m + 5 + 110 * k, h - m + 14);
+  }
+}
+function track() {
+  var c = document.getElementById('track'), w = c.width = c.clientWidth, h = c.height = c.clientHeight, g = c.getContext('2d');
+  var lat0 = Infinity, lat1 = -Infinity, lon0 = Infinity, lon1 = -Infinity;
+  order.forEach(function(id) { devices[id].rows.forEach(function(r) {
+    lat0 = Math.min(lat0, r[0]); lat1 = Math.max(lat1, r[0]); lon0 = Math.min(lon0, r[1]); lon1 = Math.max(lon1, r[1]); }); });
+  if (!isFinite(lat0)) return;
+  // Equirectangular projection with the same scale in both axes
+  var k = Math.cos((lat0 + lat1) / 2 * Math.PI / 180), m = 20;
+  var s = Math.min((w - 2 * m) / Math.max((lon1 - lon0) * k, 1e-6), (h - 2 * m) / Math.max(lat1 - lat0, 1e-6));
+  var ox = (w - (lon1 - lon0) * k * s) / 2, oy = (h - (lat1 - lat0) * s) / 2;
+  order.forEach(function(id, n) {
+    var rows = devices[id].rows, selected = id == select.value;
+    g.strokeStyle = g.fillStyle = colors[n % colors.length]; g.lineWidth = selected ? 3 : 1.5; g.beginPath();
+    rows.forEach(function(r, i) { var X = ox + (r[1] - lon0) * k * s, Y = h - oy - (r[0] - lat0) * s; i ? g.lineTo(X, Y) : g.moveTo(X, Y); });
+    g.stroke();
+    if (rows.length) { var r = rows[rows.length - 1]; g.beginPath(); g.arc(ox + (r[1] - lon0) * k * s, h - oy - (r[0] - lat0) * s, 4, 0, 7); g.fill(); }
+  });
+  g.fillStyle = '#333'; g.font = '12px sans-serif';
+  g.fillText(lat1.toFixed(5) + ', ' + lon0.toFixed(5), 4, 14); g.fillText(lat0.toFixed(5) + ', ' + lon1.toFixed(5), w - 140, h - 6);
+}
+function draw() {
+  if (dirty) {
+    dirty = false;
+    var d = devices[select.value];
+    track();
+    plot('acc', 'Gráfica de la Aceleracion', ['Aceleración X', 'Aceleración Y', 'Aceleración Z'], d, 2);
+    plot('gyro', 'Gráfica del Giroscopio', ['Gyro X', 'Gyro Y', 'Gyro Z'], d, 5);
+    plot('mag', 'Gráfica del Magnetometro', ['Magneto X', 'Magneto Y', 'Magneto Z'], d, 8);
+    document.getElementById('info').textContent = state + ', ' + order.length + ' equipos, ' + received + ' muestras recibidas' +
+      (d ? ', ' + d.rows.length + ' en la ventana de ' + select.value : '');
+  }
+  requestAnimationFrame(draw);
+}
+select.onchange = function() { dirty = true; };
+window.onresize = function() { dirty = true; };
+connect();
+draw();
+</script></body></html>
+)";
+
+/**
+ * @brief Escapa un texto para ponerlo entre comillas en JSON (los ids pueden ser rutas de --follow).
+ */
+static std::string json_escape(const std::string &text)
+{
+    std::string out;
+    for (unsigned char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (c < 0x20)
+        {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            out += code;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief SHA-1 de un mensaje corto, solo para el saludo de WebSocket (RFC 6455).
+ */
+static void sha1(const std::string &message, uint8_t digest[20])
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string data = message;
+    data += (char)0x80;
+    while (data.size() % 64 != 56) data += (char)0;
+    const uint64_t bits = (uint64_t)message.size() * 8;
+    for (int i = 7; i >= 0; i--) data += (char)(bits >> (i * 8));
+
+    for (size_t block = 0; block < data.size(); block += 64)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++)
+        {
+            const uint8_t *p = (const uint8_t *)data.data() + block + 4 * i;
+            w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+        }
+        for (int i = 16; i < 80; i++)
+        {
+            uint32_t x = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+            w[i] = x << 1 | x >> 31;
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++)
+        {
+            uint32_t f, k;
+            if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t t = (a << 5 | a >> 27) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = b << 30 | b >> 2;
+            b = a;
+            a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+    for (int i = 0; i < 20; i++) digest[i] = h[i / 4] >> (24 - 8 * (i % 4));
+}
+
+static std::string base64(const uint8_t *data, size_t length)
+{
+    static const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < length; i += 3)
+    {
+        uint32_t v = data[i] << 16 | (i + 1 < length ? data[i + 1] << 8 : 0) | (i + 2 < length ? data[i + 2] : 0);
+        out += alphabet[v >> 18 & 63];
+        out += alphabet[v >> 12 & 63];
+        out += i + 1 < length ? alphabet[v >> 6 & 63] : '=';
+        out += i + 2 < length ? alphabet[v & 63] : '=';
+    }
+    return out;
+}
+
+/**
+ * @brief Arma una trama de texto de WebSocket (el servidor no enmascara).
+ */
+static void websocket_text(std::string &out, const std::string &payload)
+{
+    out += (char)0x81;
+    if (payload.size() < 126)
+    {
+        out += (char)payload.size();
+    }
+    else if (payload.size() < 65536)
+    {
+        out += (char)126;
+        out += (char)(payload.size() >> 8);
+        out += (char)payload.size();
+    }
+    else
+    {
+        out += (char)127;
+        for (int i = 7; i >= 0; i--) out += (char)((uint64_t)payload.size() >> (8 * i));
+    }
+    out += payload;
+}
+
+/**
+ * @brief Servidor del tablero: un hilo con epoll para los equipos, los navegadores y el reloj de cuadros.
+ */
+class Dashboard
+{
+public:
+    explicit Dashboard(const Options &options) : options(options) {}
+
+    bool open(std::string &error)
+    {
+        epoll = epoll_create1(0);
+        httpListener = listen_on(options.httpPort, error);
+        if (httpListener < 0) return false;
+        if (options.ingestPort > 0)
+        {
+            ingestListener = listen_on(options.ingestPort, error);
+            if (ingestListener < 0) return false;
+        }
+        watch(httpListener, &httpListener, EPOLLIN);
+        if (ingestListener >= 0) watch(ingestListener, &ingestListener, EPOLLIN);
+
+        timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        const uint64_t period = (uint64_t)(1e9 / options.fps);
+        itimerspec spec = {};
+        spec.it_interval.tv_sec = spec.it_value.tv_sec = period / 1000000000;
+        spec.it_interval.tv_nsec = spec.it_value.tv_nsec = period % 1000000000;
+        timerfd_settime(timer, 0, &spec, nullptr);
+        watch(timer, &timer, EPOLLIN);
+
+        if (!options.follow.empty())
+        {
+            followFile = fopen(options.follow.c_str(), "rb");
+            if (!followFile)
+            {
+                error = "cannot open " + options.follow;
+                return false;
+            }
+        }
+        if (!options.replay.empty())
+        {
+            if (!read_telemetry_csv(options.replay, replayRows, error)) return false;
+            if (replayRows.empty())
+            {
+                error = options.replay + " has no rows";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void run()
+    {
+        std::vector<epoll_event> events(256);
+        replayStart = lastReport = now_ns();
+        while (1)
+        {
+            int n = epoll_wait(epoll, events.data(), events.size(), -1);
+            for (int i = 0; i < n; i++)
+            {
+                void *tag = events[i].data.ptr;
+                if (tag == &httpListener) accept_clients();
+                else if (tag == &ingestListener) accept_devices();
+                else if (tag == &timer) on_tick();
+                else if (clients.count((Client *)tag)) on_client((Client *)tag, events[i].events);
+                else on_device((IngestConnection *)tag);
+            }
+            for (Client *client : dead)
+            {
+                clients.erase(client);
+                delete client;
+            }
+            dead.clear();
+        }
+    }
+
+private:
+    int listen_on(int port, std::string &error)
+    {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0)
+        {
+            error = "cannot listen on port " + std::to_string(port) + ": " + strerror(errno);
+            return -1;
+        }
+        return fd;
+    }
+
+    void watch(int fd, void *tag, uint32_t events, int op = EPOLL_CTL_ADD)
+    {
+        epoll_event ev = {};
+        ev.events = events;
+        ev.data.ptr = tag;
+        epoll_ctl(epoll, op, fd, &ev);
+    }
+
+    /**
+     * @brief Busca el equipo por su clave; si no existe ocupa un lugar libre o el del equipo mas viejo.
+     */
+    size_t device_slot(const std::string &key)
+    {
+        auto it = slots.find(key);
+        if (it != slots.end()) return it->second;
+
+        size_t slot = windows.size();
+        if (windows.size() < options.maxDevices)
+        {
+            windows.emplace_back(new DeviceWindow());
+            windows.back()->ring.resize(options.window * 11);
+            windows.back()->position.resize(options.window * 2);
+        }
+        else
+        {
+            slot = 0;
+            for (size_t i = 1; i < windows.size(); i++)
+                if (windows[i]->lastUpdate < windows[slot]->lastUpdate) slot = i;
+            DeviceWindow &old = *windows[slot];
+            for (Client *client : clients) client->drops.push_back(old.id);
+            slots.erase(old.id);
+            old.head = old.tickStart = 0;
+            old.chunks.clear();
+            old.generation++;
+            evicted++;
+        }
+        windows[slot]->id = key;
+        slots[key] = slot;
+        return slot;
+    }
+
+    void add_sample(size_t slot, const TelemetryRow &row)
+    {
+        DeviceWindow &dev = *windows[slot];
+        const size_t i = dev.head % options.window;
+        float *v = &dev.ring[i * 11];
+        v[0] = row.lat;
+        v[1] = row.lon;
+        for (int k = 0; k < 3; k++)
+        {
+            v[2 + k] = row.acc[k];
+            v[5 + k] = row.gyro[k];
+            v[8 + k] = row.mag[k];
+        }
+        dev.position[i * 2] = row.lat;
+        dev.position[i * 2 + 1] = row.lon;
+        dev.head++;
+        dev.lastUpdate = now_ns();
+        samplesIn++;
+    }
+
+    void add_line(size_t slot, const char *line)
+    {
+        TelemetryRow row;
+        if (parse_telemetry_line(line, row)) add_sample(slot, row);
+        else if (line[0] && strncmp(line, "Latitud", 7) != 0 && strncmp(line, "VIB,", 4) != 0 &&
+                 strncmp(line, "FILTER,", 7) != 0) parseErrors++;
+    }
+
+    /**
+     * @brief Separa lineas; lo que queda sin '\n' se guarda para la proxima lectura.
+     */
+    void add_text(size_t slot, std::string &pending, const char *data, size_t length)
+    {
+        pending.append(data, length);
+        size_t start = 0, newline;
+        while ((newline = pending.find('\n', start)) != std::string::npos)
+        {
+            size_t end = newline;
+            if (end > start && pending[end - 1] == '\r') end--;
+            pending[end] = '\0';
+            add_line(slot, pending.c_str() + start);
+            start = newline + 1;
+        }
+        pending.erase(0, start);
+        if (pending.size() > MAX_LINE)
+        {
+            parseErrors++;
+            pending.clear();
+        }
+    }
+
+    void accept_devices()
+    {
+        sockaddr_in peer;
+        socklen_t length = sizeof(peer);
+        int fd;
+        while ((fd = accept4(ingestListener, (sockaddr *)&peer, &length, SOCK_NONBLOCK)) >= 0)
+        {
+            char address[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &peer.sin_addr, address, sizeof(address));
+            IngestConnection *conn = new IngestConnection();
+            conn->fd = fd;
+            conn->key = address;
+            if (options.perConnection) conn->key += ":" + std::to_string(ntohs(peer.sin_port));
+            watch(fd, conn, EPOLLIN | EPOLLRDHUP);
+            length = sizeof(peer);
+        }
+    }
+
+    void on_device(IngestConnection *conn)
+    {
+        char buf[8192];
+        const size_t slot = device_slot(conn->key);
+        while (1)
+        {
+            ssize_t n = recv(conn->fd, buf, sizeof(buf), 0);
+            if (n > 0)
+            {
+                add_text(slot, conn->line, buf, n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            // readPort.py style devices send one line per connection, maybe without '\n'
+            if (!conn->line.empty()) add_line(slot, conn->line.c_str());
+            epoll_ctl(epoll, EPOLL_CTL_DEL, conn->fd, nullptr);
+            close(conn->fd);
+            delete conn;
+            return;
+        }
+    }
+
+    /**
+     * @brief Lee lo que se agrego al archivo seguido (readPort.py escribe en datos.csv) y la repeticion.
+     */
+    void poll_sources()
+    {
+        if (followFile)
+        {
+            char buf[65536];
+            size_t n;
+            const size_t slot = device_slot(options.follow);
+            while ((n = fread(buf, 1, sizeof(buf), followFile)) > 0) add_text(slot, followLine, buf, n);
+            clearerr(followFile);  // Keep reading what is appended later
+        }
+        if (!replayRows.empty())
+        {
+            const uint64_t due = (uint64_t)((now_ns() - replayStart) / 1e9 * options.replayRate);
+            const size_t slot = device_slot("repeticion");
+            for (; replayed < due; replayed++) add_sample(slot, replayRows[replayed % replayRows.size()]);
+        }
+    }
+
+    /**
+     * @brief Filas [from, to) de un equipo en JSON: [lat,lon,...],[...].
+     */
+    void encode_rows(const DeviceWindow &dev, uint64_t from, uint64_t to, std::string &out)
+    {
+        char number[160];
+        for (uint64_t s = from; s < to; s++)
+        {
+            const size_t i = s % options.window;
+            const float *v = &dev.ring[i * 11];
+            int n = snprintf(number, sizeof(number), "%s[%.7f,%.7f,%.4g,%.4g,%.4g,%.4g,%.4g,%.4g,%.4g,%.4g,%.4g]", s > from ? "," : "",
+                             dev.position[i * 2], dev.position[i * 2 + 1], v[2], v[3], v[4], v[5], v[6], v[7], v[8], v[9], v[10]);
+            out.append(number, n);
+        }
+        rowsEncoded += to - from;
+    }
+
+    /**
+     * @brief Lo que le falta a un navegador de un equipo: {"id":..,"from":..,"rows":[...]}.
+     *
+     * Si el cursor cae en el inicio de un cuadro guardado se copian los cuadros ya codificados; solo
+     * un navegador nuevo o que se atraso mas que la ventana obliga a codificar de nuevo.
+     */
+    void append_update(const DeviceWindow &dev, uint64_t cursor, std::string &out)
+    {
+        const uint64_t oldest = dev.head - std::min<uint64_t>(dev.head, options.window);
+        auto chunk = std::lower_bound(dev.chunks.begin(), dev.chunks.end(), cursor,
+                                      [](const EncodedChunk &c, uint64_t value) { return c.from < value; });
+        const bool reuse = chunk != dev.chunks.end() && chunk->from == cursor;
+        const uint64_t from = reuse ? cursor : std::max(cursor, oldest);
+        out += "{\"id\":\"";
+        out += json_escape(dev.id);
+        out += "\",\"from\":";
+        out += std::to_string(from);
+        out += ",\"rows\":[";
+        if (reuse)
+        {
+            for (; chunk != dev.chunks.end(); ++chunk)
+            {
+                if (chunk->from != cursor) out += ',';
+                out += chunk->rows;
+            }
+            rowsReused += dev.head - cursor;
+        }
+        else
+        {
+            encode_rows(dev, from, dev.head, out);
+        }
+        out += "]}";
+    }
+
+    /**
+     * @brief Un cuadro: cada equipo codifica una sola vez sus muestras nuevas y cada navegador al que
+     * le toca recibe un mensaje con lo que le falta. Los que estan limitados o atrasados acumulan hasta
+     * su proximo turno (como maximo la ventana).
+     */
+    void on_tick()
+    {
+        uint64_t expirations;
+        if (read(timer, &expirations, sizeof(expirations)) < 0) return;
+        const uint64_t start = now_ns();
+        poll_sources();
+
+        for (auto &dev : windows)
+        {
+            const uint64_t oldest = dev->head - std::min<uint64_t>(dev->head, options.window);
+            while (!dev->chunks.empty() && dev->chunks.front().from < oldest) dev->chunks.pop_front();
+            if (dev->head > dev->tickStart)
+            {
+                dev->chunks.push_back({std::max(dev->tickStart, oldest), dev->head, std::string()});
+                encode_rows(*dev, dev->chunks.back().from, dev->head, dev->chunks.back().rows);
+            }
+        }
+
+        // Half a tick of slack, otherwise a browser limited to every other tick slips to every third one
+        const uint64_t period = (uint64_t)std::max(0.0, 1e9 / options.clientHz - 0.5e9 / options.fps);
+        std::string message;
+        for (Client *client : clients)
+        {
+            if (!client->websocket || client->closing || client->dead) continue;
+            if (start < client->nextPush)
+            {
+                rateLimited++;
+                continue;
+            }
+            if (client->out.size() - client->outOffset > options.clientBuffer)
+            {
+                backpressure++;  // Slow browser: it gets everything it missed when it drains
+                continue;
+            }
+            message = "{\"devices\":[";
+            bool any = false;
+            client->cursors.resize(windows.size(), 0);
+            client->generations.resize(windows.size(), 0);
+            for (size_t i = 0; i < windows.size(); i++)
+            {
+                DeviceWindow &dev = *windows[i];
+                uint64_t &cursor = client->cursors[i];
+                if (client->generations[i] != dev.generation)
+                {
+                    client->generations[i] = dev.generation;
+                    cursor = 0;
+                }
+                if (cursor >= dev.head) continue;
+                if (any) message += ',';
+                any = true;
+                append_update(dev, cursor, message);
+                cursor = dev.head;
+            }
+            message += ']';
+            if (!client->drops.empty())
+            {
+                message += ",\"drop\":[";
+                for (size_t i = 0; i < client->drops.size(); i++) message += (i ? ",\"" : "\"") + json_escape(client->drops[i]) + "\"";
+                message += ']';
+                client->drops.clear();
+                any = true;
+            }
+            message += '}';
+            if (!any) continue;
+            websocket_text(client->out, message);
+            pushes++;
+            bytesOut += message.size();
+            client->nextPush = start + period;
+            flush(client);
+        }
+        for (auto &dev : windows) dev->tickStart = dev->head;
+
+        const uint64_t end = now_ns();
+        tickTotalNs += end - start;
+        tickMaxNs = std::max(tickMaxNs, end - start);
+        ticks++;
+        if (end - lastReport >= REPORT_PERIOD_S * 1000000000ull) report(end);
+    }
+
+    void report(uint64_t now)
+    {
+        const double dt = (now - lastReport) / 1e9;
+        size_t browsers = 0;
+        for (Client *client : clients) browsers += client->websocket && !client->dead;
+        printf("%zu devices, %.0f samples/s in, %zu browsers, %.0f pushes/s, %.1f kB/s out, %.0f rows encoded/s, %.0f reused/s, tick %.0f us avg %.0f us max, "
+               "%" PRIu64 " rate limited, %" PRIu64 " held back, %" PRIu64 " parse errors, %" PRIu64 " evicted\n",
+               windows.size(), samplesIn / dt, browsers, pushes / dt, bytesOut / dt / 1e3, rowsEncoded / dt, rowsReused / dt, ticks ? tickTotalNs / 1e3 / ticks : 0.0,
+               tickMaxNs / 1e3, rateLimited, backpressure, parseErrors, evicted);
+        fflush(stdout);
+        samplesIn = pushes = bytesOut = rowsEncoded = rowsReused = ticks = tickTotalNs = tickMaxNs = rateLimited = backpressure = 0;
+        lastReport = now;
+    }
+
+    void accept_clients()
+    {
+        int fd;
+        while ((fd = accept4(httpListener, nullptr, nullptr, SOCK_NONBLOCK)) >= 0)
+        {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            Client *client = new Client();
+            client->fd = fd;
+            clients.insert(client);
+            watch(fd, client, EPOLLIN | EPOLLRDHUP);
+        }
+    }
+
+    void on_client(Client *client, uint32_t events)
+    {
+        if (client->dead) return;  // Dropped earlier in this batch of events
+        if (events & EPOLLOUT) flush(client);
+        if (client->dead || !(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) return;
+
+        char buf[4096];
+        while (1)
+        {
+            ssize_t n = recv(client->fd, buf, sizeof(buf), 0);
+            if (n > 0)
+            {
+                client->in.append(buf, n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            drop(client);
+            return;
+        }
+        if (client->websocket) on_websocket_input(client);
+        else on_request(client);
+    }
+
+    /**
+     * @brief Atiende una peticion HTTP: la pagina en "/" y el WebSocket en "/ws".
+     */
+    void on_request(Client *client)
+    {
+        size_t end = client->in.find("\r\n\r\n");
+        if (end == std::string::npos)
+        {
+            if (client->in.size() > MAX_REQUEST) drop(client);
+            return;
+        }
+        std::string request = client->in.substr(0, end + 2);
+        client->in.erase(0, end + 4);
+        std::string key;
+        size_t at = request.find("Sec-WebSocket-Key:");
+        if (at == std::string::npos) at = request.find("sec-websocket-key:");
+        if (at != std::string::npos)
+        {
+            size_t from = request.find_first_not_of(' ', at + 18), to = request.find("\r\n", at);
+            key = request.substr(from, to - from);
+        }
+
+        if (request.compare(0, 8, "GET /ws ") == 0 && !key.empty())
+        {
+            uint8_t digest[20];
+            sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", digest);
+            client->out += "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: " + base64(digest, 20) + "\r\n\r\n";
+            websocket_text(client->out, "{\"window\":" + std::to_string(options.window) + "}");
+            client->websocket = true;  // The whole window of every device goes with the next tick
+        }
+        else if (request.compare(0, 6, "GET / ") == 0 || request.compare(0, 16, "GET /index.html ") == 0)
+        {
+            client->out += "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nCache-Control: no-cache\r\nContent-Length: " +
+                           std::to_string(strlen(PAGE)) + "\r\n\r\n" + PAGE;
+        }
+        else
+        {
+            client->out += "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        }
+        if (!client->websocket) client->closing = true;
+        flush(client);
+    }
+
+    /**
+     * @brief Tramas del navegador: solo importan el cierre y el ping, los datos se ignoran.
+     */
+    void on_websocket_input(Client *client)
+    {
+        while (!client->dead && client->in.size() >= 2)
+        {
+            const uint8_t *p = (const uint8_t *)client->in.data();
+            const int opcode = p[0] & 0x0F;
+            uint64_t length = p[1] & 0x7F;
+            size_t header = 2;
+            if (length == 126)
+            {
+                if (client->in.size() < 4) return;
+                length = (uint64_t)p[2] << 8 | p[3];
+                header = 4;
+            }
+            else if (length == 127)
+            {
+                if (client->in.size() < 10) return;
+                length = 0;
+                for (int i = 0; i < 8; i++) length = length << 8 | p[2 + i];
+                header = 10;
+            }
+            const bool masked = p[1] & 0x80;
+            if (length > MAX_REQUEST)
+            {
+                drop(client);
+                return;
+            }
+            if (client->in.size() < header + (masked ? 4 : 0) + length) return;
+            std::string payload = client->in.substr(header + (masked ? 4 : 0), length);
+            if (masked)
+                for (size_t i = 0; i < payload.size(); i++) payload[i] ^= p[header + i % 4];
+            client->in.erase(0, header + (masked ? 4 : 0) + length);
+
+            if (opcode == 0x8)
+            {
+                client->out += "\x88";
+                client->out += '\0';
+                client->closing = true;
+                flush(client);
+                return;
+            }
+            if (opcode == 0x9)
+            {
+                client->out += (char)0x8A;
+                client->out += (char)payload.size();
+                client->out += payload;
+                flush(client);
+            }
+        }
+    }
+
+    /**
+     * @brief Envia lo pendiente; si el socket esta lleno espera EPOLLOUT.
+     */
+    void flush(Client *client)
+    {
+        if (client->dead) return;
+        while (client->outOffset < client->out.size())
+        {
+            ssize_t n = send(client->fd, client->out.data() + client->outOffset, client->out.size() - client->outOffset, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    watch(client->fd, client, EPOLLIN | EPOLLRDHUP | EPOLLOUT, EPOLL_CTL_MOD);
+                    return;
+                }
+                drop(client);
+                return;
+            }
+            client->outOffset += n;
+        }
+        client->out.clear();
+        client->outOffset = 0;
+        watch(client->fd, client, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_MOD);
+        if (client->closing) drop(client);
+    }
+
+    /**
+     * @brief Cierra la conexion; el objeto se borra al final del ciclo porque puede tener mas eventos pendientes.
+     */
+    void drop(Client *client)
+    {
+        if (client->dead) return;
+        epoll_ctl(epoll, EPOLL_CTL_DEL, client->fd, nullptr);
+        close(client->fd);
+        client->dead = true;
+        dead.push_back(client);
+    }
+
+    const Options &options;
+    int epoll = -1, httpListener = -1, ingestListener = -1, timer = -1;
+    std::vector<std::unique_ptr<DeviceWindow>> windows;
+    std::map<std::string, size_t> slots;
+    std::set<Client *> clients;
+    std::vector<Client *> dead;
+    FILE *followFile = nullptr;
+    std::string followLine;
+    std::vector<TelemetryRow> replayRows;
+    uint64_t replayStart = 0, replayed = 0;
+
+    uint64_t samplesIn = 0, pushes = 0, bytesOut = 0, rowsEncoded = 0, rowsReused = 0, ticks = 0, tickTotalNs = 0, tickMaxNs = 0;
+    uint64_t rateLimited = 0, backpressure = 0, parseErrors = 0, evicted = 0, lastReport = 0;
+};
+
+static void usage()
+{
+    fprintf(stderr, "usage: dashboard [--port n] [--ingest-port n] [--window samples] [--devices n] [--fps n] [--client-hz n]\n"
+                    "                 [--client-buffer bytes] [--per-connection] [--follow datos.csv] [--replay datos.csv [--rate hz]]\n");
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) options.httpPort = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--ingest-port") == 0 && i + 1 < argc) options.ingestPort = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) options.window = std::max(1ul, strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--devices") == 0 && i + 1 < argc) options.maxDevices = std::max(1ul, strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) options.fps = std::max(1.0, atof(argv[++i]));
+        else if (strcmp(argv[i], "--client-hz") == 0 && i + 1 < argc) options.clientHz = std::max(0.1, atof(argv[++i]));
+        else if (strcmp(argv[i], "--client-buffer") == 0 && i + 1 < argc) options.clientBuffer = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--per-connection") == 0) options.perConnection = true;
+        else if (strcmp(argv[i], "--follow") == 0 && i + 1 < argc) options.follow = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) options.replay = argv[++i];
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) options.replayRate = atof(argv[++i]);
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    Dashboard dashboard(options);
+    std::string error;
+    if (!dashboard.open(error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    printf("Dashboard on http://localhost:%d/, devices on TCP port %d\n", options.httpPort, options.ingestPort);
+    fflush(stdout);
+    dashboard.run();
+    return 0;
+}
\ No newline at end of file
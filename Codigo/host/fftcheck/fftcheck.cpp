@@ -0,0 +1,320 @@
+/**
+  @file fftcheck.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Compara en el PC el analisis de vibraciones del firmware (vibration.c, FFT en punto fijo) contra una
+  transformada de referencia en doble precision. Usa señales sinteticas de varios tamaños (o las
+  ventanas de una captura de usbStream) y revisa el espectro, las bandas, el pico y el RMS de cada eje.
+  Termina con error si alguna diferencia pasa los limites.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "telemetry_log.h"
+extern "C" {
+    #include "vibration.h"
+    #include "telemetry_frame.h"
+}
+
+static const float G_PER_COUNT = ACC_FULL_SCALE / 32768;
+static const double MIN_SNR_DB = 40;      // Spectrum error against the reference, over the whole window
+static const double MAX_BAND_ERROR = 0.02; // Relative, in bands holding at least 1% of the vibration
+static const double MAX_RMS_ERROR = 1e-4;  // Relative
+
+/**
+ * @brief Resultado de referencia de un eje, con la misma definicion que vibration.c.
+ */
+struct Reference
+{
+    std::vector<double> power;  // |X[k]|^2 / N^2 in g^2
+    vibration_axis_t axis;
+};
+
+/**
+ * @brief Peor diferencia encontrada en todas las ventanas.
+ */
+struct Worst
+{
+    double snrDb = 1e9, bandError = 0, rmsError = 0, peakHz = 0;
+    uint64_t windows = 0, failures = 0;
+};
+
+/**
+ * @brief Transformada de referencia: DFT directa en doble precision de la ventana sin media.
+ */
+static Reference reference(const int16_t *samples, int n, int rate)
+{
+    Reference ref;
+    double mean = 0;
+    for (int i = 0; i < n; i++) mean += samples[i];
+    mean /= n;
+
+    std::vector<double> x(n);
+    double sumSq = 0;
+    for (int i = 0; i < n; i++)
+    {
+        double d = (samples[i] - mean) * G_PER_COUNT;
+        sumSq += d * d;
+        x[i] = d * 0.5 * (1 - cos(2 * M_PI * i / n));
+    }
+    ref.axis.rms_g = sqrt(sumSq / n);
+
+    const int m = n / 2;
+    ref.power.resize(m + 1);
+    for (int k = 0; k <= m; k++)
+    {
+        std::complex<double> sum = 0;
+        for (int i = 0; i < n; i++) sum += x[i] * std::polar(1.0, -2 * M_PI * (double)k * i / n);
+        ref.power[k] = std::norm(sum) / ((double)n * n);
+    }
+
+    const int width = m / VIBRATION_BANDS;
+    int best = 1;
+    for (int b = 0; b < VIBRATION_BANDS; b++)
+    {
+        double band = 0;
+        for (int k = b == 0 ? 1 : b * width; k < (b + 1) * width; k++)
+        {
+            band += 2 * ref.power[k];
+            if (ref.power[k] > ref.power[best]) best = k;
+        }
+        if (b == VIBRATION_BANDS - 1) band += ref.power[m];
+        ref.axis.band_g[b] = sqrt(band / 0.375);
+    }
+    ref.axis.peak_hz = (double)best * rate / n;
+    ref.axis.peak_g = 4 * sqrt(ref.power[best]);
+    return ref;
+}
+
+/**
+ * @brief Compara un eje contra la referencia y acumula las diferencias.
+ */
+static bool compare(vibration_t &vib, const int16_t *samples, Worst &worst, bool verbose)
+{
+    const int n = vib.points, m = n / 2;
+    Reference ref = reference(samples, n, vib.rate_hz);
+    std::vector<uint32_t> power(m + 1);
+    const int shift = vibration_power_spectrum(&vib, samples, power.data());
+    vibration_axis_t axis;
+    vibration_analyse_axis(&vib, samples, &axis);
+
+    // Magnitude error over every bin, both in g
+    double signal = 0, noise = 0;
+    for (int k = 0; k <= m; k++)
+    {
+        double fixed = sqrt(ldexp(power[k], -2 * shift)) * G_PER_COUNT, exact = sqrt(ref.power[k]);
+        signal += exact * exact;
+        noise += (fixed - exact) * (fixed - exact);
+    }
+    const double snr = signal > 0 ? (noise > 0 ? 10 * log10(signal / noise) : 200) : 200;
+
+    double total = 0, bandError = 0;
+    for (int b = 0; b < VIBRATION_BANDS; b++) total += ref.axis.band_g[b] * ref.axis.band_g[b];
+    for (int b = 0; b < VIBRATION_BANDS; b++)
+        if (ref.axis.band_g[b] * ref.axis.band_g[b] >= 0.01 * total)
+            bandError = std::max(bandError, fabs(axis.band_g[b] / ref.axis.band_g[b] - 1));
+    const double rmsError = ref.axis.rms_g > 0 ? fabs(axis.rms_g / ref.axis.rms_g - 1) : axis.rms_g;
+    // With two bins of almost the same height (noise) either one is a right answer
+    const int bin = std::min(m, std::max(1, (int)lround(axis.peak_hz * n / vib.rate_hz))), refBin = (int)lround(ref.axis.peak_hz * n / vib.rate_hz);
+    const bool tie = ref.power[bin] >= 0.9 * ref.power[refBin];
+    const double peakHz = tie && abs(bin - refBin) > 1 ? 0 : fabs(axis.peak_hz - ref.axis.peak_hz);
+
+    worst.windows++;
+    worst.snrDb = std::min(worst.snrDb, snr);
+    worst.bandError = std::max(worst.bandError, bandError);
+    worst.rmsError = std::max(worst.rmsError, rmsError);
+    worst.peakHz = std::max(worst.peakHz, peakHz);
+    const bool ok = snr >= MIN_SNR_DB && bandError <= MAX_BAND_ERROR && rmsError <= MAX_RMS_ERROR
+                    && peakHz <= (double)vib.rate_hz / n;  // Interpolation moves the peak less than a bin
+    if (!ok) worst.failures++;
+    if (verbose || !ok)
+        printf("    %s: snr %.1f dB, band error %.3f%%, rms %.4f g (ref %.4f), peak %.1f Hz %.4f g (ref bin %.1f Hz %.4f g)\n",
+               ok ? "ok" : "FAIL", snr, bandError * 100, axis.rms_g, ref.axis.rms_g, axis.peak_hz, axis.peak_g, ref.axis.peak_hz,
+               ref.axis.peak_g);
+    return ok;
+}
+
+/**
+ * @brief Señal sintetica: gravedad, senos de amplitud y frecuencia dadas y ruido blanco, en cuentas.
+ */
+struct Case
+{
+    const char *name;
+    double offset_g;
+    std::vector<std::pair<double, double>> tones;  // (Hz, g)
+    double noise_g;
+};
+
+static std::vector<int16_t> synthesize(const Case &c, int n, int rate, std::mt19937 &rng)
+{
+    std::normal_distribution<double> gauss(0, 1);
+    std::uniform_real_distribution<double> phase(0, 2 * M_PI);
+    std::vector<double> phases;
+    for (size_t t = 0; t < c.tones.size(); t++) phases.push_back(phase(rng));
+
+    std::vector<int16_t> out(n);
+    for (int i = 0; i < n; i++)
+    {
+        double v = c.offset_g + c.noise_g * gauss(rng);
+        for (size_t t = 0; t < c.tones.size(); t++) v += c.tones[t].second * sin(2 * M_PI * c.tones[t].first * i / rate + phases[t]);
+        double counts = std::round(v / G_PER_COUNT);
+        out[i] = (int16_t)std::max(-32768.0, std::min(32767.0, counts));
+    }
+    return out;
+}
+
+/**
+ * @brief Pasa una señal larga por vibration_add y revisa que cada resumen sea el de su ventana.
+ */
+static bool check_stream(vibration_t &vib, const std::vector<int16_t> axes[3], double &worstNs)
+{
+    const int n = vib.points;
+    const size_t total = axes[0].size();
+    vibration_summary_t summary;
+    uint32_t expected = 0;
+    bool ok = true;
+
+    for (size_t i = 0; i < total; i++)
+    {
+        const int16_t accel[3] = {axes[0][i], axes[1][i], axes[2][i]};
+        auto start = std::chrono::steady_clock::now();
+        bool ready = vibration_add(&vib, accel, i * 1000, &summary);
+        worstNs = std::max(worstNs, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+        if (!ready) continue;
+
+        // Summary of window `expected`, samples [expected * n, (expected + 1) * n)
+        vibration_t direct = vib;
+        for (int a = 0; a < 3; a++)
+        {
+            vibration_axis_t axis;
+            vibration_analyse_axis(&direct, &axes[a][expected * n], &axis);
+            if (memcmp(&axis, &summary.axis[a], sizeof(axis)) != 0) ok = false;
+        }
+        if (summary.seq != expected || summary.t_us != (uint64_t)expected * n * 1000) ok = false;
+        expected++;
+    }
+    return ok && expected == total / n - 1;  // The last window is summarised three samples after it ends
+}
+
+/**
+ * @brief Lee las ventanas de aceleracion de una captura binaria de usbStream.
+ */
+static bool read_capture(const char *path, std::vector<int16_t> axes[3])
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    size_t offset = 0, used;
+    telemetry_frame_t frame;
+    while (offset < data.size())
+    {
+        int result = telemetry_frame_decode(data.data() + offset, data.size() - offset, &frame, &used);
+        if (result == 0) break;
+        offset += used;
+        if (result > 0 && frame.type == TELEMETRY_FRAME_IMU)
+            for (int a = 0; a < 3; a++) axes[a].push_back(frame.imu.acc[a]);
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *capture = nullptr;
+    int rate = 1000;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) capture = argv[++i];
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) rate = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-v") == 0) verbose = true;
+        else
+        {
+            fprintf(stderr, "usage: fftcheck [--capture usbstream.bin] [--rate hz] [-v]\n");
+            return 1;
+        }
+    }
+
+    static vibration_t vib;
+    Worst worst;
+    std::mt19937 rng(2023);
+    const std::vector<Case> cases = {
+        {"two tones", 1.0, {{80, 0.5}, {230, 0.2}}, 0.0},
+        {"small tone in noise", 1.0, {{120, 0.005}}, 0.002},
+        {"broadband noise", 0.0, {}, 0.05},
+        {"rotor harmonics", -0.98, {{45, 0.08}, {90, 0.04}, {135, 0.02}, {180, 0.01}, {310, 0.003}}, 0.004},
+        {"near full scale", 0.0, {{60, 1.9}}, 0.0},
+        {"no vibration", 1.0, {}, 0.0},
+    };
+
+    for (int points : {256, 512})
+    {
+        if (!vibration_init(&vib, points, rate, G_PER_COUNT))
+        {
+            fprintf(stderr, "invalid window %d\n", points);
+            return 1;
+        }
+        printf("%d points at %d Hz (%.1f Hz bins, %.1f Hz bands)\n", points, rate, (double)rate / points, rate / 2.0 / VIBRATION_BANDS);
+        for (const Case &c : cases)
+        {
+            Worst one;
+            for (int repeat = 0; repeat < 20; repeat++)
+            {
+                std::vector<int16_t> x = synthesize(c, points, rate, rng);
+                compare(vib, x.data(), one, verbose && repeat == 0);
+            }
+            printf("  %-20s snr %6.1f dB, band error %.3f%%, rms error %.5f%%, peak error %.2f Hz%s\n", c.name, one.snrDb,
+                   one.bandError * 100, one.rmsError * 100, one.peakHz, one.failures ? "  FAIL" : "");
+            worst.windows += one.windows;
+            worst.failures += one.failures;
+        }
+
+        // Same signal through the streaming path, one axis per sample
+        std::vector<int16_t> axes[3];
+        const Case stream = {"stream", 0.3, {{75, 0.2}, {190, 0.05}}, 0.01};
+        for (int a = 0; a < 3; a++)
+            for (int w = 0; w < 16; w++)
+            {
+                std::vector<int16_t> x = synthesize(stream, points, rate, rng);
+                axes[a].insert(axes[a].end(), x.begin(), x.end());
+            }
+        vibration_init(&vib, points, rate, G_PER_COUNT);
+        double worstNs = 0;
+        bool ok = check_stream(vib, axes, worstNs);
+        printf("  streaming: summaries %s, slowest sample %.1f us on this PC (sample period %.0f us)\n", ok ? "match" : "DIFFER",
+               worstNs / 1000, 1e6 / rate);
+        if (!ok) worst.failures++;
+    }
+
+    if (capture)
+    {
+        std::vector<int16_t> axes[3];
+        if (!read_capture(capture, axes))
+        {
+            fprintf(stderr, "cannot open %s\n", capture);
+            return 1;
+        }
+        vibration_init(&vib, 512, rate, G_PER_COUNT);
+        Worst recorded;
+        for (size_t start = 0; start + 512 <= axes[0].size(); start += 512)
+            for (int a = 0; a < 3; a++) compare(vib, &axes[a][start], recorded, verbose);
+        printf("%s: %" PRIu64 " windows, snr %.1f dB, band error %.3f%%, rms error %.5f%%\n", capture, recorded.windows, recorded.snrDb,
+               recorded.bandError * 100, recorded.rmsError * 100);
+        worst.failures += recorded.failures;
+    }
+
+    printf("%s (%" PRIu64 " windows)\n", worst.failures ? "FAILED" : "OK", worst.windows);
+    return worst.failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+/**
+  @file fmtbench.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Compara en el PC el formateador sin printf de telemetry.c con snprintf: verifica que los bytes sean
+  iguales (muestras realistas, floats al azar de todo el rango y casos especiales) y mide cuantas
+  lineas por segundo arma cada uno.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <random>
+#include <vector>
+extern "C" {
+    #include "telemetry.h"
+}
+
+// The format telemetry_format_csv used before it stopped depending on printf
+#define LEGACY_FORMAT "%.6f,%.6f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%" PRIu32 ",%" PRIu64 ",%" PRId64
+
+static int legacy_format(const telemetry_sample_t *s, char *buf, size_t size)
+{
+    return snprintf(buf, size, LEGACY_FORMAT, s->lat, s->lon, s->acc[0], s->acc[1], s->acc[2], s->gyro[0], s->gyro[1], s->gyro[2],
+                    s->mag[0], s->mag[1], s->mag[2], s->seq, s->t_us, s->utc_us);
+}
+
+/**
+ * @brief Compara un float escrito por los dos caminos.
+ *
+ * @return bool retorna false e imprime la diferencia si no son iguales.
+ */
+static bool check_value(float value, int decimals)
+{
+    char expected[64], got[64];
+    snprintf(expected, sizeof(expected), "%.*f", decimals, value);
+    *telemetry_put_fixed(got, value, decimals) = '\0';
+    if (strcmp(expected, got) != 0)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        fprintf(stderr, "0x%08x %%.%df: expected %s got %s\n", bits, decimals, expected, got);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Muestra con valores como los de un vuelo (o de todo el rango si wide es true).
+ */
+static telemetry_sample_t random_sample(std::mt19937_64 &rng, uint32_t seq)
+{
+    std::uniform_real_distribution<float> lat(-90, 90), lon(-180, 180), acc(-2, 2), gyro(-250, 250), mag(-4800, 4800);
+    telemetry_sample_t s;
+    s.seq = seq;
+    s.t_us = rng() >> 20;
+    s.utc_us = (int64_t)(rng() >> 12) - (1ll << 50);
+    s.lat = lat(rng);
+    s.lon = lon(rng);
+    for (int i = 0; i < 3; i++)
+    {
+        s.acc[i] = acc(rng);
+        s.gyro[i] = gyro(rng);
+        s.mag[i] = mag(rng);
+    }
+    return s;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: fmtbench [--samples n] [--floats n] [--stride n]\n");
+}
+
+int main(int argc, char **argv)
+{
+    size_t samples = 1000000, floats = 10000000;
+    uint64_t stride = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) samples = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--floats") == 0 && i + 1 < argc) floats = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--stride") == 0 && i + 1 < argc) stride = strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    uint64_t errors = 0;
+
+    // Cases where the rounding or the special values are easy to get wrong
+    const float special[] = {0.0f, -0.0f, 0.5f, -0.5f, 0.0078125f, 0.00000050f, 0.00005f, -0.00004f, 1e-7f, 2.5e-5f,
+                             9.99999f, 9.9999995f, 99.99995f, 1048576.5f, 16777216.0f, 123456789.0f, 1e20f, 3e30f,
+                             FLT_MAX, -FLT_MAX, FLT_MIN, FLT_TRUE_MIN, INFINITY, -INFINITY, NAN};
+    for (float value : special)
+    {
+        for (int decimals = 0; decimals <= 6; decimals++)
+            if (!check_value(value, decimals)) errors++;
+    }
+
+    // Every float bit pattern is as likely, so all exponents are covered
+    std::mt19937_64 rng(2023);
+    for (size_t i = 0; i < floats; i++)
+    {
+        uint32_t bits = rng();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        if (!check_value(value, i % 2 ? 4 : 6)) errors++;
+    }
+    if (stride)
+    {
+        for (uint64_t bits = 0; bits <= UINT32_MAX; bits += stride)
+        {
+            uint32_t b = bits;
+            float value;
+            memcpy(&value, &b, sizeof(value));
+            if (!check_value(value, 4) || !check_value(value, 6)) errors++;
+        }
+    }
+
+    std::vector<telemetry_sample_t> data;
+    data.reserve(samples);
+    for (size_t i = 0; i < samples; i++) data.push_back(random_sample(rng, i));
+
+    char a[TELEMETRY_CSV_MAX], b[TELEMETRY_CSV_MAX];
+    for (const telemetry_sample_t &s : data)
+    {
+        int na = legacy_format(&s, a, sizeof(a)), nb = telemetry_format_csv(&s, b, sizeof(b));
+        if (na != nb || strcmp(a, b) != 0)
+        {
+            if (errors++ < 5) fprintf(stderr, "line differs\n  snprintf: %s\n  fixed:    %s\n", a, b);
+        }
+    }
+
+    // Timing, with a checksum so the compiler keeps the calls
+    uint64_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const telemetry_sample_t &s : data) sum += legacy_format(&s, a, sizeof(a)) + a[5];
+    double legacy = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (const telemetry_sample_t &s : data) sum += telemetry_format_csv(&s, b, sizeof(b)) + b[5];
+    double fixed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("snprintf: %8.0f lines/s (%.0f ns/line)\n", samples / legacy, legacy * 1e9 / samples);
+    printf("fixed:    %8.0f lines/s (%.0f ns/line), %.1fx\n", samples / fixed, fixed * 1e9 / samples, legacy / fixed);
+    printf("Checked %zu floats and %zu lines: %llu differences (checksum %llu)\n", floats + sizeof(special) / sizeof(special[0]) * 7, samples,
+           (unsigned long long)errors, (unsigned long long)(sum & 0xFF));
+    return errors ? 1 : 0;
+}
\ No newline at end of file
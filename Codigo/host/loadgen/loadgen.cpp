@@ -0,0 +1,1040 @@
+/**
+  @file loadgen.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Generador de carga para el receptor: simula N equipos que envian muestras por TCP o UDP con el mismo
+  formato que el firmware (lineas CSV de telemetria.c o tramas binarias de telemetry_frame.c), con
+  lotes, variacion en los tiempos, desconexiones y escrituras partidas. Reporta cada segundo la tasa
+  lograda, los acuses del servidor y los percentiles de latencia. Con --serve hace de receptor: separa
+  los mensajes, mide la latencia de punta a punta con la hora UTC de cada muestra y acusa el ultimo
+  numero de secuencia recibido ("A<seq>\n").
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "telemetry_log.h"
+extern "C" {
+    #include "telemetry.h"
+    #include "telemetry_frame.h"
+}
+
+static const size_t MAX_PENDING_BYTES = 1 << 20;  // Per device; beyond this new samples are dropped (the ESP queue is 2 KB)
+static const uint32_t DEVICES_PER_SOURCE_IP = 1000;  // Loopback tests spread devices over 127.0.0.2, 127.0.0.3, ...
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t utc_now_us()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Histograma de latencias en microsegundos: 64 divisiones por cada potencia de dos (1.5 %).
+ */
+class LatencyHistogram
+{
+public:
+    void add(uint64_t us)
+    {
+        counts[index(us)]++;
+        total++;
+        if (us > max) max = us;
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (size_t i = 0; i < counts.size(); i++) counts[i] += other.counts[i];
+        total += other.total;
+        max = std::max(max, other.max);
+    }
+
+    double percentile_ms(double p) const
+    {
+        if (total == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, (uint64_t)ceil(p / 100 * total)), seen = 0;
+        for (size_t i = 0; i < counts.size(); i++)
+        {
+            seen += counts[i];
+            if (seen >= rank) return std::min(value(i), max) / 1000.0;
+        }
+        return max / 1000.0;
+    }
+
+    uint64_t total = 0, max = 0;
+
+private:
+    static size_t index(uint64_t us)
+    {
+        if (us < 64) return us;
+        int e = 63 - __builtin_clzll(us);
+        return std::min<size_t>((e - 5) * 64 + ((us >> (e - 6)) - 64), 40 * 64 - 1);
+    }
+    static uint64_t value(size_t i)
+    {
+        if (i < 64) return i;
+        return (uint64_t)(i % 64 + 64) << (i / 64 - 1);
+    }
+
+    std::vector<uint64_t> counts = std::vector<uint64_t>(40 * 64);
+};
+
+/**
+ * @brief Opciones de la linea de comandos.
+ */
+struct Options
+{
+    std::string host = "127.0.0.1";
+    int port = 9000;
+    bool udp = false, serve = false, withServer = false, frames = false;
+    uint32_t devices = 100, batch = 1;
+    double rate = 1, jitter = 0, disconnect = 0, seconds = 10, ramp = -1;
+    bool partial = false;
+    int threads = 1;
+};
+
+/**
+ * @brief Contadores del generador.
+ */
+struct ClientStats
+{
+    uint64_t samples = 0, dropped = 0, messages = 0, bytes = 0, writes = 0, pieces = 0, backpressure = 0;
+    uint64_t connects = 0, connectFailures = 0, disconnects = 0, serverCloses = 0, acked = 0, unacked = 0;
+    uint64_t unsent = 0;  // Samples of batches still open when the run ended
+    uint32_t connected = 0;
+    LatencyHistogram ackLatency;
+
+    void merge(const ClientStats &o)
+    {
+        samples += o.samples; dropped += o.dropped; messages += o.messages; bytes += o.bytes; writes += o.writes;
+        pieces += o.pieces; backpressure += o.backpressure; connects += o.connects; connectFailures += o.connectFailures;
+        disconnects += o.disconnects; serverCloses += o.serverCloses; acked += o.acked; unacked += o.unacked;
+        unsent += o.unsent; connected += o.connected;
+        ackLatency.merge(o.ackLatency);
+    }
+};
+
+/**
+ * @brief Contadores del receptor.
+ */
+struct ServerStats
+{
+    uint64_t messages = 0, bytes = 0, accepted = 0, closed = 0, errors = 0, acks = 0, acksDropped = 0, untimed = 0;
+    LatencyHistogram latency;  // From the UTC time of the sample to its arrival
+
+    void merge(const ServerStats &o)
+    {
+        messages += o.messages; bytes += o.bytes; accepted += o.accepted; closed += o.closed; errors += o.errors;
+        acks += o.acks; acksDropped += o.acksDropped; untimed += o.untimed;
+        latency.merge(o.latency);
+    }
+};
+
+/**
+ * @brief Separa mensajes de un flujo: lineas CSV o tramas binarias, que se reconocen por el primer byte.
+ *
+ * @return size_t retorna los bytes consumidos; lo que queda es un mensaje incompleto.
+ */
+static size_t parse_messages(const uint8_t *data, size_t length, ServerStats &stats, int64_t arrivalUs, uint32_t &lastSeq, bool &any)
+{
+    size_t pos = 0;
+    char line[512];
+    while (pos < length)
+    {
+        uint32_t seq;
+        int64_t sentUs;
+        if (data[pos] == TELEMETRY_FRAME_SYNC0)
+        {
+            telemetry_frame_t frame;
+            size_t used;
+            int result = telemetry_frame_decode(data + pos, length - pos, &frame, &used);
+            if (result == 0) break;
+            pos += used;
+            if (result < 0)
+            {
+                stats.errors++;
+                continue;
+            }
+            seq = frame.seq;
+            sentUs = frame.type == TELEMETRY_FRAME_GPS ? frame.gps.utc_us : 0; // t_us is device time: only GPS frames carry UTC
+        }
+        else
+        {
+            const uint8_t *newline = (const uint8_t *)memchr(data + pos, '\n', length - pos);
+            if (!newline)
+            {
+                if (length - pos > sizeof(line)) // No line is this long: garbage, resynchronise
+                {
+                    stats.errors++;
+                    pos = length;
+                }
+                break;
+            }
+            size_t n = std::min<size_t>(newline - data - pos, sizeof(line) - 1);
+            if (n > 0 && data[pos + n - 1] == '\r') n--;
+            memcpy(line, data + pos, n);
+            line[n] = '\0';
+            pos = newline - data + 1;
+
+            TelemetryRow row;
+            if (strncmp(line, "VIB,", 4) == 0 || strncmp(line, "FILTER,", 7) == 0) // Summaries carry no latency
+            {
+                stats.messages++;
+                stats.untimed++;
+                continue;
+            }
+            if (!parse_telemetry_line(line, row))
+            {
+                if (n > 0) stats.errors++;
+                continue;
+            }
+            if (!row.timed)
+            {
+                stats.messages++;
+                stats.untimed++;
+                continue;
+            }
+            seq = row.seq;
+            sentUs = row.utc_us;
+        }
+
+        stats.messages++;
+        if (sentUs > 0 && arrivalUs >= sentUs) stats.latency.add(arrivalUs - sentUs);
+        else stats.untimed++;
+        if (!any || seq > lastSeq) lastSeq = seq;
+        any = true;
+    }
+    return pos;
+}
+
+static void raise_fd_limit()
+{
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+/**
+ * @brief Receptor de prueba: un hilo con su propio socket (SO_REUSEPORT reparte las conexiones).
+ */
+class IngestServer
+{
+public:
+    IngestServer(const Options &options, std::atomic<bool> &stop) : options(options), stop(stop) {}
+
+    bool open(std::string &error)
+    {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(options.port);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        listener = socket(AF_INET, (options.udp ? SOCK_DGRAM : SOCK_STREAM) | SOCK_NONBLOCK, 0);
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        setsockopt(listener, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+        if (listener < 0 || bind(listener, (sockaddr *)&addr, sizeof(addr)) < 0 || (!options.udp && listen(listener, SOMAXCONN) < 0))
+        {
+            error = std::string("cannot listen on port ") + std::to_string(options.port) + ": " + strerror(errno);
+            return false;
+        }
+        if (options.udp)
+        {
+            int size = 8 << 20;
+            setsockopt(listener, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        }
+        epoll = epoll_create1(0);
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;  // The listener
+        epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &ev);
+        return true;
+    }
+
+    void run()
+    {
+        std::vector<epoll_event> events(1024);
+        std::vector<uint8_t> buf(1 << 16);
+        while (!stop)
+        {
+            int n = epoll_wait(epoll, events.data(), events.size(), 100);
+            const int64_t arrival = utc_now_us();
+            for (int i = 0; i < n; i++)
+            {
+                Connection *conn = (Connection *)events[i].data.ptr;
+                if (!conn && options.udp) receive_datagrams(buf, arrival);
+                else if (!conn) accept_all();
+                else receive(conn, buf, arrival);
+            }
+            publish();
+        }
+        for (Connection *conn : connections) delete conn;
+        connections.clear();
+        close(epoll);
+        close(listener);
+        publish();
+    }
+
+    /**
+     * @brief Copia de los contadores, se puede llamar desde otro hilo.
+     */
+    ServerStats snapshot()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return published;
+    }
+
+private:
+    struct Connection
+    {
+        int fd = -1;
+        std::vector<uint8_t> pending;
+        uint32_t lastSeq = 0;
+        bool any = false;
+        size_t slot = 0;
+    };
+
+    void accept_all()
+    {
+        int fd;
+        while ((fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK)) >= 0)
+        {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            Connection *conn = new Connection();
+            conn->fd = fd;
+            conn->slot = connections.size();
+            connections.push_back(conn);
+            epoll_event ev = {};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.ptr = conn;
+            epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev);
+            stats.accepted++;
+        }
+    }
+
+    void receive(Connection *conn, std::vector<uint8_t> &buf, int64_t arrival)
+    {
+        while (1)
+        {
+            ssize_t n = recv(conn->fd, buf.data(), buf.size(), 0);
+            if (n > 0)
+            {
+                stats.bytes += n;
+                conn->pending.insert(conn->pending.end(), buf.data(), buf.data() + n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            drop(conn);  // Closed by the device, or an error
+            return;
+        }
+
+        const uint32_t before = conn->lastSeq;
+        const bool hadAny = conn->any;
+        size_t used = parse_messages(conn->pending.data(), conn->pending.size(), stats, arrival, conn->lastSeq, conn->any);
+        conn->pending.erase(conn->pending.begin(), conn->pending.begin() + used);
+        if (conn->any && (!hadAny || conn->lastSeq != before))
+        {
+            char ack[16];
+            int len = snprintf(ack, sizeof(ack), "A%" PRIu32 "\n", conn->lastSeq);
+            if (send(conn->fd, ack, len, MSG_NOSIGNAL) == len) stats.acks++;
+            else stats.acksDropped++;  // Only happens when the device stops reading
+        }
+    }
+
+    void receive_datagrams(std::vector<uint8_t> &buf, int64_t arrival)
+    {
+        sockaddr_in from;
+        socklen_t fromLen = sizeof(from);
+        ssize_t n;
+        while ((n = recvfrom(listener, buf.data(), buf.size(), 0, (sockaddr *)&from, &fromLen)) > 0)
+        {
+            stats.bytes += n;
+            uint32_t lastSeq = 0;
+            bool any = false;
+            parse_messages(buf.data(), n, stats, arrival, lastSeq, any);  // A datagram holds whole messages
+            if (any)
+            {
+                char ack[16];
+                int len = snprintf(ack, sizeof(ack), "A%" PRIu32 "\n", lastSeq);
+                if (sendto(listener, ack, len, 0, (sockaddr *)&from, fromLen) == len) stats.acks++;
+                else stats.acksDropped++;
+            }
+            fromLen = sizeof(from);
+        }
+    }
+
+    void drop(Connection *conn)
+    {
+        epoll_ctl(epoll, EPOLL_CTL_DEL, conn->fd, nullptr);
+        close(conn->fd);
+        connections[conn->slot] = connections.back();
+        connections[conn->slot]->slot = conn->slot;
+        connections.pop_back();
+        delete conn;
+        stats.closed++;
+    }
+
+    void publish()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        published = stats;
+    }
+
+    const Options &options;
+    std::atomic<bool> &stop;
+    int listener = -1, epoll = -1;
+    std::vector<Connection *> connections;
+    ServerStats stats, published;
+    std::mutex mutex;
+};
+
+/**
+ * @brief Un equipo simulado.
+ */
+struct Device
+{
+    uint32_t id;
+    int fd = -1;
+    enum { IDLE, CONNECTING, OPEN } state = IDLE;
+    uint32_t seq = 0, batched = 0;
+    bool leaving = false;           // Disconnect once everything sent is acknowledged
+    uint64_t nextSample = 0, wakeAt = 0, pieceAt = 0;  // Steady clock, ns
+    std::string out;                // Bytes not yet written
+    std::deque<size_t> cuts;        // Offsets in out where a partial write stops
+    std::deque<std::pair<uint32_t, uint64_t>> inflight;  // (last seq of a batch, when it was queued)
+    std::string acks;
+    float lat, lon, heading;
+};
+
+/**
+ * @brief Un hilo del generador: sus equipos, su epoll y una cola de prioridad con el proximo evento de cada uno.
+ */
+class LoadWorker
+{
+public:
+    LoadWorker(const Options &options, int index, uint64_t startNs, int64_t startUtc)
+        : options(options), rng(2023 + index), startNs(startNs), startUtc(startUtc)
+    {
+        epoll = epoll_create1(0);
+        server.sin_family = AF_INET;
+        server.sin_port = htons(options.port);
+        inet_pton(AF_INET, options.host.c_str(), &server.sin_addr);
+        loopback = (ntohl(server.sin_addr.s_addr) >> 24) == 127;
+
+        const double ramp = options.ramp >= 0 ? options.ramp : options.devices / 5000.0;
+        const uint64_t period = (uint64_t)(1e9 / options.rate);
+        std::uniform_real_distribution<double> unit(0, 1);
+        for (uint32_t id = index; id < options.devices; id += options.threads)
+        {
+            Device dev;
+            dev.id = id;
+            dev.lat = 6.2442f + 0.05f * (unit(rng) - 0.5f);
+            dev.lon = -75.5812f + 0.05f * (unit(rng) - 0.5f);
+            dev.heading = unit(rng) * 6.2831853f;
+            dev.nextSample = startNs + (uint64_t)(ramp * 1e9 * id / std::max<uint32_t>(1, options.devices)) + (uint64_t)(unit(rng) * period);
+            devices.push_back(dev);
+        }
+        for (Device &dev : devices) schedule(dev, dev.nextSample);
+    }
+
+    ~LoadWorker()
+    {
+        for (Device &dev : devices)
+            if (dev.fd >= 0) close(dev.fd);
+        close(epoll);
+    }
+
+    void run(uint64_t endNs)
+    {
+        std::vector<epoll_event> events(1024);
+        uint64_t lastPublish = 0;
+        while (1)
+        {
+            uint64_t now = now_ns();
+            if (now >= endNs) break;
+            int timeout = 100;
+            if (!wakeups.empty()) timeout = (int)std::min<uint64_t>(100, wakeups.top().first > now ? (wakeups.top().first - now) / 1000000 : 0);
+            int n = epoll_wait(epoll, events.data(), events.size(), timeout);
+            for (int i = 0; i < n; i++) on_event(devices[events[i].data.u32], events[i].events);
+
+            now = now_ns();
+            while (!wakeups.empty() && wakeups.top().first <= now)
+            {
+                auto [at, index] = wakeups.top();
+                wakeups.pop();
+                if (devices[index].wakeAt == at) service(devices[index], now);  // Otherwise a newer wakeup replaced it
+            }
+            if (now - lastPublish > 100000000)
+            {
+                publish();
+                lastPublish = now;
+            }
+        }
+        for (Device &dev : devices)
+        {
+            stats.unacked += dev.inflight.size();
+            stats.unsent += dev.batched;
+        }
+        publish();
+    }
+
+    ClientStats snapshot()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return published;
+    }
+
+private:
+    void schedule(Device &dev, uint64_t at)
+    {
+        dev.wakeAt = at;
+        wakeups.push({at, (uint32_t)(&dev - devices.data())});
+    }
+
+    /**
+     * @brief Genera las muestras que ya tocan, cierra lotes y sigue con las escrituras partidas.
+     */
+    void service(Device &dev, uint64_t now)
+    {
+        if (dev.pieceAt && now >= dev.pieceAt)
+        {
+            dev.pieceAt = 0;
+            write_pending(dev, now);
+        }
+
+        const double period = 1e9 / options.rate;
+        std::uniform_real_distribution<double> jitter(-options.jitter, options.jitter);
+        while (dev.nextSample <= now)
+        {
+            add_sample(dev, dev.nextSample);
+            dev.nextSample += (uint64_t)(period * (1 + jitter(rng)));
+            if (++dev.batched >= options.batch)
+            {
+                dev.batched = 0;
+                dev.inflight.push_back({dev.seq - 1, now});
+                if (options.udp) send_datagram(dev);
+                else write_pending(dev, now);
+            }
+        }
+
+        uint64_t next = dev.nextSample;
+        if (dev.pieceAt) next = std::min(next, dev.pieceAt);
+        schedule(dev, next);
+    }
+
+    /**
+     * @brief Una muestra con el formato del firmware; la hora UTC es la de la muestra, no la del envio.
+     */
+    void add_sample(Device &dev, uint64_t at)
+    {
+        stats.samples++;
+        const int64_t utc = startUtc + (int64_t)(at - startNs) / 1000;
+        if (dev.out.size() > MAX_PENDING_BYTES)
+        {
+            stats.dropped++;
+            dev.seq++;  // The receiver sees the gap, as with a real device
+            return;
+        }
+        std::uniform_real_distribution<float> noise(-0.02f, 0.02f);
+        dev.lat += 1e-6f * cosf(dev.heading);
+        dev.lon += 1e-6f * sinf(dev.heading);
+
+        const size_t before = dev.out.size();
+        if (options.frames)
+        {
+            telemetry_frame_t frame = {};
+            uint8_t bytes[TELEMETRY_FRAME_MAX];
+            frame.type = dev.seq % 10 == 0 ? TELEMETRY_FRAME_GPS : TELEMETRY_FRAME_IMU;  // Like usbStream, mostly IMU
+            frame.seq = dev.seq++;
+            frame.t_us = (at - startNs) / 1000;  // Device time, as in telemetry_frame.h
+            if (frame.type == TELEMETRY_FRAME_GPS)
+            {
+                frame.gps.lat_e7 = (int32_t)lround(dev.lat * 1e7);
+                frame.gps.lon_e7 = (int32_t)lround(dev.lon * 1e7);
+                frame.gps.utc_us = utc;
+            }
+            else
+            {
+                for (int i = 0; i < 3; i++)
+                {
+                    frame.imu.acc[i] = to_raw((i == 2 ? 1.0f : 0.0f) + noise(rng), ACC_FULL_SCALE);
+                    frame.imu.gyro[i] = to_raw(noise(rng) * 100, GYRO_FULL_SCALE);
+                    frame.imu.mag[i] = to_raw(20 + noise(rng) * 100, MAG_FULL_SCALE);
+                }
+            }
+            dev.out.append((const char *)bytes, telemetry_frame_encode(&frame, bytes));
+        }
+        else
+        {
+            telemetry_sample_t sample = {};
+            char line[TELEMETRY_CSV_MAX + 1];
+            sample.seq = dev.seq++;
+            sample.t_us = (at - startNs) / 1000;
+            sample.utc_us = utc;
+            sample.lat = dev.lat;
+            sample.lon = dev.lon;
+            for (int i = 0; i < 3; i++)
+            {
+                sample.acc[i] = (i == 2 ? 1.0f : 0.0f) + noise(rng);
+                sample.gyro[i] = noise(rng) * 100;
+                sample.mag[i] = 20 + noise(rng) * 100;
+            }
+            int length = telemetry_format_csv(&sample, line, TELEMETRY_CSV_MAX);
+            line[length++] = '\n';
+            dev.out.append(line, length);
+        }
+        stats.messages++;
+
+        if (options.partial && dev.out.size() - before > 2)
+        {
+            // Split the message at a random byte, the receiver must put it back together
+            std::uniform_int_distribution<size_t> cut(before + 1, dev.out.size() - 1);
+            dev.cuts.push_back(cut(rng));
+        }
+    }
+
+    void start_connect(Device &dev)
+    {
+        dev.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (dev.fd < 0)
+        {
+            stats.connectFailures++;
+            return;
+        }
+        int one = 1;
+        setsockopt(dev.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (loopback)
+        {
+            // Each source address has its own ephemeral ports, so one box can open more than 28k connections.
+            // The port is picked by connect(): bind() alone would search a port free for every destination.
+            int noPort = 1;
+            setsockopt(dev.fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &noPort, sizeof(noPort));
+            sockaddr_in local = {};
+            local.sin_family = AF_INET;
+            local.sin_addr.s_addr = htonl(0x7F000001 + 1 + dev.id / DEVICES_PER_SOURCE_IP);
+            bind(dev.fd, (sockaddr *)&local, sizeof(local));
+        }
+        if (connect(dev.fd, (sockaddr *)&server, sizeof(server)) < 0 && errno != EINPROGRESS)
+        {
+            stats.connectFailures++;
+            close(dev.fd);
+            dev.fd = -1;
+            return;
+        }
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+        ev.data.u32 = &dev - devices.data();
+        epoll_ctl(epoll, EPOLL_CTL_ADD, dev.fd, &ev);
+        dev.state = Device::CONNECTING;
+    }
+
+    void close_device(Device &dev)
+    {
+        if (dev.fd >= 0)
+        {
+            epoll_ctl(epoll, EPOLL_CTL_DEL, dev.fd, nullptr);
+            close(dev.fd);
+        }
+        if (dev.state == Device::OPEN) stats.connected--;
+        dev.fd = -1;
+        dev.state = Device::IDLE;
+        dev.leaving = false;
+        stats.unacked += dev.inflight.size();  // Whatever was not acknowledged is lost with the connection
+        dev.inflight.clear();
+        dev.acks.clear();
+    }
+
+    /**
+     * @brief Escribe lo pendiente hasta el proximo corte; conecta primero si hace falta.
+     */
+    void write_pending(Device &dev, uint64_t now)
+    {
+        if (dev.state == Device::IDLE)
+        {
+            if (dev.out.empty()) return;
+            start_connect(dev);
+            return;  // Written once the connection is open
+        }
+        if (dev.state == Device::CONNECTING || dev.pieceAt) return;
+
+        while (!dev.out.empty())
+        {
+            size_t limit = dev.cuts.empty() ? dev.out.size() : dev.cuts.front();
+            ssize_t n = send(dev.fd, dev.out.data(), limit, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    stats.backpressure++;
+                    watch_output(dev, true);  // Continue on EPOLLOUT
+                }
+                else
+                {
+                    close_device(dev);
+                }
+                return;
+            }
+            stats.writes++;
+            stats.bytes += n;
+            dev.out.erase(0, n);
+            for (size_t &c : dev.cuts) c -= n;
+            while (!dev.cuts.empty() && dev.cuts.front() == 0) dev.cuts.pop_front();
+            if ((size_t)n < limit)
+            {
+                stats.backpressure++;
+                watch_output(dev, true);
+                return;
+            }
+            if (!dev.out.empty() && options.partial)
+            {
+                // Rest of the message a little later, like the ESP handing over a TCP segment at a time
+                std::uniform_int_distribution<uint64_t> delay(200000, 2000000);
+                dev.pieceAt = now + delay(rng);
+                stats.pieces++;
+                if (dev.pieceAt < dev.wakeAt) schedule(dev, dev.pieceAt);
+                return;
+            }
+        }
+        watch_output(dev, false);
+
+        std::uniform_real_distribution<double> unit(0, 1);
+        if (options.disconnect > 0 && unit(rng) < options.disconnect) dev.leaving = true;
+        if (dev.leaving && dev.inflight.empty()) leave(dev);
+    }
+
+    /**
+     * @brief Desconexion pedida por --disconnect, una vez acusado todo lo enviado.
+     *
+     * Cerrar con un acuse sin leer hace que el kernel mande RST y el servidor pierda lo ultimo que recibio.
+     */
+    void leave(Device &dev)
+    {
+        dev.leaving = false;
+        stats.disconnects++;
+        close_device(dev);  // Reconnects with the next batch
+    }
+
+    void send_datagram(Device &dev)
+    {
+        if (dev.fd < 0)
+        {
+            dev.fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+            connect(dev.fd, (sockaddr *)&server, sizeof(server));
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.u32 = &dev - devices.data();
+            epoll_ctl(epoll, EPOLL_CTL_ADD, dev.fd, &ev);
+            dev.state = Device::OPEN;
+            stats.connects++;
+            stats.connected++;
+        }
+        ssize_t n = send(dev.fd, dev.out.data(), dev.out.size(), 0);
+        if (n == (ssize_t)dev.out.size())
+        {
+            stats.writes++;
+            stats.bytes += n;
+        }
+        else
+        {
+            stats.backpressure++;  // Datagram lost, there is no retry on UDP
+        }
+        dev.out.clear();
+        dev.cuts.clear();
+    }
+
+    void watch_output(Device &dev, bool on)
+    {
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLRDHUP | (on ? (uint32_t)EPOLLOUT : 0u);
+        ev.data.u32 = &dev - devices.data();
+        epoll_ctl(epoll, EPOLL_CTL_MOD, dev.fd, &ev);
+    }
+
+    void on_event(Device &dev, uint32_t events)
+    {
+        const uint64_t now = now_ns();
+        if (dev.state == Device::CONNECTING && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+        {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            getsockopt(dev.fd, SOL_SOCKET, SO_ERROR, &error, &len);
+            if (error != 0)
+            {
+                stats.connectFailures++;
+                close_device(dev);
+                return;
+            }
+            dev.state = Device::OPEN;
+            stats.connects++;
+            stats.connected++;
+            write_pending(dev, now);
+            if (dev.state != Device::OPEN) return;
+        }
+        else if ((events & EPOLLOUT) && dev.state == Device::OPEN)
+        {
+            write_pending(dev, now);
+            if (dev.state != Device::OPEN) return;
+        }
+
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            char buf[4096];
+            while (1)
+            {
+                ssize_t n = recv(dev.fd, buf, sizeof(buf), 0);
+                if (n > 0)
+                {
+                    dev.acks.append(buf, n);
+                    continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                if (!options.udp)
+                {
+                    stats.serverCloses++;
+                    close_device(dev);
+                    return;
+                }
+                break;
+            }
+            on_acks(dev, now);
+        }
+    }
+
+    /**
+     * @brief Procesa los acuses "A<seq>\n": cada uno confirma todos los lotes hasta ese numero.
+     */
+    void on_acks(Device &dev, uint64_t now)
+    {
+        size_t start = 0, newline;
+        while ((newline = dev.acks.find('\n', start)) != std::string::npos)
+        {
+            if (dev.acks[start] == 'A')
+            {
+                uint32_t seq = strtoul(dev.acks.c_str() + start + 1, nullptr, 10);
+                while (!dev.inflight.empty() && dev.inflight.front().first <= seq)
+                {
+                    stats.acked++;
+                    stats.ackLatency.add((now - dev.inflight.front().second) / 1000);
+                    dev.inflight.pop_front();
+                }
+                if (dev.leaving && dev.inflight.empty() && dev.out.empty())
+                {
+                    leave(dev);
+                    return;
+                }
+            }
+            start = newline + 1;
+        }
+        dev.acks.erase(0, start);
+    }
+
+    void publish()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        published = stats;
+    }
+
+    const Options &options;
+    std::mt19937 rng;
+    uint64_t startNs;
+    int64_t startUtc;
+    int epoll;
+    sockaddr_in server = {};
+    bool loopback;
+    std::vector<Device> devices;
+    std::priority_queue<std::pair<uint64_t, uint32_t>, std::vector<std::pair<uint64_t, uint32_t>>, std::greater<>> wakeups;
+    ClientStats stats, published;
+    std::mutex mutex;
+};
+
+static void print_latency(const char *name, const LatencyHistogram &h)
+{
+    printf("%s: %" PRIu64 " samples, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, p99.9 %.2f ms, max %.2f ms\n", name, h.total, h.percentile_ms(50),
+           h.percentile_ms(90), h.percentile_ms(99), h.percentile_ms(99.9), h.max / 1000.0);
+}
+
+/**
+ * @brief Solo el receptor, hasta que pase --seconds (0 para siempre).
+ */
+static int serve(const Options &options)
+{
+    std::atomic<bool> stop(false);
+    std::vector<std::unique_ptr<IngestServer>> servers;
+    std::vector<std::thread> threads;
+    std::string error;
+    raise_fd_limit();
+    for (int i = 0; i < options.threads; i++)
+    {
+        servers.emplace_back(new IngestServer(options, stop));
+        if (!servers.back()->open(error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    for (auto &server : servers) threads.emplace_back([&server] { server->run(); });
+    printf("Listening on %s port %d with %d threads\n", options.udp ? "UDP" : "TCP", options.port, options.threads);
+
+    ServerStats last;
+    auto start = std::chrono::steady_clock::now();
+    while (options.seconds <= 0 || std::chrono::steady_clock::now() - start < std::chrono::duration<double>(options.seconds))
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        ServerStats total;
+        for (auto &server : servers) total.merge(server->snapshot());
+        printf("ingest: %" PRIu64 " connections, %" PRIu64 " msg/s, %.2f MB/s, latency p50 %.2f ms p99 %.2f ms, %" PRIu64 " errors\n",
+               total.accepted - total.closed, total.messages - last.messages, (total.bytes - last.bytes) / 1e6,
+               total.latency.percentile_ms(50), total.latency.percentile_ms(99), total.errors);
+        last = total;
+    }
+    stop = true;
+    for (auto &t : threads) t.join();
+    print_latency("End to end latency", last.latency);
+    return 0;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: loadgen [--host ip] [--port n] [--udp] [--devices n] [--rate hz] [--batch n] [--jitter fraction]\n"
+                    "               [--disconnect probability] [--partial] [--frames] [--seconds s] [--ramp s] [--threads n]\n"
+                    "               [--with-server]\n"
+                    "       loadgen --serve [--port n] [--udp] [--threads n] [--seconds s]\n");
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) options.host = argv[++i];
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) options.port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--udp") == 0) options.udp = true;
+        else if (strcmp(argv[i], "--serve") == 0) options.serve = true;
+        else if (strcmp(argv[i], "--with-server") == 0) options.withServer = true;
+        else if (strcmp(argv[i], "--frames") == 0) options.frames = true;
+        else if (strcmp(argv[i], "--partial") == 0) options.partial = true;
+        else if (strcmp(argv[i], "--devices") == 0 && i + 1 < argc) options.devices = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) options.rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) options.batch = std::max(1ul, strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc) options.jitter = std::min(0.9, atof(argv[++i]));
+        else if (strcmp(argv[i], "--disconnect") == 0 && i + 1 < argc) options.disconnect = atof(argv[++i]);
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) options.seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--ramp") == 0 && i + 1 < argc) options.ramp = atof(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) options.threads = std::max(1, atoi(argv[++i]));
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+    if (options.serve) return serve(options);
+    if (options.rate <= 0 || options.devices == 0)
+    {
+        usage();
+        return 1;
+    }
+    raise_fd_limit();
+
+    // Optional receiver in the same process, one thread
+    std::atomic<bool> stopServer(false);
+    std::unique_ptr<IngestServer> server;
+    std::thread serverThread;
+    if (options.withServer)
+    {
+        std::string error;
+        server.reset(new IngestServer(options, stopServer));
+        if (!server->open(error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        serverThread = std::thread([&server] { server->run(); });
+    }
+
+    const uint64_t startNs = now_ns();
+    const int64_t startUtc = utc_now_us();
+    const uint64_t endNs = startNs + (uint64_t)(options.seconds * 1e9);
+    std::vector<std::unique_ptr<LoadWorker>> workers;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < options.threads; i++) workers.emplace_back(new LoadWorker(options, i, startNs, startUtc));
+    for (auto &worker : workers) threads.emplace_back([&worker, endNs] { worker->run(endNs); });
+    printf("%u devices at %.1f Hz (%.0f msg/s), %s %s, batches of %u, jitter %.0f%%, disconnect %.1f%%%s\n", options.devices, options.rate,
+           options.devices * options.rate, options.frames ? "frames" : "CSV", options.udp ? "UDP" : "TCP", options.batch,
+           options.jitter * 100, options.disconnect * 100, options.partial ? ", partial writes" : "");
+
+    ClientStats last;
+    uint64_t lastNs = startNs;
+    while (now_ns() + 1000000000 <= endNs)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        ClientStats total;
+        for (auto &worker : workers) total.merge(worker->snapshot());
+        const uint64_t now = now_ns();
+        const double dt = (now - lastNs) / 1e9;
+        printf("%5.1f s: %u connected, %.0f msg/s, %.2f MB/s, %.0f acks/s (p50 %.2f ms, p99 %.2f ms), %" PRIu64 " backpressure, %" PRIu64
+               " reconnects, %" PRIu64 " connect failures\n",
+               (now - startNs) / 1e9, total.connected, (total.messages - last.messages) / dt, (total.bytes - last.bytes) / dt / 1e6,
+               (total.acked - last.acked) / dt, total.ackLatency.percentile_ms(50), total.ackLatency.percentile_ms(99), total.backpressure,
+               total.disconnects + total.serverCloses, total.connectFailures);
+        last = total;
+        lastNs = now;
+    }
+    for (auto &t : threads) t.join();
+
+    ClientStats total;
+    for (auto &worker : workers) total.merge(worker->snapshot());
+    const double elapsed = (now_ns() - startNs) / 1e9;
+    printf("Generated %" PRIu64 " messages in %.1f s: %.0f msg/s of %.0f asked, %.2f MB/s, %" PRIu64 " writes (%" PRIu64 " partial pieces), %" PRIu64
+           " dropped at the device, %" PRIu64 " in open batches\n",
+           total.messages, elapsed, total.messages / elapsed, options.devices * options.rate, total.bytes / elapsed / 1e6, total.writes,
+           total.pieces, total.dropped, total.unsent);
+    printf("Connections: %" PRIu64 " opened, %" PRIu64 " failed, %" PRIu64 " closed by the devices, %" PRIu64 " by the server\n", total.connects,
+           total.connectFailures, total.disconnects, total.serverCloses);
+    printf("Acknowledged %" PRIu64 " batches, %" PRIu64 " never acknowledged\n", total.acked, total.unacked);
+    print_latency("Ack latency (batch queued to ack)", total.ackLatency);
+
+    if (server)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));  // Let the last bytes arrive
+        stopServer = true;
+        serverThread.join();
+        ServerStats s = server->snapshot();
+        printf("Receiver: %" PRIu64 " messages (%.2f%% of those sent), %" PRIu64 " bytes, %" PRIu64 " connections, %" PRIu64 " parse errors, %" PRIu64
+               " acks sent\n",
+               s.messages, 100.0 * s.messages / std::max<uint64_t>(1, total.messages - total.unsent), s.bytes, s.accepted, s.errors, s.acks);
+        print_latency("End to end latency (sample time to arrival)", s.latency);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,196 @@
+/**
+  @file mapgen.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Genera el mapa y las graficas de un registro de telemetria (reemplazo de graficas.py). La trayectoria
+  se simplifica con Douglas-Peucker y cada serie del IMU se reduce con LTTB a un numero fijo de puntos,
+  asi el tamaño del HTML no depende del largo del registro. El registro se lee en un solo recorrido
+  con memoria acotada.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "decimate.h"
+#include "telemetry_log.h"
+
+static const char *SERIES_NAMES[9] = {"Aceleración X", "Aceleración Y", "Aceleración Z", "Gyro X", "Gyro Y", "Gyro Z", "Magneto X", "Magneto Y", "Magneto Z"};
+
+/**
+ * @brief Agrega un arreglo JSON con los puntos de una serie: [[x,y],...].
+ */
+static void append_series(std::string &out, const std::vector<SeriesPoint> &series)
+{
+    char number[48];
+    out += '[';
+    for (size_t i = 0; i < series.size(); i++)
+    {
+        snprintf(number, sizeof(number), "%s[%.0f,%.4g]", i ? "," : "", series[i].x, series[i].y);
+        out += number;
+    }
+    out += ']';
+}
+
+/**
+ * @brief Arma el GeoJSON de la trayectoria simplificada.
+ */
+static std::string track_geojson(const std::vector<GeoPoint> &track)
+{
+    std::string out = "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"properties\":{\"name\":\"Trayectoria\"},\"geometry\":{\"type\":\"LineString\",\"coordinates\":[";
+    char number[64];
+    for (size_t i = 0; i < track.size(); i++)
+    {
+        snprintf(number, sizeof(number), "%s[%.6f,%.6f]", i ? "," : "", track[i].lon, track[i].lat); // GeoJSON is lon,lat
+        out += number;
+    }
+    out += "]}}]}";
+    return out;
+}
+
+static const char *HTML_HEAD = R"(<!DOCTYPE html>
+<html><head><meta charset="utf-8"><title>Telemetría Dron</title>
+<link rel="stylesheet" href="https://unpkg.com/leaflet@1.9.4/dist/leaflet.css"/>
+<script src="https://unpkg.com/leaflet@1.9.4/dist/leaflet.js"></script>
+<style>body{margin:0;font-family:sans-serif}#map{width:100%;height:50vh}.plots{display:flex}canvas{flex:1;width:33%;height:300px}</style>
+</head><body>
+<h1 style="text-align: center;">Telemetría Dron</h1>
+<div id="map"></div>
+<div class="plots"><canvas id="acc"></canvas><canvas id="gyro"></canvas><canvas id="mag"></canvas></div>
+<p id="info"></p>
+<script>
+)";
+
+static const char *HTML_SCRIPT = R"(
+var map = L.map('map');
+L.tileLayer('https://{s}.tile.openstreetmap.org/{z}/{x}/{y}.png', {attribution: '&copy; OpenStreetMap'}).addTo(map);
+var line = L.geoJSON(track, {style: {color: 'red', weight: 2}}).addTo(map);
+var coords = track.features[0].geometry.coordinates;
+if (coords.length) {
+  L.marker([coords[0][1], coords[0][0]]).bindPopup('Inicio').addTo(map);
+  L.marker([coords[coords.length - 1][1], coords[coords.length - 1][0]]).bindPopup('Fin').addTo(map);
+  map.fitBounds(line.getBounds());
+} else map.setView([0, 0], 2);
+function plot(id, title, names, data) {
+  var c = document.getElementById(id), w = c.width = c.clientWidth, h = c.height = c.clientHeight, g = c.getContext('2d');
+  var colors = ['#1f77b4', '#ff7f0e', '#2ca02c'], x0 = Infinity, x1 = -Infinity, y0 = Infinity, y1 = -Infinity;
+  data.forEach(function(s) { s.forEach(function(p) { x0 = Math.min(x0, p[0]); x1 = Math.max(x1, p[0]); y0 = Math.min(y0, p[1]); y1 = Math.max(y1, p[1]); }); });
+  if (x1 <= x0) x1 = x0 + 1; if (y1 <= y0) { y0 -= 1; y1 += 1; }
+  var m = 40, sx = (w - 2 * m) / (x1 - x0), sy = (h - 2 * m) / (y1 - y0);
+  g.font = '12px sans-serif'; g.fillText(title, w / 2 - 40, 16);
+  g.fillText(y1.toPrecision(3), 2, m); g.fillText(y0.toPrecision(3), 2, h - m); g.fillText('Índice', w / 2, h - 8);
+  g.strokeStyle = '#ccc'; g.strokeRect(m, m, w - 2 * m, h - 2 * m);
+  data.forEach(function(s, k) {
+    g.strokeStyle = g.fillStyle = colors[k]; g.beginPath();
+    s.forEach(function(p, i) { var X = m + (p[0] - x0) * sx, Y = h - m - (p[1] - y0) * sy; i ? g.lineTo(X, Y) : g.moveTo(X, Y); });
+    g.stroke(); g.fillText(names[k], m + 5 + 110 * k, h - m + 14);
+  });
+}
+plot('acc', 'Gráfica de la Aceleracion', names.slice(0, 3), series.slice(0, 3));
+plot('gyro', 'Gráfica del Giroscopio', names.slice(3, 6), series.slice(3, 6));
+plot('mag', 'Gráfica del Magnetometro', names.slice(6, 9), series.slice(6, 9));
+document.getElementById('info').textContent = info;
+</script></body></html>
+)";
+
+static bool write_file(const std::string &path, const std::string &content)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fwrite(content.data(), 1, content.size(), file) == content.size();
+    return fclose(file) == 0 && ok;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: mapgen [--tolerance meters] [--points n] [--out mapa.html] [--geojson track.geojson] datos.csv\n");
+}
+
+int main(int argc, char **argv)
+{
+    double tolerance = 1.0;
+    size_t budget = 1000;
+    std::string out = "mapa.html", geojsonPath;
+    const char *path = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) tolerance = atof(argv[++i]);
+        else if (strcmp(argv[i], "--points") == 0 && i + 1 < argc) budget = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) out = argv[++i];
+        else if (strcmp(argv[i], "--geojson") == 0 && i + 1 < argc) geojsonPath = argv[++i];
+        else if (argv[i][0] != '-') path = argv[i];
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (!path)
+    {
+        usage();
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // One pass over the log, memory bounded by the filters
+    TrackFilter filter(tolerance);
+    std::vector<SeriesReducer> reducers(9, SeriesReducer(budget * 8));
+    size_t rows = 0;
+    std::string error;
+    bool ok = scan_telemetry_csv(path, [&](const TelemetryRow &row) {
+        filter.add({row.lat, row.lon});
+        for (int i = 0; i < 3; i++)
+        {
+            reducers[i].add(rows, row.acc[i]);
+            reducers[3 + i].add(rows, row.gyro[i]);
+            reducers[6 + i].add(rows, row.mag[i]);
+        }
+        rows++;
+    }, error);
+    if (!ok)
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    auto scanned = std::chrono::steady_clock::now();
+
+    std::vector<GeoPoint> moving = filter.finish();
+    std::vector<GeoPoint> track;
+    for (size_t i : douglas_peucker(moving, tolerance)) track.push_back(moving[i]);
+
+    std::string geojson = track_geojson(track);
+    std::string html = HTML_HEAD;
+    html += "var track = " + geojson + ";\nvar names = [";
+    for (int i = 0; i < 9; i++) html += std::string(i ? "," : "") + "\"" + SERIES_NAMES[i] + "\"";
+    html += "];\nvar series = [";
+    size_t plotted = 0;
+    for (int i = 0; i < 9; i++)
+    {
+        std::vector<SeriesPoint> series = lttb(reducers[i].points(), budget);
+        plotted += series.size();
+        if (i) html += ',';
+        append_series(html, series);
+    }
+    char info[160];
+    snprintf(info, sizeof(info), "];\nvar info = '%zu filas, %zu puntos de trayectoria, tolerancia %.1f m';\n", rows, track.size(), tolerance);
+    html += info;
+    html += HTML_SCRIPT;
+
+    if (!write_file(out, html) || (!geojsonPath.empty() && !write_file(geojsonPath, geojson)))
+    {
+        fprintf(stderr, "cannot write the report\n");
+        return 1;
+    }
+    auto done = std::chrono::steady_clock::now();
+
+    printf("%zu rows, track %zu -> %zu -> %zu points, %zu series points\n", rows, rows, moving.size(), track.size(), plotted);
+    printf("read %.1f ms, report %.1f ms, %s %zu bytes\n",
+           std::chrono::duration<double, std::milli>(scanned - start).count(),
+           std::chrono::duration<double, std::milli>(done - scanned).count(), out.c_str(), html.size());
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,316 @@
+/**
+  @file navcheck.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Valida en el PC la navegacion GPS/IMU del firmware (nav_ekf.c compilado para el PC). Con un vuelo
+  sintetico compara la posicion del filtro contra la verdad y contra repetir el ultimo fix del GPS,
+  tambien durante un corte del GPS. Con grabaciones reales (capturas binarias de usbStream o registros
+  CSV) esconde algunos fixes al filtro y mide que tan cerca los predice.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "telemetry_log.h"
+extern "C" {
+    #include "nav_ekf.h"
+    #include "telemetry_frame.h"
+}
+
+static const double METERS_PER_DEGREE = 111195.0;  // Same sphere as nav_ekf.c
+static const double DEG = M_PI / 180;
+
+/**
+ * @brief Lectura de una grabacion: del IMU (en unidades fisicas) o un fix del GPS.
+ */
+struct Event
+{
+    uint64_t t_us;
+    bool gps;
+    float acc[3], gyro[3], mag[3];
+    float lat, lon;
+};
+
+/**
+ * @brief Error cuadratico medio y maximo de una serie.
+ */
+struct ErrorStat
+{
+    double sumSq = 0, max = 0;
+    uint64_t n = 0;
+
+    void add(double e)
+    {
+        sumSq += e * e;
+        if (e > max) max = e;
+        n++;
+    }
+    double rms() const { return n ? sqrt(sumSq / n) : 0; }
+};
+
+static double distance_m(double lat1, double lon1, double lat2, double lon2)
+{
+    double dn = (lat2 - lat1) * METERS_PER_DEGREE, de = (lon2 - lon1) * METERS_PER_DEGREE * cos((lat1 + lat2) / 2 * DEG);
+    return sqrt(dn * dn + de * de);
+}
+
+/**
+ * @brief Vuelo sintetico: rumbo y velocidad variables, cuerpo nivelado con x hacia adelante.
+ *
+ * El IMU lleva ruido y sesgos, el GPS ruido de gps_noise metros a 1 Hz, y entre outageStart y
+ * outageEnd no hay fixes. Se compara cada 0.1 s.
+ */
+static int synthetic(const nav_config_t &config, double seconds, double imuHz, double gpsNoise, double outageStart, double outageEnd)
+{
+    std::mt19937 rng(2023);
+    std::normal_distribution<double> gauss(0, 1);
+    const double g = 9.80665, inclination = 30 * DEG, lat0 = 6.2442, lon0 = -75.5812;
+    const double mPerDegLon = METERS_PER_DEGREE * cos(lat0 * DEG);
+    double accBias[3], gyroBias[3];
+    for (int i = 0; i < 3; i++)
+    {
+        accBias[i] = 0.01 * gauss(rng);   // g
+        gyroBias[i] = 0.5 * gauss(rng);   // deg/s
+    }
+
+    nav_ekf_t nav;
+    nav_ekf_init(&nav, &config);
+    ErrorStat ekf, hold, outageEkf, outageHold, speed;
+    double north = 0, east = 0, heading = 0.3, v = 12;
+    double lastFixN = 0, lastFixE = 0;
+    bool haveFix = false;
+    const double dt = 1 / imuHz;
+    const uint64_t steps = seconds * imuHz, evalEvery = std::max<uint64_t>(1, imuHz / 10), gpsEvery = imuHz;
+    double busy = 0;
+
+    for (uint64_t k = 0; k < steps; k++)
+    {
+        const double t = k * dt;
+        const double headingRate = 0.05 * sin(0.03 * t), accel = 0.12 * cos(0.02 * t);  // rad/s, m/s^2
+        const double aN = accel * cos(heading) - v * headingRate * sin(heading);
+        const double aE = accel * sin(heading) + v * headingRate * cos(heading);
+
+        // Body x forward, z up; North-West-Up yaw is minus the heading
+        const double c = cos(heading), s = sin(heading);
+        const double fN = aN / g, fW = -aE / g, fU = 1;
+        float acc[3], gyro[3], mag[3];
+        double fx = c * fN - s * fW, fy = s * fN + c * fW;
+        double mx = c * cos(inclination), my = s * cos(inclination), mz = -sin(inclination);
+        double body[3] = {fx, fy, fU}, field[3] = {mx, my, mz};
+        for (int i = 0; i < 3; i++)
+        {
+            acc[i] = body[i] + accBias[i] + 0.02 * gauss(rng);
+            gyro[i] = (i == 2 ? -headingRate / DEG : 0) + gyroBias[i] + 0.1 * gauss(rng);
+            mag[i] = field[i] + 0.02 * gauss(rng);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        nav_ekf_predict(&nav, acc, gyro, mag, k ? dt : 0);
+        busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Truth moves to the end of the step
+        north += v * cos(heading) * dt + 0.5 * aN * dt * dt;
+        east += v * sin(heading) * dt + 0.5 * aE * dt * dt;
+        v += accel * dt;
+        heading += headingRate * dt;
+
+        const bool inOutage = t >= outageStart && t < outageEnd;
+        if (k % gpsEvery == gpsEvery - 1 && !inOutage)
+        {
+            double fixN = north + gpsNoise * gauss(rng), fixE = east + gpsNoise * gauss(rng);
+            nav_ekf_update_gps(&nav, lat0 + fixN / METERS_PER_DEGREE, lon0 + fixE / mPerDegLon);
+            lastFixN = fixN;
+            lastFixE = fixE;
+            haveFix = true;
+        }
+
+        if (haveFix && k % evalEvery == 0 && t > 10)  // Skip the first seconds while the filter converges
+        {
+            nav_output_t out;
+            nav_ekf_output(&nav, &out);
+            // The filter's origin is its first fix, not the origin of the flight
+            const double n = out.north + (nav.lat0 - lat0) * METERS_PER_DEGREE, en = out.east + (nav.lon0 - lon0) * mPerDegLon;
+            double e = hypot(n - north, en - east), h = hypot(lastFixN - north, lastFixE - east);
+            (inOutage ? outageEkf : ekf).add(e);
+            (inOutage ? outageHold : hold).add(h);
+            speed.add(hypot(out.vel_n - v * cos(heading), out.vel_e - v * sin(heading)));
+        }
+    }
+
+    printf("Synthetic flight: %.0f s, IMU %.0f Hz, GPS 1 Hz with %.1f m noise, %" PRIu32 " fixes (%" PRIu32 " rejected)\n", seconds, imuHz,
+           gpsNoise, nav.fixes, nav.rejected);
+    printf("  position error at 10 Hz, rms / max: filter %.2f / %.2f m, last GPS fix %.2f / %.2f m\n", ekf.rms(), ekf.max, hold.rms(), hold.max);
+    printf("  speed error rms %.2f m/s\n", speed.rms());
+    if (outageEnd > outageStart)
+        printf("  GPS outage %.0f-%.0f s, rms / max: filter %.2f / %.2f m, last GPS fix %.2f / %.2f m\n", outageStart, outageEnd, outageEkf.rms(),
+               outageEkf.max, outageHold.rms(), outageHold.max);
+    printf("  %.0f ns per IMU step on this PC (budget on the RP2040: %d us)\n", busy / steps * 1e9, NAV_STEP_BUDGET_US);
+    return ekf.rms() < hold.rms() ? 0 : 1;
+}
+
+/**
+ * @brief Lee una captura binaria de usbStream (cuentas crudas con las escalas de telemetria.c).
+ */
+static bool read_capture(const char *path, std::vector<Event> &events)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    size_t offset = 0, used;
+    telemetry_frame_t frame;
+    while (offset < data.size())
+    {
+        int result = telemetry_frame_decode(data.data() + offset, data.size() - offset, &frame, &used);
+        if (result == 0) break;
+        offset += used;
+        if (result < 0) continue;
+
+        Event e = {};
+        e.t_us = frame.t_us;
+        e.gps = frame.type == TELEMETRY_FRAME_GPS;
+        if (e.gps)
+        {
+            e.lat = frame.gps.lat_e7 * 1e-7;
+            e.lon = frame.gps.lon_e7 * 1e-7;
+            if (frame.gps.lat_e7 == 0 && frame.gps.lon_e7 == 0) continue;  // No fix yet
+        }
+        else
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                e.acc[i] = frame.imu.acc[i] / 32768.0f * ACC_FULL_SCALE;
+                e.gyro[i] = frame.imu.gyro[i] / 32768.0f * GYRO_FULL_SCALE;
+                e.mag[i] = frame.imu.mag[i] / 32768.0f * MAG_FULL_SCALE;
+            }
+        }
+        events.push_back(e);
+    }
+    return true;
+}
+
+/**
+ * @brief Lee un registro CSV: cada fila es una lectura del IMU seguida de su fix.
+ */
+static bool read_log(const char *path, std::vector<Event> &events, std::string &error)
+{
+    uint64_t index = 0;
+    return scan_telemetry_csv(path, [&](const TelemetryRow &row) {
+        Event e = {};
+        e.t_us = row.timed ? row.t_us : index * 1000000;
+        memcpy(e.acc, row.acc, sizeof(e.acc));
+        memcpy(e.gyro, row.gyro, sizeof(e.gyro));
+        memcpy(e.mag, row.mag, sizeof(e.mag));
+        events.push_back(e);
+        if (row.lat != 0 || row.lon != 0)
+        {
+            e.gps = true;
+            e.lat = row.lat;
+            e.lon = row.lon;
+            events.push_back(e);
+        }
+        index++;
+    }, error);
+}
+
+/**
+ * @brief Pasa una grabacion por el filtro escondiendo uno de cada holdout fixes y mide el error en esos.
+ */
+static int recorded(const nav_config_t &config, const std::vector<Event> &events, uint32_t holdout)
+{
+    nav_ekf_t nav;
+    nav_ekf_init(&nav, &config);
+    ErrorStat ekf, hold;
+    uint64_t lastImu = 0, imuSteps = 0, fixes = 0;
+    float lastLat = 0, lastLon = 0;
+    bool haveFix = false;
+
+    for (const Event &e : events)
+    {
+        if (!e.gps)
+        {
+            nav_ekf_predict(&nav, e.acc, e.gyro, e.mag, lastImu ? (e.t_us - lastImu) / 1e6f : 0);
+            lastImu = e.t_us;
+            imuSteps++;
+            continue;
+        }
+        if (haveFix && holdout > 1 && fixes++ % holdout == holdout - 1)
+        {
+            nav_output_t out;
+            nav_ekf_output(&nav, &out);
+            ekf.add(distance_m(out.lat, out.lon, e.lat, e.lon));
+            hold.add(distance_m(lastLat, lastLon, e.lat, e.lon));
+            continue;
+        }
+        nav_ekf_update_gps(&nav, e.lat, e.lon);
+        lastLat = e.lat;
+        lastLon = e.lon;
+        haveFix = true;
+    }
+
+    printf("Recording: %" PRIu64 " IMU readings, %" PRIu32 " fixes used (%" PRIu32 " rejected), %" PRIu64 " hidden\n", imuSteps, nav.fixes,
+           nav.rejected, ekf.n);
+    if (ekf.n)
+        printf("  hidden fix error, rms / max: filter %.2f / %.2f m, last GPS fix %.2f / %.2f m\n", ekf.rms(), ekf.max, hold.rms(), hold.max);
+    return 0;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: navcheck [--seconds s] [--imu-hz n] [--gps-noise m] [--outage start:end]\n"
+                    "       navcheck (--capture usbstream.bin | --csv datos.csv) [--holdout n]\n"
+                    "       filter: [--accel-noise a] [--bias-noise b] [--gps-sigma m] [--kp k]\n");
+}
+
+int main(int argc, char **argv)
+{
+    nav_config_t config;
+    nav_config_defaults(&config);
+    double seconds = 600, imuHz = 100, gpsNoise = 2.5, outageStart = 300, outageEnd = 310;
+    const char *capture = nullptr, *csv = nullptr;
+    uint32_t holdout = 2;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--imu-hz") == 0 && i + 1 < argc) imuHz = atof(argv[++i]);
+        else if (strcmp(argv[i], "--gps-noise") == 0 && i + 1 < argc) gpsNoise = atof(argv[++i]);
+        else if (strcmp(argv[i], "--outage") == 0 && i + 1 < argc) sscanf(argv[++i], "%lf:%lf", &outageStart, &outageEnd);
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) capture = argv[++i];
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) csv = argv[++i];
+        else if (strcmp(argv[i], "--holdout") == 0 && i + 1 < argc) holdout = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--accel-noise") == 0 && i + 1 < argc) config.accel_noise = atof(argv[++i]);
+        else if (strcmp(argv[i], "--bias-noise") == 0 && i + 1 < argc) config.bias_noise = atof(argv[++i]);
+        else if (strcmp(argv[i], "--gps-sigma") == 0 && i + 1 < argc) config.gps_noise_m = atof(argv[++i]);
+        else if (strcmp(argv[i], "--kp") == 0 && i + 1 < argc) config.attitude_kp = atof(argv[++i]);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (!capture && !csv) return synthetic(config, seconds, imuHz, gpsNoise, outageStart, outageEnd);
+
+    std::vector<Event> events;
+    std::string error;
+    if (capture && !read_capture(capture, events))
+    {
+        fprintf(stderr, "cannot open %s\n", capture);
+        return 1;
+    }
+    if (csv && !read_log(csv, events, error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return recorded(config, events, holdout);
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include "pico/stdlib.h"
+
+#ifndef pico_stub_dma_h
+#define pico_stub_dma_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct { uint32_t ctrl; } dma_channel_config;
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(unsigned channel);
+dma_channel_config dma_channel_get_default_config(unsigned channel);
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size);
+void channel_config_set_dreq(dma_channel_config *c, unsigned dreq);
+void channel_config_set_read_increment(dma_channel_config *c, bool incr);
+void channel_config_set_write_increment(dma_channel_config *c, bool incr);
+void dma_channel_configure(unsigned channel, const dma_channel_config *config, volatile void *write_addr, const volatile void *read_addr, unsigned count, bool trigger);
+void dma_start_channel_mask(uint32_t mask);
+void dma_channel_wait_for_finish_blocking(unsigned channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
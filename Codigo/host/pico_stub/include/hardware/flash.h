@@ -0,0 +1,26 @@
+#include "pico/stdlib.h"
+
+#ifndef pico_stub_flash_h
+#define pico_stub_flash_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLASH_SECTOR_SIZE 4096u
+#define FLASH_PAGE_SIZE 256u
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES (2u * 1024u * 1024u)
+#endif
+
+extern uint8_t stub_flash[PICO_FLASH_SIZE_BYTES];
+#define XIP_BASE ((uintptr_t)stub_flash) // Flash reads go to the RAM image
+
+void flash_range_erase(uint32_t offset, size_t count);
+void flash_range_program(uint32_t offset, const uint8_t *data, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,23 @@
+#include "pico/stdlib.h"
+
+#ifndef pico_stub_spi_h
+#define pico_stub_spi_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct { volatile uint32_t dr; } spi_hw_t;
+
+unsigned spi_init(spi_inst_t *spi, unsigned baudrate);
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len);
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len);
+unsigned spi_get_dreq(spi_inst_t *spi, bool is_tx);
+spi_hw_t *spi_get_hw(spi_inst_t *spi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,17 @@
+#include "pico/stdlib.h"
+
+#ifndef pico_stub_sync_h
+#define pico_stub_sync_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
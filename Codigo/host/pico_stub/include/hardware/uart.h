@@ -0,0 +1,25 @@
+#include "pico/stdlib.h"
+
+#ifndef pico_stub_uart_h
+#define pico_stub_uart_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UART_PARITY_NONE 0
+
+unsigned uart_init(uart_inst_t *uart, unsigned baudrate);
+void uart_set_translate_crlf(uart_inst_t *uart, bool translate);
+char uart_getc(uart_inst_t *uart);
+void uart_putc(uart_inst_t *uart, char c);
+void uart_putc_raw(uart_inst_t *uart, char c);
+void uart_puts(uart_inst_t *uart, const char *s);
+bool uart_is_readable(uart_inst_t *uart);
+bool uart_is_readable_within_us(uart_inst_t *uart, uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,58 @@
+/**
+  @file stdlib.h
+  @brief Sustituto de pico/stdlib.h para compilar el firmware en el PC.
+  Solo declara lo que usan los modulos del proyecto. El tiempo es virtual: sleep_* lo adelanta sin esperar.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#ifndef pico_stub_stdlib_h
+#define pico_stub_stdlib_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint64_t absolute_time_t;
+typedef struct spi_inst { int index; } spi_inst_t;
+typedef struct uart_inst { int index; } uart_inst_t;
+
+extern spi_inst_t stub_spi[2];
+extern uart_inst_t stub_uart[2];
+#define spi0 (&stub_spi[0])
+#define spi1 (&stub_spi[1])
+#define uart0 (&stub_uart[0])
+#define uart1 (&stub_uart[1])
+
+#define PICO_ERROR_TIMEOUT (-1)
+#define GPIO_OUT 1
+#define GPIO_IN 0
+#define GPIO_FUNC_SPI 1
+#define GPIO_FUNC_UART 2
+
+void gpio_init(unsigned gpio);
+void gpio_set_dir(unsigned gpio, bool out);
+void gpio_put(unsigned gpio, bool value);
+void gpio_set_function(unsigned gpio, int fn);
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+absolute_time_t get_absolute_time(void);
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+void sleep_until(absolute_time_t t);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+void tight_loop_contents(void);
+
+bool stdio_init_all(void);
+int getchar_timeout_us(uint32_t timeout_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,20 @@
+#include "pico/stdlib.h"
+
+#ifndef pico_stub_h
+#define pico_stub_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void stub_time_set(uint64_t us);
+void stub_time_advance(uint64_t us);
+void stub_uart_feed(uart_inst_t *uart, const char *data, size_t len);
+bool stub_uart_drained(uart_inst_t *uart);
+void stub_spi_set_registers(spi_inst_t *spi, const uint8_t regs[128]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
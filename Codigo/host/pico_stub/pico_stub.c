@@ -0,0 +1,180 @@
+/**
+  @file pico_stub.c
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Implementacion en el PC de las funciones del SDK que usa el firmware. El reloj es virtual, los UART
+  leen de un bufer que llena la herramienta, el SPI responde con una imagen de los registros del
+  MPU9250 y la flash es un arreglo en RAM.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/uart.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "pico_stub.h"
+
+spi_inst_t stub_spi[2] = {{0}, {1}};
+uart_inst_t stub_uart[2] = {{0}, {1}};
+uint8_t stub_flash[PICO_FLASH_SIZE_BYTES];
+
+static uint64_t now_us = 0;
+
+typedef struct {
+    char *data;
+    size_t length, position, capacity;
+} uart_buffer_t;
+
+static uart_buffer_t uart_rx[2];
+
+typedef struct {
+    uint8_t regs[128];
+    int address;      // Register of the next byte, -1 before the address byte
+    bool reading;
+} spi_device_t;
+
+static spi_device_t spi_dev[2];
+static spi_hw_t spi_hw[2];
+
+void stub_time_set(uint64_t us) { now_us = us; }
+void stub_time_advance(uint64_t us) { now_us += us; }
+
+uint64_t time_us_64(void) { return now_us; }
+uint32_t time_us_32(void) { return (uint32_t)now_us; }
+absolute_time_t get_absolute_time(void) { return now_us; }
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) { return t + us; }
+absolute_time_t make_timeout_time_ms(uint32_t ms) { return now_us + ms * 1000ull; }
+void sleep_until(absolute_time_t t) { if (t > now_us) now_us = t; }
+void sleep_us(uint64_t us) { now_us += us; }
+void sleep_ms(uint32_t ms) { now_us += ms * 1000ull; }
+void tight_loop_contents(void) {}
+
+bool stdio_init_all(void) { return true; }
+int getchar_timeout_us(uint32_t timeout_us) { now_us += timeout_us; return PICO_ERROR_TIMEOUT; }
+
+/**
+ * @brief Un pin en bajo abre una transaccion SPI (seleccion de chip) y en alto la cierra.
+ */
+void gpio_put(unsigned gpio, bool value)
+{
+    (void)gpio;
+    for (int i = 0; i < 2; i++) {
+        spi_dev[i].address = -1;
+        spi_dev[i].reading = false;
+    }
+    (void)value;
+}
+void gpio_init(unsigned gpio) { (void)gpio; }
+void gpio_set_dir(unsigned gpio, bool out) { (void)gpio; (void)out; }
+void gpio_set_function(unsigned gpio, int fn) { (void)gpio; (void)fn; }
+
+void stub_spi_set_registers(spi_inst_t *spi, const uint8_t regs[128])
+{
+    memcpy(spi_dev[spi->index].regs, regs, 128);
+}
+
+/**
+ * @brief Intercambia un byte con el MPU9250 simulado.
+ */
+static uint8_t spi_transfer(spi_inst_t *spi, uint8_t out)
+{
+    spi_device_t *dev = &spi_dev[spi->index];
+    if (dev->address < 0) { // First byte of the transaction: register and read bit
+        dev->address = out & 0x7F;
+        dev->reading = (out & 0x80) != 0;
+        return 0;
+    }
+    uint8_t in = dev->reading ? dev->regs[dev->address & 0x7F] : 0;
+    dev->address++;
+    return in;
+}
+
+unsigned spi_init(spi_inst_t *spi, unsigned baudrate) { (void)spi; return baudrate; }
+
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len)
+{
+    for (size_t i = 0; i < len; i++) spi_transfer(spi, src[i]);
+    return (int)len;
+}
+
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len)
+{
+    for (size_t i = 0; i < len; i++) dst[i] = spi_transfer(spi, repeated_tx_data);
+    return (int)len;
+}
+
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len)
+{
+    for (size_t i = 0; i < len; i++) dst[i] = spi_transfer(spi, src[i]);
+    return (int)len;
+}
+
+unsigned spi_get_dreq(spi_inst_t *spi, bool is_tx) { return spi->index * 2 + !is_tx; }
+spi_hw_t *spi_get_hw(spi_inst_t *spi) { return &spi_hw[spi->index]; }
+
+// There is no DMA on the host: the driver falls back to blocking transfers
+int dma_claim_unused_channel(bool required) { (void)required; return -1; }
+void dma_channel_unclaim(unsigned channel) { (void)channel; }
+dma_channel_config dma_channel_get_default_config(unsigned channel) { dma_channel_config c = {channel}; return c; }
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) { (void)c; (void)size; }
+void channel_config_set_dreq(dma_channel_config *c, unsigned dreq) { (void)c; (void)dreq; }
+void channel_config_set_read_increment(dma_channel_config *c, bool incr) { (void)c; (void)incr; }
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) { (void)c; (void)incr; }
+void dma_channel_configure(unsigned channel, const dma_channel_config *config, volatile void *write_addr, const volatile void *read_addr, unsigned count, bool trigger)
+{
+    (void)channel; (void)config; (void)write_addr; (void)read_addr; (void)count; (void)trigger;
+}
+void dma_start_channel_mask(uint32_t mask) { (void)mask; }
+void dma_channel_wait_for_finish_blocking(unsigned channel) { (void)channel; }
+
+/**
+ * @brief Agrega bytes a la entrada de un UART simulado.
+ */
+void stub_uart_feed(uart_inst_t *uart, const char *data, size_t len)
+{
+    uart_buffer_t *b = &uart_rx[uart->index];
+    if (b->position == b->length) b->position = b->length = 0;
+    if (b->length + len > b->capacity) {
+        b->capacity = (b->length + len) * 2;
+        b->data = realloc(b->data, b->capacity);
+    }
+    memcpy(b->data + b->length, data, len);
+    b->length += len;
+}
+
+bool stub_uart_drained(uart_inst_t *uart)
+{
+    uart_buffer_t *b = &uart_rx[uart->index];
+    return b->position >= b->length;
+}
+
+unsigned uart_init(uart_inst_t *uart, unsigned baudrate) { (void)uart; return baudrate; }
+void uart_set_translate_crlf(uart_inst_t *uart, bool translate) { (void)uart; (void)translate; }
+
+/**
+ * @brief Lee un caracter del UART simulado.
+ *
+ * En el equipo uart_getc espera a que llegue un byte; aqui, sin datos, devuelve un fin de linea para
+ * que uart_read_line termine.
+ */
+char uart_getc(uart_inst_t *uart)
+{
+    uart_buffer_t *b = &uart_rx[uart->index];
+    return b->position < b->length ? b->data[b->position++] : '\n';
+}
+
+bool uart_is_readable(uart_inst_t *uart) { return !stub_uart_drained(uart); }
+bool uart_is_readable_within_us(uart_inst_t *uart, uint32_t us) { if (stub_uart_drained(uart)) now_us += us; return !stub_uart_drained(uart); }
+void uart_putc(uart_inst_t *uart, char c) { (void)uart; (void)c; }
+void uart_putc_raw(uart_inst_t *uart, char c) { (void)uart; (void)c; }
+void uart_puts(uart_inst_t *uart, const char *s) { (void)uart; (void)s; }
+
+void flash_range_erase(uint32_t offset, size_t count) { memset(stub_flash + offset, 0xFF, count); }
+void flash_range_program(uint32_t offset, const uint8_t *data, size_t count) { memcpy(stub_flash + offset, data, count); }
+uint32_t save_and_disable_interrupts(void) { return 0; }
+void restore_interrupts(uint32_t status) { (void)status; }
\ No newline at end of file
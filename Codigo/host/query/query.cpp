@@ -0,0 +1,346 @@
+/**
+  @file query.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Consultas sobre los registros de telemetria sin recargar el CSV completo: convierte un registro en un
+  almacen indexado (.tlm) y responde rangos de hora, cajas, radios alrededor de un punto y agregados por
+  ventana (min/max/media/RMS de acc y gyro), indicando cuantos bloques leyo y cuanto tardo.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <random>
+#include <string>
+#include "telemetry_log.h"
+#include "telemetry_store.h"
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: query ingest <log.csv> <out.tlm> [--period-ms n] [--start utc_us]\n"
+            "       query synth <out.tlm> [--rows n] [--rate-hz n]\n"
+            "       query info <store.tlm>\n"
+            "       query time <store.tlm> <from> <to> [--count]\n"
+            "       query bbox <store.tlm> <lat_min> <lat_max> <lon_min> <lon_max> [--count]\n"
+            "       query radius <store.tlm> <lat> <lon> <meters> [--count]\n"
+            "       query agg <store.tlm> <from> <to> <window_s>\n"
+            "--verify repeats the query as a full scan and compares the results\n"
+            "times: microseconds since 1970, 2023-05-08T14:02:00[.5] or 14:02[:00] on the day the log starts (UTC)\n");
+}
+
+/**
+ * @brief Lee una hora de la linea de comandos.
+ *
+ * @param text microsegundos, fecha y hora ISO o solo la hora (del dia en que empieza el registro).
+ * @param dayStart primer microsegundo del dia en que empieza el registro.
+ * @param out hora en microsegundos.
+ * @return bool retorna false si el texto no es una hora.
+ */
+static bool parse_time(const char *text, int64_t dayStart, int64_t &out)
+{
+    int y, mo, d, h, mi;
+    double s = 0;
+    char *end;
+    long long us = strtoll(text, &end, 10);
+    if (*end == '\0' && end != text)
+    {
+        out = us;
+        return true;
+    }
+    if (sscanf(text, "%d-%d-%dT%d:%d:%lf", &y, &mo, &d, &h, &mi, &s) >= 5)
+    {
+        tm t = {};
+        t.tm_year = y - 1900;
+        t.tm_mon = mo - 1;
+        t.tm_mday = d;
+        t.tm_hour = h;
+        t.tm_min = mi;
+        out = (int64_t)timegm(&t) * 1000000 + llround(s * 1e6);
+        return true;
+    }
+    if (sscanf(text, "%d:%d:%lf", &h, &mi, &s) >= 2)
+    {
+        out = dayStart + ((int64_t)h * 3600 + mi * 60) * 1000000 + llround(s * 1e6);
+        return true;
+    }
+    return false;
+}
+
+static void print_row(const StoreRow &r)
+{
+    printf("%" PRId64 ",%.6f,%.6f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%" PRIu32 "\n", r.t_us, r.lat, r.lon, r.acc[0], r.acc[1],
+           r.acc[2], r.gyro[0], r.gyro[1], r.gyro[2], r.mag[0], r.mag[1], r.mag[2], r.seq);
+}
+
+/**
+ * @brief Convierte un registro CSV en un almacen.
+ *
+ * Las filas con hora usan utc_us (o t_us si no habia hora del GPS); las filas viejas sin hora se
+ * numeran desde start cada period_ms, como las enviaba el firmware.
+ */
+static int ingest(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        usage();
+        return 1;
+    }
+    int64_t periodUs = 1000000, start = 0;
+    for (int i = 4; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--period-ms") == 0 && i + 1 < argc) periodUs = atoll(argv[++i]) * 1000;
+        else if (strcmp(argv[i], "--start") == 0 && i + 1 < argc) start = atoll(argv[++i]);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    std::string error;
+    StoreWriter writer;
+    if (!writer.open(argv[3], error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    uint64_t index = 0;
+    auto begin = std::chrono::steady_clock::now();
+    bool ok = scan_telemetry_csv(argv[2], [&](const TelemetryRow &row) {
+        StoreRow r;
+        r.t_us = row.timed ? (row.utc_us ? row.utc_us : (int64_t)row.t_us) : start + (int64_t)index * periodUs;
+        r.lat = row.lat;
+        r.lon = row.lon;
+        memcpy(r.acc, row.acc, sizeof(r.acc));
+        memcpy(r.gyro, row.gyro, sizeof(r.gyro));
+        memcpy(r.mag, row.mag, sizeof(r.mag));
+        r.seq = row.timed ? row.seq : index;
+        writer.add(r);
+        index++;
+    }, error);
+    if (!ok || !writer.close(error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    printf("Ingested %" PRIu64 " rows in %.2f s\n", writer.rows(), seconds);
+    return 0;
+}
+
+/**
+ * @brief Genera un almacen grande con un vuelo sintetico (paseo aleatorio alrededor de Medellin) para
+ * medir las consultas sin necesitar registros reales de ese tamaño.
+ */
+static int synth(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        usage();
+        return 1;
+    }
+    uint64_t rows = 10000000;
+    int64_t rate = 100;
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) rows = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--rate-hz") == 0 && i + 1 < argc) rate = atoll(argv[++i]);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    std::string error;
+    StoreWriter writer;
+    if (!writer.open(argv[2], error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    std::mt19937 rng(2023);
+    std::normal_distribution<float> noise(0, 1);
+    double lat = 6.2442, lon = -75.5812, heading = 0;
+    const int64_t start = 1683547200000000;
+    for (uint64_t i = 0; i < rows; i++)
+    {
+        heading += noise(rng) * 0.01;
+        lat += cos(heading) * 5e-6 * 100 / rate;  // About 0.5 m per 1/100 s, 50 m/s
+        lon += sin(heading) * 5e-6 * 100 / rate;
+        StoreRow r;
+        r.t_us = start + (int64_t)i * 1000000 / rate;
+        r.lat = lat;
+        r.lon = lon;
+        for (int k = 0; k < 3; k++)
+        {
+            r.acc[k] = (k == 2 ? 1.0f : 0.0f) + noise(rng) * 0.05f;
+            r.gyro[k] = noise(rng) * 2;
+            r.mag[k] = 30 + noise(rng);
+        }
+        r.seq = i;
+        writer.add(r);
+    }
+    if (!writer.close(error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    printf("Wrote %" PRIu64 " rows\n", rows);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        usage();
+        return 1;
+    }
+    const std::string command = argv[1];
+    if (command == "ingest") return ingest(argc, argv);
+    if (command == "synth") return synth(argc, argv);
+
+    std::string error;
+    StoreReader store;
+    if (!store.open(argv[2], error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const std::vector<BlockInfo> &blocks = store.block_index();
+    const int64_t first = blocks.empty() ? 0 : blocks.front().tMin;
+    const int64_t dayStart = first - ((first % 86400000000ll) + 86400000000ll) % 86400000000ll;
+
+    bool countOnly = false, verify = false;
+    std::vector<const char *> args;
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--count") == 0) countOnly = true;
+        else if (strcmp(argv[i], "--verify") == 0) verify = true;
+        else args.push_back(argv[i]);
+    }
+
+    uint64_t matched = 0;
+    auto onRow = [&](const StoreRow &r) {
+        matched++;
+        if (!countOnly) print_row(r);
+    };
+    std::function<bool(const StoreRow &)> predicate;  // Same selection, for --verify
+    std::vector<WindowStats> windows;
+    int64_t from = 0, to = 0, window = 0;
+    auto begin = std::chrono::steady_clock::now();
+
+    if (command == "info" && args.empty())
+    {
+        int64_t last = INT64_MIN;
+        for (const BlockInfo &b : blocks) last = std::max(last, b.tMax);
+        printf("%" PRIu64 " rows in %zu blocks, from %" PRId64 " to %" PRId64 " us\n", store.rows(), blocks.size(), first, last);
+        return 0;
+    }
+    else if (command == "time" && args.size() == 2)
+    {
+        if (!parse_time(args[0], dayStart, from) || !parse_time(args[1], dayStart, to))
+        {
+            usage();
+            return 1;
+        }
+        store.query_time(from, to, onRow);
+        predicate = [=](const StoreRow &r) { return r.t_us >= from && r.t_us < to; };
+    }
+    else if (command == "bbox" && args.size() == 4)
+    {
+        double latMin = atof(args[0]), latMax = atof(args[1]), lonMin = atof(args[2]), lonMax = atof(args[3]);
+        store.query_bbox(latMin, latMax, lonMin, lonMax, onRow);
+        predicate = [=](const StoreRow &r) { return r.lat >= latMin && r.lat <= latMax && r.lon >= lonMin && r.lon <= lonMax; };
+    }
+    else if (command == "radius" && args.size() == 3)
+    {
+        double lat = atof(args[0]), lon = atof(args[1]), meters = atof(args[2]);
+        store.query_radius(lat, lon, meters, onRow);
+        predicate = [=](const StoreRow &r) { return store_distance_m(lat, lon, r.lat, r.lon) <= meters; };
+    }
+    else if (command == "agg" && args.size() == 3)
+    {
+        if (!parse_time(args[0], dayStart, from) || !parse_time(args[1], dayStart, to))
+        {
+            usage();
+            return 1;
+        }
+        window = llround(atof(args[2]) * 1e6);
+        windows = store.aggregate(from, to, window);
+        printf("start_us,count,accx_min,accx_max,accx_mean,accx_rms,accy_min,accy_max,accy_mean,accy_rms,accz_min,accz_max,accz_mean,accz_rms,"
+               "gyrox_min,gyrox_max,gyrox_mean,gyrox_rms,gyroy_min,gyroy_max,gyroy_mean,gyroy_rms,gyroz_min,gyroz_max,gyroz_mean,gyroz_rms\n");
+        for (const WindowStats &w : windows)
+        {
+            printf("%" PRId64 ",%" PRIu64, w.start, w.count);
+            for (int k = 0; k < 6; k++)
+            {
+                const AxisStats &a = k < 3 ? w.acc[k] : w.gyro[k - 3];
+                if (w.count == 0) printf(",,,,");
+                else printf(",%.4f,%.4f,%.4f,%.4f", a.min, a.max, a.sum / w.count, sqrt(a.sumSq / w.count));
+            }
+            printf("\n");
+            matched += w.count;
+        }
+    }
+    else
+    {
+        usage();
+        return 1;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    fprintf(stderr, "%" PRIu64 " rows, read %" PRIu64 " of %zu blocks in %.2f ms\n", matched, store.blocks_read(), blocks.size(), ms);
+    if (!verify) return 0;
+
+    // Full scan: every row goes through the same test, no index involved
+    uint64_t expected = 0, mismatches = 0;
+    std::vector<WindowStats> scanned(windows.size());
+    for (WindowStats &w : scanned)
+    {
+        w.count = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            w.acc[k].reset();
+            w.gyro[k].reset();
+        }
+    }
+    store.query_time(INT64_MIN, INT64_MAX, [&](const StoreRow &r) {
+        if (predicate && predicate(r)) expected++;
+        if (window > 0 && r.t_us >= from && r.t_us < to)
+        {
+            WindowStats &w = scanned[(r.t_us - from) / window];
+            w.count++;
+            for (int k = 0; k < 3; k++)
+            {
+                w.acc[k].add(r.acc[k]);
+                w.gyro[k].add(r.gyro[k]);
+            }
+        }
+    });
+    for (size_t i = 0; i < windows.size(); i++)
+    {
+        expected += scanned[i].count;
+        for (int k = 0; k < 6; k++)
+        {
+            const AxisStats &a = k < 3 ? windows[i].acc[k] : windows[i].gyro[k - 3], &b = k < 3 ? scanned[i].acc[k] : scanned[i].gyro[k - 3];
+            // The sums are added in another order, so they only agree to rounding
+            if (windows[i].count != scanned[i].count || a.min != b.min || a.max != b.max || fabs(a.sum - b.sum) > 1e-9 * (1 + fabs(b.sum)) ||
+                fabs(a.sumSq - b.sumSq) > 1e-9 * (1 + b.sumSq))
+            {
+                mismatches++;
+            }
+        }
+    }
+    if (expected != matched) mismatches++;
+    fprintf(stderr, "Full scan: %" PRIu64 " rows, %s\n", expected, mismatches ? "MISMATCH" : "OK");
+    return mismatches ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,561 @@
+/**
+  @file replay.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Pasa vuelos grabados por el codigo del firmware (is_correct, decode, hora GPS, lectura del MPU9250 por
+  SPI, fusion de angulos y trama de telemetria) compilado para el PC con el SDK simulado, tan rapido
+  como lo permita el PC. Acepta tramas NMEA, lecturas crudas del IMU y registros de telemetria
+  (datos.csv), mide las muestras por segundo y compara el resultado con un archivo de referencia.
+  Con --power tambien pasa las lecturas por el detector de actividad del modo de bajo consumo. Si los
+  umbrales report_* estan activos (--set) aplica el filtro de reporte y mide los bytes ahorrados y el
+  error de reconstruir las muestras descartadas con la ultima enviada.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "telemetry_log.h"
+extern "C" {
+    #include "pico/stdlib.h"
+    #include "pico_stub.h"
+    #include "gps.h"
+    #include "gps_time.h"
+    #include "mpu9250.h"
+    #include "config_store.h"
+    #include "telemetry.h"
+    #include "report_filter.h"
+    #include "power_model.h"
+}
+
+#define GPS_CHAR_US (10 * 1000000 / 9600) // Same as telemetria.c: time on the wire of one GPS character
+#define REG_ACCEL_XOUT_H 0x3B
+#define REG_GYRO_XOUT_H 0x43
+#define REG_MAG_OUT 0x4A
+#define REG_WHO_AM_I 0x75
+
+/**
+ * @brief Lectura cruda del IMU. Si timed es true se usa en el instante t_us desde el inicio de la
+ * grabacion; si no, se usa una lectura por cada trama de posicion.
+ */
+struct ImuRow
+{
+    bool timed;
+    uint64_t t_us;
+    int16_t acc[3], gyro[3], mag[3];
+};
+
+struct Trace
+{
+    std::string nmea;
+    std::vector<ImuRow> imu;
+};
+
+/**
+ * @brief Error de reconstruccion de un campo: suma de cuadrados y maximo.
+ */
+struct FieldError
+{
+    double sumSq = 0, max = 0;
+
+    void add(double e)
+    {
+        sumSq += e * e;
+        if (e > max) max = e;
+    }
+};
+
+struct ReplayStats
+{
+    uint64_t lines = 0, rejected = 0, fixes = 0, imuReads = 0, samples = 0, mismatches = 0;
+    uint64_t digest = 1469598103934665603ull; // FNV-1a of every output line
+    uint64_t suppressed = 0, bytesAll = 0, bytesSent = 0;
+    FieldError position, attitude, accel, gyro;  // Each sample against the last one sent
+};
+
+/**
+ * @brief Lee un archivo completo al final de una cadena.
+ */
+static bool append_file(const std::string &path, std::string &out)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::ostringstream data;
+    data << file.rdbuf();
+    out += data.str();
+    return true;
+}
+
+/**
+ * @brief Lee lecturas crudas del IMU: "t_us,ax,ay,az,gx,gy,gz,mx,my,mz" o las 9 lecturas sin tiempo.
+ */
+static bool read_imu(const std::string &path, std::vector<ImuRow> &rows)
+{
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        long long v[10];
+        int n = sscanf(line.c_str(), "%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld",
+                       &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8], &v[9]);
+        if (n != 9 && n != 10) continue; // Header or broken line
+        ImuRow row;
+        row.timed = n == 10;
+        row.t_us = row.timed ? v[0] : 0;
+        const long long *r = v + (row.timed ? 1 : 0);
+        for (int i = 0; i < 3; i++)
+        {
+            row.acc[i] = r[i];
+            row.gyro[i] = r[3 + i];
+            row.mag[i] = r[6 + i];
+        }
+        rows.push_back(row);
+    }
+    return true;
+}
+
+/**
+ * @brief Escribe una coordenada NMEA (grados y minutos) con su hemisferio.
+ */
+static int nmea_coordinate(char *out, size_t size, double degrees, int width, char positive, char negative)
+{
+    double a = fabs(degrees);
+    int whole = (int)a;
+    return snprintf(out, size, "%0*d%08.5f,%c", width, whole, (a - whole) * 60.0, degrees >= 0 ? positive : negative);
+}
+
+/**
+ * @brief Arma una trama $GNRMC con checksum como la que entrega el GPS.
+ */
+static std::string make_rmc(int64_t utc_s, double lat, double lon)
+{
+    time_t t = (time_t)utc_s;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+
+    char latText[24], lonText[24], body[128], line[160];
+    nmea_coordinate(latText, sizeof(latText), lat, 2, 'N', 'S');
+    nmea_coordinate(lonText, sizeof(lonText), lon, 3, 'E', 'W');
+    snprintf(body, sizeof(body), "GNRMC,%02d%02d%02d.00,A,%s,%s,0.00,0.00,%02d%02d%02d,,,A",
+             tm.tm_hour, tm.tm_min, tm.tm_sec, latText, lonText, tm.tm_mday, tm.tm_mon + 1, tm.tm_year % 100);
+
+    unsigned char sum = 0;
+    for (const char *p = body; *p; p++) sum ^= *p;
+    snprintf(line, sizeof(line), "$%s*%02X\r\n", body, sum);
+    return line;
+}
+
+/**
+ * @brief Convierte un registro de telemetria en tramas NMEA y lecturas crudas.
+ *
+ * Hace lo contrario de telemetria.c: cada fila se vuelve una trama GNRMC (una por segundo) y una
+ * lectura cruda con los offsets de la configuracion, asi el firmware deberia volver a producir la fila.
+ */
+static bool read_log(const std::string &path, const config_t *config, Trace &trace, std::string &error)
+{
+    int64_t utc = 1683547200; // 2023-05-08 12:00:00 UTC, the date of the flights
+    return scan_telemetry_csv(path, [&](const TelemetryRow &row) {
+        trace.nmea += make_rmc(utc++, row.lat, row.lon);
+        ImuRow imu;
+        imu.timed = false;
+        imu.t_us = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            imu.acc[i] = to_raw(row.acc[i], ACC_FULL_SCALE) + config->acc_offset[i];
+            imu.gyro[i] = to_raw(row.gyro[i], GYRO_FULL_SCALE) + config->gyro_offset[i];
+            imu.mag[i] = to_raw(row.mag[i] / config->mag_scale[i], MAG_FULL_SCALE) + config->mag_offset[i];
+        }
+        trace.imu.push_back(imu);
+    }, error);
+}
+
+/**
+ * @brief Carga una lectura en los registros del MPU9250 simulado (big endian, como los lee mpu9250.c).
+ */
+static void load_registers(uint8_t regs[128], const ImuRow &row)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        regs[REG_ACCEL_XOUT_H + 2 * i] = (uint16_t)row.acc[i] >> 8;
+        regs[REG_ACCEL_XOUT_H + 2 * i + 1] = row.acc[i] & 0xFF;
+        regs[REG_GYRO_XOUT_H + 2 * i] = (uint16_t)row.gyro[i] >> 8;
+        regs[REG_GYRO_XOUT_H + 2 * i + 1] = row.gyro[i] & 0xFF;
+        regs[REG_MAG_OUT + 2 * i] = (uint16_t)row.mag[i] >> 8;
+        regs[REG_MAG_OUT + 2 * i + 1] = row.mag[i] & 0xFF;
+    }
+    stub_spi_set_registers(spi0, regs);
+}
+
+/**
+ * @brief Estado del firmware que se conserva entre muestras.
+ */
+struct Pipeline
+{
+    const config_t *config;
+    gps_time_sync_t timeSync;
+    uint8_t regs[128] = {0};
+    int16_t eulerAngles[2] = {0, 0}, fullAngles[2] = {0, 0};
+    uint64_t lastImuUs = 0;
+    bool started = false;
+    uint32_t seq = 0;
+    bool power = false;             // Run the low power activity detector on every IMU read
+    activity_config_t activityConfig;
+    activity_t activity;
+    report_filter_config_t reportConfig;
+    report_filter_t reportFilter;
+    telemetry_sample_t lastSent;    // What the server holds while samples are suppressed
+};
+
+/**
+ * @brief Lee acelerometro y giroscopio por SPI y avanza la fusion de angulos, como en mpuObject.
+ */
+static void imu_step(Pipeline &p, const ImuRow &row, ReplayStats &stats)
+{
+    int16_t acceleration[3], gyro[3];
+
+    load_registers(p.regs, row);
+    mpu9250_read_raw_accel(acceleration);
+    mpu9250_read_raw_gyro(gyro);
+    for (int i = 0; i < 3; i++)
+    {
+        acceleration[i] -= p.config->acc_offset[i];
+        gyro[i] -= p.config->gyro_offset[i];
+    }
+
+    uint64_t now = time_us_64();
+    if (!p.started || now <= p.lastImuUs)
+    {
+        calculate_angles_from_accel(p.eulerAngles, acceleration);
+        p.started = true;
+    }
+    else
+    {
+        calculate_angles(p.eulerAngles, acceleration, gyro, now - p.lastImuUs);
+    }
+    convert_to_full(p.eulerAngles, acceleration, p.fullAngles);
+    if (p.power)
+    {
+        activity_update(&p.activity, &p.activityConfig, acceleration, gyro, now);
+    }
+    p.lastImuUs = now;
+    stats.imuReads++;
+}
+
+/**
+ * @brief Arma la muestra que enviaria telemetria.c despues de una trama de posicion.
+ */
+static int make_payload(Pipeline &p, float latitud, float longitud, telemetry_sample_t &sample, char *out, size_t size)
+{
+    const config_t *config = p.config;
+    int16_t acceleration[3], gyro[3], mag[3];
+
+    sample.seq = p.seq; // Taken only if the filter sends it, like telemetria.c
+    sample.t_us = time_us_64();
+    sample.utc_us = gps_time_sync_to_utc(&p.timeSync, sample.t_us);
+    sample.lat = latitud;
+    sample.lon = longitud;
+
+    mpu9250_read_raw_mag(mag);
+    mpu9250_read_raw_accel(acceleration);
+    mpu9250_read_raw_gyro(gyro);
+    for (int i = 0; i < 3; i++)
+    {
+        mag[i] -= config->mag_offset[i];
+        acceleration[i] -= config->acc_offset[i];
+        gyro[i] -= config->gyro_offset[i];
+        sample.mag[i] = ((float)mag[i] * config->mag_scale[i] / 32768.0) * 4800.0;
+        sample.acc[i] = ((float)acceleration[i] / 32768.0) * 2.0;
+        sample.gyro[i] = ((float)gyro[i] / 32768.0) * 250.0;
+    }
+
+    int n = telemetry_format_csv(&sample, out, size);
+    n += snprintf(out + n, size - n, ",%d,%d", p.fullAngles[0], p.fullAngles[1]);
+    return n;
+}
+
+/**
+ * @brief Compara una linea de salida con la referencia y la agrega al resumen.
+ */
+static void check_line(const char *line, ReplayStats &stats, std::ifstream *golden, FILE *out)
+{
+    for (const char *c = line; *c; c++)
+    {
+        stats.digest ^= (unsigned char)*c;
+        stats.digest *= 1099511628211ull;
+    }
+    stats.digest ^= '\n';
+    stats.digest *= 1099511628211ull;
+
+    if (out) fprintf(out, "%s\n", line);
+    if (golden)
+    {
+        std::string expected;
+        if (!std::getline(*golden, expected) || expected != line)
+        {
+            if (stats.mismatches++ == 0)
+                fprintf(stderr, "sample %llu differs\n  expected: %s\n  got:      %s\n",
+                        (unsigned long long)stats.samples, expected.c_str(), line);
+        }
+    }
+}
+
+/**
+ * @brief Mide cuanto se aleja una muestra descartada de la ultima enviada, que es la que el servidor
+ * sigue mostrando.
+ */
+static void report_error(const telemetry_sample_t &sent, const telemetry_sample_t &sample, ReplayStats &stats)
+{
+    float pitchSent, rollSent, pitch, roll;
+    report_attitude(sent.acc, &pitchSent, &rollSent);
+    report_attitude(sample.acc, &pitch, &roll);
+    double attitude = std::max(fabs(pitch - pitchSent), fabs(roll - rollSent));
+    stats.position.add(report_distance_m(sent.lat, sent.lon, sample.lat, sample.lon));
+    stats.attitude.add(attitude > 180 ? 360 - attitude : attitude);
+    double accel = 0, gyro = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        accel = std::max(accel, (double)fabs(sample.acc[i] - sent.acc[i]));
+        gyro = std::max(gyro, (double)fabs(sample.gyro[i] - sent.gyro[i]));
+    }
+    stats.accel.add(accel);
+    stats.gyro.add(gyro);
+}
+
+/**
+ * @brief Pasa la grabacion una vez por el ciclo principal de telemetria.c.
+ */
+static void replay_pass(Pipeline &p, const Trace &trace, uint32_t periodMs, ReplayStats &stats, std::ifstream *golden, FILE *out)
+{
+    char message[256], pos[TELEMETRY_CSV_MAX + 16];
+    size_t nextImu = 0;
+    const uint64_t passStart = time_us_64();
+
+    stub_uart_feed(uart0, trace.nmea.data(), trace.nmea.size());
+    while (!stub_uart_drained(uart0))
+    {
+        const size_t length = uart_read_line(uart0, message, sizeof(message));
+        const uint64_t lineStart = time_us_64() - length * GPS_CHAR_US;
+        stats.lines++;
+
+        if (!is_correct(message, length))
+        {
+            stats.rejected++;
+            continue;
+        }
+
+        int64_t fixUtc;
+        if (gps_parse_rmc_time(message, &fixUtc))
+        {
+            gps_time_sync_update(&p.timeSync, lineStart, fixUtc);
+        }
+
+        if (strncmp(message, "$GNRMC", strlen("$GNRMC")) != 0 && strncmp(message, "$GNGGA", strlen("$GNGGA")) != 0)
+        {
+            continue;
+        }
+        float latitud = 0, longitud = 0;
+        decode(message, &latitud, &longitud);
+        stats.fixes++;
+
+        // Timed traces run the fusion at their own rate, the others give one reading per fix
+        if (nextImu < trace.imu.size() && !trace.imu[nextImu].timed)
+        {
+            imu_step(p, trace.imu[nextImu++], stats);
+        }
+        while (nextImu < trace.imu.size() && trace.imu[nextImu].timed && passStart + trace.imu[nextImu].t_us <= time_us_64())
+        {
+            const uint64_t now = time_us_64();
+            stub_time_set(passStart + trace.imu[nextImu].t_us);
+            imu_step(p, trace.imu[nextImu++], stats);
+            stub_time_set(now);
+        }
+
+        telemetry_sample_t sample;
+        int posLength = make_payload(p, latitud, longitud, sample, pos, sizeof(pos));
+        stats.samples++;
+        stats.bytesAll += posLength + 1;
+        if (report_filter_check(&p.reportFilter, &p.reportConfig, &sample) == 0)
+        {
+            report_error(p.lastSent, sample, stats);
+            stats.suppressed++;
+        }
+        else
+        {
+            p.lastSent = sample;
+            p.seq++;
+            stats.bytesSent += posLength + 1;
+            check_line(pos, stats, golden, out);
+        }
+
+        sleep_ms(periodMs);
+    }
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: replay [--nmea gps.txt] [--imu imu.csv] [--csv datos.csv] [--set key=value] [--repeat n]\n"
+                    "              [--out salida.csv] [--golden ref.csv | --write-golden ref.csv] [--power]\n");
+}
+
+int main(int argc, char **argv)
+{
+    // The configuration comes from the (empty) simulated flash, so the firmware defaults apply
+    Pipeline p;
+    std::vector<std::string> nmeaPaths, imuPaths, csvPaths, settings;
+    const char *outPath = nullptr, *goldenPath = nullptr, *writeGoldenPath = nullptr;
+    unsigned long repeat = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--nmea") == 0 && i + 1 < argc) nmeaPaths.push_back(argv[++i]);
+        else if (strcmp(argv[i], "--imu") == 0 && i + 1 < argc) imuPaths.push_back(argv[++i]);
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) csvPaths.push_back(argv[++i]);
+        else if (strcmp(argv[i], "--set") == 0 && i + 1 < argc) settings.push_back(argv[++i]);
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) outPath = argv[++i];
+        else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) goldenPath = argv[++i];
+        else if (strcmp(argv[i], "--write-golden") == 0 && i + 1 < argc) writeGoldenPath = argv[++i];
+        else if (strcmp(argv[i], "--power") == 0) p.power = true;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if ((nmeaPaths.empty() && csvPaths.empty()) || repeat == 0 || (outPath && writeGoldenPath))
+    {
+        usage();
+        return 1;
+    }
+
+    for (const std::string &setting : settings)
+    {
+        if (!config_set(config_edit(), setting.c_str()))
+        {
+            fprintf(stderr, "invalid setting %s\n", setting.c_str());
+            return 1;
+        }
+    }
+    p.config = config_get();
+    activity_config_defaults(&p.activityConfig, p.config->imu_rate_hz, p.config->idle_rate_hz);
+    activity_reset(&p.activity);
+    p.reportConfig = {p.config->report_position_m, p.config->report_attitude_deg, p.config->report_accel_g, p.config->report_gyro_dps,
+                      p.config->report_heartbeat_ms};
+    report_filter_reset(&p.reportFilter);
+    gps_time_sync_reset(&p.timeSync);
+    p.regs[REG_WHO_AM_I] = 0x71;
+
+    Trace trace;
+    for (const std::string &path : nmeaPaths)
+    {
+        if (!append_file(path, trace.nmea))
+        {
+            fprintf(stderr, "cannot open %s\n", path.c_str());
+            return 1;
+        }
+    }
+    for (const std::string &path : imuPaths)
+    {
+        if (!read_imu(path, trace.imu))
+        {
+            fprintf(stderr, "cannot open %s\n", path.c_str());
+            return 1;
+        }
+    }
+    for (const std::string &path : csvPaths)
+    {
+        std::string error;
+        if (!read_log(path, p.config, trace, error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    std::ifstream golden;
+    if (goldenPath)
+    {
+        golden.open(goldenPath);
+        if (!golden)
+        {
+            fprintf(stderr, "cannot open %s\n", goldenPath);
+            return 1;
+        }
+    }
+    FILE *out = nullptr;
+    if (outPath || writeGoldenPath)
+    {
+        out = fopen(outPath ? outPath : writeGoldenPath, "w");
+        if (!out)
+        {
+            fprintf(stderr, "cannot write %s\n", outPath ? outPath : writeGoldenPath);
+            return 1;
+        }
+    }
+
+    ReplayStats stats;
+    stub_time_set(0);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long pass = 0; pass < repeat; pass++)
+    {
+        replay_pass(p, trace, p.config->sample_period_ms, stats, goldenPath ? &golden : nullptr, out);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (out) fclose(out);
+
+    std::string extra;
+    if (goldenPath && std::getline(golden, extra))
+    {
+        if (stats.mismatches++ == 0) fprintf(stderr, "the reference has more samples than the replay\n");
+    }
+
+    double simulated = time_us_64() / 1e6;
+    printf("Lines %llu (rejected %llu), fixes %llu, IMU reads %llu, samples %llu\n",
+           (unsigned long long)stats.lines, (unsigned long long)stats.rejected, (unsigned long long)stats.fixes,
+           (unsigned long long)stats.imuReads, (unsigned long long)stats.samples);
+    printf("Replayed %.1f s of device time in %.3f s: %.0f samples/s, %.0fx real time\n",
+           simulated, seconds, stats.samples / (seconds > 0 ? seconds : 1e-9), simulated / (seconds > 0 ? seconds : 1e-9));
+    printf("Output digest %016llx\n", (unsigned long long)stats.digest);
+
+    if (p.power && p.activity.active_us + p.activity.idle_us > 0)
+    {
+        // Only the IMU wakeups are modelled: GPS and ESP traffic cost the same in both modes
+        const activity_t &a = p.activity;
+        double total = a.active_us + a.idle_us;
+        float fixedDuty = power_duty_for_rate(p.activityConfig.active_hz);
+        float adaptiveDuty = (a.active_us * power_duty_for_rate(p.activityConfig.active_hz) + a.idle_us * power_duty_for_rate(p.activityConfig.idle_hz)) / total;
+        float fixedMa = power_estimate_ma(fixedDuty), adaptiveMa = power_estimate_ma(adaptiveDuty);
+        printf("Power: still %.1f%% of the time, %u mode changes\n", 100.0 * a.idle_us / total, a.transitions);
+        printf("  fixed %u Hz:    duty %.1f%%, about %.2f mA\n", p.activityConfig.active_hz, fixedDuty * 100, fixedMa);
+        printf("  adaptive %u/%u Hz: duty %.1f%%, about %.2f mA (%.2fx endurance)\n", p.activityConfig.active_hz, p.activityConfig.idle_hz,
+               adaptiveDuty * 100, adaptiveMa, fixedMa / adaptiveMa);
+    }
+
+    if (report_filter_enabled(&p.reportConfig) && stats.samples > 0)
+    {
+        // Errors are over every sample: sent samples count as zero error
+        auto rms = [&stats](const FieldError &e) { return sqrt(e.sumSq / stats.samples); };
+        printf("Report filter: %llu of %llu samples sent, %llu suppressed, %llu of %llu bytes (%.1f%% saved)\n",
+               (unsigned long long)(stats.samples - stats.suppressed), (unsigned long long)stats.samples, (unsigned long long)stats.suppressed,
+               (unsigned long long)stats.bytesSent, (unsigned long long)stats.bytesAll, 100.0 * (stats.bytesAll - stats.bytesSent) / stats.bytesAll);
+        printf("  reconstruction error (rms / max): position %.2f / %.2f m, attitude %.2f / %.2f deg, accel %.4f / %.4f g, gyro %.2f / %.2f deg/s\n",
+               rms(stats.position), stats.position.max, rms(stats.attitude), stats.attitude.max, rms(stats.accel), stats.accel.max,
+               rms(stats.gyro), stats.gyro.max);
+    }
+
+    if (goldenPath)
+    {
+        printf("Golden %s: %s (%llu mismatches)\n", goldenPath, stats.mismatches ? "FAIL" : "OK", (unsigned long long)stats.mismatches);
+        return stats.mismatches ? 2 : 0;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,576 @@
+/**
+  @file reprocess.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Vuelve a pasar los vuelos archivados (capturas binarias de usbStream o registros CSV) por la
+  calibracion y la fusion del firmware compiladas para el PC: angulos de calculate_angles() y
+  convert_to_full() y la navegacion de nav_ekf.c. Cada archivo se parte en vuelos (el reloj vuelve
+  atras al reiniciar la placa) y en tramos (huecos de mas de --gap segundos), y cada tramo es un
+  trabajo independiente en un pool de hilos con robo de trabajo. Escribe la actitud y la posicion de
+  cada tramo en su propio CSV. Con --verify repite todo con un solo hilo y compara bit a bit.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "telemetry_log.h"
+#include "work_pool.h"
+extern "C" {
+    #include "config_store.h"
+    #include "mpu9250.h"
+    #include "nav_ekf.h"
+    #include "telemetry_frame.h"
+}
+
+static const uint64_t FNV_OFFSET = 1469598103934665603ull, FNV_PRIME = 1099511628211ull;
+static const char HEADER[] = "t_us,pitch,roll,pitch_full,roll_full,heading,lat,lon,north,east,vel_n,vel_e,sigma_n,sigma_e\n";
+
+/**
+ * @brief Opciones de la linea de comandos.
+ */
+struct Options
+{
+    std::vector<std::string> paths;
+    std::string out;
+    int threads = 0;
+    uint64_t gapUs = 10000000;
+    uint32_t every = 1;
+    bool verify = false;
+};
+
+/**
+ * @brief Lectura archivada: del IMU en cuentas crudas o un fix del GPS.
+ */
+struct Sample
+{
+    uint64_t t_us;
+    bool gps;
+    int16_t acc[3], gyro[3], mag[3];
+    float lat, lon;
+};
+
+/**
+ * @brief Tramo continuo de un archivo, el trabajo que procesa un hilo.
+ *
+ * Los registros CSV ya traen la calibracion del equipo aplicada (calibrated), las capturas no.
+ */
+struct Segment
+{
+    bool calibrated = false;
+    std::vector<Sample> samples;
+};
+
+/**
+ * @brief Resultado de un tramo: lo que se compara entre corridas.
+ */
+struct SegmentResult
+{
+    uint64_t imuSamples = 0, rows = 0, bytes = 0;
+    uint64_t digest = FNV_OFFSET;   // FNV-1a of the whole output file
+    double seconds = 0;
+    std::string error;
+};
+
+struct LogFile
+{
+    std::string path;
+    std::string output;  // Output name without the segment number, unique among the inputs
+    uint64_t bytes = 0;
+    std::string error;
+    std::vector<SegmentResult> segments;
+};
+
+/**
+ * @brief Agrega una lectura al tramo actual o empieza uno nuevo si el reloj volvio atras o hubo un hueco.
+ */
+static void append_sample(std::vector<Segment> &segments, const Sample &sample, bool calibrated, uint64_t gapUs)
+{
+    if (segments.empty() || sample.t_us < segments.back().samples.back().t_us ||
+        sample.t_us - segments.back().samples.back().t_us > gapUs)
+    {
+        segments.emplace_back();
+        segments.back().calibrated = calibrated;
+    }
+    segments.back().samples.push_back(sample);
+}
+
+/**
+ * @brief Lee una captura binaria de usbStream (cuentas crudas del IMU, sin calibrar).
+ */
+static bool read_capture(const std::string &path, uint64_t gapUs, std::vector<Segment> &segments, std::string &error)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::vector<uint8_t> data((size_t)in.tellg());
+    in.seekg(0);
+    if (!in.read((char *)data.data(), data.size()))
+    {
+        error = "cannot read " + path;
+        return false;
+    }
+
+    size_t offset = 0, used;
+    telemetry_frame_t frame;
+    while (offset < data.size())
+    {
+        int result = telemetry_frame_decode(data.data() + offset, data.size() - offset, &frame, &used);
+        if (result == 0) break;
+        offset += used;
+        if (result < 0) continue;
+
+        Sample s = {};
+        s.t_us = frame.t_us;
+        s.gps = frame.type == TELEMETRY_FRAME_GPS;
+        if (s.gps)
+        {
+            if (frame.gps.lat_e7 == 0 && frame.gps.lon_e7 == 0) continue;  // No fix yet
+            s.lat = frame.gps.lat_e7 * 1e-7;
+            s.lon = frame.gps.lon_e7 * 1e-7;
+        }
+        else
+        {
+            memcpy(s.acc, frame.imu.acc, sizeof(s.acc));
+            memcpy(s.gyro, frame.imu.gyro, sizeof(s.gyro));
+            memcpy(s.mag, frame.imu.mag, sizeof(s.mag));
+        }
+        append_sample(segments, s, false, gapUs);
+    }
+    return true;
+}
+
+/**
+ * @brief Lee un registro CSV: cada fila es una lectura del IMU ya calibrada seguida de su fix.
+ *
+ * Las filas sin tiempo se ponen a sample_period_ms una de otra.
+ */
+static bool read_log(const std::string &path, const config_t &config, uint64_t gapUs, std::vector<Segment> &segments, std::string &error)
+{
+    const uint64_t periodUs = (config.sample_period_ms ? config.sample_period_ms : 1000) * 1000ull;
+    uint64_t index = 0;
+    return scan_telemetry_csv(path, [&](const TelemetryRow &row) {
+        Sample s = {};
+        s.t_us = row.timed ? row.t_us : index * periodUs;
+        for (int i = 0; i < 3; i++)
+        {
+            s.acc[i] = to_raw(row.acc[i], ACC_FULL_SCALE);
+            s.gyro[i] = to_raw(row.gyro[i], GYRO_FULL_SCALE);
+            s.mag[i] = to_raw(row.mag[i], MAG_FULL_SCALE);
+        }
+        append_sample(segments, s, true, gapUs);
+        if (row.lat != 0 || row.lon != 0)
+        {
+            s.gps = true;
+            s.lat = row.lat;
+            s.lon = row.lon;
+            append_sample(segments, s, true, gapUs);
+        }
+        index++;
+    }, error);
+}
+
+static bool is_csv(const std::string &path)
+{
+    return path.size() >= 4 && strcasecmp(path.c_str() + path.size() - 4, ".csv") == 0;
+}
+
+/**
+ * @brief Nombre de salida de un archivo: su ruta sin extension con las carpetas unidas por '_'.
+ *
+ * Todos los archivos de readPort.py se llaman datos.csv, asi que el nombre solo no alcanza:
+ * a/datos.csv queda a_datos y b/datos.csv queda b_datos.
+ */
+static std::string output_stem(const std::string &path)
+{
+    std::string stem = std::filesystem::path(path).lexically_normal().replace_extension().relative_path().generic_string();
+    std::replace(stem.begin(), stem.end(), '/', '_');
+    return stem;
+}
+
+/**
+ * @brief Nombre del CSV de salida de un tramo.
+ */
+static std::string output_path(const std::string &dir, const std::string &stem, size_t segment)
+{
+    return dir + "/" + stem + "." + std::to_string(segment) + ".csv";
+}
+
+/**
+ * @brief Pasa un tramo por la calibracion y la fusion del firmware y arma su CSV.
+ *
+ * Cada lectura del IMU pasa como en mpuObject y navigation_step: se le restan los offsets, los
+ * angulos avanzan con calculate_angles() (o se toman del acelerometro al empezar) y el filtro de
+ * navegacion con el tiempo desde la lectura anterior. Cada fix del GPS actualiza el filtro. Se
+ * escribe una fila cada every lecturas del IMU. Solo depende del tramo y de la configuracion, asi
+ * que el resultado no cambia con el hilo ni el orden en que se corre.
+ *
+ * @param segment tramo a procesar.
+ * @param config calibracion (offsets, mag_scale) para las capturas crudas.
+ * @param options every y carpeta de salida; sin carpeta solo se calcula el resumen.
+ * @param stem nombre de salida del archivo de origen (output_stem).
+ * @param index numero del tramo dentro del archivo.
+ * @param result filas, bytes y digest de la salida.
+ */
+static void process_segment(const Segment &segment, const config_t &config, const Options &options, const std::string &stem,
+                            size_t index, SegmentResult &result)
+{
+    auto start = std::chrono::steady_clock::now();
+    static const int16_t NO_OFFSET[3] = {0, 0, 0};
+    static const float NO_SCALE[3] = {1, 1, 1};
+    const int16_t *accOffset = segment.calibrated ? NO_OFFSET : config.acc_offset;
+    const int16_t *gyroOffset = segment.calibrated ? NO_OFFSET : config.gyro_offset;
+    const int16_t *magOffset = segment.calibrated ? NO_OFFSET : config.mag_offset;
+    const float *magScale = segment.calibrated ? NO_SCALE : config.mag_scale;
+
+    nav_config_t navConfig;
+    nav_config_defaults(&navConfig);
+    nav_ekf_t nav;
+    nav_ekf_init(&nav, &navConfig);
+    nav_output_t navOut;
+
+    int16_t eulerAngles[2] = {0, 0}, fullAngles[2] = {0, 0};
+    uint64_t last = 0;
+    bool started = false;
+    std::string out(HEADER);
+    out.reserve(segment.samples.size() / options.every * 96);
+    char line[256];
+
+    for (const Sample &s : segment.samples)
+    {
+        if (s.gps)
+        {
+            nav_ekf_update_gps(&nav, s.lat, s.lon);
+            continue;
+        }
+
+        int16_t acceleration[3], gyro[3];
+        float acc[3], gyroDps[3], mag[3];
+        for (int i = 0; i < 3; i++)  // Same scales as the samples sent to the server
+        {
+            acceleration[i] = s.acc[i] - accOffset[i];
+            gyro[i] = s.gyro[i] - gyroOffset[i];
+            acc[i] = (s.acc[i] - accOffset[i]) * (ACC_FULL_SCALE / 32768);
+            gyroDps[i] = (s.gyro[i] - gyroOffset[i]) * (GYRO_FULL_SCALE / 32768);
+            mag[i] = (s.mag[i] - magOffset[i]) * magScale[i] * (MAG_FULL_SCALE / 32768);
+        }
+        if (!started || s.t_us <= last) calculate_angles_from_accel(eulerAngles, acceleration);
+        else calculate_angles(eulerAngles, acceleration, gyro, s.t_us - last);
+        convert_to_full(eulerAngles, acceleration, fullAngles);
+        nav_ekf_predict(&nav, acc, gyroDps, mag, started ? (s.t_us - last) * 1e-6f : 0);
+        started = true;
+        last = s.t_us;
+
+        if (result.imuSamples++ % options.every) continue;
+        nav_ekf_output(&nav, &navOut);
+        int n = snprintf(line, sizeof(line), "%" PRIu64 ",%d,%d,%d,%d,%.2f", s.t_us, eulerAngles[0], eulerAngles[1], fullAngles[0],
+                         fullAngles[1], navOut.heading);
+        if (nav.position_ready)
+            n += snprintf(line + n, sizeof(line) - n, ",%.7f,%.7f,%.3f,%.3f,%.3f,%.3f,%.2f,%.2f\n", navOut.lat, navOut.lon, navOut.north,
+                          navOut.east, navOut.vel_n, navOut.vel_e, navOut.sigma_n, navOut.sigma_e);
+        else
+            n += snprintf(line + n, sizeof(line) - n, ",,,,,,,,\n");  // No fix yet
+        out.append(line, n);
+        result.rows++;
+    }
+
+    for (unsigned char c : out)
+    {
+        result.digest ^= c;
+        result.digest *= FNV_PRIME;
+    }
+    result.bytes = out.size();
+
+    if (!options.out.empty())
+    {
+        const std::string name = output_path(options.out, stem, index);
+        FILE *file = fopen(name.c_str(), "wb");
+        if (!file || fwrite(out.data(), 1, out.size(), file) != out.size()) result.error = "cannot write " + name;
+        if (file) fclose(file);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Corre todos los archivos en el pool: un trabajo lee y parte cada archivo y agrega un trabajo
+ * por tramo a la cola de su hilo, de donde los otros hilos los roban.
+ *
+ * @return double retorna los segundos que tomo.
+ */
+static double run_pass(WorkPool &pool, std::vector<LogFile> &files, const config_t &config, const Options &options)
+{
+    // Largest files first, dealt round robin, so the long ones do not start last
+    std::vector<size_t> order(files.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return files[a].bytes > files[b].bytes; });
+
+    for (size_t k = 0; k < order.size(); k++)
+    {
+        LogFile *file = &files[order[k]];
+        file->error.clear();
+        file->segments.clear();
+        pool.push(k % pool.size(), [file, &pool, &config, &options](int worker) {
+            std::vector<Segment> segments;
+            bool ok = is_csv(file->path) ? read_log(file->path, config, options.gapUs, segments, file->error)
+                                         : read_capture(file->path, options.gapUs, segments, file->error);
+            if (!ok) return;
+            file->segments.resize(segments.size());
+
+            // The owner pops from the back: pushing the shortest first leaves the longest for it
+            std::vector<size_t> bySize(segments.size());
+            for (size_t i = 0; i < bySize.size(); i++) bySize[i] = i;
+            std::stable_sort(bySize.begin(), bySize.end(),
+                             [&](size_t a, size_t b) { return segments[a].samples.size() < segments[b].samples.size(); });
+            for (size_t i : bySize)
+            {
+                auto segment = std::make_shared<Segment>(std::move(segments[i]));
+                pool.push(worker, [file, segment, i, &config, &options](int) {
+                    process_segment(*segment, config, options, file->output, i, file->segments[i]);
+                });
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    pool.run();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Genera capturas sinteticas con el formato de usbStream: varios vuelos por archivo, cada uno
+ * despues de un reinicio de la placa y de duracion variable, IMU a 100 Hz y GPS a 1 Hz.
+ */
+static int synthetic(const std::string &dir, int count, int flights, double minutes, const config_t &config)
+{
+    const double DEG = M_PI / 180, lat0 = 6.2442, lon0 = -75.5812, radius = 150, speed = 8;
+    std::mt19937 rng(2023);
+    std::normal_distribution<double> gauss(0, 1);
+    std::uniform_real_distribution<double> length(0.25, 1.75);
+    uint64_t frames = 0;
+
+    for (int f = 0; f < count; f++)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "/flight%03d.bin", f);
+        const std::string path = dir + name;
+        FILE *out = fopen(path.c_str(), "wb");
+        if (!out)
+        {
+            fprintf(stderr, "cannot write %s\n", path.c_str());
+            return 1;
+        }
+        uint32_t seq = 0;
+        for (int k = 0; k < flights; k++)
+        {
+            const uint64_t steps = minutes * 60 * 100 * length(rng);
+            const double phase = 2 * M_PI * gauss(rng);
+            for (uint64_t i = 0; i < steps; i++)
+            {
+                // Circle at constant speed, body level with x forward; counts include the board's offsets
+                const double t = i * 0.01, angle = phase + speed / radius * t, heading = angle + M_PI / 2;
+                telemetry_frame_t frame = {};
+                frame.type = TELEMETRY_FRAME_IMU;
+                frame.seq = seq++;
+                frame.t_us = 3000000 + i * 10000;  // The clock restarts with every flight
+                const double acc[3] = {0.01 * gauss(rng), speed * speed / radius / 9.80665 + 0.01 * gauss(rng), 1 + 0.01 * gauss(rng)};
+                const double gyro[3] = {0.2 * gauss(rng), 0.2 * gauss(rng), speed / radius / DEG + 0.2 * gauss(rng)};
+                const double mag[3] = {30 * cos(heading), -30 * sin(heading), -20};
+                for (int a = 0; a < 3; a++)
+                {
+                    frame.imu.acc[a] = to_raw(acc[a], ACC_FULL_SCALE) + config.acc_offset[a];
+                    frame.imu.gyro[a] = to_raw(gyro[a], GYRO_FULL_SCALE) + config.gyro_offset[a];
+                    frame.imu.mag[a] = to_raw(mag[a], MAG_FULL_SCALE) + config.mag_offset[a];
+                }
+                uint8_t buf[TELEMETRY_FRAME_MAX];
+                fwrite(buf, 1, telemetry_frame_encode(&frame, buf), out);
+                frames++;
+
+                if (i % 100 == 99)
+                {
+                    const double north = radius * sin(angle) + 2 * gauss(rng), east = radius * (1 - cos(angle)) + 2 * gauss(rng);
+                    frame.type = TELEMETRY_FRAME_GPS;
+                    frame.seq = seq++;
+                    frame.gps.lat_e7 = lround((lat0 + north / 111195.0) * 1e7);
+                    frame.gps.lon_e7 = lround((lon0 + east / (111195.0 * cos(lat0 * DEG))) * 1e7);
+                    frame.gps.utc_us = 0;
+                    fwrite(buf, 1, telemetry_frame_encode(&frame, buf), out);
+                    frames++;
+                }
+            }
+        }
+        fclose(out);
+    }
+    printf("%d captures with %d flights each written to %s, %" PRIu64 " frames\n", count, flights, dir.c_str(), frames);
+    return 0;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: reprocess [--out dir] [--threads n] [--gap s] [--every n] [--set key=value] [--verify] capture.bin|datos.csv...\n"
+                    "       reprocess --synthetic dir [--files n] [--flights n] [--minutes m]\n");
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    std::vector<std::string> settings;
+    const char *syntheticDir = nullptr;
+    int syntheticFiles = 8, syntheticFlights = 3;
+    double syntheticMinutes = 10;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) options.out = argv[++i];
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) options.threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--gap") == 0 && i + 1 < argc) options.gapUs = atof(argv[++i]) * 1e6;
+        else if (strcmp(argv[i], "--every") == 0 && i + 1 < argc) options.every = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--set") == 0 && i + 1 < argc) settings.push_back(argv[++i]);
+        else if (strcmp(argv[i], "--verify") == 0) options.verify = true;
+        else if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc) syntheticDir = argv[++i];
+        else if (strcmp(argv[i], "--files") == 0 && i + 1 < argc) syntheticFiles = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--flights") == 0 && i + 1 < argc) syntheticFlights = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--minutes") == 0 && i + 1 < argc) syntheticMinutes = atof(argv[++i]);
+        else if (argv[i][0] != '-') options.paths.push_back(argv[i]);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    // The calibration to apply: the firmware defaults with the --set changes, as in replay
+    config_t config;
+    config_defaults(&config);
+    for (const std::string &setting : settings)
+    {
+        if (!config_set(&config, setting.c_str()))
+        {
+            fprintf(stderr, "bad setting %s\n", setting.c_str());
+            return 1;
+        }
+    }
+    if (syntheticDir) return synthetic(syntheticDir, syntheticFiles, syntheticFlights, syntheticMinutes, config);
+    if (options.paths.empty())
+    {
+        usage();
+        return 1;
+    }
+    if (options.threads <= 0) options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<LogFile> files(options.paths.size());
+    std::map<std::string, std::string> outputs;  // Output name -> input that writes it
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        files[i].path = options.paths[i];
+        files[i].output = output_stem(files[i].path);
+        std::ifstream in(files[i].path, std::ios::binary | std::ios::ate);
+        files[i].bytes = in ? (uint64_t)in.tellg() : 0;
+
+        auto used = outputs.emplace(files[i].output, files[i].path);
+        if (!options.out.empty() && !used.second)
+        {
+            fprintf(stderr, "%s and %s would both write %s/%s.*.csv\n", used.first->second.c_str(), files[i].path.c_str(),
+                    options.out.c_str(), files[i].output.c_str());
+            return 1;
+        }
+    }
+    std::error_code created;
+    if (!options.out.empty() && !std::filesystem::create_directories(options.out, created) && created)
+    {
+        fprintf(stderr, "cannot create %s: %s\n", options.out.c_str(), created.message().c_str());
+        return 1;
+    }
+
+    // Reference: the same jobs one after the other on a single thread, nothing written
+    std::vector<SegmentResult> reference;
+    double referenceSeconds = 0;
+    if (options.verify)
+    {
+        Options single = options;
+        single.out.clear();
+        WorkPool one(1);
+        referenceSeconds = run_pass(one, files, config, single);
+        for (const LogFile &file : files) reference.insert(reference.end(), file.segments.begin(), file.segments.end());
+    }
+
+    WorkPool pool(options.threads);
+    const double seconds = run_pass(pool, files, config, options);
+
+    uint64_t segments = 0, imuSamples = 0, rows = 0, bytes = 0, digest = FNV_OFFSET;
+    double busy = 0, longest = 0;
+    bool failed = false;
+    for (const LogFile &file : files)
+    {
+        if (!file.error.empty())
+        {
+            fprintf(stderr, "%s\n", file.error.c_str());
+            failed = true;
+        }
+        for (const SegmentResult &r : file.segments)
+        {
+            if (!r.error.empty())
+            {
+                fprintf(stderr, "%s\n", r.error.c_str());
+                failed = true;
+            }
+            segments++;
+            imuSamples += r.imuSamples;
+            rows += r.rows;
+            bytes += r.bytes;
+            longest = std::max(longest, r.seconds);
+            for (int b = 0; b < 64; b += 8)  // Digest of the digests, in file and segment order
+            {
+                digest ^= (r.digest >> b) & 0xFF;
+                digest *= FNV_PRIME;
+            }
+        }
+    }
+
+    const char *written = options.out.empty() ? "" : failed ? ", errors writing to " : " written to ";
+    printf("%zu files, %" PRIu64 " segments, %" PRIu64 " IMU samples, %" PRIu64 " rows (%.1f MB)%s%s\n", files.size(), segments, imuSamples, rows,
+           bytes / 1e6, written, options.out.c_str());
+    printf("%.3f s with %d threads, %.2f M IMU samples/s, digest %016" PRIx64 "\n", seconds, pool.size(), imuSamples / seconds / 1e6, digest);
+    for (int i = 0; i < pool.size(); i++)
+    {
+        const WorkPool::WorkerStats &s = pool.stats(i);
+        busy += s.busySeconds;
+        printf("  thread %d: %" PRIu64 " jobs, %" PRIu64 " stolen, busy %.0f%%\n", i, s.tasks, s.steals, s.busySeconds / seconds * 100);
+    }
+    // The longest segment bounds how far more threads can go
+    if (longest > 0)
+        printf("Longest segment %.3f s of %.3f s of work: at most %.1fx faster than one thread\n", longest, busy, busy / longest);
+
+    if (options.verify)
+    {
+        uint64_t different = 0, index = 0;
+        for (const LogFile &file : files)
+        {
+            for (const SegmentResult &r : file.segments)
+            {
+                const SegmentResult *ref = index < reference.size() ? &reference[index] : nullptr;
+                if (!ref || ref->digest != r.digest || ref->bytes != r.bytes || ref->rows != r.rows) different++;
+                index++;
+            }
+        }
+        if (index != reference.size()) different++;
+        printf("Single thread: %.3f s, %.2fx faster with %d threads\n", referenceSeconds, referenceSeconds / seconds, pool.size());
+        printf("Verify: %" PRIu64 " of %" PRIu64 " segments differ from the single thread run, %s\n", different, segments,
+               different ? "FAIL" : "OK");
+        if (different) failed = true;
+    }
+    return failed ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+/**
+  @file work_pool.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Hilos con una cola por hilo y robo de trabajo entre colas, para los trabajos de reprocess.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <chrono>
+#include <thread>
+#include "work_pool.h"
+
+WorkPool::WorkPool(int threads)
+{
+    for (int i = 0; i < threads; i++) queues.emplace_back(new Queue());
+}
+
+/**
+ * @brief Agrega un trabajo a la cola de un hilo.
+ *
+ * @param worker hilo dueño de la cola; los trabajos que agrega un trabajo van a su propio hilo.
+ * @param task trabajo, recibe el numero del hilo que lo corre.
+ */
+void WorkPool::push(int worker, Task task)
+{
+    pending++;
+    {
+        std::lock_guard<std::mutex> guard(queues[worker]->lock);
+        queues[worker]->tasks.push_back(std::move(task));
+    }
+    idle.notify_one();
+}
+
+/**
+ * @brief Toma el ultimo trabajo de la cola propia o roba el primero de otra.
+ *
+ * @return bool retorna false si todas las colas estaban vacias.
+ */
+bool WorkPool::take(int worker, Task &task)
+{
+    Queue &own = *queues[worker];
+    {
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    const int n = size();
+    for (int k = 1; k < n; k++)
+    {
+        Queue &victim = *queues[(worker + k) % n];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            own.stats.steals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Ciclo de un hilo: corre trabajos hasta que no quede ninguno pendiente en todo el pool.
+ */
+void WorkPool::work(int worker)
+{
+    WorkerStats &stats = queues[worker]->stats;
+    Task task;
+    while (true)
+    {
+        if (take(worker, task))
+        {
+            auto start = std::chrono::steady_clock::now();
+            task(worker);
+            task = nullptr;
+            stats.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            stats.tasks++;
+            if (--pending == 0) idle.notify_all();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idleLock);
+        if (pending == 0) return;
+        // A push between take() and here only costs one timeout
+        idle.wait_for(lock, std::chrono::milliseconds(1));
+    }
+}
+
+/**
+ * @brief Corre todos los trabajos agregados, y los que estos agreguen, con un hilo por cola.
+ */
+void WorkPool::run()
+{
+    for (auto &queue : queues) queue->stats = WorkerStats();
+    std::vector<std::thread> threads;
+    for (int i = 1; i < size(); i++) threads.emplace_back(&WorkPool::work, this, i);
+    work(0);
+    for (std::thread &thread : threads) thread.join();
+}
\ No newline at end of file
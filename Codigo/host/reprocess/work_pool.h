@@ -0,0 +1,59 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifndef work_pool_h
+#define work_pool_h
+
+/**
+ * @brief Hilos con robo de trabajo.
+ *
+ * Cada hilo tiene su propia cola: saca de atras lo ultimo que agrego (los trabajos que acaba de crear
+ * siguen en su cache) y, si se queda sin nada, le roba a otro hilo de adelante, donde estan los
+ * trabajos mas viejos. Un trabajo puede agregar otros a la cola del hilo que lo corre; run() termina
+ * cuando no queda ninguno pendiente.
+ */
+class WorkPool
+{
+public:
+    using Task = std::function<void(int worker)>;
+
+    /**
+     * @brief Contadores de un hilo en la ultima llamada a run().
+     */
+    struct WorkerStats
+    {
+        uint64_t tasks = 0, steals = 0;
+        double busySeconds = 0;
+    };
+
+    explicit WorkPool(int threads);
+
+    int size() const { return (int)queues.size(); }
+    void push(int worker, Task task);
+    void run();
+    const WorkerStats &stats(int worker) const { return queues[worker]->stats; }
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+        WorkerStats stats;
+    };
+
+    bool take(int worker, Task &task);
+    void work(int worker);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<uint64_t> pending{0};
+    std::mutex idleLock;
+    std::condition_variable idle;
+};
+
+#endif
\ No newline at end of file
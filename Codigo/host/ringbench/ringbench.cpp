@@ -0,0 +1,275 @@
+/**
+  @file ringbench.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Mide en el PC el rendimiento de la cola spsc_ring.h con un hilo productor y uno consumidor (un
+  elemento a la vez, en bloques, sin copia y con la plantilla de C++) y la somete a una prueba de
+  estres con tamaños de bloque y capacidades al azar, verificando que los datos lleguen completos y
+  en orden.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include "spsc_ring.h"
+
+enum Mode { SINGLE, BULK, SPAN, TEMPLATE };
+const char *MODE_NAMES[] = {"single", "bulk", "span", "template"};
+const uint32_t BLOCK = 64; // Elements per bulk operation
+
+struct Result
+{
+    double seconds;
+    bool ok;
+};
+
+/**
+ * @brief Pasa count enteros consecutivos por la cola y verifica el orden en el consumidor.
+ */
+static Result run_c(Mode mode, uint64_t count, uint32_t capacity)
+{
+    std::vector<uint32_t> storage(capacity);
+    spsc_ring_t ring;
+    spsc_ring_init(&ring, storage.data(), capacity, sizeof(uint32_t));
+    bool ok = true;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&] {
+        uint32_t next = 0, block[BLOCK];
+        uint64_t sent = 0;
+        while (sent < count)
+        {
+            uint32_t want = count - sent < BLOCK ? count - sent : BLOCK, n = 0;
+            if (mode == SINGLE)
+            {
+                n = spsc_ring_push(&ring, &next) ? 1 : 0;
+            }
+            else if (mode == BULK)
+            {
+                for (uint32_t i = 0; i < want; i++) block[i] = next + i;
+                n = spsc_ring_push_n(&ring, block, want);
+            }
+            else
+            {
+                void *span;
+                n = spsc_ring_write_span(&ring, &span);
+                if (n > want) n = want;
+                for (uint32_t i = 0; i < n; i++) ((uint32_t *)span)[i] = next + i;
+                spsc_ring_write_commit(&ring, n);
+            }
+            if (n == 0) std::this_thread::yield(); // Full: let the consumer run when both share a core
+            next += n;
+            sent += n;
+        }
+    });
+
+    uint32_t expected = 0, block[BLOCK];
+    uint64_t received = 0;
+    while (received < count)
+    {
+        uint32_t n = 0;
+        if (mode == SINGLE)
+        {
+            n = spsc_ring_pop(&ring, block) ? 1 : 0;
+            if (n && block[0] != expected) ok = false;
+        }
+        else if (mode == BULK)
+        {
+            n = spsc_ring_pop_n(&ring, block, BLOCK);
+            for (uint32_t i = 0; i < n; i++) if (block[i] != expected + i) ok = false;
+        }
+        else
+        {
+            const void *span;
+            n = spsc_ring_read_span(&ring, &span);
+            for (uint32_t i = 0; i < n; i++) if (((const uint32_t *)span)[i] != expected + i) ok = false;
+            spsc_ring_read_commit(&ring, n);
+        }
+        if (n == 0) std::this_thread::yield();
+        expected += n;
+        received += n;
+    }
+    producer.join();
+    return {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), ok};
+}
+
+/**
+ * @brief Elemento del tamaño de una muestra del IMU con su hora, para la plantilla.
+ */
+struct Frame
+{
+    uint64_t seq;
+    int16_t values[12];
+};
+
+static Result run_template(uint64_t count)
+{
+    static SpscRing<Frame, 1024> ring;
+    bool ok = true;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&] {
+        Frame frame = {};
+        for (uint64_t i = 0; i < count;)
+        {
+            frame.seq = i;
+            frame.values[0] = (int16_t)i;
+            if (ring.push(frame)) i++;
+            else std::this_thread::yield();
+        }
+    });
+
+    Frame frames[BLOCK];
+    for (uint64_t expected = 0; expected < count;)
+    {
+        uint32_t n = ring.pop(frames, BLOCK);
+        if (n == 0) std::this_thread::yield();
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (frames[i].seq != expected + i || frames[i].values[0] != (int16_t)(expected + i)) ok = false;
+        }
+        expected += n;
+    }
+    producer.join();
+    return {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), ok};
+}
+
+/**
+ * @brief Prueba de estres: capacidad, operacion y tamaño de bloque al azar en cada paso.
+ *
+ * @return uint64_t retorna el numero de errores de orden o de contenido.
+ */
+static uint64_t stress(double seconds, uint64_t &rounds, uint64_t &moved)
+{
+    std::mt19937 rng(12345);
+    uint64_t errors = 0;
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+
+    while (std::chrono::steady_clock::now() < end)
+    {
+        uint32_t capacity = 1u << (rng() % 11); // 1 .. 1024
+        uint64_t count = 10000 + rng() % 100000;
+        std::vector<uint32_t> storage(capacity);
+        spsc_ring_t ring;
+        spsc_ring_init(&ring, storage.data(), capacity, sizeof(uint32_t));
+        uint32_t producerSeed = rng(), consumerSeed = rng();
+        std::atomic<uint64_t> producerErrors{0};
+
+        std::thread producer([&] {
+            std::mt19937 r(producerSeed);
+            uint32_t next = 0, block[2048];
+            while (next < count)
+            {
+                uint32_t want = 1 + r() % 2048, n = 0;
+                if (want > count - next) want = count - next;
+                switch (r() % 3)
+                {
+                case 0: n = spsc_ring_push(&ring, &next) ? 1 : 0; break;
+                case 1:
+                    for (uint32_t i = 0; i < want; i++) block[i] = next + i;
+                    n = spsc_ring_push_n(&ring, block, want);
+                    break;
+                default:
+                {
+                    void *span;
+                    n = spsc_ring_write_span(&ring, &span);
+                    if (n > want) n = want;
+                    for (uint32_t i = 0; i < n; i++) ((uint32_t *)span)[i] = next + i;
+                    spsc_ring_write_commit(&ring, n);
+                }
+                }
+                if (spsc_ring_count(&ring) > capacity) producerErrors++;
+                if (n == 0) std::this_thread::yield();
+                next += n;
+            }
+        });
+
+        std::mt19937 r(consumerSeed);
+        uint32_t expected = 0, block[2048];
+        while (expected < count)
+        {
+            uint32_t want = 1 + r() % 2048, n = 0;
+            switch (r() % 3)
+            {
+            case 0:
+                n = spsc_ring_pop(&ring, block) ? 1 : 0;
+                if (n && block[0] != expected) errors++;
+                break;
+            case 1:
+                n = spsc_ring_pop_n(&ring, block, want);
+                for (uint32_t i = 0; i < n; i++) if (block[i] != expected + i) errors++;
+                break;
+            default:
+            {
+                const void *span;
+                n = spsc_ring_read_span(&ring, &span);
+                if (n > want) n = want;
+                for (uint32_t i = 0; i < n; i++) if (((const uint32_t *)span)[i] != expected + i) errors++;
+                spsc_ring_read_commit(&ring, n);
+            }
+            }
+            if (n == 0) std::this_thread::yield();
+            expected += n;
+        }
+        producer.join();
+        if (!spsc_ring_empty(&ring)) errors++;
+        errors += producerErrors;
+        rounds++;
+        moved += count;
+    }
+    return errors;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: ringbench [--items n] [--capacity n] [--stress seconds]\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t items = 50000000;
+    uint32_t capacity = 1024;
+    double stressSeconds = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--items") == 0 && i + 1 < argc) items = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc) capacity = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc) stressSeconds = atof(argv[++i]);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+    {
+        fprintf(stderr, "the capacity must be a power of two\n");
+        return 1;
+    }
+
+    bool ok = true;
+    for (Mode mode : {SINGLE, BULK, SPAN, TEMPLATE})
+    {
+        Result r = mode == TEMPLATE ? run_template(items) : run_c(mode, items, capacity);
+        size_t size = mode == TEMPLATE ? sizeof(Frame) : sizeof(uint32_t);
+        printf("%-8s %6.1f M elements/s %8.1f MB/s %s\n", MODE_NAMES[mode], items / r.seconds / 1e6, items * size / r.seconds / 1e6,
+               r.ok ? "" : "ORDER ERROR");
+        ok = ok && r.ok;
+    }
+
+    if (stressSeconds > 0)
+    {
+        uint64_t rounds = 0, moved = 0;
+        uint64_t errors = stress(stressSeconds, rounds, moved);
+        printf("Stress: %llu rounds, %llu elements, %llu errors\n", (unsigned long long)rounds, (unsigned long long)moved, (unsigned long long)errors);
+        ok = ok && errors == 0;
+    }
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,476 @@
+/**
+  @file telemetry_store.cpp
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Almacen de telemetria indexado por tiempo y por posicion. Los registros se guardan en bloques por
+  columnas con un indice al final (rango de hora, caja de posicion y estadisticas de cada bloque, y una
+  grilla de celdas), asi una consulta por rango de hora, por caja o por radio solo lee los bloques que
+  la tocan, y los agregados por ventana usan los resumenes de los bloques completos sin leerlos.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+#include "telemetry_store.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Little endian host layout, the files are meant for the same PC tools that write them
+static const char STORE_MAGIC[8] = {'T', 'L', 'M', 'S', 'T', 'O', 'R', '1'};
+static const size_t ROW_BYTES = sizeof(int64_t) + 2 * sizeof(double) + 9 * sizeof(float) + sizeof(uint32_t);
+static const size_t MAX_LOOKUP_CELLS = 4096;  // Larger boxes use the block boxes instead of the grid
+
+struct StoreHeader
+{
+    char magic[8];
+    uint32_t blockRows, flags;  // flags bit 0: block times never go back
+    uint64_t rows, indexOffset;
+    uint32_t blockCount, pad;
+    uint64_t cellCount;
+    double cellDeg;
+};
+
+static_assert(sizeof(AxisStats) == 24, "AxisStats is written to disk as is");
+static_assert(sizeof(BlockInfo) == 64 + 6 * sizeof(AxisStats), "BlockInfo is written to disk as is");
+
+void AxisStats::reset()
+{
+    min = INFINITY;
+    max = -INFINITY;
+    sum = sumSq = 0;
+}
+
+void AxisStats::add(float v)
+{
+    if (v < min) min = v;
+    if (v > max) max = v;
+    sum += v;
+    sumSq += (double)v * v;
+}
+
+void AxisStats::merge(const AxisStats &other)
+{
+    if (other.min < min) min = other.min;
+    if (other.max > max) max = other.max;
+    sum += other.sum;
+    sumSq += other.sumSq;
+}
+
+/**
+ * @brief Celda de la grilla que contiene una posicion.
+ *
+ * @return uint64_t retorna la fila de la celda en los 32 bits altos y la columna en los bajos.
+ */
+uint64_t store_cell_key(double lat, double lon, double cellDeg)
+{
+    uint32_t row = (uint32_t)((int64_t)floor(lat / cellDeg) + 0x80000000ll);
+    uint32_t col = (uint32_t)((int64_t)floor(lon / cellDeg) + 0x80000000ll);
+    return (uint64_t)row << 32 | col;
+}
+
+/**
+ * @brief Distancia sobre la esfera (haversine) entre dos posiciones.
+ *
+ * @return double retorna la distancia en metros.
+ */
+double store_distance_m(double lat1, double lon1, double lat2, double lon2)
+{
+    const double rad = M_PI / 180, earth = 6371000;
+    double dLat = (lat2 - lat1) * rad, dLon = (lon2 - lon1) * rad;
+    double a = sin(dLat / 2) * sin(dLat / 2) + cos(lat1 * rad) * cos(lat2 * rad) * sin(dLon / 2) * sin(dLon / 2);
+    return 2 * earth * asin(std::min(1.0, sqrt(a)));
+}
+
+StoreWriter::~StoreWriter()
+{
+    if (file) fclose(file);
+}
+
+/**
+ * @brief Crea el archivo.
+ *
+ * @param path ruta del archivo.
+ * @param error mensaje si no se pudo crear.
+ * @param blockRows filas por bloque.
+ * @param cellDeg lado de una celda de la grilla, en grados.
+ * @return bool retorna false si no se pudo crear.
+ */
+bool StoreWriter::open(const std::string &path, std::string &error, uint32_t blockRows, double cellDeg)
+{
+    file = fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        error = "cannot create " + path;
+        return false;
+    }
+    this->blockRows = blockRows;
+    this->cellDeg = cellDeg;
+    StoreHeader header = {};
+    fwrite(&header, sizeof(header), 1, file);  // Rewritten by close()
+    pending.reserve(blockRows);
+    return true;
+}
+
+/**
+ * @brief Agrega una fila. Las filas deberian llegar en orden de hora; si no, las consultas por hora
+ * recorren todo el indice en vez de buscarlo por biseccion, pero siguen siendo correctas.
+ */
+void StoreWriter::add(const StoreRow &row)
+{
+    if (row.t_us < lastTime) sorted = false;
+    lastTime = row.t_us;
+    pending.push_back(row);
+    total++;
+    if (pending.size() == blockRows) flush_block();
+}
+
+/**
+ * @brief Escribe el bloque pendiente por columnas y guarda su resumen.
+ */
+void StoreWriter::flush_block()
+{
+    if (pending.empty()) return;
+
+    const size_t n = pending.size();
+    BlockInfo info = {};
+    info.offset = ftello(file);
+    info.rows = n;
+    info.tMin = INT64_MAX;
+    info.tMax = INT64_MIN;
+    info.latMin = info.lonMin = INFINITY;
+    info.latMax = info.lonMax = -INFINITY;
+    for (int i = 0; i < 3; i++)
+    {
+        info.acc[i].reset();
+        info.gyro[i].reset();
+    }
+
+    buffer.resize(n * ROW_BYTES);
+    uint8_t *p = buffer.data();
+    auto column = [&](auto get, size_t size) {
+        for (const StoreRow &r : pending)
+        {
+            auto v = get(r);
+            memcpy(p, &v, size);
+            p += size;
+        }
+    };
+    column([](const StoreRow &r) { return r.t_us; }, 8);
+    column([](const StoreRow &r) { return r.lat; }, 8);
+    column([](const StoreRow &r) { return r.lon; }, 8);
+    for (int i = 0; i < 3; i++) column([i](const StoreRow &r) { return r.acc[i]; }, 4);
+    for (int i = 0; i < 3; i++) column([i](const StoreRow &r) { return r.gyro[i]; }, 4);
+    for (int i = 0; i < 3; i++) column([i](const StoreRow &r) { return r.mag[i]; }, 4);
+    column([](const StoreRow &r) { return r.seq; }, 4);
+    fwrite(buffer.data(), 1, buffer.size(), file);
+
+    const uint32_t index = blocks.size();
+    uint64_t lastCell = UINT64_MAX;
+    for (const StoreRow &r : pending)
+    {
+        info.tMin = std::min(info.tMin, r.t_us);
+        info.tMax = std::max(info.tMax, r.t_us);
+        info.latMin = std::min(info.latMin, r.lat);
+        info.latMax = std::max(info.latMax, r.lat);
+        info.lonMin = std::min(info.lonMin, r.lon);
+        info.lonMax = std::max(info.lonMax, r.lon);
+        for (int i = 0; i < 3; i++)
+        {
+            info.acc[i].add(r.acc[i]);
+            info.gyro[i].add(r.gyro[i]);
+        }
+        uint64_t cell = store_cell_key(r.lat, r.lon, cellDeg);
+        if (cell != lastCell) cells.push_back({cell, index});  // Consecutive rows are mostly in the same cell
+        lastCell = cell;
+    }
+    blocks.push_back(info);
+    pending.clear();
+
+    // Keeps the postings of a long log from growing with the rows
+    size_t first = cells.size();
+    while (first > 0 && cells[first - 1].second == index) first--;
+    std::sort(cells.begin() + first, cells.end());
+    cells.erase(std::unique(cells.begin() + first, cells.end()), cells.end());
+}
+
+/**
+ * @brief Escribe el ultimo bloque, el indice y el encabezado.
+ *
+ * @return bool retorna false si hubo un error de escritura.
+ */
+bool StoreWriter::close(std::string &error)
+{
+    if (!file) return false;
+    flush_block();
+    std::sort(cells.begin(), cells.end());
+
+    StoreHeader header = {};
+    memcpy(header.magic, STORE_MAGIC, sizeof(header.magic));
+    header.blockRows = blockRows;
+    header.flags = sorted ? 1 : 0;
+    header.rows = total;
+    header.indexOffset = ftello(file);
+    header.blockCount = blocks.size();
+    header.cellCount = cells.size();
+    header.cellDeg = cellDeg;
+
+    fwrite(blocks.data(), sizeof(BlockInfo), blocks.size(), file);
+    for (const auto &c : cells)
+    {
+        fwrite(&c.first, sizeof(c.first), 1, file);
+        fwrite(&c.second, sizeof(c.second), 1, file);
+    }
+    fseeko(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    file = nullptr;
+    if (!ok) error = "write error";
+    return ok;
+}
+
+StoreReader::~StoreReader()
+{
+    if (fd >= 0) ::close(fd);
+}
+
+/**
+ * @brief Abre un almacen y carga el indice (los datos se leen cuando una consulta los necesita).
+ *
+ * @return bool retorna false si el archivo no existe o no es un almacen.
+ */
+bool StoreReader::open(const std::string &path, std::string &error)
+{
+    fd = ::open(path.c_str(), O_RDONLY);
+    StoreHeader header;
+    if (fd < 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header) || memcmp(header.magic, STORE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        error = path + " is not a telemetry store";
+        return false;
+    }
+    total = header.rows;
+    blockRows = header.blockRows;
+    cellDeg = header.cellDeg;
+    sorted = header.flags & 1;
+
+    blocks.resize(header.blockCount);
+    size_t blockBytes = blocks.size() * sizeof(BlockInfo);
+    std::vector<uint8_t> cellBytes(header.cellCount * 12);
+    if (pread(fd, blocks.data(), blockBytes, header.indexOffset) != (ssize_t)blockBytes ||
+        pread(fd, cellBytes.data(), cellBytes.size(), header.indexOffset + blockBytes) != (ssize_t)cellBytes.size())
+    {
+        error = path + " has a truncated index";
+        return false;
+    }
+    cells.resize(header.cellCount);
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        memcpy(&cells[i].first, &cellBytes[i * 12], 8);
+        memcpy(&cells[i].second, &cellBytes[i * 12 + 8], 4);
+    }
+    return true;
+}
+
+/**
+ * @brief Lee un bloque del disco y arma sus filas.
+ *
+ * Con imuOnly solo se leen las columnas de hora, acc y gyro (la mitad de los bytes), que son las que
+ * usan los agregados; el resto de la fila queda en cero.
+ */
+void StoreReader::read_block(uint32_t index, std::vector<StoreRow> &rows, bool imuOnly)
+{
+    const BlockInfo &info = blocks[index];
+    const size_t n = info.rows;
+    buffer.resize(n * ROW_BYTES);
+    rows.assign(n, StoreRow());
+    blocksRead++;
+
+    // Column offsets inside the block, in units of n bytes: t 0, lat 8, lon 16, acc 24, gyro 36, mag 48, seq 60
+    bool ok;
+    if (imuOnly)
+    {
+        ok = pread(fd, buffer.data(), n * 8, info.offset) == (ssize_t)(n * 8) &&
+             pread(fd, buffer.data() + n * 24, n * 24, info.offset + n * 24) == (ssize_t)(n * 24);
+    }
+    else
+    {
+        ok = pread(fd, buffer.data(), buffer.size(), info.offset) == (ssize_t)buffer.size();
+    }
+    if (!ok)
+    {
+        rows.clear();
+        return;
+    }
+
+    const uint8_t *p = buffer.data();
+    for (size_t i = 0; i < n; i++) memcpy(&rows[i].t_us, p + i * 8, 8);
+    for (int k = 0; k < 3; k++)
+    {
+        for (size_t i = 0; i < n; i++) memcpy(&rows[i].acc[k], p + n * (24 + 4 * k) + i * 4, 4);
+        for (size_t i = 0; i < n; i++) memcpy(&rows[i].gyro[k], p + n * (36 + 4 * k) + i * 4, 4);
+    }
+    if (imuOnly) return;
+    for (size_t i = 0; i < n; i++)
+    {
+        memcpy(&rows[i].lat, p + n * 8 + i * 8, 8);
+        memcpy(&rows[i].lon, p + n * 16 + i * 8, 8);
+        memcpy(&rows[i].seq, p + n * 60 + i * 4, 4);
+    }
+    for (int k = 0; k < 3; k++)
+    {
+        for (size_t i = 0; i < n; i++) memcpy(&rows[i].mag[k], p + n * (48 + 4 * k) + i * 4, 4);
+    }
+}
+
+/**
+ * @brief Bloques con alguna fila en [from, to). Si las horas estan ordenadas se busca por biseccion.
+ */
+void StoreReader::blocks_in_time(int64_t from, int64_t to, std::vector<uint32_t> &out) const
+{
+    size_t first = 0, last = blocks.size();
+    if (sorted)
+    {
+        first = std::partition_point(blocks.begin(), blocks.end(), [from](const BlockInfo &b) { return b.tMax < from; }) - blocks.begin();
+        last = std::partition_point(blocks.begin() + first, blocks.end(), [to](const BlockInfo &b) { return b.tMin < to; }) - blocks.begin();
+    }
+    for (size_t i = first; i < last; i++)
+    {
+        if (blocks[i].tMax >= from && blocks[i].tMin < to) out.push_back(i);
+    }
+}
+
+/**
+ * @brief Bloques con alguna fila dentro de la caja, buscados en la grilla o en las cajas de los bloques.
+ */
+void StoreReader::blocks_in_bbox(double latMin, double latMax, double lonMin, double lonMax, std::vector<uint32_t> &out) const
+{
+    uint64_t low = store_cell_key(latMin, lonMin, cellDeg), high = store_cell_key(latMax, lonMax, cellDeg);
+    uint64_t rowsSpan = (high >> 32) - (low >> 32) + 1, colsSpan = (uint32_t)high - (uint32_t)low + 1;
+
+    if (rowsSpan * colsSpan <= MAX_LOOKUP_CELLS)
+    {
+        for (uint64_t row = low >> 32; row <= high >> 32; row++)
+        {
+            auto begin = std::lower_bound(cells.begin(), cells.end(), std::make_pair(row << 32 | (uint32_t)low, 0u));
+            auto end = std::upper_bound(begin, cells.end(), std::make_pair(row << 32 | (uint32_t)high, UINT32_MAX));
+            for (auto it = begin; it != end; ++it) out.push_back(it->second);
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+    else
+    {
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            const BlockInfo &b = blocks[i];
+            if (b.latMax >= latMin && b.latMin <= latMax && b.lonMax >= lonMin && b.lonMin <= lonMax) out.push_back(i);
+        }
+    }
+}
+
+/**
+ * @brief Filas con hora en [from, to).
+ */
+void StoreReader::query_time(int64_t from, int64_t to, const RowCallback &onRow)
+{
+    std::vector<uint32_t> selected;
+    std::vector<StoreRow> rows;
+    blocks_in_time(from, to, selected);
+    for (uint32_t b : selected)
+    {
+        read_block(b, rows);
+        for (const StoreRow &r : rows)
+            if (r.t_us >= from && r.t_us < to) onRow(r);
+    }
+}
+
+/**
+ * @brief Filas dentro de una caja de latitud y longitud (bordes incluidos).
+ */
+void StoreReader::query_bbox(double latMin, double latMax, double lonMin, double lonMax, const RowCallback &onRow)
+{
+    std::vector<uint32_t> selected;
+    std::vector<StoreRow> rows;
+    blocks_in_bbox(latMin, latMax, lonMin, lonMax, selected);
+    for (uint32_t b : selected)
+    {
+        read_block(b, rows);
+        for (const StoreRow &r : rows)
+            if (r.lat >= latMin && r.lat <= latMax && r.lon >= lonMin && r.lon <= lonMax) onRow(r);
+    }
+}
+
+/**
+ * @brief Filas a menos de cierta distancia de un punto. Busca en la caja que contiene el circulo y
+ * filtra por la distancia real.
+ */
+void StoreReader::query_radius(double lat, double lon, double meters, const RowCallback &onRow)
+{
+    const double degLat = meters / 111194.9;  // Meters per degree on the 6371 km sphere
+    const double cosLat = std::max(cos(lat * M_PI / 180), 1e-6);
+    const double degLon = std::min(180.0, degLat / cosLat);
+    query_bbox(lat - degLat, lat + degLat, lon - degLon, lon + degLon, [&](const StoreRow &r) {
+        if (store_distance_m(lat, lon, r.lat, r.lon) <= meters) onRow(r);
+    });
+}
+
+/**
+ * @brief Minimo, maximo, suma y suma de cuadrados de acc y gyro por ventanas de tiempo.
+ *
+ * Las ventanas empiezan en from y duran window microsegundos. Un bloque que cae entero en una ventana
+ * se suma con su resumen del indice; solo se leen los bloques que cruzan un borde.
+ *
+ * @return std::vector<WindowStats> retorna una entrada por ventana, tambien las vacias.
+ */
+std::vector<WindowStats> StoreReader::aggregate(int64_t from, int64_t to, int64_t window)
+{
+    std::vector<WindowStats> out;
+    if (window <= 0 || to <= from) return out;
+
+    const size_t count = (to - from + window - 1) / window;
+    out.resize(count);
+    for (size_t w = 0; w < count; w++)
+    {
+        out[w].start = from + (int64_t)w * window;
+        out[w].end = std::min(to, out[w].start + window);
+        out[w].count = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            out[w].acc[i].reset();
+            out[w].gyro[i].reset();
+        }
+    }
+
+    std::vector<uint32_t> selected;
+    std::vector<StoreRow> rows;
+    blocks_in_time(from, to, selected);
+    for (uint32_t b : selected)
+    {
+        const BlockInfo &info = blocks[b];
+        if (info.tMin >= from && info.tMax < to && (info.tMin - from) / window == (info.tMax - from) / window)
+        {
+            WindowStats &w = out[(info.tMin - from) / window];
+            w.count += info.rows;
+            for (int i = 0; i < 3; i++)
+            {
+                w.acc[i].merge(info.acc[i]);
+                w.gyro[i].merge(info.gyro[i]);
+            }
+            continue;
+        }
+        read_block(b, rows, true);
+        for (const StoreRow &r : rows)
+        {
+            if (r.t_us < from || r.t_us >= to) continue;
+            WindowStats &w = out[(r.t_us - from) / window];
+            w.count++;
+            for (int i = 0; i < 3; i++)
+            {
+                w.acc[i].add(r.acc[i]);
+                w.gyro[i].add(r.gyro[i]);
+            }
+        }
+    }
+    return out;
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifndef telemetry_store_h
+#define telemetry_store_h
+
+const uint32_t STORE_BLOCK_ROWS = 4096;     // Rows per block, the unit that is read from disk
+const double STORE_CELL_DEG = 0.001;        // Side of a spatial grid cell, about 111 m of latitude
+
+/**
+ * @brief Una fila guardada: hora, posicion e IMU en unidades fisicas.
+ */
+struct StoreRow
+{
+    int64_t t_us;      // UTC (or device time) in microseconds
+    double lat, lon;
+    float acc[3], gyro[3], mag[3];
+    uint32_t seq;
+};
+
+/**
+ * @brief Minimo, maximo, suma y suma de cuadrados de un eje.
+ */
+struct AxisStats
+{
+    float min, max;
+    double sum, sumSq;
+
+    void reset();
+    void add(float v);
+    void merge(const AxisStats &other);
+};
+
+/**
+ * @brief Resumen de un bloque, guardado en el indice al final del archivo.
+ *
+ * Con el rango de hora y de posicion se decide si hay que leer el bloque, y con las estadisticas de
+ * acc y gyro los agregados usan el bloque completo sin leerlo.
+ */
+struct BlockInfo
+{
+    uint64_t offset;
+    uint32_t rows, pad;
+    int64_t tMin, tMax;
+    double latMin, latMax, lonMin, lonMax;
+    AxisStats acc[3], gyro[3];
+};
+
+/**
+ * @brief Agregados de una ventana de tiempo.
+ */
+struct WindowStats
+{
+    int64_t start, end;
+    uint64_t count;
+    AxisStats acc[3], gyro[3];
+};
+
+/**
+ * @brief Escribe un almacen de telemetria (.tlm).
+ *
+ * Las filas se agrupan en bloques de STORE_BLOCK_ROWS guardados por columnas. Al cerrar se escribe
+ * el indice: el resumen de cada bloque y las parejas (celda de la grilla, bloque) ordenadas.
+ */
+class StoreWriter
+{
+public:
+    ~StoreWriter();
+    bool open(const std::string &path, std::string &error, uint32_t blockRows = STORE_BLOCK_ROWS, double cellDeg = STORE_CELL_DEG);
+    void add(const StoreRow &row);
+    bool close(std::string &error);
+    uint64_t rows() const { return total; }
+
+private:
+    void flush_block();
+
+    FILE *file = nullptr;
+    uint32_t blockRows = STORE_BLOCK_ROWS;
+    double cellDeg = STORE_CELL_DEG;
+    uint64_t total = 0;
+    bool sorted = true;
+    int64_t lastTime = INT64_MIN;
+    std::vector<StoreRow> pending;
+    std::vector<BlockInfo> blocks;
+    std::vector<std::pair<uint64_t, uint32_t>> cells;
+    std::vector<uint8_t> buffer;
+};
+
+/**
+ * @brief Lee un almacen de telemetria y responde consultas leyendo solo los bloques necesarios.
+ */
+class StoreReader
+{
+public:
+    typedef std::function<void(const StoreRow &)> RowCallback;
+
+    ~StoreReader();
+    bool open(const std::string &path, std::string &error);
+    uint64_t rows() const { return total; }
+    const std::vector<BlockInfo> &block_index() const { return blocks; }
+    uint64_t blocks_read() const { return blocksRead; }
+
+    void query_time(int64_t from, int64_t to, const RowCallback &onRow);
+    void query_bbox(double latMin, double latMax, double lonMin, double lonMax, const RowCallback &onRow);
+    void query_radius(double lat, double lon, double meters, const RowCallback &onRow);
+    std::vector<WindowStats> aggregate(int64_t from, int64_t to, int64_t window);
+
+private:
+    void read_block(uint32_t index, std::vector<StoreRow> &rows, bool imuOnly = false);
+    void blocks_in_time(int64_t from, int64_t to, std::vector<uint32_t> &out) const;
+    void blocks_in_bbox(double latMin, double latMax, double lonMin, double lonMax, std::vector<uint32_t> &out) const;
+
+    int fd = -1;
+    uint64_t total = 0;
+    uint32_t blockRows = 0;
+    double cellDeg = STORE_CELL_DEG;
+    bool sorted = false;
+    uint64_t blocksRead = 0;
+    std::vector<BlockInfo> blocks;
+    std::vector<std::pair<uint64_t, uint32_t>> cells;
+    std::vector<uint8_t> buffer;
+};
+
+uint64_t store_cell_key(double lat, double lon, double cellDeg);
+double store_distance_m(double lat1, double lon1, double lat2, double lon2);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,259 @@
+/**
+  @file calibration.c
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+    Este archivo tiene los algoritmos de calibracion de los sensores del MPU9250: estadistica acumulada
+    (Welford) para los offsets del acelerometro y del giroscopio con parada temprana, y el ajuste de
+    elipsoide (hierro duro y blando) del magnetometro. No depende del SDK, por lo que tambien se compila
+    en el PC para probar los algoritmos con datos grabados.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+
+#include <math.h>
+#include <string.h>
+#include "calibration.h"
+
+/**
+ * @brief Reinicia la estadistica acumulada
+ *
+ * @param s estadistica que se quiere reiniciar.
+ */
+void calib_stats_reset(calib_stats_t *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+/**
+ * @brief Agrega una lectura a la estadistica
+ *
+ * Usa el algoritmo de Welford, que no se desborda ni pierde precision sin importar el numero de lecturas.
+ *
+ * @param s estadistica acumulada.
+ * @param v lectura de los tres ejes.
+ */
+void calib_stats_add(calib_stats_t *s, const int16_t v[3])
+{
+    s->n++;
+    for (int i = 0; i < 3; i++) {
+        float delta = v[i] - s->mean[i];
+        s->mean[i] += delta / s->n;
+        s->m2[i] += delta * (v[i] - s->mean[i]);
+    }
+}
+
+/**
+ * @brief Varianza de cada eje
+ *
+ * @param s estadistica acumulada.
+ * @param var arreglo donde se guardara la varianza muestral de cada eje.
+ */
+void calib_stats_variance(const calib_stats_t *s, float var[3])
+{
+    for (int i = 0; i < 3; i++) {
+        var[i] = s->n > 1 ? s->m2[i] / (s->n - 1) : 0;
+    }
+}
+
+/**
+ * @brief Indica si la media ya es estable
+ *
+ * La media se considera estable cuando su error estandar (sqrt(var / n)) es menor que la tolerancia en todos los ejes.
+ *
+ * @param s estadistica acumulada.
+ * @param tolerance error estandar aceptado, en cuentas crudas.
+ * @return bool retorna true si se puede dejar de leer.
+ */
+bool calib_stats_converged(const calib_stats_t *s, float tolerance)
+{
+    if (s->n < CALIB_MIN_SAMPLES) {
+        return false;
+    }
+
+    float var[3];
+    calib_stats_variance(s, var);
+    for (int i = 0; i < 3; i++) {
+        if (var[i] > tolerance * tolerance * s->n) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Offset (media redondeada) de cada eje
+ *
+ * @param s estadistica acumulada.
+ * @param offset arreglo donde se guardara el offset de cada eje.
+ */
+void calib_stats_offset(const calib_stats_t *s, int16_t offset[3])
+{
+    for (int i = 0; i < 3; i++) {
+        offset[i] = (int16_t)lroundf(s->mean[i]);
+    }
+}
+
+/**
+ * @brief Reinicia el acumulador del ajuste de elipsoide
+ *
+ * @param e acumulador que se quiere reiniciar.
+ */
+void calib_ellipsoid_reset(calib_ellipsoid_t *e)
+{
+    memset(e, 0, sizeof(*e));
+    for (int i = 0; i < 3; i++) {
+        e->min[i] = INT16_MAX;
+        e->max[i] = INT16_MIN;
+    }
+}
+
+/**
+ * @brief Agrega una lectura del magnetometro al ajuste
+ *
+ * @param e acumulador del ajuste.
+ * @param v lectura cruda de los tres ejes.
+ */
+void calib_ellipsoid_add(calib_ellipsoid_t *e, const int16_t v[3])
+{
+    double x = v[0] / CALIB_MAG_SCALE, y = v[1] / CALIB_MAG_SCALE, z = v[2] / CALIB_MAG_SCALE;
+    double row[6] = {x * x, y * y, z * z, x, y, z};
+
+    int k = 0;
+    for (int i = 0; i < 6; i++) {
+        for (int j = i; j < 6; j++) {
+            e->ata[k++] += row[i] * row[j];
+        }
+        e->atb[i] += row[i];
+    }
+
+    for (int i = 0; i < 3; i++) {
+        if (v[i] < e->min[i]) e->min[i] = v[i];
+        if (v[i] > e->max[i]) e->max[i] = v[i];
+    }
+    e->n++;
+}
+
+/**
+ * @brief Resuelve un sistema lineal de 6x6 por eliminacion gaussiana con pivoteo parcial
+ *
+ * @param m matriz del sistema, se modifica.
+ * @param b lado derecho, se modifica y queda con la solucion.
+ * @return bool retorna false si la matriz es singular.
+ */
+static bool solve6(double m[6][6], double b[6])
+{
+    for (int col = 0; col < 6; col++) {
+        int pivot = col;
+        for (int r = col + 1; r < 6; r++) {
+            if (fabs(m[r][col]) > fabs(m[pivot][col])) pivot = r;
+        }
+        if (fabs(m[pivot][col]) < 1e-12) {
+            return false;
+        }
+        if (pivot != col) {
+            for (int c = 0; c < 6; c++) {
+                double t = m[col][c]; m[col][c] = m[pivot][c]; m[pivot][c] = t;
+            }
+            double t = b[col]; b[col] = b[pivot]; b[pivot] = t;
+        }
+        for (int r = col + 1; r < 6; r++) {
+            double f = m[r][col] / m[col][col];
+            for (int c = col; c < 6; c++) {
+                m[r][c] -= f * m[col][c];
+            }
+            b[r] -= f * b[col];
+        }
+    }
+    for (int r = 5; r >= 0; r--) {
+        for (int c = r + 1; c < 6; c++) {
+            b[r] -= m[r][c] * b[c];
+        }
+        b[r] /= m[r][r];
+    }
+    return true;
+}
+
+/**
+ * @brief Ajusta el elipsoide y calcula la calibracion del magnetometro
+ *
+ * El ajuste es de un elipsoide alineado con los ejes: el centro es el offset de hierro duro y la
+ * diferencia entre los radios es el factor de escala de hierro blando. La calidad combina el residuo
+ * del ajuste con la cobertura de la rotacion (cuanto del diametro se recorrio en cada eje).
+ *
+ * @param e acumulador del ajuste.
+ * @param result estructura donde se guardara la calibracion.
+ * @return bool retorna false si no hay muestras suficientes o la forma no es un elipsoide.
+ */
+bool calib_ellipsoid_solve(const calib_ellipsoid_t *e, calib_mag_t *result)
+{
+    double m[6][6], p[6];
+
+    memset(result, 0, sizeof(*result));
+    if (e->n < CALIB_MIN_SAMPLES) {
+        return false;
+    }
+
+    int k = 0;
+    for (int i = 0; i < 6; i++) {
+        for (int j = i; j < 6; j++) {
+            m[i][j] = m[j][i] = e->ata[k++];
+        }
+        p[i] = e->atb[i];
+    }
+    if (!solve6(m, p)) {
+        return false;
+    }
+
+    // Residual sum of squares straight from the normal equations: p'(A'A)p - 2p'(A'1) + n
+    double rss = e->n;
+    k = 0;
+    for (int i = 0; i < 6; i++) {
+        for (int j = i; j < 6; j++) {
+            rss += (i == j ? 1 : 2) * p[i] * p[j] * e->ata[k++];
+        }
+        rss -= 2 * p[i] * e->atb[i];
+    }
+
+    double center[3], radius[3];
+    double g = 1;
+    for (int i = 0; i < 3; i++) {
+        if (p[i] <= 0) {
+            return false;
+        }
+        center[i] = -p[3 + i] / (2 * p[i]);
+        g += p[i] * center[i] * center[i];
+    }
+    for (int i = 0; i < 3; i++) {
+        radius[i] = sqrt(g / p[i]);
+    }
+    double mean_radius = cbrt(radius[0] * radius[1] * radius[2]);
+
+    float coverage = 1;
+    for (int i = 0; i < 3; i++) {
+        result->offset[i] = center[i] * CALIB_MAG_SCALE;
+        result->scale[i] = mean_radius / radius[i];
+        float span = (e->max[i] - e->min[i]) / (2 * radius[i] * CALIB_MAG_SCALE);
+        if (span < coverage) coverage = span;
+    }
+    result->radius = mean_radius * CALIB_MAG_SCALE;
+
+    // The algebraic residual is about twice the relative radius error
+    result->rms = sqrt(fmax(rss, 0) / e->n) / 2;
+    float fit = 1 - result->rms / 0.1f;
+    result->quality = coverage * (fit > 0 ? fit : 0);
+    return true;
+}
+
+/**
+ * @brief Aplica la calibracion a una lectura del magnetometro
+ *
+ * @param cal calibracion del magnetometro.
+ * @param raw lectura cruda.
+ * @param out arreglo donde se guardara la lectura corregida, en cuentas crudas.
+ */
+void calib_mag_apply(const calib_mag_t *cal, const int16_t raw[3], float out[3])
+{
+    for (int i = 0; i < 3; i++) {
+        out[i] = (raw[i] - cal->offset[i]) * cal->scale[i];
+    }
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef calibration_h
+#define calibration_h
+
+#define CALIB_MIN_SAMPLES 64      // Samples taken before the convergence test is trusted
+#define CALIB_MAG_SCALE 256.0     // Raw mag counts are divided by this before the fit to keep it well conditioned
+
+// Standard error of the offsets, in raw counts, that stops the still calibration. Sized from what the
+// offset is used for against the sensor noise (~100 counts accel, ~20 counts gyro, ~1 count mag RMS)
+#define CALIB_ACC_TOLERANCE 8.0f  // 0.5 mg at +-2 g
+#define CALIB_GYRO_TOLERANCE 4.0f // 0.03 deg/s at +-250 deg/s
+#define CALIB_MAG_TOLERANCE 1.0f  // 0.15 uT, about one count
+
+/**
+ * @brief Estadistica acumulada (Welford) de un sensor de tres ejes.
+ */
+typedef struct {
+    uint32_t n;
+    float mean[3];
+    float m2[3];   // Sum of squared differences from the mean
+} calib_stats_t;
+
+/**
+ * @brief Acumulador del ajuste de elipsoide del magnetometro.
+ *
+ * Guarda las ecuaciones normales del ajuste A x^2 + B y^2 + C z^2 + D x + E y + F z = 1,
+ * por lo que no hace falta guardar las muestras.
+ */
+typedef struct {
+    uint32_t n;
+    double ata[21];  // Upper triangle of the 6x6 normal matrix, row by row
+    double atb[6];
+    int16_t min[3], max[3];
+} calib_ellipsoid_t;
+
+/**
+ * @brief Resultado de la calibracion del magnetometro (hierro duro y blando).
+ *
+ * El valor corregido es (raw - offset) * scale.
+ */
+typedef struct {
+    float offset[3];  // Hard-iron offset in raw counts
+    float scale[3];   // Soft-iron per-axis scale
+    float radius;     // Mean field radius in raw counts
+    float rms;        // Relative RMS residual of the fit
+    float quality;    // 0 (useless) .. 1 (good coverage and small residual)
+} calib_mag_t;
+
+void calib_stats_reset(calib_stats_t *s);
+void calib_stats_add(calib_stats_t *s, const int16_t v[3]);
+void calib_stats_variance(const calib_stats_t *s, float var[3]);
+bool calib_stats_converged(const calib_stats_t *s, float tolerance);
+void calib_stats_offset(const calib_stats_t *s, int16_t offset[3]);
+
+void calib_ellipsoid_reset(calib_ellipsoid_t *e);
+void calib_ellipsoid_add(calib_ellipsoid_t *e, const int16_t v[3]);
+bool calib_ellipsoid_solve(const calib_ellipsoid_t *e, calib_mag_t *result);
+void calib_mag_apply(const calib_mag_t *cal, const int16_t raw[3], float out[3]);
+
+#endif
\ No newline at end of file
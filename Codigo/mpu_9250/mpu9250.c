@@ -26,8 +26,10 @@
 #include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/spi.h"
+#include "hardware/dma.h"
 #include <math.h>
 #include "mpu9250.h"
+#include "calibration.h"
 
 
 #define PIN_MISO 4
@@ -38,32 +40,47 @@
 #define SPI_PORT spi0
 #define READ_BIT 0x80
 
+#define REG_ACCEL_XOUT_H 0x3B // First register of the accel/temp/gyro/ext block
+#define REG_MAG_OUT 0x4A      // Magnetometer data mirrored in the external sensor registers
+#define REG_SMPLRT_DIV 0x19   // Output rate = 1 kHz / (1 + divider) with the DLPF on
+#define REG_CONFIG 0x1A
+#define REG_ACCEL_CONFIG2 0x1D
+#define REG_INT_PIN_CFG 0x37
+#define REG_INT_ENABLE 0x38
+#define BURST_LEN 21          // 0x3B..0x4F: accel(6) temp(2) gyro(6) ext(7)
+
+#define CALIB_PERIOD_US 1000      // Accel output rate, reading faster only repeats samples
+#define CALIB_MAG_PERIOD_US 10000 // Magnetometer output rate (100 Hz)
+
+const mpu9250_dev_t mpu9250_default_dev = {SPI_PORT, PIN_CS}; // Board wiring used by the single IMU examples
+
 /**
  * @brief Usado para seleccionar el chip
  *
- * Esta función se usa para seleccionar el chip MPU9250 para poder enviarle datos. no tiene parametros ni retorna nada.
+ * Esta función se usa para seleccionar el chip MPU9250 para poder enviarle datos. no retorna nada.
  *
+ * @param dev dispositivo que se quiere seleccionar.
  */
 
-void cs_select() //Used to select the chip
+static void cs_select(const mpu9250_dev_t *dev) //Used to select the chip
 {
     asm volatile("nop \n nop \n nop"); // Small delay
-    gpio_put(PIN_CS, 0); // Active low
+    gpio_put(dev->pin_cs, 0); // Active low
     asm volatile("nop \n nop \n nop"); // Small delay
 }
 
 /**
  * @brief Usado para deseleccionar el chip
  *
- * Esta función se usa para deseleccionar el chip MPU9250 para poder enviarle datos. no tiene parametros ni retorna nada.
+ * Esta función se usa para deseleccionar el chip MPU9250 para poder enviarle datos. no retorna nada.
  *
- * 
+ * @param dev dispositivo que se quiere deseleccionar.
  */
 
-void cs_deselect() //Used to deselect the chip
+static void cs_deselect(const mpu9250_dev_t *dev) //Used to deselect the chip
 {
     asm volatile("nop \n nop \n nop");
-    gpio_put(PIN_CS, 1);
+    gpio_put(dev->pin_cs, 1);
     asm volatile("nop \n nop \n nop");
 }
 
@@ -76,13 +93,25 @@ void cs_deselect() //Used to deselect the chip
  */
 //Used to reset the mpu
 void mpu9250_reset() 
+{
+    mpu9250_reset_dev(&mpu9250_default_dev);
+}
+
+/**
+ * @brief Resetea un MPU9250 concreto
+ *
+ * Esta función se usa para resetear el MPU9250 indicado por el descriptor. no retorna nada.
+ *
+ * @param dev dispositivo que se quiere resetear.
+ */
+void mpu9250_reset_dev(const mpu9250_dev_t *dev)
 {
     // Two byte reset. First byte register, second byte data
     // There are a load more options to set up the device in different ways that could be added here
     uint8_t buf[] = {0x6B, 0x00};
-    cs_select();
-    spi_write_blocking(SPI_PORT, buf, 2);
-    cs_deselect();
+    cs_select(dev);
+    spi_write_blocking(dev->spi, buf, 2);
+    cs_deselect(dev);
 }
 
 /**
@@ -96,18 +125,31 @@ void mpu9250_reset()
  */
 //Used to read the registers of the mpu
 void read_registers(uint8_t reg, uint8_t *buf, uint16_t len) 
+{
+    read_registers_dev(&mpu9250_default_dev, reg, buf, len);
+}
+
+/**
+ * @brief Lee los registros de un MPU9250 concreto
+ *
+ * Esta función se usa para leer los registros del MPU9250 indicado por el descriptor. no retorna nada.
+ *
+ * @param dev dispositivo que se quiere leer.
+ * @param reg registro que se quiere leer.
+ * @param buf arreglo donde se guardaran los datos.
+ * @param len longitud de los datos que se quieren leer.
+ */
+void read_registers_dev(const mpu9250_dev_t *dev, uint8_t reg, uint8_t *buf, uint16_t len)
 {
     // For this particular device, we send the device the register we want to read
     // first, then subsequently read from the device. The register is auto incrementing
     // so we don't need to keep sending the register we want, just the first.
 
     reg |= READ_BIT;
-    cs_select();
-    spi_write_blocking(SPI_PORT, &reg, 1);
-    sleep_ms(10);
-    spi_read_blocking(SPI_PORT, 0, buf, len);
-    cs_deselect();
-    sleep_ms(10);
+    cs_select(dev);
+    spi_write_blocking(dev->spi, &reg, 1);
+    spi_read_blocking(dev->spi, 0, buf, len);
+    cs_deselect(dev);
 }
 
 /**
@@ -119,11 +161,22 @@ void read_registers(uint8_t reg, uint8_t *buf, uint16_t len)
  */
 //Used to get the raw acceleration values from the mpu
 void mpu9250_read_raw_mag(int16_t mag[3]) 
+{
+    mpu9250_read_raw_mag_dev(&mpu9250_default_dev, mag);
+}
+
+/**
+ * @brief Obten los valores de magnetometro de un MPU9250 concreto
+ *
+ * @param dev dispositivo que se quiere leer.
+ * @param mag arreglo donde se guardaran los valores de magnetometro.
+ */
+void mpu9250_read_raw_mag_dev(const mpu9250_dev_t *dev, int16_t mag[3])
 {
     uint8_t buffer[6];
 
     // Start reading acceleration registers from register 0x3B for 6 bytes
-    read_registers(0x4A, buffer, 6);
+    read_registers_dev(dev, REG_MAG_OUT, buffer, 6);
 
     for (int i = 0; i < 3; i++) {
         mag[i] = (buffer[i * 2] << 8 | buffer[(i * 2) + 1]);
@@ -138,21 +191,13 @@ void mpu9250_read_raw_mag(int16_t mag[3])
  * Y hacer una media de los valores de magnetometro.
  *
  * @param magCal arreglo donde se guardaran los valores de calibracion del magnetometro.
- * @param loop numero de veces que se va a calibrar el magnetometro.
+ * @param loop numero maximo de lecturas; se detiene antes si la media ya es estable.
  */
 void calibrate_mag(int16_t magCal[3], int loop)  //Used to calibrate the acc. The gyro must be still while calibration happens
 {
-    int16_t temp[3];
-    for (int i = 0; i < loop; i++)
-    {
-        mpu9250_read_raw_mag(temp);
-        magCal[0] += temp[0];
-        magCal[1] += temp[1];
-        magCal[2] += temp[2];
-    }
-    magCal[0] /= loop;
-    magCal[1] /= loop;
-    magCal[2] /= loop;
+    calib_stats_t acc, gyro, mag;
+    calibrate_still_dev(&mpu9250_default_dev, &acc, &gyro, &mag, loop);
+    calib_stats_offset(&mag, magCal);
 }
 
 /**
@@ -163,11 +208,22 @@ void calibrate_mag(int16_t magCal[3], int loop)  //Used to calibrate the acc. Th
  * @param accel arreglo donde se guardaran los valores de aceleracion.
  */
 void mpu9250_read_raw_accel(int16_t accel[3]) //Used to get the raw acceleration values from the mpu
+{
+    mpu9250_read_raw_accel_dev(&mpu9250_default_dev, accel);
+}
+
+/**
+ * @brief Leer los valores de aceleracion de un MPU9250 concreto
+ *
+ * @param dev dispositivo que se quiere leer.
+ * @param accel arreglo donde se guardaran los valores de aceleracion.
+ */
+void mpu9250_read_raw_accel_dev(const mpu9250_dev_t *dev, int16_t accel[3])
 {
     uint8_t buffer[6];
 
     // Start reading acceleration registers from register 0x3B for 6 bytes
-    read_registers(0x3B, buffer, 6);
+    read_registers_dev(dev, REG_ACCEL_XOUT_H, buffer, 6);
 
     for (int i = 0; i < 3; i++) {
         accel[i] = (buffer[i * 2] << 8 | buffer[(i * 2) + 1]);
@@ -182,21 +238,13 @@ void mpu9250_read_raw_accel(int16_t accel[3]) //Used to get the raw acceleration
  * Y hacer una media de los valores de aceleracion.
  *
  * @param accCal arreglo donde se guardaran los valores de calibracion del acelerometro.
- * @param loop numero de veces que se va a calibrar el acelerometro.
+ * @param loop numero maximo de lecturas; se detiene antes si la media ya es estable.
  */
 void calibrate_acc(int16_t accCal[3], int loop)  //Used to calibrate the acc. The gyro must be still while calibration happens
 {
-    int16_t temp[3];
-    for (int i = 0; i < loop; i++)
-    {
-        mpu9250_read_raw_accel(temp);
-        accCal[0] += temp[0];
-        accCal[1] += temp[1];
-        accCal[2] += temp[2];
-    }
-    accCal[0] /= loop;
-    accCal[1] /= loop;
-    accCal[2] /= loop;
+    calib_stats_t acc, gyro, mag;
+    calibrate_still_dev(&mpu9250_default_dev, &acc, &gyro, &mag, loop);
+    calib_stats_offset(&acc, accCal);
 }
 
 /**
@@ -207,10 +255,21 @@ void calibrate_acc(int16_t accCal[3], int loop)  //Used to calibrate the acc. Th
  * @param gyro arreglo donde se guardaran los valores de giroscopio.
  */
 void mpu9250_read_raw_gyro(int16_t gyro[3]) //Used to get the raw gyro values from the mpu
+{
+    mpu9250_read_raw_gyro_dev(&mpu9250_default_dev, gyro);
+}
+
+/**
+ * @brief Leer los valores de giroscopio de un MPU9250 concreto
+ *
+ * @param dev dispositivo que se quiere leer.
+ * @param gyro arreglo donde se guardaran los valores de giroscopio.
+ */
+void mpu9250_read_raw_gyro_dev(const mpu9250_dev_t *dev, int16_t gyro[3])
 {
     uint8_t buffer[6];
     
-    read_registers(0x43, buffer, 6);
+    read_registers_dev(dev, 0x43, buffer, 6);
 
     for (int i = 0; i < 3; i++) {
         gyro[i] = (buffer[i * 2] << 8 | buffer[(i * 2) + 1]);;
@@ -223,22 +282,92 @@ void mpu9250_read_raw_gyro(int16_t gyro[3]) //Used to get the raw gyro values fr
  * Esta función se usa para calibrar el giroscopio del MPU9250. no retorna nada.
  *
  * @param gyroCal arreglo donde se guardaran los valores de calibracion del giroscopio.
- * @param loop numero de veces que se va a calibrar el giroscopio.
+ * @param loop numero maximo de lecturas; se detiene antes si la media ya es estable.
  */
 
 void calibrate_gyro(int16_t gyroCal[3], int loop)  //Used to calibrate the gyro. The gyro must be still while calibration happens
 {
-    int16_t temp[3];
+    calib_stats_t acc, gyro, mag;
+    calibrate_still_dev(&mpu9250_default_dev, &acc, &gyro, &mag, loop);
+    calib_stats_offset(&gyro, gyroCal);
+}
+
+/**
+ * @brief Calibra en reposo los tres sensores de un MPU9250
+ *
+ * Lee muestras completas en rafaga a la frecuencia del acelerometro y acumula su estadistica.
+ * Se detiene cuando las medias de los tres sensores son estables o al llegar a loop lecturas.
+ * El MPU9250 debe estar quieto y plano.
+ *
+ * @param dev dispositivo que se quiere calibrar.
+ * @param acc estadistica del acelerometro.
+ * @param gyro estadistica del giroscopio.
+ * @param mag estadistica del magnetometro.
+ * @param loop numero maximo de lecturas.
+ * @return int retorna el numero de lecturas usadas.
+ */
+int calibrate_still_dev(const mpu9250_dev_t *dev, calib_stats_t *acc, calib_stats_t *gyro, calib_stats_t *mag, int loop)
+{
+    mpu9250_sample_t sample;
+    int16_t lastMag[3] = {0, 0, 0};
+
+    calib_stats_reset(acc);
+    calib_stats_reset(gyro);
+    calib_stats_reset(mag);
+
+    absolute_time_t next = get_absolute_time();
     for (int i = 0; i < loop; i++)
     {
-        mpu9250_read_raw_gyro(temp);
-        gyroCal[0] += temp[0];
-        gyroCal[1] += temp[1];
-        gyroCal[2] += temp[2];
+        mpu9250_read_sample_dev(dev, &sample);
+        calib_stats_add(acc, sample.accel);
+        calib_stats_add(gyro, sample.gyro);
+        // The magnetometer updates at 100 Hz, a repeated reading is the same sample and would overstate n
+        if (mag->n == 0 || memcmp(lastMag, sample.mag, sizeof(lastMag)) != 0)
+        {
+            calib_stats_add(mag, sample.mag);
+            memcpy(lastMag, sample.mag, sizeof(lastMag));
+        }
+
+        if (calib_stats_converged(acc, CALIB_ACC_TOLERANCE) && calib_stats_converged(gyro, CALIB_GYRO_TOLERANCE) && calib_stats_converged(mag, CALIB_MAG_TOLERANCE))
+        {
+            break;
+        }
+
+        next = delayed_by_us(next, CALIB_PERIOD_US);
+        sleep_until(next);
+    }
+    return acc->n;
+}
+
+/**
+ * @brief Calibra el magnetometro con un ajuste de elipsoide
+ *
+ * Mientras dura la calibracion se debe girar el MPU9250 en todas las direcciones. El resultado
+ * corrige hierro duro (offset) y blando (escala por eje) y trae una calidad de 0 a 1.
+ *
+ * @param dev dispositivo que se quiere calibrar.
+ * @param cal estructura donde se guardara la calibracion.
+ * @param duration_ms tiempo de la rotacion en milisegundos.
+ * @return bool retorna false si el ajuste no fue posible.
+ */
+bool calibrate_mag_ellipsoid_dev(const mpu9250_dev_t *dev, calib_mag_t *cal, uint32_t duration_ms)
+{
+    calib_ellipsoid_t fit;
+    mpu9250_sample_t sample;
+
+    calib_ellipsoid_reset(&fit);
+
+    absolute_time_t next = get_absolute_time();
+    absolute_time_t end = make_timeout_time_ms(duration_ms);
+    while (absolute_time_diff_us(get_absolute_time(), end) > 0)
+    {
+        mpu9250_read_sample_dev(dev, &sample);
+        calib_ellipsoid_add(&fit, sample.mag);
+
+        next = delayed_by_us(next, CALIB_MAG_PERIOD_US);
+        sleep_until(next);
     }
-    gyroCal[0] /= loop;
-    gyroCal[1] /= loop;
-    gyroCal[2] /= loop;
+    return calib_ellipsoid_solve(&fit, cal);
 }
 
 /**
@@ -343,4 +472,215 @@ void start_spi() //Starts the mpu and resets it
     uint8_t id;
     read_registers(0x75, &id, 1);
     printf("I2C address is 0x%x\n", id);
+}
+
+/**
+ * @brief Decodifica una rafaga de registros en una muestra
+ *
+ * @param buffer bytes leidos a partir del registro 0x3B.
+ * @param sample muestra donde se guardaran los valores.
+ */
+static void unpack_sample(const uint8_t *buffer, mpu9250_sample_t *sample)
+{
+    for (int i = 0; i < 3; i++) {
+        sample->accel[i] = (buffer[i * 2] << 8 | buffer[(i * 2) + 1]);
+        sample->gyro[i] = (buffer[8 + i * 2] << 8 | buffer[8 + (i * 2) + 1]);
+        sample->mag[i] = (buffer[15 + i * 2] << 8 | buffer[15 + (i * 2) + 1]);
+    }
+    sample->temp = (buffer[6] << 8 | buffer[7]);
+}
+
+/**
+ * @brief Lee acelerometro, temperatura, giroscopio y magnetometro en una sola transaccion
+ *
+ * A diferencia de read_registers_dev no hay esperas: toda la muestra sale en una rafaga SPI.
+ *
+ * @param dev dispositivo que se quiere leer.
+ * @param sample muestra donde se guardaran los valores.
+ */
+void mpu9250_read_sample_dev(const mpu9250_dev_t *dev, mpu9250_sample_t *sample)
+{
+    uint8_t tx[BURST_LEN + 1] = {REG_ACCEL_XOUT_H | READ_BIT};
+    uint8_t rx[BURST_LEN + 1];
+
+    cs_select(dev);
+    spi_write_read_blocking(dev->spi, tx, rx, sizeof(rx));
+    cs_deselect(dev);
+
+    unpack_sample(rx + 1, sample);
+}
+
+/**
+ * @brief Inicializa un bus SPI compartido por varios MPU9250
+ *
+ * Configura los pines del bus y reserva dos canales DMA para las lecturas en rafaga. Si no hay
+ * canales libres las lecturas se hacen por escritura/lectura bloqueante. no retorna nada.
+ *
+ * @param bus bus que se quiere inicializar.
+ * @param spi puerto SPI del bus.
+ * @param pin_miso pin MISO.
+ * @param pin_sck pin SCK.
+ * @param pin_mosi pin MOSI.
+ * @param baudrate frecuencia del bus en Hz (los registros de datos admiten hasta 20 MHz).
+ */
+void mpu9250_bus_init(mpu9250_bus_t *bus, spi_inst_t *spi, uint8_t pin_miso, uint8_t pin_sck, uint8_t pin_mosi, uint32_t baudrate)
+{
+    memset(bus, 0, sizeof(*bus));
+    bus->spi = spi;
+    bus->pin_miso = pin_miso;
+    bus->pin_sck = pin_sck;
+    bus->pin_mosi = pin_mosi;
+    bus->baudrate = spi_init(spi, baudrate); // Keeps the rate the hardware actually achieved
+
+    gpio_set_function(pin_miso, GPIO_FUNC_SPI);
+    gpio_set_function(pin_sck, GPIO_FUNC_SPI);
+    gpio_set_function(pin_mosi, GPIO_FUNC_SPI);
+
+    bus->dma_tx = dma_claim_unused_channel(false);
+    bus->dma_rx = dma_claim_unused_channel(false);
+    if (bus->dma_tx < 0 || bus->dma_rx < 0) { // Both channels are needed, release the odd one
+        if (bus->dma_tx >= 0) dma_channel_unclaim(bus->dma_tx);
+        if (bus->dma_rx >= 0) dma_channel_unclaim(bus->dma_rx);
+        bus->dma_tx = bus->dma_rx = -1;
+    }
+}
+
+/**
+ * @brief Agrega un MPU9250 al bus
+ *
+ * Inicializa el pin de seleccion de chip, resetea el dispositivo y comprueba su identificador.
+ *
+ * @param bus bus al que se agrega el dispositivo.
+ * @param dev dispositivo que se agrega; debe seguir existiendo mientras se use el bus.
+ * @return bool retorna true si el dispositivo respondio y cabia en el bus.
+ */
+bool mpu9250_bus_add(mpu9250_bus_t *bus, const mpu9250_dev_t *dev)
+{
+    if (bus->count >= MPU9250_MAX_DEVICES || dev->spi != bus->spi) {
+        return false;
+    }
+
+    // Chip select is active-low, so we'll initialise it to a driven-high state
+    gpio_init(dev->pin_cs);
+    gpio_set_dir(dev->pin_cs, GPIO_OUT);
+    gpio_put(dev->pin_cs, 1);
+
+    mpu9250_reset_dev(dev);
+
+    uint8_t tx[2] = {0x75 | READ_BIT, 0}, rx[2]; // WHO_AM_I: 0x71 on the MPU9250, 0x73 on the MPU9255
+    cs_select(dev);
+    spi_write_read_blocking(dev->spi, tx, rx, 2);
+    cs_deselect(dev);
+    if (rx[1] == 0x00 || rx[1] == 0xFF) { // Nothing is driving MISO
+        return false;
+    }
+
+    bus->devs[bus->count++] = dev;
+    return true;
+}
+
+/**
+ * @brief Lee una rafaga por DMA
+ *
+ * @param bus bus con los canales DMA reservados.
+ * @param tx bytes a enviar.
+ * @param rx arreglo donde se guardan los bytes recibidos.
+ * @param len numero de bytes de la transaccion.
+ */
+static void dma_transfer(const mpu9250_bus_t *bus, const uint8_t *tx, uint8_t *rx, uint16_t len)
+{
+    dma_channel_config c = dma_channel_get_default_config(bus->dma_tx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, spi_get_dreq(bus->spi, true));
+    dma_channel_configure(bus->dma_tx, &c, &spi_get_hw(bus->spi)->dr, tx, len, false);
+
+    c = dma_channel_get_default_config(bus->dma_rx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, spi_get_dreq(bus->spi, false));
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    dma_channel_configure(bus->dma_rx, &c, rx, &spi_get_hw(bus->spi)->dr, len, false);
+
+    // Start both at once so the RX FIFO never overflows
+    dma_start_channel_mask((1u << bus->dma_tx) | (1u << bus->dma_rx));
+    dma_channel_wait_for_finish_blocking(bus->dma_rx);
+}
+
+/**
+ * @brief Lee todos los MPU9250 del bus en una sola pasada
+ *
+ * Recorre los dispositivos en orden (round-robin) y lee de cada uno la muestra completa en una
+ * rafaga, uno detras de otro y sin esperas entre ellos. Usa DMA si el bus tiene canales reservados.
+ *
+ * @param bus bus que se quiere leer.
+ * @param samples arreglo con una muestra por dispositivo, en el orden en que se agregaron.
+ * @return uint8_t retorna el numero de muestras leidas.
+ */
+uint8_t mpu9250_bus_read_all(mpu9250_bus_t *bus, mpu9250_sample_t samples[])
+{
+    static const uint8_t tx[BURST_LEN + 1] = {REG_ACCEL_XOUT_H | READ_BIT};
+    uint8_t rx[BURST_LEN + 1];
+
+    for (uint8_t d = 0; d < bus->count; d++) {
+        const mpu9250_dev_t *dev = bus->devs[d];
+
+        cs_select(dev);
+        if (bus->dma_tx >= 0) {
+            dma_transfer(bus, tx, rx, sizeof(rx));
+        } else {
+            spi_write_read_blocking(bus->spi, tx, rx, sizeof(rx));
+        }
+        cs_deselect(dev);
+
+        unpack_sample(rx + 1, &samples[d]);
+    }
+    return bus->count;
+}
+
+/**
+ * @brief Escribe un registro de un MPU9250 concreto
+ *
+ * @param dev dispositivo al que se escribe.
+ * @param reg registro que se quiere escribir.
+ * @param value valor del registro.
+ */
+static void write_register_dev(const mpu9250_dev_t *dev, uint8_t reg, uint8_t value)
+{
+    uint8_t buf[] = {reg & ~READ_BIT, value};
+    cs_select(dev);
+    spi_write_blocking(dev->spi, buf, 2);
+    cs_deselect(dev);
+}
+
+/**
+ * @brief Cambia la frecuencia de muestreo del MPU9250
+ *
+ * Activa los filtros pasa bajos (184 Hz en el giroscopio y 218 Hz en el acelerometro), con los que el
+ * reloj interno es de 1 kHz, y ajusta el divisor. La salida va de 1000 Hz a 3.9 Hz. no retorna nada.
+ *
+ * @param dev dispositivo que se quiere configurar.
+ * @param hz frecuencia de muestreo deseada.
+ */
+void mpu9250_set_sample_rate_dev(const mpu9250_dev_t *dev, uint16_t hz)
+{
+    uint32_t divider = hz ? 1000 / hz : 256;
+    divider = divider < 1 ? 0 : divider > 256 ? 255 : divider - 1;
+
+    write_register_dev(dev, REG_CONFIG, 0x01);        // DLPF_CFG = 1
+    write_register_dev(dev, REG_ACCEL_CONFIG2, 0x01); // A_DLPF_CFG = 1
+    write_register_dev(dev, REG_SMPLRT_DIV, divider);
+}
+
+/**
+ * @brief Activa la interrupcion de dato listo del MPU9250
+ *
+ * El pin INT da un pulso en alto de 50 us cada vez que hay una muestra nueva, asi el programa puede
+ * dormir entre muestras en lugar de preguntar. no retorna nada.
+ *
+ * @param dev dispositivo que se quiere configurar.
+ */
+void mpu9250_enable_data_ready_dev(const mpu9250_dev_t *dev)
+{
+    write_register_dev(dev, REG_INT_PIN_CFG, 0x00); // Active high, push-pull, 50 us pulse
+    write_register_dev(dev, REG_INT_ENABLE, 0x01);  // RAW_RDY_EN
 }
\ No newline at end of file
@@ -2,10 +2,49 @@
 #include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/spi.h"
+#include "calibration.h"
 
 #ifndef mpu9250_h
 #define mpu9250_h
 
+#define MPU9250_MAX_DEVICES 4 // Maximum number of MPU9250 sharing one SPI bus
+
+/**
+ * @brief Descriptor de un MPU9250.
+ *
+ * Identifica el bus SPI y el pin de seleccion de chip (CS) de un MPU9250.
+ */
+typedef struct {
+    spi_inst_t *spi;   // SPI port the device is wired to
+    uint8_t pin_cs;    // Chip select pin (active low)
+} mpu9250_dev_t;
+
+/**
+ * @brief Bus SPI compartido por varios MPU9250.
+ *
+ * Guarda los pines del bus, los dispositivos conectados y los canales DMA usados para las lecturas en rafaga.
+ */
+typedef struct {
+    spi_inst_t *spi;
+    uint8_t pin_miso, pin_sck, pin_mosi;
+    uint32_t baudrate;
+    int dma_tx, dma_rx;                          // -1 when DMA is not available
+    const mpu9250_dev_t *devs[MPU9250_MAX_DEVICES];
+    uint8_t count;
+} mpu9250_bus_t;
+
+/**
+ * @brief Muestra cruda de un MPU9250 leida en una sola rafaga.
+ */
+typedef struct {
+    int16_t accel[3];
+    int16_t temp;
+    int16_t gyro[3];
+    int16_t mag[3];
+} mpu9250_sample_t;
+
+extern const mpu9250_dev_t mpu9250_default_dev;
+
 void mpu9250_reset();
 void read_registers(uint8_t reg, uint8_t *buf, uint16_t len);
 void mpu9250_read_raw_mag(int16_t mag[3]);
@@ -19,4 +58,20 @@ void calibrate_gyro(int16_t gyroCal[3], int loop);
 void start_spi();
 void convert_to_full(int16_t eulerAngles[2], int16_t accel[3], int16_t fullAngles[2]);
 
+void mpu9250_reset_dev(const mpu9250_dev_t *dev);
+void read_registers_dev(const mpu9250_dev_t *dev, uint8_t reg, uint8_t *buf, uint16_t len);
+void mpu9250_read_raw_mag_dev(const mpu9250_dev_t *dev, int16_t mag[3]);
+void mpu9250_read_raw_accel_dev(const mpu9250_dev_t *dev, int16_t accel[3]);
+void mpu9250_read_raw_gyro_dev(const mpu9250_dev_t *dev, int16_t gyro[3]);
+void mpu9250_read_sample_dev(const mpu9250_dev_t *dev, mpu9250_sample_t *sample);
+void mpu9250_set_sample_rate_dev(const mpu9250_dev_t *dev, uint16_t hz);
+void mpu9250_enable_data_ready_dev(const mpu9250_dev_t *dev);
+
+void mpu9250_bus_init(mpu9250_bus_t *bus, spi_inst_t *spi, uint8_t pin_miso, uint8_t pin_sck, uint8_t pin_mosi, uint32_t baudrate);
+bool mpu9250_bus_add(mpu9250_bus_t *bus, const mpu9250_dev_t *dev);
+uint8_t mpu9250_bus_read_all(mpu9250_bus_t *bus, mpu9250_sample_t samples[]);
+
+int calibrate_still_dev(const mpu9250_dev_t *dev, calib_stats_t *acc, calib_stats_t *gyro, calib_stats_t *mag, int loop);
+bool calibrate_mag_ellipsoid_dev(const mpu9250_dev_t *dev, calib_mag_t *cal, uint32_t duration_ms);
+
 #endif
\ No newline at end of file
@@ -1,26 +1,56 @@
 #include "mpuObject.h"
-extern "C" {
-    #include "mpu9250.h"
+
+mpu9250::mpu9250(int loop) : mpu9250(&mpu9250_default_dev, loop) //Starts the mpu wired to the default pins
+{
 }
 
-mpu9250::mpu9250(int loop) //Starts the mpu and calibrates the gyro
+mpu9250::mpu9250(const mpu9250_dev_t *device, int loop) : dev(device) //Starts the mpu and calibrates the gyro
 {
-    start_spi();
-    calibrate_gyro(gyroCal, loop);
-    mpu9250_read_raw_accel(acceleration);
+    if (dev == &mpu9250_default_dev) start_spi(); //Devices on a shared bus are set up by mpu9250_bus_add
+    calib_stats_t accStats, gyroStats, magStats;
+    calibrate_still_dev(dev, &accStats, &gyroStats, &magStats, loop);
+    calib_stats_offset(&gyroStats, gyroCal);
+    mpu9250_read_raw_accel_dev(dev, acceleration);
     calculate_angles_from_accel(eulerAngles, acceleration);
     timeOfLastCheck = get_absolute_time();
 }
 
-void mpu9250::updateAngles() //Calculates the angles based on the sensor readings
+mpu9250::mpu9250(const mpu9250_dev_t *device, const int16_t storedGyroCal[3]) : dev(device) //Starts the mpu with a stored calibration, no recalibration at boot
 {
-    mpu9250_read_raw_accel(acceleration);
-    mpu9250_read_raw_gyro(gyro);
-    gyro[0] -= gyroCal[0];
-    gyro[1] -= gyroCal[1];
-    gyro[2] -= gyroCal[2];
-    calculate_angles(eulerAngles, acceleration, gyro, absolute_time_diff_us(timeOfLastCheck, get_absolute_time()));
+    if (dev == &mpu9250_default_dev) start_spi();
+    gyroCal[0] = storedGyroCal[0];
+    gyroCal[1] = storedGyroCal[1];
+    gyroCal[2] = storedGyroCal[2];
+    mpu9250_read_raw_accel_dev(dev, acceleration);
+    calculate_angles_from_accel(eulerAngles, acceleration);
     timeOfLastCheck = get_absolute_time();
+}
+
+void mpu9250::updateAngles() //Calculates the angles based on the sensor readings
+{
+    mpu9250_sample_t sample;
+    mpu9250_read_raw_accel_dev(dev, sample.accel);
+    mpu9250_read_raw_gyro_dev(dev, sample.gyro);
+    updateAngles(sample);
+}
+
+void mpu9250::updateAngles(const mpu9250_sample_t &sample) //Calculates the angles from a sample read by the bus scheduler
+{
+    updateAngles(sample, time_us_64());
+}
+
+void mpu9250::updateAngles(const mpu9250_sample_t &sample, uint64_t sampleTimeUs) //Calculates the angles from a sample read earlier, e.g. queued by the other core
+{
+    int64_t elapsed = sampleTimeUs - to_us_since_boot(timeOfLastCheck);
+    if (elapsed <= 0) return; //Same or older sample, the gyro can't be integrated
+
+    for (int i = 0; i < 3; i++)
+    {
+        acceleration[i] = sample.accel[i];
+        gyro[i] = sample.gyro[i] - gyroCal[i];
+    }
+    calculate_angles(eulerAngles, acceleration, gyro, elapsed);
+    timeOfLastCheck = from_us_since_boot(sampleTimeUs);
 
     convert_to_full(eulerAngles, acceleration, fullAngles);
 }
@@ -1,4 +1,7 @@
 #include "pico/stdlib.h"
+extern "C" {
+    #include "mpu9250.h"
+}
 
 #ifndef mpuObject_h
 #define mpuObject_h
@@ -8,9 +11,14 @@ class mpu9250
     public: 
     int16_t acceleration[3], gyro[3], gyroCal[3], eulerAngles[2], fullAngles[2];
     absolute_time_t timeOfLastCheck;
+    const mpu9250_dev_t *dev;
 
     mpu9250(int loop);
+    mpu9250(const mpu9250_dev_t *device, int loop);
+    mpu9250(const mpu9250_dev_t *device, const int16_t storedGyroCal[3]);
     void updateAngles();
+    void updateAngles(const mpu9250_sample_t &sample);
+    void updateAngles(const mpu9250_sample_t &sample, uint64_t sampleTimeUs);
     void printData();
 };
 
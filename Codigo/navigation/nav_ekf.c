@@ -0,0 +1,346 @@
+/**
+  @file nav_ekf.c
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Navegacion GPS/IMU debilmente acoplada. Con cada lectura del IMU actualiza la actitud (filtro
+  complementario sobre un cuaternion: giroscopio corregido hacia la gravedad y el campo magnetico),
+  pasa la aceleracion a coordenadas Norte-Este y propaga posicion, velocidad y sesgo del acelerometro
+  de cada eje con su covarianza. Cada fix del GPS corrige los dos ejes. Todo en float de precision
+  simple y sin funciones trigonometricas en el paso del IMU, porque el RP2040 no tiene FPU.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+
+#include <math.h>
+#include <string.h>
+#include "nav_ekf.h"
+
+#define GRAVITY 9.80665f
+#define DEG_TO_RAD 0.017453293f
+#define METERS_PER_DEGREE 111195.0f // Along a meridian, on the 6371 km sphere
+#define MAX_STEP_S 0.5f             // Longer gaps between IMU readings only grow the covariance (nav_rate_hz >= 2)
+#define ACCEL_TRUST_G 0.2f          // Gravity only corrects the attitude while |a| is this close to 1 g
+#define INITIAL_SPEED_SIGMA 5.0f    // m/s, speed is unknown at the first fix
+#define INITIAL_BIAS_SIGMA 0.2f     // m/s^2
+#define REJECTS_BEFORE_RESET 3      // Consecutive rejected fixes mean the filter is lost, not the GPS
+
+/**
+ * @brief Valores por defecto para el MPU9250 y un GPS de uso general
+ *
+ * @param config configuracion que se quiere llenar.
+ */
+void nav_config_defaults(nav_config_t *config)
+{
+    config->accel_noise = 0.5f;
+    config->bias_noise = 0.01f;
+    config->gps_noise_m = 2.5f;
+    config->attitude_kp = 0.5f;
+    config->gate = 5.0f;
+}
+
+/**
+ * @brief Reinicia la navegacion. La actitud se fija con la primera lectura del IMU y la posicion con
+ * el primer fix.
+ *
+ * @param nav estado que se quiere reiniciar.
+ * @param config ruido y ganancias del filtro.
+ */
+void nav_ekf_init(nav_ekf_t *nav, const nav_config_t *config)
+{
+    memset(nav, 0, sizeof(*nav));
+    nav->config = *config;
+    nav->q[0] = 1;
+}
+
+/**
+ * @brief Normaliza un vector de tres componentes
+ *
+ * @return bool retorna false si el vector es nulo.
+ */
+static bool normalize3(float v[3])
+{
+    float n = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+    if (n <= 1e-12f) {
+        return false;
+    }
+    n = 1.0f / sqrtf(n);
+    v[0] *= n;
+    v[1] *= n;
+    v[2] *= n;
+    return true;
+}
+
+/**
+ * @brief Actitud inicial a partir de la gravedad y el campo magnetico (TRIAD)
+ *
+ * Los ejes Norte, Oeste y Arriba escritos en coordenadas del cuerpo son las filas de la matriz de
+ * rotacion, que despues se pasa a cuaternion.
+ */
+static void attitude_from_vectors(float q[4], const float acc[3], const float mag[3])
+{
+    float up[3] = {acc[0], acc[1], acc[2]}, west[3], north[3], m[3] = {mag[0], mag[1], mag[2]};
+    normalize3(up);
+    if (!normalize3(m)) {
+        m[0] = 1; // Without a magnetometer the heading starts at the body x axis
+        m[1] = m[2] = 0;
+    }
+    west[0] = up[1] * m[2] - up[2] * m[1];
+    west[1] = up[2] * m[0] - up[0] * m[2];
+    west[2] = up[0] * m[1] - up[1] * m[0];
+    if (!normalize3(west)) {
+        west[0] = up[1]; // Field along gravity, any horizontal axis will do
+        west[1] = -up[0];
+        west[2] = 0;
+        normalize3(west);
+    }
+    north[0] = west[1] * up[2] - west[2] * up[1];
+    north[1] = west[2] * up[0] - west[0] * up[2];
+    north[2] = west[0] * up[1] - west[1] * up[0];
+
+    const float r[3][3] = {{north[0], north[1], north[2]}, {west[0], west[1], west[2]}, {up[0], up[1], up[2]}};
+    float trace = r[0][0] + r[1][1] + r[2][2], s;
+    if (trace > 0) {
+        s = 2 * sqrtf(trace + 1);
+        q[0] = 0.25f * s;
+        q[1] = (r[2][1] - r[1][2]) / s;
+        q[2] = (r[0][2] - r[2][0]) / s;
+        q[3] = (r[1][0] - r[0][1]) / s;
+    } else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+        s = 2 * sqrtf(1 + r[0][0] - r[1][1] - r[2][2]);
+        q[0] = (r[2][1] - r[1][2]) / s;
+        q[1] = 0.25f * s;
+        q[2] = (r[0][1] + r[1][0]) / s;
+        q[3] = (r[0][2] + r[2][0]) / s;
+    } else if (r[1][1] > r[2][2]) {
+        s = 2 * sqrtf(1 + r[1][1] - r[0][0] - r[2][2]);
+        q[0] = (r[0][2] - r[2][0]) / s;
+        q[1] = (r[0][1] + r[1][0]) / s;
+        q[2] = 0.25f * s;
+        q[3] = (r[1][2] + r[2][1]) / s;
+    } else {
+        s = 2 * sqrtf(1 + r[2][2] - r[0][0] - r[1][1]);
+        q[0] = (r[1][0] - r[0][1]) / s;
+        q[1] = (r[0][2] + r[2][0]) / s;
+        q[2] = (r[1][2] + r[2][1]) / s;
+        q[3] = 0.25f * s;
+    }
+}
+
+/**
+ * @brief Avanza la actitud con el giroscopio, corregido hacia la gravedad y el campo magnetico
+ *
+ * El error es el producto cruz entre lo que miden el acelerometro y el magnetometro y lo que deberian
+ * medir con la actitud actual; una parte (attitude_kp) se suma a la velocidad angular.
+ */
+static void attitude_update(nav_ekf_t *nav, const float acc[3], const float gyro_dps[3], const float mag[3], float dt)
+{
+    float *q = nav->q;
+    float q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    float e[3] = {0, 0, 0}, a[3] = {acc[0], acc[1], acc[2]}, m[3] = {mag[0], mag[1], mag[2]};
+    float norm = sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+
+    if (fabsf(norm - 1) < ACCEL_TRUST_G && normalize3(a)) {
+        // Gravity direction expected in the body frame: third row of the rotation
+        float vx = 2 * (q1 * q3 - q0 * q2), vy = 2 * (q0 * q1 + q2 * q3), vz = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+        e[0] = a[1] * vz - a[2] * vy;
+        e[1] = a[2] * vx - a[0] * vz;
+        e[2] = a[0] * vy - a[1] * vx;
+    }
+    if (normalize3(m)) {
+        // Field in the navigation frame, then its horizontal and vertical parts back in the body frame
+        float hx = 2 * (m[0] * (0.5f - q2 * q2 - q3 * q3) + m[1] * (q1 * q2 - q0 * q3) + m[2] * (q1 * q3 + q0 * q2));
+        float hy = 2 * (m[0] * (q1 * q2 + q0 * q3) + m[1] * (0.5f - q1 * q1 - q3 * q3) + m[2] * (q2 * q3 - q0 * q1));
+        float bz = 2 * (m[0] * (q1 * q3 - q0 * q2) + m[1] * (q2 * q3 + q0 * q1) + m[2] * (0.5f - q1 * q1 - q2 * q2));
+        float bx = sqrtf(hx * hx + hy * hy);
+        float wx = 2 * (bx * (0.5f - q2 * q2 - q3 * q3) + bz * (q1 * q3 - q0 * q2));
+        float wy = 2 * (bx * (q1 * q2 - q0 * q3) + bz * (q0 * q1 + q2 * q3));
+        float wz = 2 * (bx * (q0 * q2 + q1 * q3) + bz * (0.5f - q1 * q1 - q2 * q2));
+        e[0] += m[1] * wz - m[2] * wy;
+        e[1] += m[2] * wx - m[0] * wz;
+        e[2] += m[0] * wy - m[1] * wx;
+    }
+
+    const float kp = nav->config.attitude_kp, h = 0.5f * dt;
+    float gx = gyro_dps[0] * DEG_TO_RAD + kp * e[0];
+    float gy = gyro_dps[1] * DEG_TO_RAD + kp * e[1];
+    float gz = gyro_dps[2] * DEG_TO_RAD + kp * e[2];
+    q[0] = q0 + (-q1 * gx - q2 * gy - q3 * gz) * h;
+    q[1] = q1 + (q0 * gx + q2 * gz - q3 * gy) * h;
+    q[2] = q2 + (q0 * gy - q1 * gz + q3 * gx) * h;
+    q[3] = q3 + (q0 * gz + q1 * gy - q2 * gx) * h;
+
+    norm = 1.0f / sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (int i = 0; i < 4; i++) q[i] *= norm;
+}
+
+/**
+ * @brief Propaga un eje: x = [posicion, velocidad, sesgo], con la aceleracion medida menos el sesgo
+ *
+ * La covarianza se propaga con los productos de F P F' ya desarrollados (F es casi la identidad) y
+ * el ruido de proceso de una aceleracion y un sesgo de ruido blanco continuo.
+ */
+static void axis_predict(nav_axis_t *x, float accel, float dt, float qa, float qb)
+{
+    const float h = 0.5f * dt * dt;
+    const float a = accel - x->b;
+    x->p += x->v * dt + a * h;
+    x->v += a * dt;
+
+    // A = F P, then P = A F'
+    float a00 = x->p00 + dt * x->p01 - h * x->p02, a01 = x->p01 + dt * x->p11 - h * x->p12, a02 = x->p02 + dt * x->p12 - h * x->p22;
+    float a11 = x->p11 - dt * x->p12, a12 = x->p12 - dt * x->p22;
+    x->p00 = a00 + dt * a01 - h * a02 + qa * dt * dt * dt * (1.0f / 3);
+    x->p01 = a01 - dt * a02 + qa * h;
+    x->p02 = a02;
+    x->p11 = a11 - dt * a12 + qa * dt;
+    x->p12 = a12;
+    x->p22 += qb * dt;
+}
+
+/**
+ * @brief Corrige un eje con una medida de posicion de varianza r
+ */
+static void axis_update(nav_axis_t *x, float innovation, float r)
+{
+    const float s = 1.0f / (x->p00 + r);
+    const float k0 = x->p00 * s, k1 = x->p01 * s, k2 = x->p02 * s;
+    x->p += k0 * innovation;
+    x->v += k1 * innovation;
+    x->b += k2 * innovation;
+
+    const float p00 = x->p00, p01 = x->p01, p02 = x->p02;
+    x->p00 -= k0 * p00;
+    x->p01 -= k0 * p01;
+    x->p02 -= k0 * p02;
+    x->p11 -= k1 * p01;
+    x->p12 -= k1 * p02;
+    x->p22 -= k2 * p02;
+}
+
+/**
+ * @brief Reinicia un eje en una posicion conocida
+ */
+static void axis_reset(nav_axis_t *x, float position, float r)
+{
+    memset(x, 0, sizeof(*x));
+    x->p = position;
+    x->p00 = r;
+    x->p11 = INITIAL_SPEED_SIGMA * INITIAL_SPEED_SIGMA;
+    x->p22 = INITIAL_BIAS_SIGMA * INITIAL_BIAS_SIGMA;
+}
+
+/**
+ * @brief Paso del IMU: actitud, y posicion y velocidad si ya hubo un fix
+ *
+ * @param nav estado de la navegacion.
+ * @param acc_g aceleracion en g.
+ * @param gyro_dps velocidad angular en grados por segundo.
+ * @param mag campo magnetico en cualquier unidad (solo importa la direccion), ceros si no hay.
+ * @param dt segundos desde la lectura anterior.
+ */
+void nav_ekf_predict(nav_ekf_t *nav, const float acc_g[3], const float gyro_dps[3], const float mag[3], float dt)
+{
+    if (!nav->attitude_ready) {
+        if (acc_g[0] == 0 && acc_g[1] == 0 && acc_g[2] == 0) {
+            return;
+        }
+        attitude_from_vectors(nav->q, acc_g, mag);
+        nav->attitude_ready = true;
+        return;
+    }
+    if (dt <= 0) {
+        return;
+    }
+    const float qa = nav->config.accel_noise * nav->config.accel_noise, qb = nav->config.bias_noise * nav->config.bias_noise;
+    if (dt > MAX_STEP_S) {
+        // Too long to integrate the reading, but the uncertainty still grew: coast on the velocity
+        if (nav->position_ready) {
+            axis_predict(&nav->north, nav->north.b, dt, qa, qb);
+            axis_predict(&nav->east, nav->east.b, dt, qa, qb);
+        }
+        return;
+    }
+    attitude_update(nav, acc_g, gyro_dps, mag, dt);
+    nav->steps++;
+    if (!nav->position_ready) {
+        return;
+    }
+
+    // Specific force in North-West-Up: first two rows of the rotation; gravity only shows in Up
+    const float q0 = nav->q[0], q1 = nav->q[1], q2 = nav->q[2], q3 = nav->q[3];
+    float fn = (1 - 2 * (q2 * q2 + q3 * q3)) * acc_g[0] + 2 * (q1 * q2 - q0 * q3) * acc_g[1] + 2 * (q1 * q3 + q0 * q2) * acc_g[2];
+    float fw = 2 * (q1 * q2 + q0 * q3) * acc_g[0] + (1 - 2 * (q1 * q1 + q3 * q3)) * acc_g[1] + 2 * (q2 * q3 - q0 * q1) * acc_g[2];
+
+    axis_predict(&nav->north, fn * GRAVITY, dt, qa, qb);
+    axis_predict(&nav->east, -fw * GRAVITY, dt, qa, qb);
+}
+
+/**
+ * @brief Corrige la posicion con un fix del GPS
+ *
+ * El primer fix fija el origen de las coordenadas locales. Un fix muy lejos de lo esperado se
+ * rechaza; si se rechazan varios seguidos el filtro se reinicia en el GPS.
+ *
+ * @param nav estado de la navegacion.
+ * @param lat latitud en grados.
+ * @param lon longitud en grados.
+ * @return bool retorna false si el fix se rechazo.
+ */
+bool nav_ekf_update_gps(nav_ekf_t *nav, float lat, float lon)
+{
+    const float r = nav->config.gps_noise_m * nav->config.gps_noise_m;
+
+    if (!nav->position_ready) {
+        nav->lat0 = lat;
+        nav->lon0 = lon;
+        nav->m_per_deg_lon = METERS_PER_DEGREE * cosf(lat * DEG_TO_RAD);
+        axis_reset(&nav->north, 0, r);
+        axis_reset(&nav->east, 0, r);
+        nav->position_ready = true;
+        nav->fixes++;
+        return true;
+    }
+
+    const float n = (lat - nav->lat0) * METERS_PER_DEGREE, e = (lon - nav->lon0) * nav->m_per_deg_lon;
+    const float yn = n - nav->north.p, ye = e - nav->east.p;
+    const float gate = nav->config.gate;
+    if (yn * yn / (nav->north.p00 + r) + ye * ye / (nav->east.p00 + r) > gate * gate) {
+        nav->rejected++;
+        if (++nav->rejected_in_row < REJECTS_BEFORE_RESET) {
+            return false;
+        }
+        axis_reset(&nav->north, n, r);
+        axis_reset(&nav->east, e, r);
+    } else {
+        axis_update(&nav->north, yn, r);
+        axis_update(&nav->east, ye, r);
+    }
+    nav->rejected_in_row = 0;
+    nav->fixes++;
+    return true;
+}
+
+/**
+ * @brief Posicion, velocidad y covarianza para enviar con la muestra
+ *
+ * @param nav estado de la navegacion.
+ * @param out salida, en ceros si todavia no hay fix.
+ */
+void nav_ekf_output(const nav_ekf_t *nav, nav_output_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    const float q0 = nav->q[0], q1 = nav->q[1], q2 = nav->q[2], q3 = nav->q[3];
+    float heading = -atan2f(2 * (q1 * q2 + q0 * q3), 1 - 2 * (q2 * q2 + q3 * q3)) / DEG_TO_RAD; // Body x axis, clockwise from north
+    out->heading = heading < 0 ? heading + 360 : heading;
+    if (!nav->position_ready) {
+        return;
+    }
+    out->north = nav->north.p;
+    out->east = nav->east.p;
+    out->lat = nav->lat0 + nav->north.p / METERS_PER_DEGREE;
+    out->lon = nav->lon0 + nav->east.p / nav->m_per_deg_lon;
+    out->vel_n = nav->north.v;
+    out->vel_e = nav->east.v;
+    out->sigma_n = sqrtf(nav->north.p00);
+    out->sigma_e = sqrtf(nav->east.p00);
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef nav_ekf_h
+#define nav_ekf_h
+
+#define NAV_STEP_BUDGET_US 200 // Longest time one IMU step may take on the RP2040 at 125 MHz (2% of the CPU at 100 Hz)
+
+/**
+ * @brief Ruido y ganancias del filtro.
+ */
+typedef struct {
+    float accel_noise;   // Acceleration noise density, m/s^2/sqrt(Hz)
+    float bias_noise;    // Accelerometer bias random walk, m/s^3/sqrt(Hz)
+    float gps_noise_m;   // Horizontal GPS error, 1 sigma
+    float attitude_kp;   // Gain pulling the attitude towards gravity and the magnetic field
+    float gate;          // Fixes with a normalised innovation above this (sigma) are rejected
+} nav_config_t;
+
+/**
+ * @brief Filtro de un eje horizontal: posicion, velocidad y sesgo del acelerometro, con su covarianza.
+ */
+typedef struct {
+    float p, v, b;
+    float p00, p01, p02, p11, p12, p22;  // Symmetric covariance
+} nav_axis_t;
+
+/**
+ * @brief Estado de la navegacion: actitud (cuaternion del cuerpo a Norte-Oeste-Arriba), los dos
+ * ejes horizontales y el origen de las coordenadas locales.
+ */
+typedef struct {
+    nav_config_t config;
+    bool attitude_ready, position_ready;
+    float q[4];
+    nav_axis_t north, east;
+    float lat0, lon0, m_per_deg_lon;
+    uint32_t steps, fixes, rejected, rejected_in_row;
+} nav_ekf_t;
+
+/**
+ * @brief Salida de la navegacion para la trama de telemetria.
+ */
+typedef struct {
+    float lat, lon;         // Degrees
+    float north, east;      // Meters from the first fix
+    float vel_n, vel_e;     // m/s
+    float sigma_n, sigma_e; // Position standard deviation, m
+    float heading;          // Degrees from north, clockwise
+} nav_output_t;
+
+void nav_config_defaults(nav_config_t *config);
+void nav_ekf_init(nav_ekf_t *nav, const nav_config_t *config);
+void nav_ekf_predict(nav_ekf_t *nav, const float acc_g[3], const float gyro_dps[3], const float mag[3], float dt);
+bool nav_ekf_update_gps(nav_ekf_t *nav, float lat, float lon);
+void nav_ekf_output(const nav_ekf_t *nav, nav_output_t *out);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,186 @@
+/**
+  @file power.c
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Este archivo duerme el procesador (WFI) hasta que llega un evento: datos en el UART del GPS o del
+  ESP, el pulso de dato listo del MPU9250 o un temporizador. Tambien mide el tiempo dormido para
+  reportar el ciclo de trabajo y, si se le da una cola, pasa los bytes del GPS a ella desde la interrupcion.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/uart.h"
+#include "hardware/irq.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "power.h"
+
+static volatile uint32_t pending = 0; // Events seen by the interrupt handlers and not yet returned
+static uart_inst_t *gps = NULL, *wifi = NULL;
+static spsc_ring_t *gps_ring = NULL;  // Filled by the interrupt, emptied by the main loop
+static spsc_ring_t *gps_starts = NULL; // time_us_64() of every '$' queued in gps_ring, same order
+static power_stats_t stats;
+
+/**
+ * @brief Interrupcion de los UART
+ *
+ * Los bytes del GPS pasan a su cola, asi no se pierden mientras el programa hace otra cosa, y la hora
+ * de cada '$' (inicio de una linea) pasa a la cola de inicios. Para el
+ * ESP solo avisa: apaga la interrupcion de recepcion para que no se repita y el programa lee los
+ * bytes; power_wait la vuelve a encender antes de dormir.
+ */
+static void uart_irq()
+{
+    if (gps && gps_ring) {
+        while (uart_is_readable(gps)) {
+            char c = uart_getc(gps);
+            // Late by at most the FIFO interrupt level, not by however long the main loop was busy
+            const uint64_t now = time_us_64();
+            // The time goes first and a '$' is never queued without it, the reader pairs them in order
+            if (spsc_ring_count(gps_ring) >= spsc_ring_capacity(gps_ring) || (c == '$' && gps_starts && !spsc_ring_push(gps_starts, &now))) {
+                stats.rx_dropped++;
+            } else {
+                spsc_ring_push(gps_ring, &c);
+            }
+            pending |= POWER_EVENT_GPS_RX;
+        }
+    } else if (gps && uart_is_readable(gps)) {
+        uart_set_irq_enables(gps, false, false);
+        pending |= POWER_EVENT_GPS_RX;
+    }
+    if (wifi && uart_is_readable(wifi)) {
+        uart_set_irq_enables(wifi, false, false);
+        pending |= POWER_EVENT_WIFI_RX;
+    }
+}
+
+/**
+ * @brief Interrupcion del pin INT del MPU9250
+ */
+static void imu_irq(uint gpio, uint32_t events)
+{
+    pending |= POWER_EVENT_IMU_READY;
+}
+
+/**
+ * @brief Alarma del temporizador de power_wait
+ */
+static int64_t timer_irq(alarm_id_t id, void *user_data)
+{
+    pending |= POWER_EVENT_TIMER;
+    return 0; // Don't repeat
+}
+
+/**
+ * @brief Conecta la interrupcion de recepcion de un UART
+ */
+static void attach_uart(uart_inst_t *uart, bool always_on)
+{
+    int irq = uart_get_index(uart) ? UART1_IRQ : UART0_IRQ;
+    irq_set_exclusive_handler(irq, uart_irq);
+    irq_set_enabled(irq, true);
+    uart_set_irq_enables(uart, always_on, false); // Otherwise armed by power_wait
+}
+
+/**
+ * @brief Prepara las fuentes que despiertan al procesador
+ *
+ * Los UART ya deben estar inicializados. Con una cola para el GPS la interrupcion de recepcion
+ * queda siempre activa, aunque no se use el modo de bajo consumo. no retorna nada.
+ *
+ * @param gps_uart UART del GPS, o NULL.
+ * @param gps_rx cola de bytes para el GPS, o NULL para leer el UART directamente.
+ * @param gps_starts cola de uint64_t con la hora de llegada de cada '$', o NULL.
+ * @param wifi_uart UART del ESP, o NULL.
+ * @param imu_int_pin pin conectado al INT del MPU9250, o -1 si no esta conectado.
+ */
+void power_init(uart_inst_t *gps_uart, spsc_ring_t *gps_rx, spsc_ring_t *gps_line_starts, uart_inst_t *wifi_uart, int imu_int_pin)
+{
+    gps = gps_uart;
+    gps_ring = gps_rx;
+    gps_starts = gps_line_starts;
+    wifi = wifi_uart;
+    if (gps) attach_uart(gps, gps_ring != NULL);
+    if (wifi) attach_uart(wifi, false);
+
+    if (imu_int_pin >= 0) {
+        gpio_init(imu_int_pin);
+        gpio_set_dir(imu_int_pin, GPIO_IN);
+        gpio_set_irq_enabled_with_callback(imu_int_pin, GPIO_IRQ_EDGE_RISE, true, imu_irq);
+    }
+    power_reset_stats();
+}
+
+/**
+ * @brief Duerme hasta que ocurra alguno de los eventos o se cumpla el plazo
+ *
+ * Entre la comprobacion de los eventos y el WFI las interrupciones estan desactivadas, asi un evento
+ * que llega justo antes de dormir no se pierde: el WFI despierta igual y el manejador corre al
+ * reactivarlas. Los eventos que no se pidieron quedan pendientes para la siguiente llamada.
+ *
+ * @param events mascara de power_event_t que se esperan.
+ * @param deadline hora maxima de espera; al cumplirse se retorna POWER_EVENT_TIMER.
+ * @return uint32_t retorna los eventos que ocurrieron.
+ */
+uint32_t power_wait(uint32_t events, absolute_time_t deadline)
+{
+    events |= POWER_EVENT_TIMER;
+    pending &= ~POWER_EVENT_TIMER; // Left over by an earlier alarm that fired late
+    if ((events & POWER_EVENT_GPS_RX) && gps && !gps_ring) uart_set_irq_enables(gps, true, false);
+    if ((events & POWER_EVENT_WIFI_RX) && wifi) uart_set_irq_enables(wifi, true, false);
+    alarm_id_t alarm = add_alarm_at(deadline, timer_irq, NULL, true);
+
+    uint64_t start = time_us_64();
+    while (true) {
+        uint32_t ints = save_and_disable_interrupts();
+        if (pending & events) {
+            restore_interrupts(ints);
+            break;
+        }
+        __wfi();
+        restore_interrupts(ints); // The handler that woke us runs here
+        stats.wakeups++;
+    }
+    stats.asleep_us += time_us_64() - start;
+
+    if (alarm > 0) cancel_alarm(alarm);
+    uint32_t ints = save_and_disable_interrupts();
+    uint32_t happened = pending & events;
+    pending &= ~happened;
+    restore_interrupts(ints);
+    return happened;
+}
+
+/**
+ * @brief Reinicia la medida del ciclo de trabajo
+ */
+void power_reset_stats()
+{
+    uint32_t ints = save_and_disable_interrupts(); // rx_dropped is written by the interrupt
+    memset(&stats, 0, sizeof(stats));
+    restore_interrupts(ints);
+    stats.start_us = time_us_64();
+}
+
+/**
+ * @brief Copia la medida del tiempo dormido
+ *
+ * @param out estructura donde se copia.
+ */
+void power_get_stats(power_stats_t *out)
+{
+    *out = stats;
+}
+
+/**
+ * @brief Fraccion del tiempo que el procesador estuvo despierto desde power_reset_stats
+ *
+ * @return float retorna el ciclo de trabajo (0 a 1).
+ */
+float power_duty_cycle()
+{
+    uint64_t elapsed = time_us_64() - stats.start_us;
+    return elapsed ? 1.0f - (float)stats.asleep_us / elapsed : 1.0f;
+}
\ No newline at end of file
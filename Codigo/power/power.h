@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/uart.h"
+#include "power_model.h"
+#include "spsc_ring.h"
+
+#ifndef power_h
+#define power_h
+
+/**
+ * @brief Eventos que despiertan al procesador.
+ */
+typedef enum {
+    POWER_EVENT_TIMER = 1,      // The deadline passed to power_wait was reached
+    POWER_EVENT_GPS_RX = 2,     // Bytes waiting in the GPS UART or its receive queue
+    POWER_EVENT_WIFI_RX = 4,    // Bytes waiting in the ESP UART
+    POWER_EVENT_IMU_READY = 8,  // Data ready pulse from the MPU9250
+} power_event_t;
+
+/**
+ * @brief Tiempo dormido y despertares desde power_reset_stats.
+ */
+typedef struct {
+    uint64_t start_us;
+    uint64_t asleep_us;
+    uint32_t wakeups;
+    uint32_t rx_dropped;        // GPS bytes lost because the receive queue was full
+} power_stats_t;
+
+void power_init(uart_inst_t *gps_uart, spsc_ring_t *gps_rx, spsc_ring_t *gps_starts, uart_inst_t *wifi_uart, int imu_int_pin);
+uint32_t power_wait(uint32_t events, absolute_time_t deadline);
+void power_reset_stats();
+void power_get_stats(power_stats_t *stats);
+float power_duty_cycle();
+
+#endif
\ No newline at end of file
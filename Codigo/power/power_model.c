@@ -0,0 +1,105 @@
+/**
+  @file power_model.c
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Este archivo decide la frecuencia de muestreo del IMU segun el movimiento (detector de actividad con
+  histeresis) y estima el consumo a partir del ciclo de trabajo. No depende del SDK, por lo que tambien
+  se compila en el PC para comparar los modos con vuelos grabados.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "power_model.h"
+
+/**
+ * @brief Umbrales por defecto del detector de actividad
+ *
+ * @param config umbrales que se quieren llenar.
+ * @param active_hz frecuencia del IMU en movimiento.
+ * @param idle_hz frecuencia del IMU en reposo.
+ */
+void activity_config_defaults(activity_config_t *config, uint16_t active_hz, uint16_t idle_hz)
+{
+    config->active_hz = active_hz;
+    config->idle_hz = idle_hz < active_hz ? idle_hz : active_hz;
+    config->gyro_threshold = 262;
+    config->accel_threshold = 820;
+    config->still_us = 2000000;
+}
+
+/**
+ * @brief Reinicia el detector; empieza en movimiento
+ *
+ * @param activity detector que se quiere reiniciar.
+ */
+void activity_reset(activity_t *activity)
+{
+    memset(activity, 0, sizeof(*activity));
+}
+
+/**
+ * @brief Agrega una muestra al detector de actividad
+ *
+ * Un eje del giroscopio por encima del umbral, o un cambio del acelerometro entre muestras por encima
+ * del suyo, cuenta como movimiento y devuelve de inmediato la frecuencia alta. La frecuencia baja
+ * solo se usa despues de still_us sin movimiento, para no cambiar de modo en cada vibracion.
+ *
+ * @param activity estado del detector.
+ * @param config umbrales del detector.
+ * @param accel aceleracion cruda.
+ * @param gyro velocidad angular cruda, sin el offset de calibracion.
+ * @param t_us hora de la muestra en microsegundos.
+ * @return uint16_t retorna la frecuencia del IMU que se debe usar.
+ */
+uint16_t activity_update(activity_t *activity, const activity_config_t *config, const int16_t accel[3], const int16_t gyro[3], uint64_t t_us)
+{
+    bool moving = !activity->started;
+    for (int i = 0; i < 3; i++) {
+        if (abs(gyro[i]) > config->gyro_threshold) moving = true;
+        if (activity->started && abs(accel[i] - activity->last_acc[i]) > config->accel_threshold) moving = true;
+        activity->last_acc[i] = accel[i];
+    }
+
+    if (activity->started) {
+        uint64_t elapsed = t_us - activity->last_us;
+        if (activity->idle) activity->idle_us += elapsed;
+        else activity->active_us += elapsed;
+    }
+    activity->started = true;
+    activity->last_us = t_us;
+
+    if (moving) {
+        activity->last_motion_us = t_us;
+    }
+    bool idle = t_us - activity->last_motion_us >= config->still_us;
+    if (idle != activity->idle) {
+        activity->idle = idle;
+        activity->transitions++;
+    }
+    return idle ? config->idle_hz : config->active_hz;
+}
+
+/**
+ * @brief Ciclo de trabajo del procesador para una frecuencia del IMU
+ *
+ * @param imu_hz frecuencia de muestreo del IMU.
+ * @return float retorna la fraccion del tiempo despierto (0 a 1).
+ */
+float power_duty_for_rate(uint16_t imu_hz)
+{
+    float duty = imu_hz * (POWER_SAMPLE_US * 1e-6f);
+    return duty < 1 ? duty : 1;
+}
+
+/**
+ * @brief Corriente promedio estimada del Pico y del IMU
+ *
+ * @param duty fraccion del tiempo que el procesador esta despierto.
+ * @return float retorna la corriente en mA.
+ */
+float power_estimate_ma(float duty)
+{
+    return duty * POWER_MCU_ACTIVE_MA + (1 - duty) * POWER_MCU_SLEEP_MA + POWER_IMU_MA;
+}
\ No newline at end of file
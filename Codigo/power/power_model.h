@@ -0,0 +1,41 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef power_model_h
+#define power_model_h
+
+// Supply currents used for the estimate, typical datasheet values at 3.3 V
+#define POWER_MCU_ACTIVE_MA 24.0f  // RP2040 running from the 125 MHz system clock
+#define POWER_MCU_SLEEP_MA 8.0f    // RP2040 in WFI with the clocks still running
+#define POWER_IMU_MA 3.7f          // MPU9250 with gyro and accel on (the rate barely changes it)
+#define POWER_SAMPLE_US 250        // Awake time per IMU sample: wake up, SPI burst and activity check
+
+/**
+ * @brief Umbrales del detector de actividad.
+ */
+typedef struct {
+    uint16_t active_hz, idle_hz;  // IMU rate while moving and while still
+    int16_t gyro_threshold;       // Raw counts, 262 is 2 deg/s at +-250 deg/s
+    int16_t accel_threshold;      // Raw change between samples, 820 is 0.05 g at +-2 g
+    uint32_t still_us;            // Time below both thresholds before going idle
+} activity_config_t;
+
+/**
+ * @brief Estado del detector de actividad.
+ */
+typedef struct {
+    bool started, idle;
+    int16_t last_acc[3];
+    uint64_t last_us, last_motion_us;
+    uint64_t active_us, idle_us;  // Time spent in each state
+    uint32_t transitions;
+} activity_t;
+
+void activity_config_defaults(activity_config_t *config, uint16_t active_hz, uint16_t idle_hz);
+void activity_reset(activity_t *activity);
+uint16_t activity_update(activity_t *activity, const activity_config_t *config, const int16_t accel[3], const int16_t gyro[3], uint64_t t_us);
+
+float power_duty_for_rate(uint16_t imu_hz);
+float power_estimate_ma(float duty);
+
+#endif
\ No newline at end of file
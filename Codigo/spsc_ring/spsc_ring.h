@@ -0,0 +1,273 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifndef spsc_ring_h
+#define spsc_ring_h
+
+/*
+ * Cola circular sin bloqueos de un productor y un consumidor.
+ *
+ * Solo el productor escribe head y solo el consumidor escribe tail; los dos son contadores que
+ * nunca se reinician, asi head - tail es el numero de elementos aunque den la vuelta. Los datos se
+ * publican con una escritura release de head y se liberan con una escritura release de tail, por lo
+ * que la cola sirve entre una interrupcion y el programa y entre los dos nucleos del RP2040 (no tiene
+ * cache, la barrera basta). No sirve con dos productores o dos consumidores.
+ */
+
+#if defined(__arm__)
+#define SPSC_RING_ALIGN 4   // No cache on the RP2040, don't waste RAM on padding
+#else
+#define SPSC_RING_ALIGN 64  // Keep head and tail on different cache lines on the PC
+#endif
+
+#ifdef __cplusplus
+#define SPSC_RING_STATIC_ASSERT static_assert
+#else
+#define SPSC_RING_STATIC_ASSERT _Static_assert
+#endif
+
+#define SPSC_RING_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SPSC_RING_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/**
+ * @brief Cola de elementos de tamaño fijo. La capacidad debe ser potencia de dos.
+ */
+typedef struct {
+    uint32_t head __attribute__((aligned(SPSC_RING_ALIGN)));  // Elements ever written, owned by the producer
+    uint32_t tail __attribute__((aligned(SPSC_RING_ALIGN)));  // Elements ever read, owned by the consumer
+    uint32_t mask __attribute__((aligned(SPSC_RING_ALIGN)));  // Capacity - 1
+    uint32_t elem_size;
+    uint8_t *data;
+} spsc_ring_t;
+
+/**
+ * @brief Declara una cola estatica con su memoria.
+ */
+#define SPSC_RING_DEFINE(name, type, capacity) \
+    SPSC_RING_STATIC_ASSERT((capacity) > 0 && ((capacity) & ((capacity) - 1)) == 0, "capacity must be a power of two"); \
+    static type name##_storage[capacity]; \
+    static spsc_ring_t name = {0, 0, (capacity) - 1, sizeof(type), (uint8_t *)name##_storage}
+
+/**
+ * @brief Inicializa una cola sobre una memoria dada
+ *
+ * @param ring cola que se quiere inicializar.
+ * @param storage memoria para capacity elementos.
+ * @param capacity numero de elementos, potencia de dos.
+ * @param elem_size tamaño de cada elemento en bytes.
+ * @return bool retorna false si la capacidad no es potencia de dos.
+ */
+static inline bool spsc_ring_init(spsc_ring_t *ring, void *storage, uint32_t capacity, uint32_t elem_size)
+{
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return false;
+    }
+    ring->head = ring->tail = 0;
+    ring->mask = capacity - 1;
+    ring->elem_size = elem_size;
+    ring->data = (uint8_t *)storage;
+    return true;
+}
+
+static inline uint32_t spsc_ring_capacity(const spsc_ring_t *ring)
+{
+    return ring->mask + 1;
+}
+
+/**
+ * @brief Elementos en la cola. Exacto para el consumidor; para el productor puede ser mayor que el real.
+ */
+static inline uint32_t spsc_ring_count(const spsc_ring_t *ring)
+{
+    return SPSC_RING_LOAD(&ring->head) - SPSC_RING_LOAD(&ring->tail);
+}
+
+static inline bool spsc_ring_empty(const spsc_ring_t *ring)
+{
+    return spsc_ring_count(ring) == 0;
+}
+
+/**
+ * @brief Espacio libre contiguo para escribir sin copiar (productor)
+ *
+ * El espacio puede ser menor que el libre total cuando la cola da la vuelta; despues de
+ * spsc_ring_write_commit se puede pedir el resto.
+ *
+ * @param ring cola.
+ * @param span puntero donde se guarda la direccion del espacio.
+ * @return uint32_t retorna el numero de elementos que caben en el espacio.
+ */
+static inline uint32_t spsc_ring_write_span(spsc_ring_t *ring, void **span)
+{
+    uint32_t head = ring->head;
+    uint32_t free_count = spsc_ring_capacity(ring) - (head - SPSC_RING_LOAD(&ring->tail));
+    uint32_t index = head & ring->mask;
+    uint32_t contiguous = spsc_ring_capacity(ring) - index;
+
+    *span = ring->data + index * ring->elem_size;
+    return free_count < contiguous ? free_count : contiguous;
+}
+
+/**
+ * @brief Publica elementos escritos en el espacio de spsc_ring_write_span (productor)
+ */
+static inline void spsc_ring_write_commit(spsc_ring_t *ring, uint32_t count)
+{
+    SPSC_RING_STORE(&ring->head, ring->head + count);
+}
+
+/**
+ * @brief Elementos contiguos para leer sin copiar (consumidor)
+ *
+ * @param ring cola.
+ * @param span puntero donde se guarda la direccion del primer elemento.
+ * @return uint32_t retorna el numero de elementos contiguos disponibles.
+ */
+static inline uint32_t spsc_ring_read_span(spsc_ring_t *ring, const void **span)
+{
+    uint32_t tail = ring->tail;
+    uint32_t count = SPSC_RING_LOAD(&ring->head) - tail;
+    uint32_t index = tail & ring->mask;
+    uint32_t contiguous = spsc_ring_capacity(ring) - index;
+
+    *span = ring->data + index * ring->elem_size;
+    return count < contiguous ? count : contiguous;
+}
+
+/**
+ * @brief Libera elementos leidos con spsc_ring_read_span (consumidor)
+ */
+static inline void spsc_ring_read_commit(spsc_ring_t *ring, uint32_t count)
+{
+    SPSC_RING_STORE(&ring->tail, ring->tail + count);
+}
+
+/**
+ * @brief Agrega hasta count elementos (productor)
+ *
+ * @return uint32_t retorna los elementos agregados; menos de count si la cola se lleno.
+ */
+static inline uint32_t spsc_ring_push_n(spsc_ring_t *ring, const void *items, uint32_t count)
+{
+    const uint8_t *src = (const uint8_t *)items;
+    uint32_t done = 0;
+    for (int part = 0; part < 2 && done < count; part++) { // At most two pieces: up to the end, then from the start
+        void *span;
+        uint32_t n = spsc_ring_write_span(ring, &span);
+        if (n == 0) break;
+        if (n > count - done) n = count - done;
+        memcpy(span, src + done * ring->elem_size, n * ring->elem_size);
+        done += n;
+        spsc_ring_write_commit(ring, n);
+    }
+    return done;
+}
+
+/**
+ * @brief Saca hasta count elementos (consumidor)
+ *
+ * @return uint32_t retorna los elementos copiados.
+ */
+static inline uint32_t spsc_ring_pop_n(spsc_ring_t *ring, void *items, uint32_t count)
+{
+    uint8_t *dst = (uint8_t *)items;
+    uint32_t done = 0;
+    for (int part = 0; part < 2 && done < count; part++) {
+        const void *span;
+        uint32_t n = spsc_ring_read_span(ring, &span);
+        if (n == 0) break;
+        if (n > count - done) n = count - done;
+        memcpy(dst + done * ring->elem_size, span, n * ring->elem_size);
+        done += n;
+        spsc_ring_read_commit(ring, n);
+    }
+    return done;
+}
+
+/**
+ * @brief Agrega un elemento (productor)
+ *
+ * @return bool retorna false si la cola esta llena.
+ */
+static inline bool spsc_ring_push(spsc_ring_t *ring, const void *item)
+{
+    uint32_t head = ring->head;
+    if (head - SPSC_RING_LOAD(&ring->tail) > ring->mask) {
+        return false;
+    }
+    memcpy(ring->data + (head & ring->mask) * ring->elem_size, item, ring->elem_size);
+    SPSC_RING_STORE(&ring->head, head + 1);
+    return true;
+}
+
+/**
+ * @brief Saca un elemento (consumidor)
+ *
+ * @return bool retorna false si la cola esta vacia.
+ */
+static inline bool spsc_ring_pop(spsc_ring_t *ring, void *item)
+{
+    uint32_t tail = ring->tail;
+    if (SPSC_RING_LOAD(&ring->head) == tail) {
+        return false;
+    }
+    memcpy(item, ring->data + (tail & ring->mask) * ring->elem_size, ring->elem_size);
+    SPSC_RING_STORE(&ring->tail, tail + 1);
+    return true;
+}
+
+#ifdef __cplusplus
+#include <type_traits>
+
+extern "C++" { // The header may be included inside an extern "C" block
+/**
+ * @brief Version con tipo de spsc_ring_t: la memoria va dentro del objeto y los tamaños se conocen al compilar.
+ */
+template <typename T, uint32_t N>
+class SpscRing
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "elements are copied with memcpy");
+
+public:
+    SpscRing() { spsc_ring_init(&ring, storage, N, sizeof(T)); }
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    static constexpr uint32_t capacity() { return N; }
+    uint32_t size() const { return spsc_ring_count(&ring); }
+    bool empty() const { return spsc_ring_empty(&ring); }
+
+    // Producer side
+    bool push(const T &item) { return spsc_ring_push(&ring, &item); }
+    uint32_t push(const T *items, uint32_t count) { return spsc_ring_push_n(&ring, items, count); }
+    T *write_span(uint32_t &count)
+    {
+        void *span;
+        count = spsc_ring_write_span(&ring, &span);
+        return static_cast<T *>(span);
+    }
+    void write_commit(uint32_t count) { spsc_ring_write_commit(&ring, count); }
+
+    // Consumer side
+    bool pop(T &item) { return spsc_ring_pop(&ring, &item); }
+    uint32_t pop(T *items, uint32_t count) { return spsc_ring_pop_n(&ring, items, count); }
+    const T *read_span(uint32_t &count)
+    {
+        const void *span;
+        count = spsc_ring_read_span(&ring, &span);
+        return static_cast<const T *>(span);
+    }
+    void read_commit(uint32_t count) { spsc_ring_read_commit(&ring, count); }
+
+    spsc_ring_t *c_ring() { return &ring; } // For C code that takes a spsc_ring_t
+
+private:
+    spsc_ring_t ring;
+    T storage[N];
+};
+}
+#endif
+
+#endif
\ No newline at end of file
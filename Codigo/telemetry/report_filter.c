@@ -0,0 +1,129 @@
+/**
+  @file report_filter.c
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Filtro de banda muerta entre la adquisicion y el envio al servidor: una muestra solo se envia si la
+  posicion, la actitud, la aceleracion o la velocidad angular cambiaron mas que su umbral desde la
+  ultima muestra enviada, o si paso el tiempo maximo sin enviar. Las muestras descartadas se cuentan
+  para medir el ancho de banda ahorrado; no toman numero de secuencia.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+
+#include <math.h>
+#include <string.h>
+#include "report_filter.h"
+
+#define METERS_PER_DEGREE 111195.0f // Along a meridian, on the 6371 km sphere
+#define DEG_PER_RAD 57.29578f
+
+/**
+ * @brief Reinicia el filtro: la siguiente muestra siempre se envia.
+ *
+ * @param filter filtro que se quiere reiniciar.
+ */
+void report_filter_reset(report_filter_t *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+}
+
+/**
+ * @brief Indica si algun umbral esta activo.
+ *
+ * @param config umbrales del filtro.
+ * @return bool retorna false si se debe enviar cada muestra.
+ */
+bool report_filter_enabled(const report_filter_config_t *config)
+{
+    return config->position_m > 0 || config->attitude_deg > 0 || config->accel_g > 0 || config->gyro_dps > 0 || config->heartbeat_ms > 0;
+}
+
+/**
+ * @brief Inclinacion (pitch y roll) a partir de la direccion de la gravedad
+ *
+ * @param acc aceleracion en g.
+ * @param pitch puntero donde se guardara el pitch en grados.
+ * @param roll puntero donde se guardara el roll en grados.
+ */
+void report_attitude(const float acc[3], float *pitch, float *roll)
+{
+    *pitch = atan2f(acc[0], sqrtf(acc[1] * acc[1] + acc[2] * acc[2])) * DEG_PER_RAD;
+    *roll = atan2f(acc[1], acc[2]) * DEG_PER_RAD;
+}
+
+/**
+ * @brief Distancia aproximada entre dos posiciones cercanas (proyeccion equirectangular)
+ *
+ * @return float retorna la distancia en metros.
+ */
+float report_distance_m(float lat1, float lon1, float lat2, float lon2)
+{
+    float dy = (lat2 - lat1) * METERS_PER_DEGREE;
+    float dx = (lon2 - lon1) * METERS_PER_DEGREE * cosf((lat1 + lat2) * 0.5f / DEG_PER_RAD);
+    return sqrtf(dx * dx + dy * dy);
+}
+
+/**
+ * @brief Diferencia entre dos angulos en grados, en el rango de 0 a 180
+ */
+static float angle_change(float a, float b)
+{
+    float d = fabsf(a - b);
+    return d > 180 ? 360 - d : d;
+}
+
+/**
+ * @brief Decide si una muestra se envia.
+ *
+ * Compara la muestra con la ultima enviada. Si se envia, pasa a ser la referencia; si no, solo se
+ * cuenta como descartada. Con el filtro encendido siempre hay latido: si no se configuro, se usa
+ * REPORT_DEFAULT_HEARTBEAT_MS, asi el servidor distingue un equipo quieto de un enlace caido.
+ *
+ * @param filter estado del filtro.
+ * @param config umbrales del filtro.
+ * @param sample muestra que se quiere enviar.
+ * @return uint32_t retorna los motivos para enviarla (report_reason_t), 0 si se descarta.
+ */
+uint32_t report_filter_check(report_filter_t *filter, const report_filter_config_t *config, const telemetry_sample_t *sample)
+{
+    float pitch, roll;
+    uint32_t reasons = 0;
+
+    report_attitude(sample->acc, &pitch, &roll);
+    if (!report_filter_enabled(config)) {
+        reasons = REPORT_ALWAYS;
+    } else if (!filter->started) {
+        reasons = REPORT_FIRST;
+    } else {
+        if (config->position_m > 0 && report_distance_m(filter->lat, filter->lon, sample->lat, sample->lon) > config->position_m) {
+            reasons |= REPORT_POSITION;
+        }
+        if (config->attitude_deg > 0 &&
+            (angle_change(pitch, filter->pitch) > config->attitude_deg || angle_change(roll, filter->roll) > config->attitude_deg)) {
+            reasons |= REPORT_ATTITUDE;
+        }
+        for (int i = 0; i < 3; i++) {
+            if (config->accel_g > 0 && fabsf(sample->acc[i] - filter->acc[i]) > config->accel_g) reasons |= REPORT_ACCEL;
+            if (config->gyro_dps > 0 && fabsf(sample->gyro[i] - filter->gyro[i]) > config->gyro_dps) reasons |= REPORT_GYRO;
+        }
+        const uint32_t heartbeat_ms = config->heartbeat_ms ? config->heartbeat_ms : REPORT_DEFAULT_HEARTBEAT_MS;
+        if (sample->t_us - filter->last_us >= (uint64_t)heartbeat_ms * 1000) {
+            reasons |= REPORT_HEARTBEAT;
+        }
+    }
+
+    if (reasons == 0) {
+        filter->suppressed++;
+        return 0;
+    }
+    filter->started = true;
+    filter->lat = sample->lat;
+    filter->lon = sample->lon;
+    filter->pitch = pitch;
+    filter->roll = roll;
+    memcpy(filter->acc, sample->acc, sizeof(filter->acc));
+    memcpy(filter->gyro, sample->gyro, sizeof(filter->gyro));
+    filter->last_us = sample->t_us;
+    filter->sent++;
+    return reasons;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "telemetry.h"
+
+#ifndef report_filter_h
+#define report_filter_h
+
+#define REPORT_DEFAULT_HEARTBEAT_MS 10000 // Used when the filter is on without a heartbeat, a parked device still shows it is alive
+
+/**
+ * @brief Umbrales del filtro de reporte. Un umbral en cero no dispara envios; si todos estan en cero
+ * el filtro esta apagado y se envia cada muestra.
+ */
+typedef struct {
+    float position_m;       // Distance from the last sent position
+    float attitude_deg;     // Pitch or roll change from the last sent sample
+    float accel_g;          // Change on any accelerometer axis
+    float gyro_dps;         // Change on any gyroscope axis
+    uint32_t heartbeat_ms;  // Longest time without sending, 0 for REPORT_DEFAULT_HEARTBEAT_MS
+} report_filter_config_t;
+
+/**
+ * @brief Motivos por los que se envio una muestra (se pueden combinar).
+ */
+typedef enum {
+    REPORT_FIRST = 1,
+    REPORT_POSITION = 2,
+    REPORT_ATTITUDE = 4,
+    REPORT_ACCEL = 8,
+    REPORT_GYRO = 16,
+    REPORT_HEARTBEAT = 32,
+    REPORT_ALWAYS = 64,     // The filter is off
+} report_reason_t;
+
+/**
+ * @brief Estado del filtro: la ultima muestra enviada y los contadores.
+ */
+typedef struct {
+    bool started;
+    float lat, lon, pitch, roll;
+    float acc[3], gyro[3];
+    uint64_t last_us;
+    uint32_t sent, suppressed;
+} report_filter_t;
+
+void report_filter_reset(report_filter_t *filter);
+bool report_filter_enabled(const report_filter_config_t *config);
+uint32_t report_filter_check(report_filter_t *filter, const report_filter_config_t *config, const telemetry_sample_t *sample);
+void report_attitude(const float acc[3], float *pitch, float *roll);
+float report_distance_m(float lat1, float lon1, float lat2, float lon2);
+
+#endif
\ No newline at end of file
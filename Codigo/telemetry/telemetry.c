@@ -0,0 +1,244 @@
+/**
+  @file telemetry.c
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Este archivo arma la trama de texto que se envia al servidor a partir de una muestra de telemetria.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+
+#include <string.h>
+#include "telemetry.h"
+
+#define FIELD_MAX 56 // Longest field: comma, sign, 39 integer digits of FLT_MAX, point and 6 decimals
+
+static const uint32_t POW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+/**
+ * @brief Divide un entero de 64 bits por un divisor menor que 2^16 usando solo divisiones de 32 bits.
+ *
+ * El M0+ no tiene division de 64 bits y la llamada a la libreria (__aeabi_uldivmod) es lenta. Se
+ * divide de a 16 bits como en una division larga: el resto por 2^16 mas el siguiente pedazo cabe en 32 bits.
+ *
+ * @param value dividendo, queda con el cociente.
+ * @param divisor divisor, de 1 a 65535.
+ * @return uint32_t retorna el resto.
+ */
+static uint32_t divide_small(uint64_t *value, uint32_t divisor)
+{
+    uint32_t hi = (uint32_t)(*value >> 32), lo = (uint32_t)*value;
+    uint32_t pieces[4] = {hi >> 16, hi & 0xFFFF, lo >> 16, lo & 0xFFFF};
+    uint32_t rem = 0;
+
+    for (int i = 0; i < 4; i++) {
+        uint32_t cur = rem << 16 | pieces[i];
+        pieces[i] = cur / divisor;
+        rem = cur % divisor;
+    }
+    *value = (uint64_t)(pieces[0] << 16 | pieces[1]) << 32 | (pieces[2] << 16 | pieces[3]);
+    return rem;
+}
+
+/**
+ * @brief Escribe un entero sin signo en decimal.
+ *
+ * @param out arreglo donde se escriben los digitos, sin terminar en cero.
+ * @param value valor.
+ * @return char* retorna el puntero despues del ultimo digito.
+ */
+char *telemetry_put_u64(char *out, uint64_t value)
+{
+    char digits[20];
+    int n = 0;
+
+    // Four digits at a time with 32 bit divisions until the rest fits in 32 bits
+    while (value > UINT32_MAX) {
+        uint32_t r = divide_small(&value, 10000);
+        for (int i = 0; i < 4; i++) {
+            digits[n++] = '0' + r % 10;
+            r /= 10;
+        }
+    }
+    uint32_t v = (uint32_t)value;
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    while (n) *out++ = digits[--n];
+    return out;
+}
+
+/**
+ * @brief Escribe un entero con signo en decimal.
+ */
+char *telemetry_put_i64(char *out, int64_t value)
+{
+    if (value < 0) {
+        *out++ = '-';
+        return telemetry_put_u64(out, -(uint64_t)value);
+    }
+    return telemetry_put_u64(out, value);
+}
+
+/**
+ * @brief Escribe un entero de hasta 128 bits guardado en palabras de 32 bits (la menos significativa primero).
+ *
+ * Solo hace falta para numeros de 2^64 o mas, que no caben en un uint64_t.
+ */
+static char *put_wide(char *out, uint32_t words[4])
+{
+    char digits[40];
+    int n = 0;
+    bool zero;
+
+    do {
+        uint64_t rem = 0;
+        zero = true;
+        for (int i = 3; i >= 0; i--) {
+            uint64_t cur = (rem << 32) | words[i];
+            words[i] = (uint32_t)(cur / 10);
+            rem = cur % 10;
+            if (words[i]) zero = false;
+        }
+        digits[n++] = '0' + rem;
+    } while (!zero);
+
+    while (n) *out++ = digits[--n];
+    return out;
+}
+
+/**
+ * @brief Escribe un float con un numero fijo de decimales, igual que printf("%.Nf").
+ *
+ * Trabaja sobre los bits del float con enteros: el valor es m * 2^e, asi que m * 10^N * 2^e se
+ * redondea de forma exacta (al par en los empates, como printf) sin usar punto flotante. Escribe
+ * "nan" e "inf" como la libreria de C del PC.
+ *
+ * @param out arreglo donde se escribe el numero, sin terminar en cero (hasta 47 caracteres).
+ * @param value valor.
+ * @param decimals numero de decimales, de 0 a 6.
+ * @return char* retorna el puntero despues del ultimo caracter.
+ */
+char *telemetry_put_fixed(char *out, float value, int decimals)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t mantissa = bits & 0x7FFFFF;
+    int exponent = (bits >> 23) & 0xFF;
+
+    if (bits >> 31) *out++ = '-'; // Also for -0 and values that round to zero, like printf
+    if (exponent == 0xFF) {
+        memcpy(out, mantissa ? "nan" : "inf", 3);
+        return out + 3;
+    }
+    if (exponent) {
+        mantissa |= 0x800000;  // Implicit leading one
+    } else {
+        exponent = 1;          // Subnormal
+    }
+    int shift = exponent - 150; // value = mantissa * 2^shift
+
+    uint64_t scaled; // round(value * 10^decimals)
+    if (shift >= 0) {
+        // Whole number: no rounding, but it may need up to 128 bits
+        if (shift > 20) { // 2^24 * 2^20 * 10^6 would not fit in 64 bits
+            uint32_t words[4] = {0, 0, 0, 0};
+            uint64_t m = (uint64_t)mantissa << (shift % 32);
+            words[shift / 32] = (uint32_t)m;
+            if (shift / 32 + 1 < 4) words[shift / 32 + 1] = (uint32_t)(m >> 32);
+            out = put_wide(out, words);
+            if (decimals) {
+                *out++ = '.';
+                memset(out, '0', decimals);
+                out += decimals;
+            }
+            return out;
+        }
+        scaled = ((uint64_t)mantissa << shift) * POW10[decimals];
+    } else {
+        uint64_t product = (uint64_t)mantissa * POW10[decimals]; // Below 2^44
+        int s = -shift;
+        if (s >= 64) {
+            scaled = 0; // Below 2^-20, far from half a unit
+        } else {
+            scaled = product >> s;
+            uint64_t rem = product & ((1ull << s) - 1), half = 1ull << (s - 1);
+            if (rem > half || (rem == half && (scaled & 1))) scaled++;
+        }
+    }
+
+    // Every realistic field fits in 32 bits and takes one 32 bit division
+    uint64_t whole = scaled;
+    uint32_t fraction = 0;
+    if (scaled <= UINT32_MAX) {
+        whole = (uint32_t)scaled / POW10[decimals];
+        fraction = (uint32_t)scaled - (uint32_t)whole * POW10[decimals];
+    } else {
+        for (int i = 0; i < decimals; i++) fraction += divide_small(&whole, 10) * POW10[i];
+    }
+    out = telemetry_put_u64(out, whole);
+    if (decimals) {
+        *out++ = '.';
+        for (int i = decimals - 1; i >= 0; i--) {
+            out[i] = '0' + fraction % 10;
+            fraction /= 10;
+        }
+        out += decimals;
+    }
+    return out;
+}
+
+/**
+ * @brief Agrega texto a la linea sin pasarse del tamaño del arreglo.
+ */
+static void append(char *buf, size_t size, size_t *length, const char *text, size_t n)
+{
+    if (*length + 1 >= size) return;
+    if (n > size - 1 - *length) n = size - 1 - *length;
+    memcpy(buf + *length, text, n);
+    *length += n;
+}
+
+/**
+ * @brief Escribe una muestra como linea CSV.
+ *
+ * Los 11 primeros campos son los de siempre (Latitud,Longitud,accx,...,magz); despues van el numero
+ * de secuencia, la hora del equipo y la hora UTC en microsegundos. La salida es la misma que daba
+ * snprintf con "%.6f,%.6f,%.4f,...", pero sin printf ni operaciones de punto flotante.
+ *
+ * @param sample muestra que se quiere escribir.
+ * @param buf arreglo donde se escribe la linea, terminada en cero.
+ * @param size tamaño del arreglo.
+ * @return int retorna el numero de caracteres escritos, sin contar el cero.
+ */
+int telemetry_format_csv(const telemetry_sample_t *sample, char *buf, size_t size)
+{
+    const float *imu[9] = {&sample->acc[0], &sample->acc[1], &sample->acc[2], &sample->gyro[0], &sample->gyro[1],
+                           &sample->gyro[2], &sample->mag[0], &sample->mag[1], &sample->mag[2]};
+    char field[FIELD_MAX];
+    size_t length = 0;
+
+    if (size == 0) {
+        return 0;
+    }
+
+    char *end = telemetry_put_fixed(field, sample->lat, 6);
+    append(buf, size, &length, field, end - field);
+    field[0] = ',';
+    end = telemetry_put_fixed(field + 1, sample->lon, 6);
+    append(buf, size, &length, field, end - field);
+    for (int i = 0; i < 9; i++) {
+        end = telemetry_put_fixed(field + 1, *imu[i], 4);
+        append(buf, size, &length, field, end - field);
+    }
+    end = telemetry_put_u64(field + 1, sample->seq);
+    append(buf, size, &length, field, end - field);
+    end = telemetry_put_u64(field + 1, sample->t_us);
+    append(buf, size, &length, field, end - field);
+    end = telemetry_put_i64(field + 1, sample->utc_us);
+    append(buf, size, &length, field, end - field);
+
+    buf[length] = '\0';
+    return length;
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef telemetry_h
+#define telemetry_h
+
+#define TELEMETRY_CSV_MAX 192 // Longest CSV line telemetry_format_csv can write, with the terminating 0
+
+/**
+ * @brief Muestra de telemetria: posicion, IMU en unidades fisicas, numero de secuencia y horas.
+ */
+typedef struct {
+    uint32_t seq;      // Increments on every sample, gaps mean lost samples
+    uint64_t t_us;     // Monotonic device time (time_us_64) when the IMU was read
+    int64_t utc_us;    // UTC estimated from the GPS, microseconds since 1970, 0 without GPS time
+    float lat, lon;
+    float acc[3], gyro[3], mag[3];
+} telemetry_sample_t;
+
+int telemetry_format_csv(const telemetry_sample_t *sample, char *buf, size_t size);
+char *telemetry_put_fixed(char *out, float value, int decimals);
+char *telemetry_put_u64(char *out, uint64_t value);
+char *telemetry_put_i64(char *out, int64_t value);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,151 @@
+/**
+  @file telemetry_frame.c
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Este archivo arma y lee las tramas binarias (IMU y GPS) que se envian por USB a alta frecuencia.
+  Lo usan el firmware para transmitir y la herramienta de captura del PC para leer.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+
+#include <string.h>
+#include "telemetry_frame.h"
+
+#define IMU_PAYLOAD 20
+#define GPS_PAYLOAD 16
+
+/**
+ * @brief CRC-16/CCITT (polinomio 0x1021, valor inicial 0xFFFF)
+ *
+ * @param data bytes.
+ * @param length numero de bytes.
+ * @return uint16_t retorna el CRC.
+ */
+uint16_t telemetry_crc16(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint8_t *put_le(uint8_t *p, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++) {
+        *p++ = value >> (8 * i);
+    }
+    return p;
+}
+
+static uint64_t get_le(const uint8_t *p, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+/**
+ * @brief Escribe una trama
+ *
+ * @param frame trama que se quiere escribir.
+ * @param out arreglo de al menos TELEMETRY_FRAME_MAX bytes.
+ * @return size_t retorna el numero de bytes escritos, 0 si el tipo no existe.
+ */
+size_t telemetry_frame_encode(const telemetry_frame_t *frame, uint8_t *out)
+{
+    uint8_t *p = out + TELEMETRY_FRAME_HEADER;
+
+    if (frame->type == TELEMETRY_FRAME_IMU) {
+        for (int i = 0; i < 3; i++) p = put_le(p, (uint16_t)frame->imu.acc[i], 2);
+        for (int i = 0; i < 3; i++) p = put_le(p, (uint16_t)frame->imu.gyro[i], 2);
+        for (int i = 0; i < 3; i++) p = put_le(p, (uint16_t)frame->imu.mag[i], 2);
+        p = put_le(p, (uint16_t)frame->imu.temp, 2);
+    } else if (frame->type == TELEMETRY_FRAME_GPS) {
+        p = put_le(p, (uint32_t)frame->gps.lat_e7, 4);
+        p = put_le(p, (uint32_t)frame->gps.lon_e7, 4);
+        p = put_le(p, (uint64_t)frame->gps.utc_us, 8);
+    } else {
+        return 0;
+    }
+
+    out[0] = TELEMETRY_FRAME_SYNC0;
+    out[1] = TELEMETRY_FRAME_SYNC1;
+    out[2] = frame->type;
+    out[3] = p - out - TELEMETRY_FRAME_HEADER;
+    put_le(out + 4, frame->seq, 4);
+    put_le(out + 8, frame->t_us, 8);
+    p = put_le(p, telemetry_crc16(out, p - out), 2);
+    return p - out;
+}
+
+/**
+ * @brief Lee la primera trama de un arreglo de bytes
+ *
+ * Si los bytes no empiezan con una trama valida (sincronizacion, tamaño o CRC malos) indica cuantos
+ * bytes saltar para buscar la siguiente, asi el lector se recupera de bytes perdidos.
+ *
+ * @param data bytes recibidos.
+ * @param length numero de bytes.
+ * @param frame trama leida.
+ * @param used bytes consumidos (la trama o los que hay que saltar).
+ * @return int retorna 1 si leyo una trama, 0 si faltan bytes y -1 si hay que saltar *used bytes.
+ */
+int telemetry_frame_decode(const uint8_t *data, size_t length, telemetry_frame_t *frame, size_t *used)
+{
+    *used = 0;
+    size_t skip = 0;
+    while (skip < length && data[skip] != TELEMETRY_FRAME_SYNC0) skip++;
+    if (skip) {
+        *used = skip;
+        return -1;
+    }
+    if (length < 2) {
+        return 0;
+    }
+    if (data[1] != TELEMETRY_FRAME_SYNC1) {
+        *used = 1;
+        return -1;
+    }
+    if (length < TELEMETRY_FRAME_HEADER) {
+        return 0;
+    }
+
+    uint8_t type = data[2], payload = data[3];
+    if ((type == TELEMETRY_FRAME_IMU && payload != IMU_PAYLOAD) || (type == TELEMETRY_FRAME_GPS && payload != GPS_PAYLOAD)
+        || (type != TELEMETRY_FRAME_IMU && type != TELEMETRY_FRAME_GPS)) {
+        *used = 1;
+        return -1;
+    }
+    size_t total = TELEMETRY_FRAME_HEADER + payload + 2;
+    if (length < total) {
+        return 0;
+    }
+    if (telemetry_crc16(data, total - 2) != get_le(data + total - 2, 2)) {
+        *used = 1;
+        return -1;
+    }
+
+    memset(frame, 0, sizeof(*frame));
+    frame->type = type;
+    frame->seq = get_le(data + 4, 4);
+    frame->t_us = get_le(data + 8, 8);
+    const uint8_t *p = data + TELEMETRY_FRAME_HEADER;
+    if (type == TELEMETRY_FRAME_IMU) {
+        for (int i = 0; i < 3; i++) frame->imu.acc[i] = (int16_t)get_le(p + 2 * i, 2);
+        for (int i = 0; i < 3; i++) frame->imu.gyro[i] = (int16_t)get_le(p + 6 + 2 * i, 2);
+        for (int i = 0; i < 3; i++) frame->imu.mag[i] = (int16_t)get_le(p + 12 + 2 * i, 2);
+        frame->imu.temp = (int16_t)get_le(p + 18, 2);
+    } else {
+        frame->gps.lat_e7 = (int32_t)get_le(p, 4);
+        frame->gps.lon_e7 = (int32_t)get_le(p + 4, 4);
+        frame->gps.utc_us = (int64_t)get_le(p + 8, 8);
+    }
+    *used = total;
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef telemetry_frame_h
+#define telemetry_frame_h
+
+#define TELEMETRY_FRAME_SYNC0 0xA5
+#define TELEMETRY_FRAME_SYNC1 0x5A
+#define TELEMETRY_FRAME_HEADER 16  // sync(2) type(1) length(1) seq(4) t_us(8)
+#define TELEMETRY_FRAME_MAX 64     // Longest frame, header and CRC included
+
+/**
+ * @brief Tipos de trama binaria.
+ */
+typedef enum {
+    TELEMETRY_FRAME_IMU = 1,
+    TELEMETRY_FRAME_GPS = 2,
+} telemetry_frame_type_t;
+
+/**
+ * @brief Trama binaria de la transmision por USB.
+ *
+ * En el cable todos los campos van en little endian: encabezado, datos y un CRC-16/CCITT de todo lo
+ * anterior. seq cuenta todas las tramas generadas, tambien las que se perdieron, asi que un salto
+ * en seq es el numero de tramas perdidas.
+ */
+typedef struct {
+    uint8_t type;
+    uint32_t seq;
+    uint64_t t_us;     // Device time (time_us_64) of the reading
+    union {
+        struct {
+            int16_t acc[3], gyro[3], mag[3], temp;  // Raw counts
+        } imu;
+        struct {
+            int32_t lat_e7, lon_e7;  // Degrees * 10^7
+            int64_t utc_us;          // UTC of the fix, 0 without time
+        } gps;
+    };
+} telemetry_frame_t;
+
+uint16_t telemetry_crc16(const uint8_t *data, size_t length);
+size_t telemetry_frame_encode(const telemetry_frame_t *frame, uint8_t *out);
+int telemetry_frame_decode(const uint8_t *data, size_t length, telemetry_frame_t *frame, size_t *used);
+
+#endif
\ No newline at end of file
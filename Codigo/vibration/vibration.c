@@ -0,0 +1,306 @@
+/**
+  @file vibration.c
+  @brief Universidad De Antioquia - Departamento de Ingenieria Electronica - Laboratorio N°3 - Telemetria - Electronica Digital III
+  Analisis de vibraciones a bordo. Junta ventanas de 256 o 512 muestras del acelerometro por eje, les
+  quita la media, aplica una ventana de Hann y calcula una FFT real en punto fijo (Q15 con exponente de
+  bloque). De cada eje solo sale el RMS, el pico del espectro y la energia por bandas, que caben en el
+  enlace del ESP aunque las muestras crudas a 1 kHz no quepan.
+  @author Sebastian Bernal Cuaspa & Kevin David Martinez Zapata.
+  @date 8/05/2023
+
+*/
+
+#include <math.h>
+#include <string.h>
+#include "vibration.h"
+#include "telemetry.h"
+
+#define Q15_ONE 32767
+#define FFT_INPUT_MAX 16383   // Largest input component: magnitudes stay below 2^15 through every stage
+#define HANN_POWER_GAIN 0.375f // Mean of the squared Hann window
+#define HANN_AMPLITUDE_GAIN 0.5f
+#define FIELD_MAX 48
+
+/**
+ * @brief Prepara las tablas de la FFT y la ventana
+ *
+ * @param vib estado que se quiere preparar.
+ * @param points muestras por ventana, potencia de dos entre 64 y VIBRATION_MAX_POINTS.
+ * @param rate_hz frecuencia de muestreo del acelerometro.
+ * @param g_per_count g que vale una cuenta del acelerometro.
+ * @return bool retorna false si el tamaño no es valido.
+ */
+bool vibration_init(vibration_t *vib, uint16_t points, uint16_t rate_hz, float g_per_count)
+{
+    if (points < 64 || points > VIBRATION_MAX_POINTS || (points & (points - 1)) != 0 || rate_hz == 0) {
+        return false;
+    }
+    memset(vib, 0, sizeof(*vib));
+    vib->points = points;
+    vib->rate_hz = rate_hz;
+    vib->g_per_count = g_per_count;
+    vib->pending = -1;
+
+    // Only runs once, the soft float trigonometry is not in the sample path
+    const float step = 6.2831853f / points;
+    for (int n = 0; n < points; n++) {
+        vib->window[n] = (int16_t)lroundf(0.5f * (1 - cosf(step * n)) * Q15_ONE);
+    }
+    for (int k = 0; k < points / 2; k++) {
+        vib->twiddle[k][0] = (int16_t)lroundf(cosf(step * k) * Q15_ONE);
+        vib->twiddle[k][1] = (int16_t)lroundf(-sinf(step * k) * Q15_ONE);
+    }
+    return true;
+}
+
+/**
+ * @brief Multiplicacion Q15 con redondeo
+ */
+static inline int32_t q15_mul(int32_t a, int32_t b)
+{
+    return (a * b + (1 << 14)) >> 15;
+}
+
+/**
+ * @brief Multiplica por 2^shift (divide si es negativo), con redondeo
+ */
+static inline int32_t scale_pow2(int32_t v, int shift)
+{
+    return shift >= 0 ? v * (1 << shift) : (v + (1 << (-shift - 1))) >> -shift;
+}
+
+/**
+ * @brief Espectro de potencia de una ventana
+ *
+ * Los N valores reales se tratan como N/2 complejos (pares en la parte real, impares en la imaginaria),
+ * se transforman con una FFT radix 2 que divide por dos en cada etapa, y al final se separan los dos
+ * espectros para obtener las N/2 + 1 frecuencias de la FFT real. Antes de la FFT la ventana se corre
+ * para que su mayor valor quede cerca de FFT_INPUT_MAX, asi las señales pequeñas no pierden bits.
+ *
+ * @param vib estado con las tablas (y la memoria de trabajo).
+ * @param samples muestras crudas de un eje.
+ * @param power salida de points / 2 + 1 valores: |X[k]|^2 / N^2 de la señal corrida.
+ * @return int retorna el corrimiento aplicado: la potencia de la señal original es power / 4^shift.
+ */
+int vibration_power_spectrum(vibration_t *vib, const int16_t *samples, uint32_t *power)
+{
+    const int n = vib->points, m = n / 2;
+    int16_t (*z)[2] = vib->fft;
+
+    int32_t sum = 0;
+    for (int i = 0; i < n; i++) sum += samples[i];
+    const int32_t mean = sum >= 0 ? (sum + n / 2) / n : -((-sum + n / 2) / n);
+
+    // Largest windowed value, to pick the block exponent. The products keep the 15 fraction bits of
+    // the window until the final shift, so small vibrations are not rounded to a few counts first.
+    int32_t peak = 0;
+    for (int i = 0; i < n; i++) {
+        int32_t v = (samples[i] - mean) * vib->window[i];
+        if (v < 0) v = -v;
+        if (v > peak) peak = v;
+    }
+    if (peak == 0) {
+        memset(power, 0, (m + 1) * sizeof(*power));
+        return 0;
+    }
+    int right = 0;
+    while ((peak >> right) > FFT_INPUT_MAX) right++;
+    const int32_t half = right ? 1 << (right - 1) : 0;
+
+    // Windowed, scaled and stored in bit reversed order
+    int bits = 0; // log2(m)
+    while ((1 << bits) < m) bits++;
+    for (int i = 0; i < m; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+        z[r][0] = ((samples[2 * i] - mean) * vib->window[2 * i] + half) >> right;
+        z[r][1] = ((samples[2 * i + 1] - mean) * vib->window[2 * i + 1] + half) >> right;
+    }
+    const int shift = 15 - right;
+
+    // Radix 2 decimation in time, halving every stage so nothing overflows
+    for (int len = 2; len <= m; len <<= 1) {
+        const int span = len / 2, step = n / len;
+        for (int start = 0; start < m; start += len) {
+            for (int j = 0; j < span; j++) {
+                const int32_t wr = vib->twiddle[j * step][0], wi = vib->twiddle[j * step][1];
+                int16_t *a = z[start + j], *b = z[start + j + span];
+                const int32_t tr = q15_mul(b[0], wr) - q15_mul(b[1], wi);
+                const int32_t ti = q15_mul(b[0], wi) + q15_mul(b[1], wr);
+                const int32_t ar = a[0], ai = a[1];
+                a[0] = (ar + tr + 1) >> 1;
+                a[1] = (ai + ti + 1) >> 1;
+                b[0] = (ar - tr + 1) >> 1;
+                b[1] = (ai - ti + 1) >> 1;
+            }
+        }
+    }
+
+    // Split the even and odd spectra: X[k] = (Z[k] + Z*[m-k]) / 2 - i W^k (Z[k] - Z*[m-k]) / 2
+    // The integer mean leaves the constant (sum / n - mean) in the signal; the Hann window only leaks it
+    // into bins 0 and 1 (n / 2 and -n / 4 times), where it is taken out
+    const int32_t rest = sum - mean * n;
+    const int32_t dc = ((z[0][0] + z[0][1]) >> 1) - scale_pow2(rest, shift - 2 - bits), nyquist = (z[0][0] - z[0][1]) >> 1;
+    power[0] = (uint32_t)(dc * dc);
+    power[m] = (uint32_t)(nyquist * nyquist);
+    for (int k = 1; k < m; k++) {
+        const int32_t er = (z[k][0] + z[m - k][0]) >> 1, ei = (z[k][1] - z[m - k][1]) >> 1;
+        const int32_t dr = (z[k][0] - z[m - k][0]) >> 1, di = (z[k][1] + z[m - k][1]) >> 1;
+        const int32_t wr = vib->twiddle[k][0], wi = vib->twiddle[k][1];
+        const int32_t pr = q15_mul(dr, wr) - q15_mul(di, wi), pi = q15_mul(dr, wi) + q15_mul(di, wr);
+        int32_t xr = (er + pi) >> 1, xi = (ei - pr) >> 1; // -i (pr + i pi) = pi - i pr
+        if (k == 1) {
+            xr += scale_pow2(rest, shift - 3 - bits);
+        }
+        power[k] = (uint32_t)(xr * xr) + (uint32_t)(xi * xi);
+    }
+    return shift;
+}
+
+/**
+ * @brief RMS, pico y bandas de un eje
+ *
+ * El RMS sale de las muestras (exacto); las bandas del espectro, corregidas por la potencia que quita
+ * la ventana. El pico se interpola con una parabola entre los bins vecinos.
+ *
+ * @param vib estado con las tablas.
+ * @param samples muestras crudas de un eje.
+ * @param axis salida.
+ */
+void vibration_analyse_axis(vibration_t *vib, const int16_t *samples, vibration_axis_t *axis)
+{
+    const int n = vib->points, m = n / 2;
+    uint32_t *power = vib->power;
+    const int shift = vibration_power_spectrum(vib, samples, power);
+
+    int32_t sum = 0;
+    for (int i = 0; i < n; i++) sum += samples[i];
+    int64_t sumSq = 0;
+    for (int i = 0; i < n; i++) {
+        int32_t d = samples[i] * n - sum; // n times the distance to the mean, stays exact
+        sumSq += (int64_t)d * d;
+    }
+    axis->rms_g = sqrtf((float)sumSq / ((float)n * n * n)) * vib->g_per_count;
+
+    // Band power over bins 1..m, the Nyquist bin counts once and the rest twice (one sided spectrum)
+    const float toG2 = ldexpf(vib->g_per_count * vib->g_per_count / HANN_POWER_GAIN, -2 * shift);
+    const int width = m / VIBRATION_BANDS;
+    int best = 1;
+    for (int b = 0; b < VIBRATION_BANDS; b++) {
+        uint64_t bandSum = 0;
+        for (int k = b == 0 ? 1 : b * width; k < (b + 1) * width; k++) {
+            bandSum += 2 * (uint64_t)power[k];
+            if (power[k] > power[best]) best = k;
+        }
+        if (b == VIBRATION_BANDS - 1) {
+            bandSum += power[m];
+        }
+        axis->band_g[b] = sqrtf((float)bandSum * toG2);
+    }
+
+    float a = sqrtf((float)power[best - 1]), c = best + 1 <= m ? sqrtf((float)power[best + 1]) : 0, p = sqrtf((float)power[best]);
+    float den = a - 2 * p + c, delta = den != 0 ? 0.5f * (a - c) / den : 0;
+    if (delta > 0.5f || delta < -0.5f) delta = 0;
+    axis->peak_hz = (best + delta) * vib->rate_hz / n;
+    axis->peak_g = ldexpf(p - 0.25f * (a - c) * delta, -shift) * 2 / HANN_AMPLITUDE_GAIN * vib->g_per_count;
+}
+
+/**
+ * @brief Agrega una lectura del acelerometro
+ *
+ * Cuando un juego de ventanas se llena se cambia al otro; el lleno se analiza un eje por llamada, asi
+ * el trabajo de cada muestra queda acotado a una FFT y la ventana termina tres muestras despues.
+ *
+ * @param vib estado.
+ * @param accel aceleracion cruda de los tres ejes.
+ * @param t_us hora de la lectura.
+ * @param out resumen de la ventana anterior cuando esta listo.
+ * @return bool retorna true si se escribio un resumen en out.
+ */
+bool vibration_add(vibration_t *vib, const int16_t accel[3], uint64_t t_us, vibration_summary_t *out)
+{
+    if (vib->count == 0) {
+        vib->start_us[vib->filling] = t_us;
+    }
+    for (int i = 0; i < 3; i++) {
+        vib->samples[vib->filling][i][vib->count] = accel[i];
+    }
+
+    bool ready = false;
+    if (vib->pending >= 0) {
+        vibration_analyse_axis(vib, vib->samples[vib->filling ^ 1][vib->pending], &vib->summary.axis[vib->pending]);
+        if (++vib->pending == 3) {
+            vib->pending = -1;
+            *out = vib->summary;
+            ready = true;
+        }
+    }
+
+    if (++vib->count == vib->points) {
+        vib->summary.seq = vib->seq++;
+        vib->summary.t_us = vib->start_us[vib->filling];
+        vib->summary.points = vib->points;
+        vib->summary.rate_hz = vib->rate_hz;
+        vib->filling ^= 1;
+        vib->count = 0;
+        vib->pending = 0;
+    }
+    return ready;
+}
+
+/**
+ * @brief Agrega un campo a la linea si cabe
+ */
+static void append(char *buf, size_t size, size_t *length, const char *field, size_t n)
+{
+    if (*length + n >= size) {
+        n = size - 1 - *length;
+    }
+    memcpy(buf + *length, field, n);
+    *length += n;
+}
+
+/**
+ * @brief Escribe un resumen como linea CSV.
+ *
+ * "VIB,seq,t_us,puntos,Hz" y por cada eje rms,pico_hz,pico_g y las VIBRATION_BANDS bandas, en g. La
+ * primera columna no es un numero: readPort.py la guarda aparte en vibraciones.csv, graficas.py y
+ * scan_telemetry_csv la saltan.
+ *
+ * @param summary resumen que se quiere escribir.
+ * @param buf arreglo donde se escribe la linea, terminada en cero.
+ * @param size tamaño del arreglo.
+ * @return int retorna el numero de caracteres escritos, sin contar el cero.
+ */
+int vibration_format_csv(const vibration_summary_t *summary, char *buf, size_t size)
+{
+    char field[FIELD_MAX];
+    size_t length = 0;
+
+    if (size == 0) {
+        return 0;
+    }
+    append(buf, size, &length, "VIB", 3);
+    field[0] = ',';
+    const uint64_t header[4] = {summary->seq, summary->t_us, summary->points, summary->rate_hz};
+    for (int i = 0; i < 4; i++) {
+        char *end = telemetry_put_u64(field + 1, header[i]);
+        append(buf, size, &length, field, end - field);
+    }
+    for (int a = 0; a < 3; a++) {
+        const vibration_axis_t *axis = &summary->axis[a];
+        char *end = telemetry_put_fixed(field + 1, axis->rms_g, 5);
+        append(buf, size, &length, field, end - field);
+        end = telemetry_put_fixed(field + 1, axis->peak_hz, 1);
+        append(buf, size, &length, field, end - field);
+        end = telemetry_put_fixed(field + 1, axis->peak_g, 5);
+        append(buf, size, &length, field, end - field);
+        for (int b = 0; b < VIBRATION_BANDS; b++) {
+            end = telemetry_put_fixed(field + 1, axis->band_g[b], 5);
+            append(buf, size, &length, field, end - field);
+        }
+    }
+
+    buf[length] = '\0';
+    return length;
+}
\ No newline at end of file
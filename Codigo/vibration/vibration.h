@@ -0,0 +1,59 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef vibration_h
+#define vibration_h
+
+#define VIBRATION_MAX_POINTS 512 // Largest window, in samples per axis
+#define VIBRATION_BANDS 8        // Equal width bands from the first bin to the Nyquist frequency
+#define VIBRATION_CSV_MAX 400    // Longest line vibration_format_csv can write, with the terminating 0
+
+/**
+ * @brief Resumen del espectro de un eje.
+ */
+typedef struct {
+    float rms_g;                    // RMS without the mean (gravity and offset)
+    float peak_hz, peak_g;          // Strongest bin above DC and the amplitude of a sine at that bin
+    float band_g[VIBRATION_BANDS];  // RMS of the vibration inside each band
+} vibration_axis_t;
+
+/**
+ * @brief Resumen de una ventana: lo unico que se envia al servidor.
+ */
+typedef struct {
+    uint32_t seq;          // Window number, gaps mean lost summaries
+    uint64_t t_us;         // Device time of the first sample of the window
+    uint16_t points, rate_hz;
+    vibration_axis_t axis[3];
+} vibration_summary_t;
+
+/**
+ * @brief Ventanas de aceleracion y tablas de la FFT.
+ *
+ * Hay dos juegos de ventanas: mientras uno se llena con las muestras nuevas, el otro se analiza un eje
+ * por muestra, asi ninguna llamada hace mas de una FFT.
+ */
+typedef struct {
+    uint16_t points, rate_hz;
+    float g_per_count;
+    int16_t window[VIBRATION_MAX_POINTS];          // Hann, Q15
+    int16_t twiddle[VIBRATION_MAX_POINTS / 2][2];  // cos and -sin of 2 pi k / points, Q15
+    int16_t samples[2][3][VIBRATION_MAX_POINTS];
+    int16_t fft[VIBRATION_MAX_POINTS / 2][2];      // Work memory of the FFT, complex Q15
+    uint32_t power[VIBRATION_MAX_POINTS / 2 + 1];
+    uint8_t filling;          // Set of windows being filled
+    uint16_t count;           // Samples in the set being filled
+    int8_t pending;           // Next axis of the full set to analyse, -1 when there is none
+    uint64_t start_us[2];
+    uint32_t seq;
+    vibration_summary_t summary;
+} vibration_t;
+
+bool vibration_init(vibration_t *vib, uint16_t points, uint16_t rate_hz, float g_per_count);
+bool vibration_add(vibration_t *vib, const int16_t accel[3], uint64_t t_us, vibration_summary_t *out);
+int vibration_power_spectrum(vibration_t *vib, const int16_t *samples, uint32_t *power);
+void vibration_analyse_axis(vibration_t *vib, const int16_t *samples, vibration_axis_t *axis);
+int vibration_format_csv(const vibration_summary_t *summary, char *buf, size_t size);
+
+#endif
\ No newline at end of file
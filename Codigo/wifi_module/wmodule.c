@@ -12,6 +12,7 @@
 #include "pico/stdlib.h"
 #include "hardware/uart.h"
 #include "wmodule.h"
+#include "config_store.h"
 
 #define UART_ID2 uart0
 #define BAUD_RATE 9600
@@ -25,11 +26,7 @@
 #define UART_TX_PIN 0
 #define UART_RX_PIN 1
 
-char SSID[] = "GLORIA";
-char password[] = "43G495E336Z";
-char ServerIP[] = "192.168.1.8";
-char Port[] = "80";
-char uart_command[50] = "";
+char uart_command[128] = "";
 char buf[1024] = {0};
 
 /**
@@ -60,7 +57,8 @@ void uart_init_wifi()
 bool send_sensor_values(const char *data)
 {
     // Open connection
-    sprintf(uart_command, "AT+CIPSTART=\"TCP\",\"%s\",%s", ServerIP, Port);
+    const config_t *config = config_get(); // Network settings live in the flash config block
+    sprintf(uart_command, "AT+CIPSTART=\"TCP\",\"%s\",%u", config->server_ip, config->server_port);
     sendCMD(uart_command, "OK");
 
     // Send data
@@ -138,6 +136,7 @@ void connectToWifi()
 {
     sendCMD("AT", "OK");
     sendCMD("AT+CWMODE=3", "OK");
-    sprintf(uart_command, "AT+CWJAP=\"%s\",\"%s\"", SSID, password);
+    const config_t *config = config_get();
+    sprintf(uart_command, "AT+CWJAP=\"%s\",\"%s\"", config->ssid, config->password);
     sendCMD(uart_command, "OK");
 }
\ No newline at end of file
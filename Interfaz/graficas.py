@@ -24,8 +24,12 @@ columna12 = []
 # Leer el archivo CSV y extraer los datos
 with open(archivo_csv, 'r') as file:
     csv_reader = csv.reader(file)
-    next(csv_reader)  # Saltar la primera fila
     for row in csv_reader:
+        # Saltar encabezados (readPort escribe uno cada vez que arranca) y lineas que no son muestras
+        try:
+            float(row[0])
+        except (ValueError, IndexError):
+            continue
         latitudes.append(float(row[0]))  # Convertir a flotante
         longitudes.append(float(row[1]))  # Convertir a flotante
         columna3.append(float(row[2]))  # Convertir a flotante